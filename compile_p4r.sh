@@ -37,7 +37,10 @@ mkdir -p ${output_path}
 output_base="${output_path}${infile_prefix}"
 output_c_fn="${output_base}_mantis.c"
 output_p4_fn="${output_base}_mantis.p4"
-output_include_fn="${output_base}_mantis.include"
+# Post-pass state of the last compilation, and the p4 hash of the last data
+# plane p4c built successfully
+cache_fn="${output_base}.cache"
+built_fn="${output_base}_mantis.p4.built"
 
 # Parse verbosity
 if [ $verbose -eq 1 ]; then
@@ -53,13 +56,19 @@ set -x
 { echo "Output base: ${output_base}"; } 2> /dev/null
 make clean
 make -j4
-./frontend -i ${input_file} -o ${output_base}
+./frontend -i ${input_file} -o ${output_base} --cache ${cache_fn}
 
-{ echo "==============Run preprocesser and install the agent implementation=============="; } 2> /dev/null
-echo "#include \"pd.h\"" >> ${output_include_fn} && cat ${output_include_fn} > ${output_path}"/p4r.c" && g++ -E ${output_c_fn} | sed 's/_MANTIS_NL_\s*;/_MANTIS_NL_/g' | sed 's/_MANTIS_NL_/\n /g' | grep "^[^#]" >> ${output_path}"/p4r.c"
-rm ${output_include_fn} ${output_c_fn}
+{ echo "==============Install the agent implementation=============="; } 2> /dev/null
+mv ${output_c_fn} ${output_path}"/p4r.c"
+
+p4_hash=$(sed -n 's/^p4_hash //p' ${cache_fn})
+if [ -f ${built_fn} ] && [ "$(cat ${built_fn})" == "${p4_hash}" ]; then
+  { echo "==============Data plane unchanged, p4c build and switch reload skipped=============="; } 2> /dev/null
+  exit 0
+fi
 
 { echo "==============Compile output p4 to tofino target with p4c=============="; } 2> /dev/null
 output_namebase=$(basename ${output_base})
 abs_output_p4_path=$(cd ${output_path}; pwd)"/"${output_namebase}"_mantis.p4"
 ./util/p4_14_compile.sh ${abs_output_p4_path}
+echo ${p4_hash} > ${built_fn}
@@ -3,86 +3,41 @@
 #define YYDEBUG 1
 #include <string>
 #include <cstdio>
-#include <iostream>
-#include <fstream>
 #include <vector>
 
-#include <stdio.h>
-#include <execinfo.h>
-#include <signal.h>
-#include <stdlib.h>
-#include <unistd.h>
-#include <typeinfo>
-
 #include "include/ast_nodes.h"
 #include "include/ast_nodes_p4.h"
 #include "include/ast_nodes_p4r.h"
 #include "include/compile.h"
-#include "include/find_nodes.h"
 #include "include/helper.h"
-
-// Only support tofino target
-int with_tofino=1;
-int done_init=0;
-
-extern int yylex();
-extern int yyparse();
-extern FILE* yyin;
-extern int yylineno;
-extern char* yytext;
-void yyerror(const char* s);
+#include "include/node_registry.h"
 
 using namespace std;
+%}
 
-char* in_fn = NULL;
-char* out_fn_base = NULL;
-std::string p4_out_fn, c_out_fn;
-FILE* in_file;
-
-// From: https://stackoverflow.com/questions/865668/how-to-parse-command-line-arguments-in-c
-char* getCmdOption(char ** begin, char ** end, const std::string & option)
-{
-    char ** itr = std::find(begin, end, option);
-    if (itr != end && ++itr != end)
-    {
-        return *itr;
-    }
-    return 0;
-}
-
-bool cmdOptionExists(char** begin, char** end, const std::string& option)
-{
-    return std::find(begin, end, option) != end;
+// Reentrant: the scanner and all parse state come in as arguments
+%define api.pure full
+%lex-param {yyscan_t scanner}
+%parse-param {yyscan_t scanner} {CompileContext* ctx}
+
+%code requires {
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void* yyscan_t;
+#endif
+struct CompileContext;
 }
 
-void parseArgs(int argc, char* argv[]){ 
-    in_fn = getCmdOption(argv, argv+argc, "-i");
-    out_fn_base = getCmdOption(argv, argv+argc, "-o");
-    if ((in_fn == NULL) || (out_fn_base == NULL)){
-        cout << "expected arguments: "
-             << argv[0]
-             << " -i <input P4R filename> -o <output filename base> "
-             << endl;
-        exit(0);
-    }
-
-    in_file = fopen(in_fn, "r");
-    if (in_file == 0) {
-        PANIC("Input P4R file not found");
-    }
-    
-    p4_out_fn = string(string(out_fn_base) + string("_mantis.p4"));
-    c_out_fn = string(string(out_fn_base) + string("_mantis.c"));
+%code {
+int yylex(YYSTYPE* yylval, yyscan_t scanner);
+void yyerror(yyscan_t scanner, CompileContext* ctx, const char* s);
 }
 
-std::vector<AstNode*> node_array;
-AstNode* root;
-%}
-
 %union {
     AstNode* aval;
     std::string* pval;
-    char* sval;
+    // Interned in the current arena by the scanner
+    const std::string* sval;
 }
 
 // One could extend tofino-specifc P4 syntax to support other variants by branching
@@ -137,6 +92,8 @@ AstNode* root;
 %token <sval> IDENTIFIER
 %token <sval> STRING
 %token <sval> INTEGER
+// Span of an uninspected declaration body, see OpaqueBodyNode
+%token <aval> OPAQUE_BODY
 
 
 %type <aval> rootTofino;
@@ -152,6 +109,7 @@ AstNode* root;
 %type <aval> nameList
 %type <aval> keyWord
 %type <aval> body
+%type <aval> declBody
 %type <aval> opts
 %type <aval> p4rMalleable
 %type <aval> varWidth
@@ -216,13 +174,13 @@ root:
 
 rootTofino :
     inputTofino {
-        root = $1;
+        ctx->root_ = $1;
     }
 ;
 
 rootBmv2 :
     inputBmv2 {
-        root = $1;
+        ctx->root_ = $1;
     }   
 
 inputTofino :
@@ -231,12 +189,12 @@ inputTofino :
     }
     | inputTofino include {
         AstNode* rv = new InputNode($1, $2);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
     | inputTofino p4rExpr {
         AstNode* rv = new InputNode($1, $2);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
         PRINT_VERBOSE("----- parsed P4R Expr ------ \n");
         PRINT_VERBOSE("%s\n", $2 -> toString().c_str());
@@ -244,7 +202,7 @@ inputTofino :
     }
     | inputTofino p4ExprTofino  {
         AstNode* rv = new InputNode($1, $2);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
         PRINT_VERBOSE("----- parsed P4 Expr ------ \n");
         PRINT_VERBOSE("%s\n", $2 -> toString().c_str());
@@ -258,12 +216,12 @@ inputBmv2 :
     }
     | inputBmv2 include {
         AstNode* rv = new InputNode($1, $2);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
     | inputBmv2 p4rExpr {
         AstNode* rv = new InputNode($1, $2);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
         PRINT_VERBOSE("- Parsed REACTIVE P4 Expr -- \n");
         PRINT_VERBOSE("%s\n", $2 -> toString().c_str());
@@ -271,7 +229,7 @@ inputBmv2 :
     }
     | inputBmv2 p4ExprBmv2  {
         AstNode* rv = new InputNode($1, $2);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
         PRINT_VERBOSE("----- parsed P4 Expr ------ \n");
         PRINT_VERBOSE("%s\n", $2 -> toString().c_str());
@@ -282,11 +240,10 @@ inputBmv2 :
 // Include statements
 include :
     INCLUDE {
-        string* strVal = new string(string($1));
+        const string* strVal = $1;
         AstNode* rv = new IncludeNode(strVal, IncludeNode::P4);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
-        free($1);
     }
 ;
 
@@ -298,7 +255,7 @@ include :
 registerDecl :
     REGISTER name "{" body "}" {
         AstNode* rv = new P4RegisterNode($2, $4);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;    
     }
 ;
@@ -307,26 +264,26 @@ tableDecl :
     TABLE name "{" tableReads tableActions body "}" {
         auto rv = new TableNode($2, $4, $5,
                                 $6->toString(), "");
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
     | TABLE name "{" tableActions body "}" {
         // Reads are optional
         auto rv = new TableNode($2, NULL, $4,
                                 $5->toString(), "");
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
     | PRAGMA TABLE name "{" tableReads tableActions body "}" {
         auto rv = new TableNode($3, $5, $6,
-                                $7->toString(), $1);
-        node_array.push_back(rv);
+                                $7->toString(), *$1);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
     | PRAGMA TABLE name "{" tableActions body "}" {
         auto rv = new TableNode($3, NULL, $5,
-                                $6->toString(), $1);
-        node_array.push_back(rv);
+                                $6->toString(), *$1);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }    
 ;
@@ -345,7 +302,7 @@ tableReadStmts :
         TableReadStmtsNode* rv = dynamic_cast<TableReadStmtsNode*>($1);
         TableReadStmtNode* trs = dynamic_cast<TableReadStmtNode*>($2);
         rv->push_back(trs);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;        
     }
 ;
@@ -353,22 +310,22 @@ tableReadStmts :
 tableReadStmt :
     field ":" EXACT ";" {
         AstNode* rv = new TableReadStmtNode(TableReadStmtNode::EXACT, $1);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
     | field ":" TERNARY ";" {
         AstNode* rv = new TableReadStmtNode(TableReadStmtNode::TERNARY, $1);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
     | varRef ":" EXACT ";" {
         AstNode* rv = new TableReadStmtNode(TableReadStmtNode::EXACT, $1);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
     | varRef ":" TERNARY ";" {
         AstNode* rv = new TableReadStmtNode(TableReadStmtNode::TERNARY, $1);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
 ;
@@ -387,7 +344,7 @@ tableActionStmts :
         TableActionStmtsNode* rv = dynamic_cast<TableActionStmtsNode*>($1);
         TableActionStmtNode* tas = dynamic_cast<TableActionStmtNode*>($2);
         rv->push_back(tas);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;        
     }
 ;
@@ -395,7 +352,7 @@ tableActionStmts :
 tableActionStmt :
     name ";" {
         AstNode* rv = new TableActionStmtNode($1);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
 ;
@@ -403,7 +360,7 @@ tableActionStmt :
 headerTypeDeclaration :
     HEADER_TYPE name "{" headerDecBody body "}" {
         AstNode* rv = new HeaderTypeDeclarationNode($2, $4, $5);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
 ;
@@ -439,7 +396,7 @@ fieldDecList :
 headerInstance :
     HEADER name name ";" {
         HeaderInstanceNode* rv = new HeaderInstanceNode($2, $3);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
 ;
@@ -447,7 +404,7 @@ headerInstance :
 metadataInstance :
     METADATA name name ";" {
         MetadataInstanceNode* rv = new MetadataInstanceNode($2, $3);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
 ;    
@@ -455,7 +412,7 @@ metadataInstance :
 actionFunctionDeclaration :
     ACTION name "(" actionParamList ")" "{" actionStatements "}" {
         ActionNode* rv = new ActionNode($2, $4, $7);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
 ;
@@ -481,17 +438,17 @@ actionParamList :
 actionParam :
     field {
         AstNode* rv = new ActionParamNode($1);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
     | varRef {
         AstNode* rv = new ActionParamNode($1);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
     | name {
         AstNode* rv = new ActionParamNode($1);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
 ;
@@ -499,7 +456,7 @@ actionParam :
 actionStatements :
     /* empty */ {
         AstNode* rv = new ActionStmtsNode();
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
     | actionStatements actionStatement {
@@ -513,13 +470,13 @@ actionStatements :
 actionStatement :
     name "(" argList ")" ";" {
         ActionStmtNode* rv = new ActionStmtNode($1, $3, ActionStmtNode::NAME_ARGLIST, NULL, NULL);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
     /* e.g., bi.execute_stateful_alu(eg_intr_md.egress_port) or index */
     | name "." name "(" argList ")" ";" {
         ActionStmtNode* rv = new ActionStmtNode($1, $5, ActionStmtNode::PROG_EXEC, $3, NULL);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;    
     }
 ;
@@ -527,14 +484,14 @@ actionStatement :
 argList :
     /* empty */ {
         ArgsNode* rv = new ArgsNode();
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
     | arg {
         ArgsNode* rv = new ArgsNode();
         BodyWordNode* bw = dynamic_cast<BodyWordNode*>($1);
         rv->push_back(bw);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
     | argList "," arg {
@@ -548,22 +505,22 @@ argList :
 arg :
     varRef {
         AstNode* rv = new BodyWordNode(BodyWordNode::VARREF, $1);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
     | name {
         AstNode* rv = new BodyWordNode(BodyWordNode::NAME, $1);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
     | field {
         AstNode* rv = new BodyWordNode(BodyWordNode::FIELD, $1);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
     | integer {
         AstNode* rv = new BodyWordNode(BodyWordNode::INTEGER, $1);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
 ;
@@ -576,78 +533,77 @@ keyWord name [ name ] ["(" opts ")"] [ [";"] | "{" body "}"]
 p4ExprTofino :
     // Parsed statements.
     tableDecl {
-        node_array.push_back($1);
         $$=$1;
     }
     | headerTypeDeclaration {
-        node_array.push_back($1);
         $$=$1;
     }
     | headerInstance {
-        node_array.push_back($1);
         $$=$1;
     } 
     | metadataInstance {
-        node_array.push_back($1);
         $$=$1;
     }
     | actionFunctionDeclaration {
-        node_array.push_back($1);
         $$=$1;
     } 
     | registerDecl {
         // necessary for mirroring measurement register
-        node_array.push_back($1);
         $$=$1;
     }
     // Generic statements.
     | keyWord name ";" {
         AstNode* rv = new P4ExprNode($1, $2, NULL, NULL, NULL);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
-    | keyWord name "{" body "}" {
+    | keyWord name "{" declBody "}" {
         AstNode* rv = new P4ExprNode($1, $2, NULL, NULL, $4);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
     /* name2, no opts */
     | keyWord name name ";" {
         AstNode* rv = new P4ExprNode($1, $2, $3, NULL, NULL);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
-    | keyWord name name "{" body "}" {
-        AstNode* rv = new P4ExprNode($1, $2, $3, NULL, $5);
-        node_array.push_back(rv);
+    | keyWord name name "{" declBody "}" {
+        AstNode* rv;
+        if (P4StatefulAluNode::declares($1, $2)) {
+            rv = new P4StatefulAluNode($1, $2, $3, NULL, $5);
+        } else {
+            rv = new P4ExprNode($1, $2, $3, NULL, $5);
+        }
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
     /* To parse e.g., "calculated_field ipv4.hdrChecksum" */
-    | keyWord name "." name "{" body "}" {    
+    | keyWord name "." name "{" declBody "}" {    
         AstNode* rv = new P4ExprNode($1, $2, $4, NULL, $6);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
     /* no name2, opts */
     | keyWord name "(" opts ")" ";" {
         AstNode* rv = new P4ExprNode($1, $2, NULL, $4, NULL);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;        
     }
-    | keyWord name "(" opts ")" "{" body "}" {
+    | keyWord name "(" opts ")" "{" declBody "}" {
         AstNode* rv = new P4ExprNode($1, $2, NULL, $4, $7);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;                
     }        
     /* name2, opts */
     | keyWord name name "(" opts ")" ";" {
         AstNode* rv = new P4ExprNode($1, $2, $3, $5, NULL);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
-    | keyWord name name "(" opts ")" "{" body "}" {
+    | keyWord name name "(" opts ")" "{" declBody "}" {
         AstNode* rv = new P4ExprNode($1, $2, $3, $5, $8);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
 ;
@@ -655,63 +611,59 @@ p4ExprTofino :
 p4ExprBmv2 :
     // Parsed statements.
     tableDecl {
-        node_array.push_back($1);
         $$=$1;
     }
     | headerTypeDeclaration {
-        node_array.push_back($1);
         $$=$1;
     }
     | headerInstance {
-        node_array.push_back($1);
         $$=$1;
     }
     | actionFunctionDeclaration {
-        node_array.push_back($1);
         $$=$1;
     }
     // Generic statements.
     | keyWord name ";" {
         AstNode* rv = new P4ExprNode($1, $2, NULL, NULL, NULL);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
-    | keyWord name "{" body "}" {
+    | keyWord name "{" declBody "}" {
         AstNode* rv = new P4ExprNode($1, $2, NULL, NULL, $4);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
     /* name2, no opts */
     | keyWord name name ";" {
         AstNode* rv = new P4ExprNode($1, $2, $3, NULL, NULL);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
-    | keyWord name name "{" body "}" {
+    | keyWord name name "{" declBody "}" {
         AstNode* rv = new P4ExprNode($1, $2, $3, NULL, $5);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
     /* no name2, opts */
     | keyWord name "(" opts ")" ";" {
         AstNode* rv = new P4ExprNode($1, $2, NULL, $4, NULL);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;        
     }
-    | keyWord name "(" opts ")" "{" body "}" {
+    | keyWord name "(" opts ")" "{" declBody "}" {
         AstNode* rv = new P4ExprNode($1, $2, NULL, $4, $7);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;                
     }        
     /* name2, opts */
     | keyWord name name "(" opts ")" ";" {
         AstNode* rv = new P4ExprNode($1, $2, $3, $5, NULL);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
-    | keyWord name name "(" opts ")" "{" body "}" {
+    | keyWord name name "(" opts ")" "{" declBody "}" {
         AstNode* rv = new P4ExprNode($1, $2, $3, $5, $8);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
 ;
@@ -720,9 +672,9 @@ p4ExprBmv2 :
 // For now its a generic identifier.
 keyWord :
     IDENTIFIER {
-        std::string* newStr = new string(string($1));
+        const string* newStr = $1;
         AstNode* rv = new KeywordNode(newStr);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
 ;
@@ -730,9 +682,9 @@ keyWord :
 // A name is a valid P4 identifier
 name : 
     IDENTIFIER {
-        std::string* newStr = new string(string($1));
+        const string* newStr = $1;
         AstNode* rv = new NameNode(newStr);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
 ;
@@ -741,12 +693,12 @@ name :
 opts :
     /* empty */ {
         AstNode* rv = new OptsNode(NULL);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
     | nameList {
         AstNode* rv = new OptsNode($1);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
 ;
@@ -755,12 +707,12 @@ opts :
 nameList : 
     name {
         AstNode* rv = new NameListNode(NULL, $1);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
     | nameList "," name {
         AstNode* rv = new NameListNode($1, $3);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
 ;
@@ -775,50 +727,61 @@ body :
     }
     | body bodyWord {
         AstNode* rv = new BodyNode($1, NULL, $2);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
     | body "{" body "}" {
         AstNode* rv = new BodyNode($1, $3, NULL);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
 ;
 
+// Body of a generic declaration, the scanner hands over the bodies no pass
+// looks into as a whole
+declBody :
+    body {
+        $$=$1;
+    }
+    | OPAQUE_BODY {
+        ctx->nodes_.push_back($1);
+        $$=$1;
+    }
+;
+
 // A string can be an identifier, word, or parsed special character.
 bodyWord :
     varRef {
         AstNode* rv = new BodyWordNode(BodyWordNode::VARREF, $1);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
     | name {
         AstNode* rv = new BodyWordNode(BodyWordNode::NAME, $1);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
     | integer {
         AstNode* rv = new BodyWordNode(BodyWordNode::INTEGER, $1);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }     
     | specialChar {
         AstNode* rv = new BodyWordNode(BodyWordNode::SPECIAL, $1);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }       
     | STRING {
-        AstNode* sv = new StrNode(new string($1));
+        AstNode* sv = new StrNode($1);
         AstNode* rv = new BodyWordNode(BodyWordNode::STRING, sv);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
-        free($1);
     }
     // Better to set up blackbox declaration itself
     | REACTION_ARG_REG {
-        AstNode* sv = new StrNode(new string("reg"));
+        AstNode* sv = new StrNode(intern("reg"));
         AstNode* rv = new BodyWordNode(BodyWordNode::STRING, sv);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
 ;
@@ -826,71 +789,70 @@ bodyWord :
 varRef :
     "$" "{" name "}" {
         AstNode* rv = new MblRefNode($3);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
 ;
 
 specialChar:
     L_PAREN {
-        string* newStr = new string("(");
+        const string* newStr = intern("(");
         AstNode* rv = new SpecialCharNode(newStr);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;}
     | R_PAREN {
-        string* newStr = new string(")");
+        const string* newStr = intern(")");
         AstNode* rv = new SpecialCharNode(newStr);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;}
     | L_BRACKET {
-        string* newStr = new string("[");
+        const string* newStr = intern("[");
         AstNode* rv = new SpecialCharNode(newStr);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;}
     | R_BRACKET {
-        string* newStr = new string("]");
+        const string* newStr = intern("]");
         AstNode* rv = new SpecialCharNode(newStr);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;}
     | SEMICOLON {
-        string* newStr = new string(";");
+        const string* newStr = intern(";");
         AstNode* rv = new SpecialCharNode(newStr);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;}
     | COLON {
-        string* newStr = new string(":");
+        const string* newStr = intern(":");
         AstNode* rv = new SpecialCharNode(newStr);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;}
     | COMMA {
-        string* newStr = new string(",");
+        const string* newStr = intern(",");
         AstNode* rv = new SpecialCharNode(newStr);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;}
     | PERIOD {
-        string* newStr = new string(".");
+        const string* newStr = intern(".");
         AstNode* rv = new SpecialCharNode(newStr);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;}
     | WIDTH {
-        string* newStr = new string("width");
+        const string* newStr = intern("width");
         AstNode* rv = new SpecialCharNode(newStr);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;}
     | SLASH {
-        string* newStr = new string("/");
+        const string* newStr = intern("/");
         AstNode* rv = new SpecialCharNode(newStr);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;}
 ;
 
 integer :
     INTEGER {
-        string* strVal = new string(string($1));
+        const string* strVal = $1;
         AstNode* rv = new IntegerNode(strVal);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;        
-        free($1);    
     }
 ;
 
@@ -905,18 +867,18 @@ integer :
 p4rExpr :
     p4rInitBlock {
         AstNode* rv = new P4RExprNode($1);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;        
     }
     |
     p4rReaction {
         AstNode* rv = new P4RExprNode($1);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
     | p4rMalleable {
         AstNode* rv = new P4RExprNode($1);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
 ;
@@ -924,9 +886,9 @@ p4rExpr :
 /************** Reactions **************/
 
 p4rInitBlock :
-    P4R_INIT_BLOCK name "{" body "}" {
+    P4R_INIT_BLOCK name "{" declBody "}" {
         AstNode* rv = new P4RInitBlockNode($2, $4);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
 ;
@@ -934,7 +896,7 @@ p4rInitBlock :
 p4rReaction :
     P4R_REACTION name "(" reactionArgs ")" "{" includes body "}" {
         AstNode* rv = new P4RReactionNode($2, $4, $8);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }  
 ;
@@ -945,9 +907,9 @@ includes :
         $$ = empty;
     }
     | includes INCLUDE {
-        string* strVal = new string(string($2));
+        const string* strVal = $2;
         AstNode* rv = new IncludeNode(strVal, IncludeNode::C);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$ = rv;
     }
 ;
@@ -962,14 +924,14 @@ reactionArgs :
         ReactionArgsNode* rv = new ReactionArgsNode();
         ReactionArgNode* ra = dynamic_cast<ReactionArgNode*>($1);
         rv->push_back(ra);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
     | reactionArgs "," reactionArg {
         ReactionArgsNode* rv = dynamic_cast<ReactionArgsNode*>($1);
         ReactionArgNode* ra = dynamic_cast<ReactionArgNode*>($3);
         rv->push_back(ra);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;        
     }
 ;
@@ -977,33 +939,33 @@ reactionArgs :
 reactionArg :
     REACTION_ARG_ING field {
         AstNode* rv = new ReactionArgNode(ReactionArgNode::INGRESS_FIELD, $2, NULL, NULL);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
     | REACTION_ARG_EGR field {
         AstNode* rv = new ReactionArgNode(ReactionArgNode::EGRESS_FIELD, $2, NULL, NULL);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
     | REACTION_ARG_ING varRef {
         AstNode* rv = new ReactionArgNode(ReactionArgNode::INGRESS_MBL_FIELD, $2, NULL, NULL);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;        
     } 
     | REACTION_ARG_EGR varRef {
         AstNode* rv = new ReactionArgNode(ReactionArgNode::EGRESS_MBL_FIELD, $2, NULL, NULL);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;        
     }
     // Better to treat reg as a token parsed with blackbox
     | REACTION_ARG_REG name {
         AstNode* rv = new ReactionArgNode(ReactionArgNode::REGISTER, $2, NULL, NULL);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;        
     }       
     | REACTION_ARG_REG name "[" integer ":" integer "]" {
         AstNode* rv = new ReactionArgNode(ReactionArgNode::REGISTER, $2, $4, $6);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;        
     }   
 ;
@@ -1013,22 +975,22 @@ reactionArg :
 p4rMalleable :
     P4R_MALLEABLE VALUE name "{" varWidth varValueInit "}" {
         AstNode* rv = new P4RMalleableValueNode($3, $5, $6);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
     | P4R_MALLEABLE FIELD name "{" varWidth varFieldInit varAlts "}" {
         AstNode* rv = new P4RMalleableFieldNode($3, $5, $6, $7);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
     | P4R_MALLEABLE tableDecl {
         AstNode* rv = new P4RMalleableTableNode($2, "");
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
     | PRAGMA P4R_MALLEABLE tableDecl {
-        AstNode* rv = new P4RMalleableTableNode($3, $1);
-        node_array.push_back(rv);
+        AstNode* rv = new P4RMalleableTableNode($3, *$1);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
 ;
@@ -1036,7 +998,7 @@ p4rMalleable :
 varWidth :
     WIDTH ":" integer ";" {
         AstNode* rv = new VarWidthNode($3);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
 ;
@@ -1044,7 +1006,7 @@ varWidth :
 varValueInit :
     INIT ":" integer ";" {
         AstNode* rv = new VarInitNode($3);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
 ;
@@ -1052,12 +1014,12 @@ varValueInit :
 varFieldInit :
     INIT ":" integer ";" {
         AstNode* rv = new VarInitNode($3);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
     | INIT ":" field ";" {
         AstNode* rv = new VarInitNode($3);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
 ;
@@ -1065,7 +1027,7 @@ varFieldInit :
 varAlts :
     ALTS "{" fieldList "}" {
         AstNode* rv = new VarAltNode($3);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
 ;
@@ -1074,21 +1036,21 @@ varAlts :
 fieldList :
     /* empty */ {
         FieldsNode* rv = new FieldsNode();
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
     | field {
         FieldsNode* rv = new FieldsNode();
         FieldNode* fld = dynamic_cast<FieldNode*>($1);
         rv->push_back(fld);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
     | fieldList "," field {
         FieldsNode* rv = dynamic_cast<FieldsNode*>($1);
         FieldNode* fld = dynamic_cast<FieldNode*>($3);
         rv->push_back(fld);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
 ;
@@ -1096,7 +1058,7 @@ fieldList :
 field :
     name "." name {
         AstNode* rv = new FieldNode($1, $3);
-        node_array.push_back(rv);
+        ctx->nodes_.push_back(rv);
         $$=rv;
     }
 ;
@@ -1105,65 +1067,32 @@ field :
 
 %%
 
-
-void handler(int sig);
-
-int main(int argc, char* argv[]) {
-    signal(SIGSEGV, handler);
-
-    parseArgs(argc, argv);  
-
-    yyin = in_file;
-    yyparse();
-    fclose(in_file);
-
-    PRINT_VERBOSE("Number of syntax tree nodes: %d\n", node_array.size());
-
-    vector<AstNode*> newP4Nodes = compileP4Code(&node_array);
-
-    vector<P4RReactionNode*> reactions;
-    findAndRemoveReactions(&reactions, node_array);
-
-    ofstream os;
-    os.open(p4_out_fn);
-    os << root->toString() << endl << endl;
-    for (auto n : newP4Nodes) {
-        os << n->toString();
-    }
-    os.close();
-
-    vector<UnanchoredNode*> cNodes = compileCCode(node_array, out_fn_base);
-
-	os.open(c_out_fn);
-
-    PRINT_VERBOSE("Number of C nodes: %d\n", cNodes.size());
-
-	for (auto node : cNodes){
-		os << node -> toString() << endl;
-		os << "\n" << endl;		
-	}
-	os.close();
-
-    return 0;
-}
-
-
-
-void yyerror(const char* s) {
-    printf("Line %d: %s when parsing '%s'\n", yylineno, s, yytext);
-    exit(1);
+// Reentrant flex scanner, see frontend.l
+typedef struct yy_buffer_state* YY_BUFFER_STATE;
+int yylex_init_extra(CompileContext* extra, yyscan_t* scanner);
+YY_BUFFER_STATE yy_scan_bytes(const char* bytes, int len, yyscan_t scanner);
+int yylex_destroy(yyscan_t scanner);
+int yyget_lineno(yyscan_t scanner);
+char* yyget_text(yyscan_t scanner);
+
+void parseP4R(const char* source, size_t len, CompileContext* ctx) {
+    yyscan_t scanner;
+    if (yylex_init_extra(ctx, &scanner) != 0) {
+        PANIC("Failed to set up the scanner\n");
+    }
+    ctx->source_ = source;
+    ctx->sourceLen_ = len;
+    yy_scan_bytes(source, len, scanner);
+    try {
+        yyparse(scanner, ctx);
+    } catch (...) {
+        yylex_destroy(scanner);
+        throw;
+    }
+    yylex_destroy(scanner);
 }
 
-// Crash dump handler: https://stackoverflow.com/questions/77005/how-to-automatically-generate-a-stacktrace-when-my-program-crashes
-void handler(int sig) {
-  void* array[10];
-  size_t size;
-
-  // get void*'s for all entries on the stack
-  size = backtrace(array, 10);
-
-  // print out all the frames to stderr
-  fprintf(stderr, "Error: signal %d:\n", sig);
-  backtrace_symbols_fd(array, size, STDERR_FILENO);
-  exit(1);
+void yyerror(yyscan_t scanner, CompileContext* ctx, const char* s) {
+    throw CompileError(formatPanic("Line %d: %s when parsing '%s'\n",
+                                   yyget_lineno(scanner), s, yyget_text(scanner)));
 }
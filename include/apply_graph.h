@@ -0,0 +1,91 @@
+/* Copyright 2020-present University of Pennsylvania
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef APPLY_GRAPH_H
+#define APPLY_GRAPH_H
+
+#include <set>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "ast_nodes.h"
+#include "ast_nodes_p4.h"
+#include "node_registry.h"
+
+// Control flow as written in the control blocks: which control applies which
+// table (apply(t)) and which control calls which (c();).  Tables are placed in
+// ingress/egress by following calls transitively from the two pipeline roots,
+// so programs whose ingress delegates to sub-controls are handled.
+class ApplyGraph {
+public:
+    enum Pipeline {
+        NONE = 0,
+        INGRESS = 0b01,
+        EGRESS = 0b10
+    };
+
+    struct ApplySite {
+        P4ExprNode* control;
+        BodyWordNode* table;
+    };
+
+    void build(const NodeRegistry& nodes);
+
+    // Pipeline bits of the controls reaching the table, NONE if unreachable
+    unsigned int pipelines(const std::string& tableName) const;
+
+    const std::vector<ApplySite>& applySites(const std::string& tableName) const;
+    const std::vector<P4ExprNode*>& callees(P4ExprNode* control) const;
+    // header.field read by the if conditions around any apply of the table,
+    // in its control and the controls calling it
+    const std::set<std::string>& conditionFields(const std::string& tableName) const;
+
+    // Tables of the pipeline in the order they are first applied, calls
+    // followed in place
+    std::vector<std::string> tableOrder(Pipeline pipeline) const;
+
+private:
+    // An apply(table) or a call of another control, in the order written
+    struct Step {
+        std::string table;
+        P4ExprNode* callee;
+        // Fields of the conditions around it in the control
+        std::set<std::string> conditions;
+    };
+
+    void scan(P4ExprNode* control, BodyNode* body, const std::set<std::string>& conditions);
+    void scanWords(P4ExprNode* control, const std::vector<BodyWordNode*>& words,
+                   const std::set<std::string>& conditions);
+    void place(P4ExprNode* control, Pipeline pipeline);
+    void gate(P4ExprNode* control, const std::set<std::string>& conditions,
+              std::vector<P4ExprNode*>* stack);
+    void order(P4ExprNode* control, std::vector<P4ExprNode*>* stack,
+               std::vector<std::string>* tables) const;
+
+    std::vector<P4ExprNode*> controls_;
+    std::unordered_map<std::string, P4ExprNode*> byName_;
+
+    std::unordered_map<P4ExprNode*, std::vector<P4ExprNode*>> calls_;
+    std::unordered_map<P4ExprNode*, std::vector<std::string>> applies_;
+    std::unordered_map<P4ExprNode*, std::vector<Step>> steps_;
+    std::unordered_map<std::string, std::vector<ApplySite>> applySites_;
+
+    std::unordered_map<P4ExprNode*, unsigned int> controlPipelines_;
+    std::unordered_map<std::string, unsigned int> tablePipelines_;
+    std::unordered_map<std::string, std::set<std::string>> conditionFields_;
+};
+
+#endif
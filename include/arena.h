@@ -0,0 +1,88 @@
+/* Copyright 2020-present University of Pennsylvania
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <unordered_set>
+
+class AstNode;
+
+// Memory of one compilation: syntax tree nodes are bump allocated from large
+// chunks and identifiers are interned, so equal names share one string and
+// compare by pointer.  Destroying the arena runs the node destructors and
+// releases everything in one shot.  Passes of a compilation running on
+// several threads allocate and intern into the same arena concurrently.
+class Arena {
+public:
+    static const size_t kDefaultChunkSize = 256 * 1024;
+
+    explicit Arena(size_t chunkSize = kDefaultChunkSize);
+    ~Arena();
+
+    void* allocate(size_t size);
+
+    // Run the node's destructor when the arena is released
+    void adopt(AstNode* node);
+
+    const std::string* intern(const char* str);
+    const std::string* intern(const std::string& str);
+
+    size_t bytesAllocated() const { return bytesAllocated_; }
+    size_t numNodes() const { return nodes_.size(); }
+    size_t numSymbols() const { return symbols_.size(); }
+
+    // Nodes and bytes the calling thread placed in any arena so far, what
+    // one pass allocated while others run beside it
+    static size_t threadNumNodes();
+    static size_t threadBytesAllocated();
+
+    // Arena new nodes are placed in, falling back to a process-wide one
+    static Arena* current();
+
+    // Makes an arena current for the calling thread until the scope ends
+    class Scope {
+    public:
+        explicit Scope(Arena* arena);
+        ~Scope();
+    private:
+        Arena* previous_;
+    };
+
+private:
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    std::mutex mutex_;
+    size_t chunkSize_;
+    std::vector<char*> chunks_;
+    char* next_ = NULL;
+    char* end_ = NULL;
+    size_t bytesAllocated_ = 0;
+
+    std::vector<AstNode*> nodes_;
+    std::unordered_set<std::string> symbols_;
+};
+
+// Interned copy of str in the current arena
+inline const std::string* intern(const std::string& str) {
+    return Arena::current()->intern(str);
+}
+
+#endif
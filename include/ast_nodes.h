@@ -20,104 +20,202 @@
 #include <sstream>
 #include <cstdio>
 #include <iostream>
-#include <typeinfo>
 #include <vector>
 #include <boost/algorithm/string.hpp>
 
+#include "arena.h"
+#include "emitter.h"
+
 using namespace std;
 
 
-// Base syntax tree node
+// Concrete type of a syntax tree node, set once by each constructor.
+// Passes dispatch on the kind instead of inspecting RTTI names.
+enum NodeKind {
+    BASE_NODE,
+    EMPTY_NODE,
+    NAME_NODE,
+    STR_NODE,
+    INTEGER_NODE,
+    SPECIAL_CHAR_NODE,
+    INCLUDE_NODE,
+    INPUT_NODE,
+    // P4 nodes
+    BODY_WORD_NODE,
+    BODY_NODE,
+    OPAQUE_BODY_NODE,
+    KEYWORD_NODE,
+    P4_ATTRIBUTE_NODE,
+    P4_ATTRIBUTES_NODE,
+    P4_REGISTER_NODE,
+    P4_EXPR_NODE,
+    P4_STATEFUL_ALU_NODE,
+    OPTS_NODE,
+    NAME_LIST_NODE,
+    TABLE_READ_STMT_NODE,
+    TABLE_READ_STMTS_NODE,
+    TABLE_ACTION_STMT_NODE,
+    TABLE_ACTION_STMTS_NODE,
+    TABLE_NODE,
+    FIELD_DEC_NODE,
+    FIELD_DECS_NODE,
+    HEADER_TYPE_DECLARATION_NODE,
+    HEADER_INSTANCE_NODE,
+    METADATA_INSTANCE_NODE,
+    ARGS_NODE,
+    ACTION_PARAM_NODE,
+    ACTION_PARAMS_NODE,
+    ACTION_STMT_NODE,
+    ACTION_STMTS_NODE,
+    ACTION_NODE,
+    // P4R nodes
+    P4R_EXPR_NODE,
+    VAR_WIDTH_NODE,
+    VAR_INIT_NODE,
+    P4R_MALLEABLE_VALUE_NODE,
+    FIELD_NODE,
+    FIELDS_NODE,
+    VAR_ALT_NODE,
+    P4R_MALLEABLE_FIELD_NODE,
+    P4R_MALLEABLE_TABLE_NODE,
+    REACTION_ARG_NODE,
+    REACTION_ARGS_NODE,
+    P4R_REACTION_NODE,
+    P4R_INIT_BLOCK_NODE,
+    MBL_REF_NODE,
+    UNANCHORED_NODE,
+    NUM_NODE_KINDS
+};
+
+// Base syntax tree node, allocated from and released with the current arena
 class AstNode {
 public:
     bool valid_ = true;
-    string nodeType_ = string("base");
+    NodeKind kind_ = BASE_NODE;
     AstNode* parent_ = NULL;
     bool removed_ = false;
 
+    AstNode() {
+        Arena::current()->adopt(this);
+    }
+    virtual ~AstNode() {}
+
+    static void* operator new(size_t size) {
+        return Arena::current()->allocate(size);
+    }
+    static void operator delete(void* ptr) {
+        // Memory goes back with the arena
+    }
+
+    bool isKind(NodeKind kind) const {
+        return kind_ == kind;
+    }
+
+    // Nodes override at least one of the two: composite nodes write their
+    // parts into the emitter, leaves may just produce their string
     virtual string toString() {
-        return "";
+        return Emitter::render(this);
+    }
+    virtual void emit(Emitter& out) {
+        out << toString();
     }
 };
 
 class EmptyNode : public AstNode {
 public:
-    string* emptyStr_ = new string("");
     EmptyNode() {    
-        nodeType_ = typeid(*this).name();
+        kind_ = EMPTY_NODE;
         valid_ = false;    
     }
     string toString() {
-        return *(emptyStr_);
+        return "";
+    }
+    void emit(Emitter& out) {
     }
 };
 
 // A P4 identifier
 class NameNode : public AstNode {
 public:
-    string* word_;
-    NameNode(string* word) {
-        nodeType_ = typeid(*this).name();
+    // Interned, rename by pointing at another interned string
+    const string* word_;
+    NameNode(const string* word) {
+        kind_ = NAME_NODE;
         word_ = word;
     }
     NameNode* deepCopy() {
-        return new NameNode(new string(*word_));
+        return new NameNode(word_);
     }
     string toString() {
         return *(word_);
     }
+    void emit(Emitter& out) {
+        out << *word_;
+    }
 };
 
 class StrNode : public AstNode {
 public:
-    string* word_;
-    StrNode(string* word) {
-        nodeType_ = typeid(*this).name();
+    const string* word_;
+    StrNode(const string* word) {
+        kind_ = STR_NODE;
         word_ = word;
     }
     string toString() {
         return *(word_);
     }
+    void emit(Emitter& out) {
+        out << *word_;
+    }
 };
 
 class IntegerNode : public AstNode {
 public:
-    string* word_;
-    IntegerNode(string* word) {
-        nodeType_ = typeid(*this).name();
+    const string* word_;
+    IntegerNode(const string* word) {
+        kind_ = INTEGER_NODE;
         word_ = word;
     }
     string toString() {
         return *(word_);
     }
+    void emit(Emitter& out) {
+        out << *word_;
+    }
 };
 
 class SpecialCharNode : public AstNode {
 public:
-    string* word_;
-    SpecialCharNode(string* word) {
-        nodeType_ = typeid(*this).name();
+    const string* word_;
+    SpecialCharNode(const string* word) {
+        kind_ = SPECIAL_CHAR_NODE;
         word_ = word;
     }
     string toString() {
         return *(word_);
     }
+    void emit(Emitter& out) {
+        out << *word_;
+    }
 };
 
 class IncludeNode : public AstNode {
 public:
     enum MacroType {P4, C};
 
-    string* line_;
+    const string* line_;
     MacroType macrotype_;
-    IncludeNode(string* line, MacroType macrotype) {
-        nodeType_ = typeid(*this).name();
+    IncludeNode(const string* line, MacroType macrotype) {
+        kind_ = INCLUDE_NODE;
         line_ = line;
         macrotype_ = macrotype;
     }
 
     string toString() {
         return *(line_);
+    }
+    void emit(Emitter& out) {
+        out << *line_;
     }   
 };
 
@@ -127,18 +225,23 @@ public:
     AstNode* expression_;
 
     InputNode(AstNode* next, AstNode* expression) {
-        nodeType_ = typeid(*this).name();
+        kind_ = INPUT_NODE;
         next_ = dynamic_cast<InputNode*>(next);
         expression_ = expression;
         expression_->parent_ = this;
     }
-    string toString() {
-        ostringstream oss;
-        if (next_) {
-            oss << next_->toString() << "\n";
+    void emit(Emitter& out) {
+        // One input per top level declaration, walk the chain without recursing
+        vector<InputNode*> chain;
+        for (InputNode* input = this; input != NULL; input = input->next_) {
+            chain.push_back(input);
+        }
+        for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+            if (it != chain.rbegin()) {
+                out << "\n";
+            }
+            out << (*it)->expression_;
         }
-        oss << expression_->toString();
-        return oss.str();
     }
 };
 
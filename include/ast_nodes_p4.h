@@ -25,10 +25,17 @@ public:
     ListNode() {
         list_ = new std::vector<T*>();
     }
+    ~ListNode() {
+        delete list_;
+    }
     void push_back(T* node) {
         list_->push_back(node);
         node->parent_ = this;
     }
+    // Add a node shared with the list that owns it, its parent stays there
+    void share(T* node) {
+        list_->push_back(node);
+    }
     std::vector<T*>* list_;
 };
 
@@ -39,41 +46,85 @@ public:
 
     BodyWordNode(WordType wordType, AstNode* contents);
     BodyWordNode* deepCopy();
-    std::string toString();
+    void emit(Emitter& out);
+    // Write the word as the successor of prev at the given body level
+    void emitWord(Emitter& out, BodyWordNode* prev, int level);
 
     const WordType wordType_;
     AstNode* contents_;
-
-    int indent_=1;
 };
 
 class BodyNode : public AstNode {
 public:
     BodyNode(AstNode* bodyOuter, AstNode* bodyInner, AstNode* str);
-    std::string toString();
+    void emit(Emitter& out);
 
     BodyNode* bodyOuter_;
     BodyNode* bodyInner_;
     BodyWordNode* str_;
+};
 
-    int indent_=1;
+// Body of a declaration no pass looks into (parser, field_list, ...) or that
+// is only processed as text (init_block), kept as a span of the source
+// instead of a word tree.  The source has to outlive the node, see parseP4R.
+class OpaqueBodyNode : public AstNode {
+public:
+    OpaqueBodyNode(const char* text, size_t len);
+    void emit(Emitter& out);
+
+    // Declarations whose body can stay opaque
+    static bool opaqueKeyword(const char* word);
+    // Length of the body at text up to its closing brace, 0 when the body
+    // has to be parsed into words: empty, unbalanced or referring to a
+    // malleable while mblRefs is unset.  Bodies rewritten as C code take
+    // their ${} references along.
+    static size_t spanLength(const char* text, size_t len, bool mblRefs);
+
+    const char* text_;
+    size_t len_;
 };
 
 class KeywordNode : public AstNode {
 public: 
-    KeywordNode(std::string* word);
-    std::string toString();
+    KeywordNode(const std::string* word);
+    void emit(Emitter& out);
 
-    std::string* word_;
+    const std::string* word_;
+};
+
+// "name : value ;" of a register or stateful alu body, the value words as
+// parsed.  Attributes are taken from the words once, when the declaration is
+// parsed, and kept in source order.
+class P4AttributeNode : public AstNode {
+public:
+    P4AttributeNode(const std::string* name, const std::vector<BodyWordNode*>& value);
+    void emit(Emitter& out);
+
+    // The value when it is a single name or integer, NULL otherwise
+    const std::string* word() const;
+
+    const std::string* name_;
+    std::vector<BodyWordNode*> value_;
+};
+
+class P4AttributesNode : public ListNode<P4AttributeNode> {
+public:
+    P4AttributesNode();
+    // Top level attributes of body, nested blocks are skipped
+    static P4AttributesNode* parse(BodyNode* body);
+    void emit(Emitter& out);
+
+    P4AttributeNode* find(const std::string& name) const;
 };
 
 class P4RegisterNode : public AstNode {
 public:
     P4RegisterNode(AstNode* name, AstNode* body);
-    std::string toString();
+    void emit(Emitter& out);
     
     AstNode* name_;
     BodyNode* body_;
+    P4AttributesNode* attributes_;
     
     int width_;
     int instanceCount_;    
@@ -83,19 +134,45 @@ class P4ExprNode : public AstNode {
 public:
     P4ExprNode(AstNode* keyword, AstNode* name1, AstNode* name2,
                AstNode* opts, AstNode* body);
-    std::string toString();
+    void emit(Emitter& out);
 
     KeywordNode* keyword_;
     NameNode* name1_;
     AstNode* name2_;
     AstNode* opts_;
     BodyNode* body_;
+    // Set instead of body_ for uninspected declarations
+    OpaqueBodyNode* opaqueBody_;
+};
+
+// blackbox stateful_alu <name> { ... }, with its attributes.  The body is
+// still what gets emitted, attributes added by passes are appended to it.
+// Other blackboxes stay P4ExprNodes.
+class P4StatefulAluNode : public P4ExprNode {
+public:
+    P4StatefulAluNode(AstNode* keyword, AstNode* name1, AstNode* name2,
+                      AstNode* opts, AstNode* body);
+
+    // Declarations of this form are parsed into a P4StatefulAluNode
+    static bool declares(AstNode* keyword, AstNode* name1);
+
+    const std::string& name() const { return *name_; }
+    // Register the alu works on, NULL if not declared
+    const std::string* reg() const { return reg_; }
+    P4AttributeNode* attribute(const std::string& name) const;
+    void addAttribute(const std::string* name, const std::vector<BodyWordNode*>& value);
+
+    P4AttributesNode* attributes_;
+
+private:
+    const std::string* name_;
+    const std::string* reg_;
 };
 
 class OptsNode : public AstNode {
 public:
     OptsNode(AstNode* nameList);
-    std::string toString();
+    void emit(Emitter& out);
 
     AstNode* nameList_;
 };
@@ -103,7 +180,7 @@ public:
 class NameListNode : public AstNode {
 public: 
     NameListNode(AstNode* nameList, AstNode* name);
-    std::string toString();
+    void emit(Emitter& out);
 
     AstNode *nameList_, *name_;
 };
@@ -113,7 +190,7 @@ public:
     enum MatchType { EXACT, TERNARY };
 
     TableReadStmtNode(MatchType matchType, AstNode* field);
-    std::string toString();
+    void emit(Emitter& out);
 
     MatchType matchType_;
     AstNode* field_;
@@ -122,13 +199,13 @@ public:
 class TableReadStmtsNode : public ListNode<TableReadStmtNode> {
 public:
     TableReadStmtsNode();
-    std::string toString();
+    void emit(Emitter& out);
 };
 
 class TableActionStmtNode : public AstNode {
 public:
     TableActionStmtNode(AstNode* name);
-    std::string toString();
+    void emit(Emitter& out);
 
     NameNode* name_;
 };
@@ -136,7 +213,7 @@ public:
 class TableActionStmtsNode : public ListNode<TableActionStmtNode> {
 public:
     TableActionStmtsNode();
-    std::string toString();
+    void emit(Emitter& out);
 };
 
 // A P4 table
@@ -144,8 +221,7 @@ class TableNode : public AstNode {
 public:
     TableNode(AstNode* name, AstNode* reads, AstNode* actions,
               std::string options, std::string pragma);
-    std::string toString();
-    void transformPragma();
+    void emit(Emitter& out);
 
     NameNode* name_;
     TableReadStmtsNode* reads_;
@@ -153,8 +229,8 @@ public:
     // size, default action, etc.
     vector<std::string> options_;
 
+    // @pragma stage is rewritten to the planned stage, see planStages
     std::string pragma_;
-    bool pragmaTransformed_;
 
     // for malleable table, parser gives TableNode as well 
     // need to keep this meta data to indicate if the table node is variable
@@ -164,7 +240,7 @@ public:
 class FieldDecNode : public AstNode {
 public:
     FieldDecNode(AstNode* name, AstNode* size);
-    std::string toString();
+    void emit(Emitter& out);
 
     NameNode* name_;
     IntegerNode* size_;
@@ -173,14 +249,14 @@ public:
 class FieldDecsNode : public ListNode<FieldDecNode> {
 public:
     FieldDecsNode();
-    std::string toString();
+    void emit(Emitter& out);
 };
 
 class HeaderTypeDeclarationNode : public AstNode {
 public:
     HeaderTypeDeclarationNode(AstNode* name, AstNode* field_decs,
                               AstNode* other_stmts);
-    std::string toString();
+    void emit(Emitter& out);
 
     NameNode* name_;
     FieldDecsNode* field_decs_;
@@ -190,7 +266,7 @@ public:
 class HeaderInstanceNode : public AstNode {
 public:
     HeaderInstanceNode(AstNode* type, AstNode* name);
-    std::string toString();
+    void emit(Emitter& out);
 
     NameNode* type_;
     NameNode* name_;
@@ -199,7 +275,7 @@ public:
 class MetadataInstanceNode : public AstNode {
 public:
     MetadataInstanceNode(AstNode* type, AstNode* name);
-    std::string toString();
+    void emit(Emitter& out);
 
     NameNode* type_;
     NameNode* name_;
@@ -208,15 +284,14 @@ public:
 class ArgsNode : public ListNode<BodyWordNode> {
 public:
     ArgsNode();
-    ArgsNode* deepCopy();
-    std::string toString();
+    ArgsNode* copyFor(const std::string& mblName);
+    void emit(Emitter& out);
 };
 
 class ActionParamNode : public AstNode {
 public:
     ActionParamNode(AstNode* param);
-    ActionParamNode* deepCopy();
-    std::string toString();
+    void emit(Emitter& out);
 
     AstNode* param_;
 };
@@ -224,8 +299,8 @@ public:
 class ActionParamsNode : public ListNode<ActionParamNode> {
 public:
     ActionParamsNode();
-    ActionParamsNode* deepCopy();
-    std::string toString();
+    ActionParamsNode* copyFor(const std::string& mblName);
+    void emit(Emitter& out);
 };
 
 class ActionStmtNode : public AstNode {
@@ -233,8 +308,14 @@ public:
     enum ActionStmtType { NAME_ARGLIST, PROG_EXEC };
 
     ActionStmtNode(AstNode* name1, AstNode* args, ActionStmtType type, AstNode* name2, AstNode* index);
-    ActionStmtNode* deepCopy();
-    std::string toString();
+    // This statement itself when it can be shared, see ActionNode::duplicateAction
+    ActionStmtNode* copyFor(const std::string& mblName);
+    void emit(Emitter& out);
+
+    // <blackbox>.execute_stateful_alu*(...)
+    bool executesStatefulAlu() const;
+    // Index the stateful alu is executed at, NULL when left out
+    BodyWordNode* aluIndex() const;
 
     ActionStmtType type_;
 
@@ -247,15 +328,19 @@ public:
 class ActionStmtsNode : public ListNode<ActionStmtNode> {
 public:
     ActionStmtsNode();
-    ActionStmtsNode* deepCopy();
-    std::string toString();
+    ActionStmtsNode* copyFor(const std::string& mblName);
+    void emit(Emitter& out);
 };
 
 class ActionNode : public AstNode {
 public:
     ActionNode(AstNode* name, AstNode* params, AstNode* stmts);
-    ActionNode* duplicateAction(const std::string& name);
-    std::string toString();
+    // Copy of the action to instantiate with another alt of malleable field
+    // mblName.  Only the statements referring to mblName or to malleables
+    // not transformed yet are copied, the others are shared with this
+    // action, so copies for many alts stay small.
+    ActionNode* duplicateAction(const std::string& name, const std::string& mblName);
+    void emit(Emitter& out);
 
     NameNode* name_;
     ActionParamsNode* params_;
@@ -25,7 +25,7 @@
 class P4RExprNode : public AstNode {
 public:
     P4RExprNode(AstNode* varOrReaction);
-    std::string toString();
+    void emit(Emitter& out);
 
     AstNode *varOrReaction_;
 };
@@ -39,7 +39,7 @@ public:
 class VarWidthNode : public AstNode {
 public:
     VarWidthNode(AstNode* val);
-    std::string toString();
+    void emit(Emitter& out);
 
     IntegerNode *val_;
 };
@@ -47,7 +47,7 @@ public:
 class VarInitNode : public AstNode {
 public:
     VarInitNode(AstNode* val);
-    std::string toString();
+    void emit(Emitter& out);
 
     AstNode *val_;
 };
@@ -56,7 +56,7 @@ class P4RSettableMalleableNode : public AstNode {
 public:
     enum MalleableType { VALUE, FIELD };
 
-    P4RSettableMalleableNode(std::string nodeType, AstNode* name,
+    P4RSettableMalleableNode(NodeKind kind, AstNode* name,
                             AstNode* varWidth, MalleableType MalleableType);
 
     const MalleableType malleableType_;
@@ -67,7 +67,7 @@ public:
 class P4RMalleableValueNode : public P4RSettableMalleableNode {
 public:
     P4RMalleableValueNode(AstNode* name, AstNode* varWidth, AstNode* varInit);
-    std::string toString();
+    void emit(Emitter& out);
 
     AstNode* varInit_;
 };
@@ -75,7 +75,7 @@ public:
 class FieldNode : public AstNode {
 public: 
     FieldNode(AstNode* headerName, AstNode* fieldName);
-    std::string toString();
+    void emit(Emitter& out);
 
     NameNode* headerName_;
     NameNode* fieldName_;
@@ -84,13 +84,13 @@ public:
 class FieldsNode : public ListNode<FieldNode> {
 public :
     FieldsNode();
-    std::string toString();
+    void emit(Emitter& out);
 };
 
 class VarAltNode : public AstNode {
 public:
     VarAltNode(AstNode* fieldList);
-    std::string toString();
+    void emit(Emitter& out);
 
     FieldsNode* fields_;
 };
@@ -99,23 +99,30 @@ class P4RMalleableFieldNode : public P4RSettableMalleableNode {
 public:
     P4RMalleableFieldNode(AstNode* name, AstNode* varWidth,
                          AstNode* varInit, AstNode* varAlts);
-    std::string toString();
+    void emit(Emitter& out);
 
     // during prologue/dialogue, each alternative corresponds to a unique value in pointer metadata
     int mapAltToInt(std::string alt);
 
     AstNode* varInit_;
     VarAltNode* varAlts_;
+    // Exact reads of the field kept exact, on a helper metadata field the
+    // selected alt is copied to, and the ternary match bits that saved
+    int numExactReads_ = 0;
+    int tcamBitsSaved_ = 0;
+    // Actions reading the helper field instead of being duplicated per alt
+    int numFactoredActions_ = 0;
+
+    // The selected alt is copied to the helper field
+    bool selected() const { return numExactReads_ > 0 || numFactoredActions_ > 0; }
 };
 
 class P4RMalleableTableNode : public AstNode {
 public:
     P4RMalleableTableNode(AstNode* table, std::string pragma);
-    std::string toString();
-    void transformPragma();
+    void emit(Emitter& out);
 
     TableNode* table_;
-    bool pragmaTransformed_;
     std::string pragma_;
 };
 
@@ -130,7 +137,7 @@ public:
     enum ArgType { INGRESS_FIELD, EGRESS_FIELD, INGRESS_MBL_FIELD, EGRESS_MBL_FIELD, REGISTER };
 
     ReactionArgNode(const ArgType& argType, AstNode* arg, AstNode* index1, AstNode* index2);
-    std::string toString();
+    void emit(Emitter& out);
 
     const ArgType argType_;
     AstNode* arg_;
@@ -141,13 +148,13 @@ public:
 class ReactionArgsNode : public ListNode<ReactionArgNode> {
 public:
     ReactionArgsNode();
-    std::string toString();
+    void emit(Emitter& out);
 };
 
 class P4RReactionNode : public AstNode {
 public:
     P4RReactionNode(AstNode* name, AstNode* args, AstNode* body);
-    std::string toString();
+    void emit(Emitter& out);
 
     NameNode* name_;
     ReactionArgsNode* args_;
@@ -157,10 +164,11 @@ public:
 class P4RInitBlockNode : public AstNode {
 public:
     P4RInitBlockNode(AstNode* name, AstNode* body);
-    std::string toString();
+    void emit(Emitter& out);
 
     NameNode* name_;
-    BodyNode* body_;
+    // Opaque source span, or words when the block is empty
+    AstNode* body_;
 };
 
 class MblRefNode : public AstNode {
@@ -188,13 +196,13 @@ public:
 class UnanchoredNode : public AstNode {
 // A block of code that is not anchored anywhere in the syntax tree
 public:
-    UnanchoredNode(std::string* newCode, std::string* objType,
-                   std::string* objName);
-    std::string toString();
+    UnanchoredNode(const std::string& newCode, const std::string& objType,
+                   const std::string& objName);
+    void emit(Emitter& out);
 
-    std::string *codeBlob_; // The P4 code
-    std::string *objType_;  // The type of the P4 object (ex: table, metadata)
-    std::string *objName_;  // A P4 object to invoke
+    std::string codeBlob_;        // The P4 code
+    const std::string* objType_;  // The type of the P4 object (ex: table, metadata)
+    const std::string* objName_;  // A P4 object to invoke
 };
 
 /*=====  End of Custom nodes to add transformations  ======*/
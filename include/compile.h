@@ -16,15 +16,88 @@
 #ifndef COMPILE_H
 #define COMPILE_H
 
+#include <string>
 #include <vector>
+#include <unordered_map>
 
+#include "arena.h"
 #include "ast_nodes.h"
 #include "ast_nodes_p4r.h"
+#include "node_registry.h"
+#include "symbol_table.h"
+#include "pass_manager.h"
+#include "mantisc.h"
 
 using namespace std;
 
-vector<AstNode*> compileP4Code(vector<AstNode*>* nodeArray);
+typedef pair<ReactionArgNode*, int /* size */> ReactionArgSize;
+typedef pair<vector<ReactionArgSize>, int /* size */> ReactionArgBin;
 
-vector<UnanchoredNode *> compileCCode(std::vector<AstNode*> nodeArray, char * outFnBase);
+// Everything one compilation owns, from the scanner state to the results of
+// the P4 passes the C generation picks up.  Nothing is kept in globals, so
+// separate contexts can compile side by side.
+struct CompileContext {
+    // Declared first, the syntax tree goes away last
+    Arena arena_;
+
+    // Parser
+    NodeRegistry nodes_;
+    AstNode* root_ = NULL;
+    bool withTofino_ = true;
+    bool scanStarted_ = false;
+    // Scanner position in the source, brace depth and the opaque body to
+    // return after the brace just scanned
+    const char* source_ = NULL;
+    size_t sourceLen_ = 0;
+    size_t lexOffset_ = 0;
+    int lexDepth_ = 0;
+    bool lexOpaqueDecl_ = false;
+    bool lexOpaqueMblRefs_ = false;
+    size_t lexOpaqueLen_ = 0;
+
+    // Field argument bins share 64-bit registers in pairs, see ArgLayout
+    bool pairArgBins_ = false;
+    bool mergeArgTables_ = false;
+    // Register arguments are mirrored to one replica, see RegReplicaLayout
+    bool singleRegReplica_ = false;
+    // Entries per dirty bit of the register argument replicas, 0 for none
+    int dirtyBlock_ = 0;
+    // Copies of an action past which it reads the selected alts, and the
+    // actions that do with the copies saved
+    int maxActionCopies_ = 4;
+    vector<pair<string, int> > factoredActions_;
+
+    // Filled by the P4 passes, consumed by the C passes
+    SymbolTable symbols_;
+    int ingIsoOpt_ = -1;
+    int egrIsoOpt_ = -1;
+    int numInitMblsIng_ = -1;
+    int numInitMblsEgr_ = -1;
+    // Widest alts list of a malleable field, known after the handle pool
+    int numMaxAlts_ = 1;
+    vector<ReactionArgBin> ingBins_;
+    vector<ReactionArgBin> egrBins_;
+    ArgExportCost argExport_;
+    ArgExportCost argExportPerRegister_;
+    vector<TableStage> ingStages_;
+    vector<TableStage> egrStages_;
+    unordered_map<string, int> mblUsages_;
+    unordered_map<string, P4RMalleableValueNode*> mblValues_;
+    unordered_map<string, P4RMalleableFieldNode*> mblFields_;
+    unordered_map<string, P4RMalleableTableNode*> mblTables_;
+};
+
+// Parses source into ctx->nodes_ and ctx->root_, in the current arena.
+// Opaque bodies point into source, which has to outlive the syntax tree.
+void parseP4R(const char* source, size_t len, CompileContext* ctx);
+
+// Registers the passes turning the parsed program into the malleable data
+// plane, the declarations they add go to OUT_P4_NODES
+void addP4Passes(PassManager* pm, CompileContext* ctx);
+
+// Registers the passes generating the agent code, the header, prologue and
+// dialogue go to OUT_C_NODES.  progName is what the PD api of the compiled
+// program is generated under.
+void addCPasses(PassManager* pm, CompileContext* ctx, const string& progName);
 
 #endif
@@ -0,0 +1,50 @@
+/* Copyright 2020-present University of Pennsylvania
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPILE_CACHE_H
+#define COMPILE_CACHE_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "mantisc.h"
+
+// What the P4 passes decided for a program: isolation options, malleable
+// usages, handle layout, argument packing and the hash of the generated P4.
+// Saved next to the outputs, it lets the next compilation tell whether only
+// the agent code changed, in which case the data plane build and switch
+// reload can be skipped.
+class CompileCache {
+public:
+    CompileCache() {}
+    explicit CompileCache(const CompileMetadata& meta);
+
+    // False when path is missing or was written by another version
+    bool load(const std::string& path);
+    bool save(const std::string& path) const;
+
+    bool empty() const { return facts_.empty(); }
+    std::string p4Hash() const;
+
+    // "<fact>: <old> -> <new>" for every fact that differs from old
+    std::vector<std::string> changesFrom(const CompileCache& old) const;
+
+private:
+    // "<key> <value>" lines of the file, in a fixed order
+    std::vector<std::pair<std::string, std::string> > facts_;
+};
+
+#endif
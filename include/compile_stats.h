@@ -0,0 +1,50 @@
+/* Copyright 2020-present University of Pennsylvania
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPILE_STATS_H
+#define COMPILE_STATS_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Cost of one compiler pass
+struct PassStats {
+    std::string phase_;  // parse, p4, c or emit
+    std::string name_;
+    double seconds_ = 0;
+    // Syntax tree nodes created and arena bytes taken by the pass
+    size_t nodes_ = 0;
+    size_t arenaBytes_ = 0;
+    // Heap allocations of the compiling thread during the pass, arena
+    // chunks included
+    size_t heapBytes_ = 0;
+    size_t heapAllocs_ = 0;
+    // Skipped, the output of an earlier run with the same inputs was reused
+    bool cached_ = false;
+};
+
+// Bytes and count of operator new calls made by the calling thread so far.
+// A pass runs on one thread, which makes the difference its own.
+size_t threadHeapBytes();
+size_t threadHeapAllocs();
+
+// Per pass, per phase and total report.  Either column group can be left
+// out, json gives one object with passes, phases and total.  Times are
+// summed, passes that ran side by side count with their full time.
+std::string formatPassStats(const std::vector<PassStats>& passes,
+                            bool withTime, bool withMem, bool json);
+
+#endif
@@ -0,0 +1,88 @@
+/* Copyright 2020-present University of Pennsylvania
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef EMITTER_H
+#define EMITTER_H
+
+#include <ostream>
+#include <string>
+
+class AstNode;
+
+// Buffered sink that syntax tree nodes write themselves into, front to back
+// in a single pass.  Body indentation is emitter state instead of being
+// pushed down into every body node before printing.
+class Emitter {
+public:
+    static const size_t kFlushSize = 64 * 1024;
+
+    // Buffer and write through to a stream
+    explicit Emitter(std::ostream& os);
+    // Append to a string
+    explicit Emitter(std::string* out);
+    ~Emitter();
+
+    Emitter& operator<<(const std::string& str) {
+        buf_->append(str);
+        maybeFlush();
+        return *this;
+    }
+    Emitter& operator<<(const char* str) {
+        buf_->append(str);
+        maybeFlush();
+        return *this;
+    }
+    Emitter& operator<<(char c) {
+        buf_->push_back(c);
+        return *this;
+    }
+    Emitter& write(const char* str, size_t len) {
+        buf_->append(str, len);
+        maybeFlush();
+        return *this;
+    }
+    Emitter& operator<<(int val) {
+        return *this << std::to_string(val);
+    }
+    Emitter& operator<<(AstNode* node);
+
+    // Body nesting depth, two spaces per level
+    int level() const { return level_; }
+    void indent() { level_++; }
+    void dedent() { level_--; }
+    Emitter& writeIndent(int level);
+
+    void flush();
+
+    // String form of a node, for passes that still inspect text
+    static std::string render(AstNode* node);
+
+private:
+    Emitter(const Emitter&) = delete;
+    Emitter& operator=(const Emitter&) = delete;
+
+    void maybeFlush() {
+        if (os_ != NULL && buf_->size() >= kFlushSize) {
+            flush();
+        }
+    }
+
+    std::ostream* os_ = NULL;
+    std::string own_;
+    std::string* buf_;
+    int level_ = 0;
+};
+
+#endif
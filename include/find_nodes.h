@@ -16,35 +16,34 @@
 #ifndef FIND_NODES_H
 #define FIND_NODES_H
 
-#include <regex>
 #include <unordered_map>
 
 #include "ast_nodes.h"
 #include "ast_nodes_p4.h"
 #include "ast_nodes_p4r.h"
+#include "node_registry.h"
+#include "symbol_table.h"
 
 
-bool typeContains(AstNode* n, const char* type);
-
 bool p4KeywordMatches(P4ExprNode* n, const char* type);
 
-P4ExprNode* findIngress(const std::vector<AstNode*>& astNodes);
+P4ExprNode* findIngress(const NodeRegistry& astNodes);
 
-P4ExprNode* findEgress(const std::vector<AstNode*>& astNodes);
+P4ExprNode* findEgress(const NodeRegistry& astNodes);
 
-vector<P4ExprNode*> findBlackbox(const std::vector<AstNode*>& astNodes);
+vector<P4StatefulAluNode*> findStatefulAlus(const NodeRegistry& astNodes);
 
 void findAndRemoveMalleables(
             unordered_map<string, P4RMalleableValueNode*>* varValues,
             unordered_map<string, P4RMalleableFieldNode*>* varFields,
             unordered_map<string, P4RMalleableTableNode*>* varTables,
-            const vector<AstNode*>& astNodes);
+            const NodeRegistry& astNodes);
 
 void findMalleableRefs(vector<MblRefNode*>* mblRefs,
-                      const vector<AstNode*>& astNodes);
+                      const NodeRegistry& astNodes);
 
 unordered_map<TableActionStmtNode*, TableNode*> findTableActionStmts(
-            const vector<AstNode*>& astNodes, const string& actionName);
+            const SymbolTable& symbols, const string& actionName);
 
 bool findTableReadStmt(const TableNode& table, const string& fieldName);
 
@@ -54,19 +53,21 @@ void findAndTransformMblRefsInAction(ActionNode* action,
                                      const string& altHeader,
                                      const string& altField);
 
+vector<BodyWordNode*> findBodyWords(BodyNode* body);
+
 vector<FieldNode*> findAllAlts(const P4RMalleableFieldNode& malleable);
 
-P4RInitBlockNode* findInitBlock(std::vector<AstNode*> astNodes);
+P4RInitBlockNode* findInitBlock(const NodeRegistry& astNodes);
 
-P4RReactionNode* findReaction(std::vector<AstNode*> astNodes);
+P4RReactionNode* findReaction(const NodeRegistry& astNodes);
 
-vector<P4RegisterNode*> findP4RegisterNode(const vector<AstNode*>& astNodes);
+vector<P4RegisterNode*> findP4RegisterNode(const NodeRegistry& astNodes);
 
-vector<ReactionArgNode*> findReactionArgs(const vector<AstNode*>& astNodes);
+vector<ReactionArgNode*> findReactionArgs(const NodeRegistry& astNodes);
 
 typedef unordered_map<string /* instanceName */,
                       std::vector<FieldDecNode*>*> HeaderDecsMap;
-HeaderDecsMap findHeaderDecs(const vector<AstNode*>& astNodes);
+HeaderDecsMap findHeaderDecs(const NodeRegistry& astNodes);
 
 vector<pair<ReactionArgNode*, int> > findAllReactionArgSizes(
             const vector<ReactionArgNode*>& reactionArgs,
@@ -75,12 +76,18 @@ vector<pair<ReactionArgNode*, int> > findAllReactionArgSizes(
             const unordered_map<string, P4RMalleableFieldNode*>& varFields);
 
 void findAndRemoveReactions(vector<P4RReactionNode*>* reactions,
-                            const vector<AstNode*>& astNodes);
+                            const NodeRegistry& astNodes);
+
+bool findTblInIng(string tableName, const SymbolTable& symbols);
+
+TableNode* findRegargTable(ReactionArgNode* regarg, const SymbolTable& symbols);
 
-bool findTblInIng(string tableName, const vector<AstNode*>& astNodes);
+bool findRegargInIng(ReactionArgNode* regarg, const SymbolTable& symbols);
 
-bool findRegargInIng(ReactionArgNode* regarg, std::vector<AstNode*> astNodes);
+int findRegargWidth(ReactionArgNode* regarg, const SymbolTable& symbols);
 
-int findRegargWidth(ReactionArgNode* regarg, std::vector<AstNode*> nodeArray);
+// Whether the statement of an action writes its argument word: the
+// destination of the primitives known, any argument of the others
+bool findArgWritten(ActionStmtNode* stmt, BodyWordNode* word);
 
 #endif
\ No newline at end of file
@@ -7,7 +7,10 @@
 #include <errno.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <algorithm>
+#include <stdexcept>
+#include <string>
 
 #ifdef VERBOSE
  #define PRINT_VERBOSE(msg, args...) fprintf(stdout, "VERBOSE: %s %d %s: " msg, __FILE__, __LINE__, __func__, ##args)
@@ -21,8 +24,22 @@
  #define PRINT_INFO(msg, args...)
 #endif
 
-#define PANIC(msg, args...) {\
- fprintf(stderr, "PANIC: %s %d %s: " msg, __FILE__, __LINE__, __func__, ##args);\
- exit(1); }
+// Raised by PANIC, a failed compilation must not take the host process down
+class CompileError : public std::runtime_error {
+public:
+    explicit CompileError(const std::string& what) : std::runtime_error(what) {}
+};
+
+inline std::string formatPanic(const char* fmt, ...) {
+    char buf[1024];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    return buf;
+}
+
+#define PANIC(msg, args...) \
+ throw CompileError(formatPanic("PANIC: %s %d %s: " msg, __FILE__, __LINE__, __func__, ##args))
 
 #endif // HELPER_H
@@ -0,0 +1,150 @@
+/* Copyright 2020-present University of Pennsylvania
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MANTISC_H
+#define MANTISC_H
+
+#include <string>
+#include <vector>
+
+#include "helper.h"
+#include "compile_stats.h"
+#include "pass_manager.h"
+
+// How the bins of measured field arguments are laid out in registers
+enum ArgLayout {
+    // One 32-bit register per bin, set by its own stateful alu.  The
+    // registers do not depend on each other and spread over stages freely.
+    ARG_LAYOUT_STAGES,
+    // Two bins in the halves of one 64-bit register, set by one stateful alu
+    // and read by one PCIe round trip per dialogue iteration
+    ARG_LAYOUT_READS,
+};
+
+// How register arguments are mirrored for measurement isolation
+enum RegReplicaLayout {
+    // Two replicas, one per value of mv, each set by its own table and
+    // stateful alu behind a gateway on mv
+    REG_REPLICAS_PAIR,
+    // One replica of twice the entries, entry (index << 1) | mv, set by a
+    // single table and stateful alu addressed through a hash of index and
+    // mv.  Half the tables and alus, no gateway.
+    REG_REPLICAS_SINGLE,
+};
+
+struct CompileOptions {
+    // Record the cost of every pass in CompileMetadata::passes_
+    bool passStats_ = false;
+    // Threads running independent passes, 0 for one per core
+    int passThreads_ = 0;
+    // Passes whose inputs are unchanged since they last ran with this cache
+    // are skipped when set
+    PassCache* passCache_ = NULL;
+    ArgLayout argLayout_ = ARG_LAYOUT_STAGES;
+    // One table packs every bin of a pipeline and one table per stage sets
+    // the registers, instead of a pack and a SetArgs table per register
+    bool mergeArgTables_ = false;
+    RegReplicaLayout regReplicaLayout_ = REG_REPLICAS_PAIR;
+    // Entries per block of the dirty bitmaps kept next to the isolated
+    // register arguments, a power of two.  The reactions then only read the
+    // blocks updated since, 0 reads every entry.
+    int dirtyBlock_ = 0;
+    // An action referring to malleable fields is duplicated for every
+    // combination of their alts.  Past this many copies, the fields it only
+    // reads are read from the alt selected in ingress instead.
+    int maxActionCopies_ = 4;
+};
+
+// Tables exporting the measured field arguments and the match-action
+// stages they take, estimated from the per stage limits
+struct ArgExportCost {
+    int tables_ = 0;
+    int stages_ = 0;
+};
+
+// Stage a table of the generated program is planned in
+struct TableStage {
+    std::string table_;
+    int stage_ = 0;
+    // @pragma stage of the program, -1 without
+    int pinned_ = -1;
+    // Added by the compiler around the tables of the program
+    bool injected_ = false;
+};
+
+// Reaction arguments packed into one register, by name and width
+typedef std::vector<std::pair<std::string, int> > PackedArgs;
+
+// Facts about a compiled program, besides the generated code
+struct CompileMetadata {
+    // Isolation options picked for ingress/egress, bit 0 for measurement
+    // and bit 1 for malleable table updates
+    int ingIsoOpt_ = -1;
+    int egrIsoOpt_ = -1;
+    // Names of the malleables, sorted
+    std::vector<std::string> mblValues_;
+    std::vector<std::string> mblFields_;
+    std::vector<std::string> mblTables_;
+    // Pipelines using each malleable, 0 ingress, 1 egress and 2 both,
+    // sorted by name
+    std::vector<std::pair<std::string, int> > mblUsages_;
+    // Handle layout of the malleables: init table entries per pipeline and
+    // the widest alts list
+    int numInitMblsIng_ = -1;
+    int numInitMblsEgr_ = -1;
+    int numMaxAlts_ = 1;
+    // Exact reads of malleable fields kept exact on the selected alt, and
+    // the ternary match bits on the alts that saved
+    int numExactMblReads_ = 0;
+    int tcamBitsSaved_ = 0;
+    // Actions reading the selected alts, with the copies of the action that
+    // saved
+    std::vector<std::pair<std::string, int> > factoredActions_;
+    // Registers the measured reaction arguments are packed into
+    std::vector<PackedArgs> ingBins_;
+    std::vector<PackedArgs> egrBins_;
+    // Export of the packed arguments as generated, and with a pack and a
+    // SetArgs table per register
+    ArgExportCost argExport_;
+    ArgExportCost argExportPerRegister_;
+    // Tables of each pipeline in the order applied, with their stages
+    std::vector<TableStage> ingStages_;
+    std::vector<TableStage> egrStages_;
+    // FNV-1a of the generated P4, in hex.  Equal hashes mean the data plane
+    // need not be rebuilt.
+    std::string p4Hash_;
+    size_t numNodes_ = 0;
+    size_t arenaBytes_ = 0;
+    // In the order the passes ran, see formatPassStats
+    std::vector<PassStats> passes_;
+};
+
+struct CompileOutput {
+    std::string p4_;  // Malleable data plane, <progName>_mantis.p4
+    std::string c_;   // Prologue/dialogue implementation, p4r.c
+    CompileMetadata meta_;
+};
+
+// Compiles a P4R program held in memory.  progName is the name the data
+// plane is compiled under, the agent code calls into its PD api.  All state
+// lives in a context of the call, so compilations can run in parallel
+// threads.  Errors are thrown as CompileError.
+CompileOutput compileP4R(const std::string& source, const std::string& progName,
+                         const CompileOptions& opts = CompileOptions());
+// Same over a buffer, e.g. a memory mapped file, only read during the call
+CompileOutput compileP4R(const char* source, size_t len, const std::string& progName,
+                         const CompileOptions& opts = CompileOptions());
+
+#endif
@@ -0,0 +1,59 @@
+/* Copyright 2020-present University of Pennsylvania
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NODE_REGISTRY_H
+#define NODE_REGISTRY_H
+
+#include <vector>
+#include <unordered_set>
+
+#include "ast_nodes.h"
+
+// Every node the parser creates, recorded once in creation order and
+// additionally bucketed by kind.  Passes that only care about e.g. tables or
+// actions walk the matching bucket instead of the whole program.
+class NodeRegistry {
+public:
+    typedef std::vector<AstNode*>::const_iterator const_iterator;
+
+    // Record a node; nodes that were already recorded are ignored
+    void push_back(AstNode* node);
+
+    const std::vector<AstNode*>& ofKind(NodeKind kind) const {
+        return byKind_[kind];
+    }
+
+    // Typed view of one bucket
+    template<class T>
+    std::vector<T*> allOf(NodeKind kind) const {
+        std::vector<T*> ret;
+        ret.reserve(byKind_[kind].size());
+        for (auto node : byKind_[kind]) {
+            ret.push_back(static_cast<T*>(node));
+        }
+        return ret;
+    }
+
+    const_iterator begin() const { return nodes_.begin(); }
+    const_iterator end() const { return nodes_.end(); }
+    size_t size() const { return nodes_.size(); }
+
+private:
+    std::vector<AstNode*> nodes_;
+    std::unordered_set<AstNode*> seen_;
+    std::vector<AstNode*> byKind_[NUM_NODE_KINDS];
+};
+
+#endif
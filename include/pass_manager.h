@@ -0,0 +1,172 @@
+/* Copyright 2020-present University of Pennsylvania
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PASS_MANAGER_H
+#define PASS_MANAGER_H
+
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "compile_stats.h"
+
+class Arena;
+class AstNode;
+
+// Parts of a compilation a pass reads or writes
+enum PassResource : uint64_t {
+    // Syntax tree and node registry, the declarations in them included
+    RES_TREE              = 1ull << 0,
+    RES_SYMBOLS           = 1ull << 1,
+    RES_ING_ISO_OPT       = 1ull << 2,
+    RES_EGR_ISO_OPT       = 1ull << 3,
+    RES_ISO_OPTS          = RES_ING_ISO_OPT | RES_EGR_ISO_OPT,
+    // Malleable values, fields and tables by name
+    RES_MBLS              = 1ull << 4,
+    RES_MBL_REFS          = 1ull << 5,
+    RES_MBL_USAGES        = 1ull << 6,
+    RES_NUM_INIT_MBLS_ING = 1ull << 7,
+    RES_NUM_INIT_MBLS_EGR = 1ull << 8,
+    RES_NUM_MAX_ALTS      = 1ull << 9,
+    // Reaction arguments and the header declarations sizing them
+    RES_REACTION_ARGS     = 1ull << 10,
+    RES_ING_BINS          = 1ull << 11,
+    RES_EGR_BINS          = 1ull << 12,
+    RES_BINS              = RES_ING_BINS | RES_EGR_BINS,
+    // init_block and reaction code after rewriting
+    RES_INIT_CODE         = 1ull << 13,
+    RES_REACTION_CODE     = 1ull << 14,
+};
+
+// What passes append to, see PassOutput
+enum PassOutputId {
+    OUT_P4_NODES,         // Declarations added to the data plane
+    OUT_C_NODES,          // Header, prologue and dialogue of p4r.c
+    OUT_PREPROCESSOR,     // Macros expanded into the C code
+    OUT_MBL_INIT,         // Prologue before the init_block
+    OUT_INIT_END,         // Prologue after the init_block
+    OUT_REACTION_MIRROR,  // Dialogue before the reaction
+    OUT_REACTION_UPDATE,  // Dialogue after the reaction
+    NUM_PASS_OUTPUTS
+};
+
+// Resource of an output.  Writing it means appending, so passes that only
+// append to the same output do not wait for each other.
+inline uint64_t outputRes(PassOutputId id) {
+    return 1ull << (32 + id);
+}
+
+// What one pass appended.  Kept per pass and joined in registration order,
+// the result does not depend on which pass finished first.
+class PassOutput {
+public:
+    std::vector<AstNode*>& nodes(PassOutputId id) { return nodes_[id]; }
+    std::ostringstream& stream(PassOutputId id);
+
+private:
+    friend class PassManager;
+    friend class PassCache;
+
+    std::vector<AstNode*> nodes_[NUM_PASS_OUTPUTS];
+    std::unique_ptr<std::ostringstream> streams_[NUM_PASS_OUTPUTS];
+};
+
+// Streams a pass appended, under the key of the inputs they came from.  Only
+// the last key of each pass is kept: a pass is skipped when its inputs did
+// not change since it last ran, e.g. in the previous compilation of a
+// program being edited.  Can be shared by compilations on several threads.
+class PassCache {
+public:
+    // Replays the cached streams of pass into out if they are for key
+    bool lookup(const std::string& pass, const std::string& key, PassOutput* out);
+    void store(const std::string& pass, const std::string& key, const PassOutput& out);
+
+private:
+    struct Entry {
+        std::string key_;
+        std::string streams_[NUM_PASS_OUTPUTS];
+    };
+
+    std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+};
+
+// Runs the passes of one compilation.  Each pass declares the resources it
+// reads and writes, and runs after every earlier registered pass it shares
+// one with, unless both only read it.  Registration order is therefore the
+// sequential order, and passes sharing nothing, e.g. the ingress and egress
+// halves of a pass, run side by side on a pool of threads.
+class PassManager {
+public:
+    typedef std::function<void(PassOutput* out)> Body;
+    // Describes everything a pass reads, called once the passes it depends
+    // on ran
+    typedef std::function<std::string()> Key;
+
+    // Nodes are created in arena, pass costs are appended to stats and
+    // cached passes looked up in cache, each when set
+    PassManager(Arena* arena, std::vector<PassStats>* stats = NULL, PassCache* cache = NULL);
+
+    // reads and writes are PassResource masks
+    void add(const char* phase, const char* name, uint64_t reads, uint64_t writes, Body body);
+    // A pass that only appends to streams.  It is skipped and its streams
+    // replayed when the cache holds them for the same key.
+    void addCached(const char* phase, const char* name, uint64_t reads, uint64_t writes,
+                   Key key, Body body);
+
+    // Runs the passes on up to numThreads threads, the calling one included,
+    // 0 for one per core.  After a failure no further pass is started, the
+    // error of the earliest registered failed pass is rethrown.
+    void run(int numThreads);
+
+    // Everything appended to an output so far, in registration order, for a
+    // pass that declared to read it
+    std::vector<AstNode*> nodes(PassOutputId id) const;
+    std::string str(PassOutputId id) const;
+
+private:
+    struct Pass {
+        const char* phase_;
+        const char* name_;
+        uint64_t reads_;
+        uint64_t writes_;
+        Key key_;
+        Body body_;
+        PassOutput output_;
+        // Earlier passes to wait for, later passes waiting
+        int numDeps_ = 0;
+        std::vector<size_t> dependents_;
+        bool ran_ = false;
+        PassStats stats_;
+        std::exception_ptr error_;
+    };
+
+    static bool dependsOn(const Pass& later, const Pass& earlier);
+    void runPass(Pass* pass);
+    void runParallel(int numThreads);
+
+    Arena* arena_;
+    std::vector<PassStats>* stats_;
+    PassCache* cache_;
+    std::vector<std::unique_ptr<Pass> > passes_;
+};
+
+#endif
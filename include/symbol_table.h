@@ -0,0 +1,74 @@
+/* Copyright 2020-present University of Pennsylvania
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYMBOL_TABLE_H
+#define SYMBOL_TABLE_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "ast_nodes.h"
+#include "ast_nodes_p4.h"
+#include "ast_nodes_p4r.h"
+#include "node_registry.h"
+#include "apply_graph.h"
+
+// Program-wide name -> node maps plus the reverse edges that passes keep
+// asking for (register -> stateful alu -> action -> table -> control).
+// Built once after parsing; passes that rename or instantiate actions keep it
+// current through renameAction/addAction/addTableAction.
+class SymbolTable {
+public:
+    void build(const NodeRegistry& nodes);
+
+    const NodeRegistry& nodes() const { return *nodes_; }
+    const ApplyGraph& applyGraph() const { return applyGraph_; }
+
+    TableNode* table(const std::string& name) const;
+    ActionNode* action(const std::string& name) const;
+    P4RegisterNode* reg(const std::string& name) const;
+    P4StatefulAluNode* blackbox(const std::string& name) const;
+    P4ExprNode* control(const std::string& name) const;
+    // Declared width of a field of a header or metadata instance, -1 when
+    // unknown
+    int fieldWidth(const std::string& instance, const std::string& field) const;
+
+    // Reverse edges, in program order
+    const std::vector<P4StatefulAluNode*>& blackboxesOn(const std::string& regName) const;
+    const std::vector<ActionNode*>& actionsExecuting(const std::string& blackboxName) const;
+    const std::vector<TableNode*>& tablesListing(const std::string& actionName) const;
+
+    void renameAction(const std::string& oldName, const std::string& newName);
+    void addAction(ActionNode* action);
+    void addTableAction(TableNode* table, const std::string& actionName);
+
+private:
+    const NodeRegistry* nodes_ = NULL;
+    ApplyGraph applyGraph_;
+
+    std::unordered_map<std::string, TableNode*> tables_;
+    std::unordered_map<std::string, ActionNode*> actions_;
+    std::unordered_map<std::string, P4RegisterNode*> registers_;
+    std::unordered_map<std::string, P4StatefulAluNode*> blackboxes_;
+    std::unordered_map<std::string, P4ExprNode*> controls_;
+    std::unordered_map<std::string, FieldDecsNode*> instanceFields_;
+
+    std::unordered_map<std::string, std::vector<P4StatefulAluNode*>> regBlackboxes_;
+    std::unordered_map<std::string, std::vector<ActionNode*>> aluActions_;
+    std::unordered_map<std::string, std::vector<TableNode*>> actionTables_;
+};
+
+#endif
@@ -0,0 +1,392 @@
+/* Copyright 2020-present University of Pennsylvania
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Command line frontend over libmantisc
+
+#include <string>
+#include <cstdio>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+#include <execinfo.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "include/mantisc.h"
+#include "include/compile_cache.h"
+
+using namespace std;
+
+char* in_fn = NULL;
+char* out_fn_base = NULL;
+char* batch_fn = NULL;
+char* cache_fn = NULL;
+int num_jobs = 0;
+int pass_threads = -1;
+bool time_passes = false;
+bool mem_report = false;
+bool stats_json = false;
+ArgLayout arg_layout = ARG_LAYOUT_STAGES;
+bool merge_arg_tables = false;
+RegReplicaLayout reg_replicas = REG_REPLICAS_PAIR;
+int max_action_copies = -1;
+int dirty_block = 0;
+bool stage_map = false;
+
+// From: https://stackoverflow.com/questions/865668/how-to-parse-command-line-arguments-in-c
+char* getCmdOption(char ** begin, char ** end, const std::string & option)
+{
+    char ** itr = std::find(begin, end, option);
+    if (itr != end && ++itr != end)
+    {
+        return *itr;
+    }
+    return 0;
+}
+
+bool cmdOptionExists(char** begin, char** end, const std::string& option)
+{
+    return std::find(begin, end, option) != end;
+}
+
+void parseArgs(int argc, char* argv[]){
+    in_fn = getCmdOption(argv, argv+argc, "-i");
+    out_fn_base = getCmdOption(argv, argv+argc, "-o");
+    batch_fn = getCmdOption(argv, argv+argc, "--batch");
+    cache_fn = getCmdOption(argv, argv+argc, "--cache");
+    char* jobs = getCmdOption(argv, argv+argc, "-j");
+    if (jobs != NULL) {
+        num_jobs = atoi(jobs);
+    }
+    char* passThreads = getCmdOption(argv, argv+argc, "--pass-threads");
+    if (passThreads != NULL) {
+        pass_threads = atoi(passThreads);
+    }
+    char* argLayout = getCmdOption(argv, argv+argc, "--arg-layout");
+    if (argLayout != NULL) {
+        if (string(argLayout) == "stages") {
+            arg_layout = ARG_LAYOUT_STAGES;
+        } else if (string(argLayout) == "reads") {
+            arg_layout = ARG_LAYOUT_READS;
+        } else {
+            fprintf(stderr, "PANIC: --arg-layout expects stages or reads, got %s\n", argLayout);
+            exit(1);
+        }
+    }
+    char* maxActionCopies = getCmdOption(argv, argv+argc, "--max-action-copies");
+    if (maxActionCopies != NULL) {
+        max_action_copies = atoi(maxActionCopies);
+    }
+    char* regReplicas = getCmdOption(argv, argv+argc, "--reg-replicas");
+    if (regReplicas != NULL) {
+        if (string(regReplicas) == "pair") {
+            reg_replicas = REG_REPLICAS_PAIR;
+        } else if (string(regReplicas) == "single") {
+            reg_replicas = REG_REPLICAS_SINGLE;
+        } else {
+            fprintf(stderr, "PANIC: --reg-replicas expects pair or single, got %s\n", regReplicas);
+            exit(1);
+        }
+    }
+    char* dirtyBlocks = getCmdOption(argv, argv+argc, "--dirty-blocks");
+    if (dirtyBlocks != NULL) {
+        dirty_block = atoi(dirtyBlocks);
+        if (dirty_block < 0 || (dirty_block & (dirty_block - 1)) != 0) {
+            fprintf(stderr, "PANIC: --dirty-blocks expects 0 or a power of two, got %s\n", dirtyBlocks);
+            exit(1);
+        }
+    }
+    merge_arg_tables = cmdOptionExists(argv, argv+argc, "--merge-arg-tables");
+    stage_map = cmdOptionExists(argv, argv+argc, "--stage-map");
+    time_passes = cmdOptionExists(argv, argv+argc, "--time-passes");
+    mem_report = cmdOptionExists(argv, argv+argc, "--mem-report");
+    stats_json = cmdOptionExists(argv, argv+argc, "--stats-json");
+    if (batch_fn == NULL && ((in_fn == NULL) || (out_fn_base == NULL))){
+        cout << "expected arguments: "
+             << argv[0]
+             << " -i <input P4R filename> -o <output filename base> [--cache <cache file>] "
+             << "[--pass-threads <threads>] [--arg-layout stages|reads] [--reg-replicas pair|single] [--dirty-blocks <entries>] [--merge-arg-tables] [--max-action-copies <copies>] [--stage-map] [--time-passes] [--mem-report] [--stats-json]"
+             << endl
+             << "                or: "
+             << argv[0]
+             << " --batch <list of input/output base pairs> [-j <threads>] [--pass-threads <threads>] [--arg-layout stages|reads] [--reg-replicas pair|single] [--dirty-blocks <entries>] [--merge-arg-tables] [--max-action-copies <copies>]"
+             << endl;
+        exit(0);
+    }
+}
+
+// One line per stage, tables whose @pragma stage moved are marked with the
+// stage they were pinned to
+void printStageMap(const string& inFn, const char* pipeline, const vector<TableStage>& tables) {
+    int numStages = 0;
+    for (const TableStage& table : tables) {
+        numStages = std::max(numStages, table.stage_ + 1);
+    }
+    printf("%s: %s takes %d stage%s\n", inFn.c_str(), pipeline, numStages, numStages == 1 ? "" : "s");
+    for (int stage = 0; stage < numStages; stage++) {
+        bool first = true;
+        for (const TableStage& table : tables) {
+            if (table.stage_ != stage) {
+                continue;
+            }
+            if (first) {
+                printf("  stage %d:", stage);
+                first = false;
+            }
+            printf(" %s", table.table_.c_str());
+            if (table.pinned_ >= 0 && table.pinned_ != stage) {
+                printf(" (pinned to %d)", table.pinned_);
+            }
+        }
+        if (!first) {
+            printf("\n");
+        }
+    }
+}
+
+// Compiles one program to <outFnBase>_mantis.p4 and <outFnBase>_mantis.c,
+// with the pass report asked for on the command line.  Passes already run
+// with the same inputs are taken from passCache when set.  With a cacheFn,
+// <outFnBase>_mantis.p4 is left alone when the data plane is the same as in
+// the compilation that saved the cache.
+bool compileFile(const string& inFn, const string& outFnBase, int passThreads,
+                 PassCache* passCache, const char* cacheFn, string* error, string* report) {
+    // The source is scanned in place from a read only mapping of the file
+    int fd = open(inFn.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0) close(fd);
+        *error = "PANIC: Input P4R file not found\n";
+        return false;
+    }
+    size_t len = st.st_size;
+    void* source = len == 0 ? NULL : mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (source == MAP_FAILED) {
+        *error = "PANIC: Failed to map input P4R file\n";
+        return false;
+    }
+
+    // The data plane is compiled under the output base name
+    string base_fn = outFnBase.substr(outFnBase.find_last_of("/\\") + 1);
+
+    CompileOptions opts;
+    opts.passStats_ = time_passes || mem_report;
+    opts.passThreads_ = passThreads;
+    opts.passCache_ = passCache;
+    opts.argLayout_ = arg_layout;
+    opts.mergeArgTables_ = merge_arg_tables;
+    opts.regReplicaLayout_ = reg_replicas;
+    opts.dirtyBlock_ = dirty_block;
+    if (max_action_copies >= 0) {
+        opts.maxActionCopies_ = max_action_copies;
+    }
+    CompileOutput output;
+    bool ok = true;
+    try {
+        output = compileP4R(len == 0 ? "" : (const char*)source, len, base_fn, opts);
+    } catch (const std::exception& e) {
+        *error = e.what();
+        ok = false;
+    }
+    if (opts.passStats_) {
+        *report = formatPassStats(output.meta_.passes_, time_passes, mem_report, stats_json);
+    }
+    if (source != NULL) {
+        munmap(source, len);
+    }
+    if (!ok) {
+        return false;
+    }
+
+    if (output.meta_.numExactMblReads_ > 0) {
+        printf("%s: %d exact reads of malleable fields kept exact, %d TCAM match bits saved\n",
+               inFn.c_str(), output.meta_.numExactMblReads_, output.meta_.tcamBitsSaved_);
+    }
+    for (const auto& action : output.meta_.factoredActions_) {
+        printf("%s: action %s reads the selected alts of its malleable fields, %d copies saved\n",
+               inFn.c_str(), action.first.c_str(), action.second);
+    }
+    if (stage_map) {
+        printStageMap(inFn, "ingress", output.meta_.ingStages_);
+        printStageMap(inFn, "egress", output.meta_.egrStages_);
+    }
+    if (merge_arg_tables) {
+        const ArgExportCost& merged = output.meta_.argExport_;
+        const ArgExportCost& perRegister = output.meta_.argExportPerRegister_;
+        printf("%s: argument export takes %d tables and %d stages, %d tables and %d stages saved by merging\n",
+               inFn.c_str(), merged.tables_, merged.stages_,
+               perRegister.tables_ - merged.tables_, perRegister.stages_ - merged.stages_);
+    }
+
+    bool writeP4 = true;
+    if (cacheFn != NULL) {
+        CompileCache cache(output.meta_);
+        CompileCache previous;
+        if (!previous.load(cacheFn)) {
+            printf("No compile cache at %s, data plane compiled from scratch\n", cacheFn);
+        } else if (previous.p4Hash() == cache.p4Hash() && access((outFnBase + "_mantis.p4").c_str(), F_OK) == 0) {
+            printf("Data plane unchanged (p4 hash %s), only %s_mantis.c regenerated\n",
+                   cache.p4Hash().c_str(), outFnBase.c_str());
+            writeP4 = false;
+        } else {
+            printf("Data plane changed:\n");
+            for (const string& change : cache.changesFrom(previous)) {
+                printf("  %s\n", change.c_str());
+            }
+        }
+        if (!cache.save(cacheFn)) {
+            *error = "PANIC: Failed to write compile cache " + string(cacheFn) + "\n";
+            return false;
+        }
+    }
+
+    ofstream os;
+    if (writeP4) {
+        os.open(outFnBase + "_mantis.p4");
+        os << output.p4_;
+        os.close();
+    }
+
+	os.open(outFnBase + "_mantis.c");
+    os << output.c_;
+	os.close();
+
+    return true;
+}
+
+struct BatchJob {
+    string inFn_;
+    string outFnBase_;
+    bool ok_ = false;
+    string error_;
+    string report_;
+    double seconds_ = 0;
+};
+
+// One "<input P4R filename> <output filename base>" pair per line, blank
+// lines and lines starting with # are skipped
+vector<BatchJob> readBatchList(const string& listFn) {
+    ifstream is(listFn);
+    if (!is) {
+        fprintf(stderr, "PANIC: Batch list %s not found\n", listFn.c_str());
+        exit(1);
+    }
+    vector<BatchJob> jobs;
+    string line;
+    int lineno = 0;
+    while (getline(is, line)) {
+        lineno++;
+        istringstream words(line);
+        BatchJob job;
+        if (!(words >> job.inFn_) || job.inFn_[0] == '#') {
+            continue;
+        }
+        if (!(words >> job.outFnBase_)) {
+            fprintf(stderr, "PANIC: %s line %d: expected <input> <output base>\n", listFn.c_str(), lineno);
+            exit(1);
+        }
+        jobs.push_back(job);
+    }
+    return jobs;
+}
+
+// Compiles every program of the list on a pool of worker threads.  A failed
+// program is reported in the summary and does not stop the others.
+int runBatch(const string& listFn, int numThreads) {
+    vector<BatchJob> jobs = readBatchList(listFn);
+    if (numThreads <= 0) {
+        numThreads = std::max(1u, thread::hardware_concurrency());
+    }
+    numThreads = std::min<int>(numThreads, std::max<size_t>(jobs.size(), 1));
+    // Programs already keep the threads busy, their passes run in sequence
+    // unless asked otherwise
+    int passThreads = pass_threads < 0 ? 1 : pass_threads;
+    PassCache passCache;
+
+    auto start = chrono::steady_clock::now();
+    atomic<size_t> next(0);
+    vector<thread> workers;
+    for (int t = 0; t < numThreads; t++) {
+        workers.emplace_back([&]() {
+            for (size_t i = next++; i < jobs.size(); i = next++) {
+                BatchJob& job = jobs[i];
+                auto jobStart = chrono::steady_clock::now();
+                job.ok_ = compileFile(job.inFn_, job.outFnBase_, passThreads, &passCache, NULL,
+                                      &job.error_, &job.report_);
+                job.seconds_ = chrono::duration<double>(chrono::steady_clock::now() - jobStart).count();
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    int numFailed = 0;
+    for (const BatchJob& job : jobs) {
+        if (job.ok_) {
+            printf("ok     %.3fs %s -> %s\n", job.seconds_, job.inFn_.c_str(), job.outFnBase_.c_str());
+        } else {
+            numFailed++;
+            printf("FAILED %.3fs %s\n  %s", job.seconds_, job.inFn_.c_str(), job.error_.c_str());
+        }
+        fprintf(stderr, "%s", job.report_.c_str());
+    }
+    printf("%zu compiled, %d failed, %.3fs on %d threads\n",
+           jobs.size() - numFailed, numFailed, seconds, numThreads);
+    return numFailed == 0 ? 0 : 1;
+}
+
+void handler(int sig);
+
+int main(int argc, char* argv[]) {
+    signal(SIGSEGV, handler);
+
+    parseArgs(argc, argv);
+
+    if (batch_fn != NULL) {
+        return runBatch(batch_fn, num_jobs);
+    }
+
+    string error, report;
+    bool ok = compileFile(in_fn, out_fn_base, pass_threads < 0 ? 0 : pass_threads, NULL,
+                          cache_fn, &error, &report);
+    fprintf(stderr, "%s%s", report.c_str(), error.c_str());
+    return ok ? 0 : 1;
+}
+
+// Crash dump handler: https://stackoverflow.com/questions/77005/how-to-automatically-generate-a-stacktrace-when-my-program-crashes
+void handler(int sig) {
+  void* array[10];
+  size_t size;
+
+  // get void*'s for all entries on the stack
+  size = backtrace(array, 10);
+
+  // print out all the frames to stderr
+  fprintf(stderr, "Error: signal %d:\n", sig);
+  backtrace_symbols_fd(array, size, STDERR_FILENO);
+  exit(1);
+}
@@ -0,0 +1,101 @@
+/* Copyright 2020-present University of Pennsylvania
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdlib>
+
+#include "../../include/arena.h"
+#include "../../include/ast_nodes.h"
+
+static thread_local Arena* currentArena = NULL;
+static thread_local size_t threadNodes = 0;
+static thread_local size_t threadBytes = 0;
+
+static const size_t kAlignment = alignof(std::max_align_t);
+
+Arena::Arena(size_t chunkSize) : chunkSize_(chunkSize) {
+}
+
+Arena::~Arena() {
+    // Later nodes may point at earlier ones, tear down newest first
+    for (auto it = nodes_.rbegin(); it != nodes_.rend(); ++it) {
+        (*it)->~AstNode();
+    }
+    for (char* chunk : chunks_) {
+        free(chunk);
+    }
+}
+
+void* Arena::allocate(size_t size) {
+    size = (size + kAlignment - 1) & ~(kAlignment - 1);
+    threadBytes += size;
+    std::lock_guard<std::mutex> lock(mutex_);
+    bytesAllocated_ += size;
+
+    if (size > chunkSize_ / 4) {
+        // Oversized requests get their own chunk, the current one stays open
+        char* chunk = static_cast<char*>(malloc(size));
+        chunks_.push_back(chunk);
+        return chunk;
+    }
+    if (next_ == NULL || next_ + size > end_) {
+        next_ = static_cast<char*>(malloc(chunkSize_));
+        end_ = next_ + chunkSize_;
+        chunks_.push_back(next_);
+    }
+    void* ret = next_;
+    next_ += size;
+    return ret;
+}
+
+void Arena::adopt(AstNode* node) {
+    threadNodes++;
+    std::lock_guard<std::mutex> lock(mutex_);
+    nodes_.push_back(node);
+}
+
+const std::string* Arena::intern(const char* str) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return &*symbols_.emplace(str).first;
+}
+
+const std::string* Arena::intern(const std::string& str) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return &*symbols_.insert(str).first;
+}
+
+size_t Arena::threadNumNodes() {
+    return threadNodes;
+}
+
+size_t Arena::threadBytesAllocated() {
+    return threadBytes;
+}
+
+Arena* Arena::current() {
+    if (currentArena == NULL) {
+        // Nodes created outside any compilation live until exit
+        static Arena processArena;
+        return &processArena;
+    }
+    return currentArena;
+}
+
+Arena::Scope::Scope(Arena* arena) : previous_(currentArena) {
+    currentArena = arena;
+}
+
+Arena::Scope::~Scope() {
+    currentArena = previous_;
+}
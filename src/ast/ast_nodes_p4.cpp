@@ -13,24 +13,18 @@
  * limitations under the License.
  */
 
+#include <cstring>
+#include <cctype>
+
 #include "../../include/ast_nodes_p4.h"
 #include "../../include/ast_nodes_p4r.h"
 
 using namespace std;
 
-static string operator*(std::string str, int count)
-{
-    string ret;
-    for(auto i = 0; i<count; i++) {
-        ret = ret + str;
-    }
-    return ret;
-}
-
 BodyWordNode::BodyWordNode(WordType wordType, AstNode* contents)
                            : wordType_(wordType) {
 
-    nodeType_ = typeid(*this).name();
+    kind_ = BODY_WORD_NODE;
     contents_ = contents;
     contents_->parent_ = this;
 }
@@ -45,29 +39,44 @@ BodyWordNode* BodyWordNode::deepCopy() {
     return newNode;
 }
 
-string BodyWordNode::toString() {
-    ostringstream oss; 
-    if (wordType_ == WordType::INTEGER || wordType_ == WordType::SPECIAL) {
-        oss << contents_->toString();
-    } else if (dynamic_cast<BodyNode*>(parent_) != NULL && dynamic_cast<BodyNode*>(parent_)->bodyOuter_ != NULL && 
-        dynamic_cast<BodyNode*>(parent_)->bodyOuter_->str_ != NULL && dynamic_cast<BodyNode*>(parent_)->bodyOuter_->str_->wordType_ == WordType::SPECIAL &&
-        dynamic_cast<BodyNode*>(parent_)->bodyOuter_->str_->contents_->toString() != ";" ) {
-        oss << contents_->toString();
-    } else if (dynamic_cast<BodyNode*>(parent_) != NULL && dynamic_cast<BodyNode*>(parent_)->bodyOuter_ != NULL && 
-        dynamic_cast<BodyNode*>(parent_)->bodyOuter_->str_ != NULL && dynamic_cast<BodyNode*>(parent_)->bodyOuter_->str_->wordType_ == WordType::INTEGER) {
-        oss << contents_->toString();
+// A word directly follows a non ';' special char or an integer without indent
+static bool gluedTo(BodyWordNode* prev) {
+    if (prev == NULL) {
+        return false;
+    }
+    if (prev->wordType_ == BodyWordNode::SPECIAL) {
+        return prev->contents_->toString() != ";";
+    }
+    return prev->wordType_ == BodyWordNode::INTEGER;
+}
+
+void BodyWordNode::emitWord(Emitter& out, BodyWordNode* prev, int level) {
+    if (wordType_ == WordType::INTEGER || wordType_ == WordType::SPECIAL ||
+        gluedTo(prev)) {
+        out << contents_;
     } else {
-        oss << string("  ")*indent_ << contents_->toString();
+        out.writeIndent(level) << contents_;
+    }
+    if (wordType_ == WordType::SPECIAL && contents_->toString() == ";") {
+        out << "\n";
     }
-    if (contents_->toString() == ";") {
-        oss << "\n";
-    }    
-    return oss.str();
+}
+
+void BodyWordNode::emit(Emitter& out) {
+    // Outside a body (e.g. action arguments) a word sits at the first level
+    BodyWordNode* prev = NULL;
+    if (parent_ != NULL && parent_->isKind(BODY_NODE)) {
+        BodyNode* body = dynamic_cast<BodyNode*>(parent_);
+        if (body->bodyOuter_ != NULL) {
+            prev = body->bodyOuter_->str_;
+        }
+    }
+    emitWord(out, prev, out.level() > 0 ? out.level() : 1);
 }
 
 BodyNode::BodyNode(AstNode* bodyOuter, AstNode* bodyInner, AstNode* str) {
 
-    nodeType_ = typeid(*this).name();
+    kind_ = BODY_NODE;
     bodyOuter_ = dynamic_cast<BodyNode*>(bodyOuter);
     if (bodyOuter_) bodyOuter_->parent_ = this;
     bodyInner_ = dynamic_cast<BodyNode*>(bodyInner);
@@ -80,73 +89,220 @@ BodyNode::BodyNode(AstNode* bodyOuter, AstNode* bodyInner, AstNode* str) {
     }
 }
 
-string BodyNode::toString() {
-    ostringstream oss;
-    // Called from the root BodyNode
-    if (bodyOuter_) {
-        bodyOuter_->indent_ = indent_;
-        oss << bodyOuter_->toString();
+void BodyNode::emit(Emitter& out) {
+    // The outer chain is as long as the body, walk it without recursing
+    vector<BodyNode*> chain;
+    for (BodyNode* body = this; body != NULL; body = body->bodyOuter_) {
+        chain.push_back(body);
     }
-    if (str_) {
-        str_->indent_ = indent_;
-        oss << str_->toString();
-        return oss.str();
-    } else if (bodyInner_) {
-        bodyInner_->indent_ = indent_ + 1; 
-        oss << string("  ")*indent_ << "{\n"
-            << bodyInner_->toString()
-            << string("  ")*indent_ << "}\n";
-        return oss.str();
-    } else {
-        assert(false);
+
+    out.indent();
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+        BodyNode* body = *it;
+        if (body->str_) {
+            BodyWordNode* prev = body->bodyOuter_ ? body->bodyOuter_->str_ : NULL;
+            body->str_->emitWord(out, prev, out.level());
+        } else if (body->bodyInner_) {
+            out.writeIndent(out.level()) << "{\n";
+            out << body->bodyInner_;
+            out.writeIndent(out.level()) << "}\n";
+        } else {
+            assert(false);
+        }
+    }
+    out.dedent();
+}
+
+OpaqueBodyNode::OpaqueBodyNode(const char* text, size_t len)
+                               : text_(text), len_(len) {
+    kind_ = OPAQUE_BODY_NODE;
+}
+
+bool OpaqueBodyNode::opaqueKeyword(const char* word) {
+    static const char* const kKeywords[] = {
+        "parser", "parser_exception", "parser_value_set",
+        "field_list", "field_list_calculation", "calculated_field",
+        "counter", "meter", "action_profile", "action_selector"
+    };
+    for (const char* keyword : kKeywords) {
+        if (strcmp(word, keyword) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t OpaqueBodyNode::spanLength(const char* text, size_t len, bool mblRefs) {
+    // Skips what the scanner skips or takes as a whole line, so braces are
+    // matched the same way the word tree would have matched them
+    int depth = 0;
+    size_t i = 0;
+    while (i < len) {
+        char c = text[i];
+        if (c == '/' && i + 1 < len && text[i+1] == '/') {
+            while (i < len && text[i] != '\n') i++;
+        } else if (c == '/' && i + 1 < len && text[i+1] == '*') {
+            i += 2;
+            while (i + 1 < len && !(text[i] == '*' && text[i+1] == '/')) i++;
+            if (i + 1 >= len) {
+                return 0;
+            }
+            i += 2;
+        } else if (c == '#' || c == '@') {
+            while (i < len && text[i] != '\n') i++;
+        } else if (c == '$' && !mblRefs) {
+            return 0;
+        } else if (c == '{') {
+            depth++;
+            i++;
+        } else if (c == '}') {
+            if (depth-- == 0) {
+                return i;
+            }
+            i++;
+        } else {
+            i++;
+        }
+    }
+    return 0;
+}
+
+void OpaqueBodyNode::emit(Emitter& out) {
+    // Verbatim from the line the first word is on to the last word
+    size_t begin = 0;
+    while (begin < len_ && isspace((unsigned char)text_[begin])) begin++;
+    if (begin == len_) {
+        return;
+    }
+    while (begin > 0 && text_[begin-1] != '\n') begin--;
+    size_t end = len_;
+    while (isspace((unsigned char)text_[end-1])) end--;
+    out.write(text_ + begin, end - begin) << "\n";
+}
+
+P4AttributeNode::P4AttributeNode(const string* name, const vector<BodyWordNode*>& value)
+                                 : name_(name), value_(value) {
+    kind_ = P4_ATTRIBUTE_NODE;
+}
+
+void P4AttributeNode::emit(Emitter& out) {
+    out << *name_ << " :";
+    for (BodyWordNode* word : value_) {
+        out << " " << word->contents_;
+    }
+    out << ";\n";
+}
+
+const string* P4AttributeNode::word() const {
+    if (value_.size() != 1) {
+        return NULL;
+    }
+    AstNode* contents = value_[0]->contents_;
+    if (contents->isKind(NAME_NODE)) {
+        return dynamic_cast<NameNode*>(contents)->word_;
+    } else if (contents->isKind(INTEGER_NODE)) {
+        return dynamic_cast<IntegerNode*>(contents)->word_;
+    }
+    return NULL;
+}
+
+P4AttributesNode::P4AttributesNode() {
+    kind_ = P4_ATTRIBUTES_NODE;
+}
+
+// The scanner hands "reg" over as a string and "width" as a special char
+static const string* attributeName(BodyWordNode* word) {
+    AstNode* contents = word->contents_;
+    if (contents->isKind(NAME_NODE)) {
+        return dynamic_cast<NameNode*>(contents)->word_;
+    } else if (contents->isKind(STR_NODE)) {
+        return dynamic_cast<StrNode*>(contents)->word_;
+    } else if (contents->isKind(SPECIAL_CHAR_NODE)) {
+        const string* special = dynamic_cast<SpecialCharNode*>(contents)->word_;
+        return isalpha((unsigned char)(*special)[0]) ? special : NULL;
+    }
+    return NULL;
+}
+
+P4AttributesNode* P4AttributesNode::parse(BodyNode* body) {
+    vector<BodyNode*> chain;
+    for (BodyNode* b = body; b != NULL; b = b->bodyOuter_) {
+        chain.push_back(b);
+    }
+
+    // name : value ;
+    auto ret = new P4AttributesNode();
+    vector<BodyWordNode*> stmt;
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+        BodyWordNode* word = (*it)->str_;
+        if (word == NULL) {
+            stmt.clear();
+        } else if (word->wordType_ != BodyWordNode::SPECIAL || word->contents_->toString() != ";") {
+            stmt.push_back(word);
+        } else {
+            const string* name = stmt.size() >= 2 ? attributeName(stmt[0]) : NULL;
+            if (name != NULL &&
+                stmt[1]->wordType_ == BodyWordNode::SPECIAL &&
+                stmt[1]->contents_->toString() == ":") {
+                ret->push_back(new P4AttributeNode(
+                    name, vector<BodyWordNode*>(stmt.begin() + 2, stmt.end())));
+            }
+            stmt.clear();
+        }
+    }
+    return ret;
+}
+
+void P4AttributesNode::emit(Emitter& out) {
+    for (auto attribute : *list_) {
+        out << attribute;
+    }
+}
+
+P4AttributeNode* P4AttributesNode::find(const string& name) const {
+    for (auto attribute : *list_) {
+        if (*attribute->name_ == name) {
+            return attribute;
+        }
+    }
+    return NULL;
+}
+
+static int intAttribute(P4AttributesNode* attributes, const char* name) {
+    P4AttributeNode* attribute = attributes->find(name);
+    if (attribute == NULL || attribute->word() == NULL) {
+        return -1;
     }
+    return stoi(*attribute->word());
 }
 
 P4RegisterNode::P4RegisterNode(AstNode* name, AstNode* body) {
-    nodeType_ = typeid(*this).name();
+    kind_ = P4_REGISTER_NODE;
     name_ = dynamic_cast<NameNode*>(name);
-    if(body->nodeType_.find("EmptyNode")!=string::npos) {
-        body_ = new BodyNode(NULL, NULL, new BodyWordNode(BodyWordNode::STRING, new StrNode(new string(""))));
-        width_ = -1;
-        instanceCount_ = -1;        
+    if(body->isKind(EMPTY_NODE)) {
+        body_ = new BodyNode(NULL, NULL, new BodyWordNode(BodyWordNode::STRING, new StrNode(intern(""))));
+        attributes_ = new P4AttributesNode();
     } else {
         body_ = dynamic_cast<BodyNode*>(body);
-        std::stringstream ss(body_->toString());
-        std::string item;
-        while (std::getline(ss, item, ';'))
-        {
-            std::stringstream ss_(item);
-            std::string item_;
-            while (std::getline(ss_, item_, ':')) {
-                boost::algorithm::trim(item_);
-                if(item_.compare("width")==0) {
-                    std::getline(ss_, item_, ':');
-                    boost::algorithm::trim(item_);
-                    width_ = stoi(item_);
-                } else if (item_.compare("instance_count")==0) {
-                    std::getline(ss_, item_, ':');
-                    boost::algorithm::trim(item_);
-                    instanceCount_ = stoi(item_);
-                }
-            }
-        }        
+        attributes_ = P4AttributesNode::parse(body_);
     }
+    attributes_->parent_ = this;
+    width_ = intAttribute(attributes_, "width");
+    instanceCount_ = intAttribute(attributes_, "instance_count");
     if (body_) body_->parent_ = this;
 }
 
-string P4RegisterNode::toString() {
-    ostringstream oss;
-    oss << "register " 
-        << name_->toString() 
+void P4RegisterNode::emit(Emitter& out) {
+    out << "register " 
+        << name_
         << " {\n"
-        << "  " << body_->toString()
+        << "  " << body_
         << "}\n\n";
-    return oss.str();
 }
 
 P4ExprNode::P4ExprNode(AstNode* keyword, AstNode* name1, AstNode* name2,
            AstNode* opts, AstNode* body) {
-    nodeType_ = typeid(*this).name();
+    kind_ = P4_EXPR_NODE;
     keyword_ = dynamic_cast<KeywordNode*>(keyword);
     name1_ = dynamic_cast<NameNode*>(name1);
     if (name1_) name1_->parent_ = this;
@@ -154,142 +310,172 @@ P4ExprNode::P4ExprNode(AstNode* keyword, AstNode* name1, AstNode* name2,
     if (name2_) name2_->parent_ = this;
     opts_ = opts;
     if (opts_) opts_->parent_ = this;
-    if(body->nodeType_.find("EmptyNode")!=string::npos) {
-        body_ = new BodyNode(NULL, NULL, new BodyWordNode(BodyWordNode::STRING, new StrNode(new string(""))));
+    body_ = NULL;
+    opaqueBody_ = NULL;
+    if (body == NULL) {
+        // Statement without body
+    } else if (body->isKind(EMPTY_NODE)) {
+        body_ = new BodyNode(NULL, NULL, new BodyWordNode(BodyWordNode::STRING, new StrNode(intern(""))));
+    } else if (body->isKind(OPAQUE_BODY_NODE)) {
+        opaqueBody_ = dynamic_cast<OpaqueBodyNode*>(body);
+        opaqueBody_->parent_ = this;
     } else {
         body_ = dynamic_cast<BodyNode*>(body);
     }    
     if (body_) body_->parent_ = this;
 }
 
-string P4ExprNode::toString() {
-    ostringstream oss;
-    oss << keyword_->toString() << " "
-        << name1_->toString() << " ";
+void P4ExprNode::emit(Emitter& out) {
+    out << keyword_ << " "
+        << name1_ << " ";
 
     // Append name2 if its present
     if (name2_) {
-        if (keyword_->toString().compare("calculated_field")==0) {
-            oss << ". "
-                << name2_->toString();
+        if (*keyword_->word_ == "calculated_field") {
+            out << ". "
+                << name2_;
         } else {
-            oss << name2_->toString();
+            out << name2_;
         }
     }
 
     // Append opts if they're present
     if (opts_) {
-        oss << "(" << opts_->toString() << ") ";
+        out << "(" << opts_ << ") ";
     }
 
     // Append body if its present.
     if (body_) {
-        string res = body_->toString();
-        oss << "{\n" << res << "}\n";
+        out << "{\n" << body_ << "}\n";
+    } else if (opaqueBody_) {
+        out << "{\n" << opaqueBody_ << "}\n";
     } else {
         // If there's no body, its a statement that 
         // ends with a semicolon
-        oss << ";";
+        out << ";";
     }
-    return oss.str();
 }
 
-KeywordNode::KeywordNode(string* word) {
-    nodeType_ = typeid(*this).name();
+P4StatefulAluNode::P4StatefulAluNode(AstNode* keyword, AstNode* name1, AstNode* name2,
+                                     AstNode* opts, AstNode* body)
+                                     : P4ExprNode(keyword, name1, name2, opts, body) {
+    kind_ = P4_STATEFUL_ALU_NODE;
+    name_ = dynamic_cast<NameNode*>(name2_)->word_;
+    attributes_ = body_ ? P4AttributesNode::parse(body_) : new P4AttributesNode();
+    attributes_->parent_ = this;
+    P4AttributeNode* reg = attributes_->find("reg");
+    reg_ = reg ? reg->word() : NULL;
+}
+
+bool P4StatefulAluNode::declares(AstNode* keyword, AstNode* name1) {
+    return *dynamic_cast<KeywordNode*>(keyword)->word_ == "blackbox" &&
+           *dynamic_cast<NameNode*>(name1)->word_ == "stateful_alu";
+}
+
+P4AttributeNode* P4StatefulAluNode::attribute(const string& name) const {
+    return attributes_->find(name);
+}
+
+void P4StatefulAluNode::addAttribute(const string* name, const vector<BodyWordNode*>& value) {
+    // Emitted as if it closed the source body
+    vector<BodyWordNode*> words;
+    words.push_back(new BodyWordNode(BodyWordNode::NAME, new NameNode(name)));
+    words.push_back(new BodyWordNode(BodyWordNode::SPECIAL, new SpecialCharNode(intern(":"))));
+    words.insert(words.end(), value.begin(), value.end());
+    words.push_back(new BodyWordNode(BodyWordNode::SPECIAL, new SpecialCharNode(intern(";"))));
+    for (BodyWordNode* word : words) {
+        body_ = new BodyNode(body_, NULL, word);
+    }
+    body_->parent_ = this;
+
+    attributes_->push_back(new P4AttributeNode(name, value));
+    if (*name == "reg") {
+        reg_ = attributes_->list_->back()->word();
+    }
+}
+
+KeywordNode::KeywordNode(const string* word) {
+    kind_ = KEYWORD_NODE;
     word_ = word;
 }
 
-string KeywordNode::toString() {
-    return *word_;
+void KeywordNode::emit(Emitter& out) {
+    out << *word_;
 }
 
 OptsNode::OptsNode(AstNode* nameList) {
-    nodeType_ = typeid(*this).name();
+    kind_ = OPTS_NODE;
     nameList_ = nameList;
 }
 
-string OptsNode::toString() {
+void OptsNode::emit(Emitter& out) {
     if (nameList_) {
-        return nameList_->toString();
+        out << nameList_;
     }
-    return "";
 }
 
 NameListNode::NameListNode(AstNode* nameList, AstNode* name) {
-    nodeType_ = typeid(*this).name();
+    kind_ = NAME_LIST_NODE;
     nameList_ = nameList;
     name_ = name;
 }
 
-string NameListNode::toString() {
+void NameListNode::emit(Emitter& out) {
     if (nameList_) {
-        ostringstream oss;
-        oss << nameList_->toString()
-            << ", "
-            << name_->toString();
-        return oss.str();
-    } else {
-        return name_->toString();
+        out << nameList_
+            << ", ";
     }
-
+    out << name_;
 }
 
 TableReadStmtNode::TableReadStmtNode(MatchType matchType, AstNode* field) {
-    nodeType_ = typeid(*this).name();
+    kind_ = TABLE_READ_STMT_NODE;
     matchType_ = matchType;
     field_ = field;
     field_->parent_ = this;
 }
 
-string TableReadStmtNode::toString() {
-    ostringstream oss;
-    oss << "    " << field_->toString() << " : ";
+void TableReadStmtNode::emit(Emitter& out) {
+    out << "    " << field_ << " : ";
     switch(matchType_) {
-        case EXACT: oss << "exact"; break;
-        case TERNARY: oss << "ternary"; break;
+        case EXACT: out << "exact"; break;
+        case TERNARY: out << "ternary"; break;
     }
-    oss << ";\n";
-    return oss.str();
+    out << ";\n";
 }
 
 TableReadStmtsNode::TableReadStmtsNode() {
-    nodeType_ = typeid(*this).name();
+    kind_ = TABLE_READ_STMTS_NODE;
 }
 
-string TableReadStmtsNode::toString() {
-    ostringstream oss;
+void TableReadStmtsNode::emit(Emitter& out) {
     for (auto rsn : *list_) {
-        oss << rsn->toString();
+        out << rsn;
     }
-    return oss.str();
 }
 
 TableActionStmtNode::TableActionStmtNode(AstNode* name) {
-    nodeType_ = typeid(*this).name();
+    kind_ = TABLE_ACTION_STMT_NODE;
     name_ = dynamic_cast<NameNode*>(name);
 }
 
-string TableActionStmtNode::toString() {
-    ostringstream oss;
-    oss << "    " << name_->toString() << ";\n";
-    return oss.str();
+void TableActionStmtNode::emit(Emitter& out) {
+    out << "    " << name_ << ";\n";
 }
 
 TableActionStmtsNode::TableActionStmtsNode() {
-    nodeType_ = typeid(*this).name();
+    kind_ = TABLE_ACTION_STMTS_NODE;
 }
 
-string TableActionStmtsNode::toString() {
-    ostringstream oss;
+void TableActionStmtsNode::emit(Emitter& out) {
     for (auto asn : *list_) {
-        oss << asn->toString();
+        out << asn;
     }
-    return oss.str();
 }
 
 TableNode::TableNode(AstNode* name, AstNode* reads, AstNode* actions,
                      string options, string pragma) {
-    nodeType_ = typeid(*this).name();
+    kind_ = TABLE_NODE;
     name_ = dynamic_cast<NameNode*>(name);
     name_->parent_ = this;
     reads_ = dynamic_cast<TableReadStmtsNode*>(reads);
@@ -307,194 +493,170 @@ TableNode::TableNode(AstNode* name, AstNode* reads, AstNode* actions,
         boost::algorithm::trim(options_[i]);
     }
     isMalleable_ = false;
-    pragmaTransformed_ = false;
 }
 
-string TableNode::toString() {
-    ostringstream oss;
+void TableNode::emit(Emitter& out) {
     if(pragma_.compare("")!=0) {
-        oss << pragma_ << "\n";
+        out << pragma_ << "\n";
     }
-    oss << "table " << name_->toString() << " {\n";
+    out << "table " << name_ << " {\n";
     if (reads_ && reads_->list_->size() > 0) {
-        oss << "  reads {\n"
-            << reads_->toString()
+        out << "  reads {\n"
+            << reads_
             << "  }\n";
     }
-    oss << "  actions {\n"
-        << actions_->toString()
+    out << "  actions {\n"
+        << actions_
         << "  }\n";
     for (auto str : options_) {
-        oss << "  " << str << ";\n";
-    }
-    oss << "}\n\n";
-    return oss.str();
-}
-
-void TableNode::transformPragma() {
-    if(pragma_.compare("")!=0 && !pragmaTransformed_) {
-        std::vector<string> tmp_v;
-        boost::algorithm::split(tmp_v, pragma_, boost::algorithm::is_space());
-        pragma_ = "";
-        for(int i=0; i<tmp_v.size()-1; i++) {
-            pragma_ += tmp_v[i];
-            pragma_ += " ";            
-        }
-        int stage_num = stoi(tmp_v[tmp_v.size()-1]);
-        stage_num ++;
-        pragma_ += std::to_string(stage_num);
-
-        pragmaTransformed_=true;
+        out << "  " << str << ";\n";
     }
+    out << "}\n\n";
 }
 
 FieldDecNode::FieldDecNode(AstNode* name, AstNode* size) {
-    nodeType_ = typeid(*this).name();
+    kind_ = FIELD_DEC_NODE;
     name_ = dynamic_cast<NameNode*>(name);
     size_ = dynamic_cast<IntegerNode*>(size);
 }
 
-string FieldDecNode::toString() {
-    ostringstream oss;
-    oss << "  " << name_->toString() << " : " << size_->toString() << ";";
-    return oss.str();
+void FieldDecNode::emit(Emitter& out) {
+    out << "  " << name_ << " : " << size_ << ";";
 }
 
 FieldDecsNode::FieldDecsNode() {
-    nodeType_ = typeid(*this).name();
+    kind_ = FIELD_DECS_NODE;
 }
 
-string FieldDecsNode::toString() {
-    ostringstream oss;
+void FieldDecsNode::emit(Emitter& out) {
     for (auto fdn : *list_) {
-        oss << fdn->toString() << endl;
+        out << fdn << "\n";
     }
-    return oss.str();
 }
 
 HeaderTypeDeclarationNode::HeaderTypeDeclarationNode(AstNode* name,
                                                      AstNode* field_decs,
                                                      AstNode* other_stmts) {
-    nodeType_ = typeid(*this).name();
+    kind_ = HEADER_TYPE_DECLARATION_NODE;
     name_ = dynamic_cast<NameNode*>(name);
     field_decs_ = dynamic_cast<FieldDecsNode*>(field_decs);
     other_stmts_ = other_stmts;
 }
 
-string HeaderTypeDeclarationNode::toString() {
-    ostringstream oss;
-    oss << "header_type " << name_->toString() << " {\n";
-    oss << "  fields {\n";
-    oss << field_decs_->toString();
-    oss << "  }\n";
-    oss << other_stmts_->toString();
-    oss << "}\n\n";
-    return oss.str();
+void HeaderTypeDeclarationNode::emit(Emitter& out) {
+    out << "header_type " << name_ << " {\n";
+    out << "  fields {\n";
+    out << field_decs_;
+    out << "  }\n";
+    out << other_stmts_;
+    out << "}\n\n";
 }
 
 HeaderInstanceNode::HeaderInstanceNode(AstNode* type, AstNode* name) {
-    nodeType_ = typeid(*this).name();
+    kind_ = HEADER_INSTANCE_NODE;
     type_ = dynamic_cast<NameNode*>(type);
     name_ = dynamic_cast<NameNode*>(name);
 }
 
-string HeaderInstanceNode::toString() {
-    ostringstream oss;
-    oss << "header " << type_->toString() << " " << name_->toString() << ";\n\n";
-    return oss.str();
+void HeaderInstanceNode::emit(Emitter& out) {
+    out << "header " << type_ << " " << name_ << ";\n\n";
 }
 
 MetadataInstanceNode::MetadataInstanceNode(AstNode* type, AstNode* name) {
-    nodeType_ = typeid(*this).name();
+    kind_ = METADATA_INSTANCE_NODE;
     type_ = dynamic_cast<NameNode*>(type);
     name_ = dynamic_cast<NameNode*>(name);
 }
 
-string MetadataInstanceNode::toString() {
-    ostringstream oss;
-    oss << "metadata " << type_->toString() << " " << name_->toString() << ";\n\n";
-    return oss.str();
+void MetadataInstanceNode::emit(Emitter& out) {
+    out << "metadata " << type_ << " " << name_ << ";\n\n";
 }
 
 ArgsNode::ArgsNode() {
-    nodeType_ = typeid(*this).name();
+    kind_ = ARGS_NODE;
 }
 
-ArgsNode* ArgsNode::deepCopy() {
+// A reference still to be transformed, or to be transformed again for another
+// alt of mblName, differs between copies of an action.  Everything else is
+// left alone once parsed.
+static bool differsInCopy(AstNode* contents, const string& mblName) {
+    if (!contents->isKind(MBL_REF_NODE)) {
+        return false;
+    }
+    auto ref = dynamic_cast<MblRefNode*>(contents);
+    return !ref->transformed_ || *ref->name_->word_ == mblName;
+}
+
+ArgsNode* ArgsNode::copyFor(const string& mblName) {
     auto newNode = new ArgsNode();
     for (auto bw : *list_) {
-        auto newArg = bw->deepCopy();
-        newNode->push_back(newArg);
+        if (differsInCopy(bw->contents_, mblName)) {
+            newNode->push_back(bw->deepCopy());
+        } else {
+            newNode->share(bw);
+        }
     }
 
     return newNode;
 }
 
-string ArgsNode::toString() {
+void ArgsNode::emit(Emitter& out) {
     bool first = true;
-    ostringstream oss;
     for (auto bw : *list_) {
         if (first) {
             first = false;
         } else {
-            oss << ", ";
+            out << ", ";
         }
-        oss << bw->toString();
+        out << bw;
     }
-    return oss.str();
 }
 
 ActionParamNode::ActionParamNode(AstNode* param) {
-    nodeType_ = typeid(*this).name();
+    kind_ = ACTION_PARAM_NODE;
     param_ = param;
     param->parent_ = this;
 }
 
-ActionParamNode* ActionParamNode::deepCopy() {
-    AstNode* newParam = param_;
-    if (param_->nodeType_.find("MblRefNode") != string::npos) {
-        newParam = dynamic_cast<MblRefNode*>(param_)->deepCopy();
-    }
-    auto newNode = new ActionParamNode(newParam);
-    return newNode;
-}
-
-string ActionParamNode::toString() {
-    return param_->toString();
+void ActionParamNode::emit(Emitter& out) {
+    out << param_;
 }
 
 ActionParamsNode::ActionParamsNode() {
-    nodeType_ = typeid(*this).name();
+    kind_ = ACTION_PARAMS_NODE;
 }
 
-ActionParamsNode* ActionParamsNode::deepCopy() {
+ActionParamsNode* ActionParamsNode::copyFor(const string& mblName) {
     auto newNode = new ActionParamsNode();
     for (auto ap : *list_) {
-        auto newParam = ap->deepCopy();
-        newNode->push_back(newParam);
+        if (differsInCopy(ap->param_, mblName)) {
+            auto newParam = dynamic_cast<MblRefNode*>(ap->param_)->deepCopy();
+            newNode->push_back(new ActionParamNode(newParam));
+        } else {
+            newNode->share(ap);
+        }
     }
 
     return newNode;
 }
 
-string ActionParamsNode::toString(){
+void ActionParamsNode::emit(Emitter& out) {
     bool first = true;
-    ostringstream oss;
     for (auto ap : *list_) {
         if (first) {
             first = false;
         } else {
-            oss << ", ";
+            out << ", ";
         }
-        oss << ap->toString();
+        out << ap;
     }
-    return oss.str();
 }
 
 ActionStmtNode::ActionStmtNode(AstNode* name1, AstNode* args, ActionStmtType type, AstNode* name2, AstNode* index) {
-    nodeType_ = typeid(*this).name();
+    kind_ = ACTION_STMT_NODE;
     name1_ = dynamic_cast<NameNode*>(name1);
     name2_ = dynamic_cast<NameNode*>(name2);
+    args_ = NULL;
     if(args) {
         args_ = dynamic_cast<ArgsNode*>(args);
         args_->parent_ = this;
@@ -504,56 +666,74 @@ ActionStmtNode::ActionStmtNode(AstNode* name1, AstNode* args, ActionStmtType typ
     type_ = type;
 }
 
-ActionStmtNode* ActionStmtNode::deepCopy() {
-    return new ActionStmtNode(name1_, args_->deepCopy(), type_, name2_, index_);
+ActionStmtNode* ActionStmtNode::copyFor(const string& mblName) {
+    for (auto bw : *args_->list_) {
+        if (differsInCopy(bw->contents_, mblName)) {
+            return new ActionStmtNode(name1_, args_->copyFor(mblName), type_, name2_, index_);
+        }
+    }
+    return this;
 }
 
-string ActionStmtNode::toString() {
-    ostringstream oss;
+bool ActionStmtNode::executesStatefulAlu() const {
+    static const string kExecute = "execute_stateful_alu";
+    return type_ == ActionStmtType::PROG_EXEC &&
+           name2_->word_->compare(0, kExecute.size(), kExecute) == 0;
+}
+
+BodyWordNode* ActionStmtNode::aluIndex() const {
+    if (args_ == NULL || args_->list_->empty()) {
+        return NULL;
+    }
+    return args_->list_->front();
+}
+
+void ActionStmtNode::emit(Emitter& out) {
     if(type_==ActionStmtType::NAME_ARGLIST) {
-        oss << " " 
-            << name1_->toString()
+        out << " " 
+            << name1_
             << "("
-            << args_->toString() 
+            << args_ 
             << ");\n";
     } else if (type_==ActionStmtType::PROG_EXEC) {
-        oss << " " 
-            << name1_->toString() 
+        out << " " 
+            << name1_ 
             << " . "
-            << name2_->toString()
+            << name2_
             << " ( "
-            << args_->toString()
+            << args_
             << " );\n";
     } else {
-        oss << "parsing error!\n";
+        out << "parsing error!\n";
     }
-    return oss.str();
 }
 
 ActionStmtsNode::ActionStmtsNode() {
-    nodeType_ = typeid(*this).name();
+    kind_ = ACTION_STMTS_NODE;
 }
 
-ActionStmtsNode* ActionStmtsNode::deepCopy() {
+ActionStmtsNode* ActionStmtsNode::copyFor(const string& mblName) {
     auto newNode = new ActionStmtsNode();
     for (auto as : *list_) {
-        auto newStmt = as->deepCopy();
-        newNode->push_back(newStmt);
+        auto newStmt = as->copyFor(mblName);
+        if (newStmt == as) {
+            newNode->share(as);
+        } else {
+            newNode->push_back(newStmt);
+        }
     }
 
     return newNode;
 }
 
-string ActionStmtsNode::toString() {
-    ostringstream oss;
+void ActionStmtsNode::emit(Emitter& out) {
     for (auto as : *list_) {
-        oss << as->toString();
+        out << as;
     }
-    return oss.str();
 }
 
 ActionNode::ActionNode(AstNode* name, AstNode* params, AstNode* stmts) {
-    nodeType_ = typeid(*this).name();
+    kind_ = ACTION_NODE;
     name_ = dynamic_cast<NameNode*>(name);
     name_->parent_ = this;
     params_ = dynamic_cast<ActionParamsNode*>(params);
@@ -562,17 +742,15 @@ ActionNode::ActionNode(AstNode* name, AstNode* params, AstNode* stmts) {
     stmts_->parent_ = this;
 }
 
-ActionNode* ActionNode::duplicateAction(const string& name) {
-    auto newNode = new ActionNode(new NameNode(new string(name)),
-                                  params_->deepCopy(), stmts_->deepCopy());
+ActionNode* ActionNode::duplicateAction(const string& name, const string& mblName) {
+    auto newNode = new ActionNode(new NameNode(intern(name)),
+                                  params_->copyFor(mblName), stmts_->copyFor(mblName));
     return newNode;
 }
 
-string ActionNode::toString() {
-    ostringstream oss;
-    oss << "action " << name_->toString()
-                     << "(" << params_->toString() << ") {\n"
-        << stmts_->toString()
+void ActionNode::emit(Emitter& out) {
+    out << "action " << name_
+                     << "(" << params_ << ") {\n"
+        << stmts_
         << "}\n";
-    return oss.str();
 }
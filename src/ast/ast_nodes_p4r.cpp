@@ -19,107 +19,95 @@ using namespace std;
 
 
 P4RExprNode::P4RExprNode(AstNode* varOrReaction) {
-    nodeType_ = typeid(*this).name();
+    kind_ = P4R_EXPR_NODE;
     varOrReaction_ = varOrReaction;
 }
 
-string P4RExprNode::toString() {
-    return varOrReaction_->toString();
+void P4RExprNode::emit(Emitter& out) {
+    out << varOrReaction_;
 }
 
-P4RSettableMalleableNode::P4RSettableMalleableNode(string nodeType, AstNode* name,
+P4RSettableMalleableNode::P4RSettableMalleableNode(NodeKind kind, AstNode* name,
                                                  AstNode* varWidth,
                                                  MalleableType malleableType)
                                                  : malleableType_(malleableType) {
-    nodeType_ = nodeType;
+    kind_ = kind;
     name_ = dynamic_cast<NameNode*>(name);
     varWidth_ = dynamic_cast<VarWidthNode*>(varWidth);
 }
 
 P4RMalleableValueNode::P4RMalleableValueNode(AstNode* name, AstNode* varWidth,
                                            AstNode* varInit)
-        : P4RSettableMalleableNode(typeid(*this).name(), name, varWidth,
+        : P4RSettableMalleableNode(P4R_MALLEABLE_VALUE_NODE, name, varWidth,
                                   P4RSettableMalleableNode::VALUE) {
     varInit_ = varInit;
 }
 
-string P4RMalleableValueNode::toString() {
+void P4RMalleableValueNode::emit(Emitter& out) {
     if (removed_) {
-        return "";
+        return;
     }
-
-    ostringstream oss;
-    oss << "Malleable value " << name_->toString() << " {\n" 
-        << " " << varWidth_->toString() << "\n"
-        << " " << varInit_->toString() << "\n"
+    out << "Malleable value " << name_ << " {\n" 
+        << " " << varWidth_ << "\n"
+        << " " << varInit_ << "\n"
         << "}";
-    return oss.str();
 }
 
 FieldNode::FieldNode(AstNode* headerName, AstNode* fieldName) {
-    nodeType_ = typeid(*this).name();
+    kind_ = FIELD_NODE;
     headerName_ = dynamic_cast<NameNode*>(headerName);
     fieldName_ = dynamic_cast<NameNode*>(fieldName);
 }
 
-string FieldNode::toString() {
-    ostringstream oss;
-    oss << headerName_->toString()
+void FieldNode::emit(Emitter& out) {
+    out << headerName_
         << "."
-        << fieldName_->toString();
-    return oss.str();
+        << fieldName_;
 }
 
 FieldsNode::FieldsNode() {
-    nodeType_ = typeid(*this).name();
+    kind_ = FIELDS_NODE;
 }
 
-string FieldsNode::toString() {
+void FieldsNode::emit(Emitter& out) {
     bool first = true;
-    ostringstream oss;
 
     for (auto fld : *this->list_) {
         if (first) {
             first = false;
         } else {
-            oss << ", ";
+            out << ", ";
         }
-        oss << fld->toString();
+        out << fld;
     }
-    return oss.str();
 }
 
 VarAltNode::VarAltNode(AstNode* fields) {
-    nodeType_ = typeid(*this).name();
+    kind_ = VAR_ALT_NODE;
     fields_ = dynamic_cast<FieldsNode*>(fields);
 }
 
-string VarAltNode::toString() {
-    ostringstream oss;
-    oss << "alts: {" << fields_->toString() << "}";
-    return oss.str();
+void VarAltNode::emit(Emitter& out) {
+    out << "alts: {" << fields_ << "}";
 }
 
 P4RMalleableFieldNode::P4RMalleableFieldNode(AstNode* name, AstNode* varWidth,
                                            AstNode* varInit, AstNode* varAlts)
-        : P4RSettableMalleableNode(typeid(*this).name(), name, varWidth,
+        : P4RSettableMalleableNode(P4R_MALLEABLE_FIELD_NODE, name, varWidth,
                                   P4RSettableMalleableNode::FIELD) {
     varInit_ = varInit;
     varAlts_ = dynamic_cast<VarAltNode*>(varAlts);
 }
 
-string P4RMalleableFieldNode::toString() {
+void P4RMalleableFieldNode::emit(Emitter& out) {
     if (removed_) {
-        return "";
+        return;
     }
-
-    ostringstream oss;
-    oss << "malleable field " << name_->toString() << " {\n" 
-        << " " << varWidth_->toString() << "\n"
-        << " " << varInit_->toString() << "\n"
-        << " " << varAlts_->toString() << "\n"
+    out << "malleable field " << name_ << " {\n" 
+        << " " << varWidth_ << "\n"
+        << " " << varInit_ << "\n"
+        << " " << varAlts_ << "\n"
         << "}";
-    return oss.str();
 }
 
 int P4RMalleableFieldNode::mapAltToInt(std::string input) {
@@ -135,64 +123,40 @@ int P4RMalleableFieldNode::mapAltToInt(std::string input) {
 }
 
 P4RMalleableTableNode::P4RMalleableTableNode(AstNode* table, std::string pragma) {
-    nodeType_ = typeid(*this).name();
+    kind_ = P4R_MALLEABLE_TABLE_NODE;
     table_ = dynamic_cast<TableNode*>(table);
 
-    pragmaTransformed_ = false;
     pragma_ = pragma;
 }
 
-void P4RMalleableTableNode::transformPragma() {
-    if(pragma_.compare("")!=0 && !pragmaTransformed_) {
-        std::vector<string> tmp_v;
-        boost::algorithm::split(tmp_v, pragma_, boost::algorithm::is_space());
-        pragma_ = "";
-        for(int i=0; i<tmp_v.size()-1; i++) {
-            pragma_ += tmp_v[i];
-            pragma_ += " ";            
-        }
-        int stage_num = stoi(tmp_v[tmp_v.size()-1]);
-        stage_num ++;
-        pragma_ += std::to_string(stage_num);
-
-        pragmaTransformed_=true;
-    }
-}
-
-string P4RMalleableTableNode::toString() {
-    ostringstream oss;
+void P4RMalleableTableNode::emit(Emitter& out) {
     if(pragma_.compare("")!=0) {
-        oss << pragma_ << "\n";
+        out << pragma_ << "\n";
     }
         
     if (!removed_) {
-        oss << " malleable ";
+        out << " malleable ";
     }
 
-    oss << table_->toString();
-    return oss.str();
+    out << table_;
 }
 
 VarWidthNode::VarWidthNode(AstNode* val) {
-    nodeType_ = typeid(*this).name();
+    kind_ = VAR_WIDTH_NODE;
     val_ = dynamic_cast<IntegerNode*>(val);
 }
 
-string VarWidthNode::toString() {
-    ostringstream oss;
-    oss << "width: " << val_->toString() << ";";
-    return oss.str();
+void VarWidthNode::emit(Emitter& out) {
+    out << "width: " << val_ << ";";
 }
 
 VarInitNode::VarInitNode(AstNode* val) {
-    nodeType_ = typeid(*this).name();
+    kind_ = VAR_INIT_NODE;
     val_ = val;
 }
 
-string VarInitNode::toString() {
-    ostringstream oss;
-    oss << "init: " << val_->toString() << ";";
-    return oss.str();
+void VarInitNode::emit(Emitter& out) {
+    out << "init: " << val_ << ";";
 }
 
 /**
@@ -202,25 +166,22 @@ string VarInitNode::toString() {
  */
 
 P4RInitBlockNode::P4RInitBlockNode(AstNode* name, AstNode* body) {
-    nodeType_ = typeid(*this).name();
+    kind_ = P4R_INIT_BLOCK_NODE;
     name_ = dynamic_cast<NameNode*>(name);
     name_->parent_ = this;
-    body_ = dynamic_cast<BodyNode*>(body);
+    body_ = body;
     body_->parent_ = this;
 }
 
-string P4RInitBlockNode::toString() {
+void P4RInitBlockNode::emit(Emitter& out) {
     if (removed_) {
-        return "";
+        return;
     }
-
-    ostringstream oss;
-    oss << "initialization " 
-        << name_->toString()
+    out << "initialization " 
+        << name_
         << " {\n"
-        << body_->toString()
+        << body_
         << "}";
-    return oss.str();
 }
 
 /**
@@ -229,57 +190,52 @@ string P4RInitBlockNode::toString() {
  *
  */
 P4RReactionNode::P4RReactionNode(AstNode* name, AstNode* args, AstNode* body) {
-    nodeType_ = typeid(*this).name();
+    kind_ = P4R_REACTION_NODE;
     name_ = dynamic_cast<NameNode*>(name);
     name_->parent_ = this;
     args_ = dynamic_cast<ReactionArgsNode*>(args);
     args_->parent_ = this;
-    if(body->nodeType_.find("EmptyNode")!=string::npos) {
+    if(body->isKind(EMPTY_NODE)) {
         // if body is empty node
-        body_ = new BodyNode(NULL, NULL, new BodyWordNode(BodyWordNode::STRING, new StrNode(new string(""))));
+        body_ = new BodyNode(NULL, NULL, new BodyWordNode(BodyWordNode::STRING, new StrNode(intern(""))));
     } else {
         body_ = dynamic_cast<BodyNode*>(body);
     }
     body_->parent_ = this;
 }
 
-string P4RReactionNode::toString() {
+void P4RReactionNode::emit(Emitter& out) {
     if (removed_) {
-        return "";
+        return;
     }
-
-    ostringstream oss;
-    oss << "reaction " 
-        << name_->toString()
+    out << "reaction " 
+        << name_
         << " (" 
-        << args_->toString()
+        << args_
         << " ) {\n"
-        << body_->toString()
+        << body_
         << "}";
-    return oss.str();
 }
 
 ReactionArgsNode::ReactionArgsNode() {
-    nodeType_ = typeid(*this).name();
+    kind_ = REACTION_ARGS_NODE;
 }
 
-string ReactionArgsNode::toString() {
+void ReactionArgsNode::emit(Emitter& out) {
     bool first = true;
-    ostringstream oss;
     for (auto ra : *list_) {
         if (first) {
             first = false;
         } else {
-            oss << ", ";
+            out << ", ";
         }
-        oss << ra->toString();
+        out << ra;
     }
-    return oss.str();
 }
 
 ReactionArgNode::ReactionArgNode(const ArgType& argType, AstNode* arg, AstNode* index1, AstNode* index2)
                                  : argType_(argType) {
-    nodeType_ = typeid(*this).name();
+    kind_ = REACTION_ARG_NODE;
     arg_ = arg;
     arg_->parent_ = this;
 
@@ -287,12 +243,12 @@ ReactionArgNode::ReactionArgNode(const ArgType& argType, AstNode* arg, AstNode*
     index2_ = dynamic_cast<IntegerNode*>(index2);
 }
 
-string ReactionArgNode::toString() {
-    return arg_->toString();
+void ReactionArgNode::emit(Emitter& out) {
+    out << arg_;
 }
 
 MblRefNode::MblRefNode(AstNode* name) {
-    nodeType_ = typeid(*this).name();
+    kind_ = MBL_REF_NODE;
     name_ = dynamic_cast<NameNode*>(name);
 }
 
@@ -324,16 +280,13 @@ string MblRefNode::toString() {
     }
 }
 
-UnanchoredNode::UnanchoredNode(string* newCode, string* objType,
-                               string* objName) {
-    nodeType_ = typeid(*this).name();
-    codeBlob_ = newCode;
-    objType_ = objType;
-    objName_ = objName;
+UnanchoredNode::UnanchoredNode(const string& newCode, const string& objType,
+                               const string& objName) : codeBlob_(newCode) {
+    kind_ = UNANCHORED_NODE;
+    objType_ = intern(objType);
+    objName_ = intern(objName);
 }
 
-string UnanchoredNode::toString() {
-    ostringstream oss;
-    oss << *codeBlob_;
-    return oss.str();
+void UnanchoredNode::emit(Emitter& out) {
+    out << codeBlob_;
 }
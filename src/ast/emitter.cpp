@@ -0,0 +1,54 @@
+/* Copyright 2020-present University of Pennsylvania
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../../include/emitter.h"
+#include "../../include/ast_nodes.h"
+
+Emitter::Emitter(std::ostream& os) : os_(&os), buf_(&own_) {
+    own_.reserve(kFlushSize + 4096);
+}
+
+Emitter::Emitter(std::string* out) : buf_(out) {
+}
+
+Emitter::~Emitter() {
+    flush();
+}
+
+Emitter& Emitter::operator<<(AstNode* node) {
+    node->emit(*this);
+    return *this;
+}
+
+Emitter& Emitter::writeIndent(int level) {
+    for (int i = 0; i < level; i++) {
+        buf_->append("  ");
+    }
+    return *this;
+}
+
+void Emitter::flush() {
+    if (os_ != NULL && !buf_->empty()) {
+        os_->write(buf_->data(), buf_->size());
+        buf_->clear();
+    }
+}
+
+std::string Emitter::render(AstNode* node) {
+    std::string ret;
+    Emitter out(&ret);
+    node->emit(out);
+    return ret;
+}
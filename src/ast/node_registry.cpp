@@ -0,0 +1,25 @@
+/* Copyright 2020-present University of Pennsylvania
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../../include/node_registry.h"
+
+void NodeRegistry::push_back(AstNode* node) {
+    // The grammar hands list nodes back on every reduction that extends them
+    if (!seen_.insert(node).second) {
+        return;
+    }
+    nodes_.push_back(node);
+    byKind_[node->kind_].push_back(node);
+}
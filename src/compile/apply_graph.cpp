@@ -0,0 +1,215 @@
+/* Copyright 2020-present University of Pennsylvania
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+
+#include "../../include/apply_graph.h"
+#include "../../include/find_nodes.h"
+#include "../../include/helper.h"
+
+static const std::vector<ApplyGraph::ApplySite> kNoSites;
+static const std::vector<P4ExprNode*> kNoControls;
+static const std::set<std::string> kNoFields;
+
+void ApplyGraph::build(const NodeRegistry& nodes) {
+    for (auto node : nodes.ofKind(P4_EXPR_NODE)) {
+        auto expr = dynamic_cast<P4ExprNode*>(node);
+        if (p4KeywordMatches(expr, "control")) {
+            controls_.push_back(expr);
+            byName_.emplace(expr->name1_->toString(), expr);
+        }
+    }
+
+    for (auto control : controls_) {
+        scan(control, control->body_, {});
+    }
+
+    auto ingress = byName_.find("ingress");
+    if (ingress != byName_.end()) {
+        place(ingress->second, INGRESS);
+        std::vector<P4ExprNode*> stack;
+        gate(ingress->second, {}, &stack);
+    }
+    auto egress = byName_.find("egress");
+    if (egress != byName_.end()) {
+        place(egress->second, EGRESS);
+        std::vector<P4ExprNode*> stack;
+        gate(egress->second, {}, &stack);
+    }
+    PRINT_VERBOSE("Apply graph: %d controls, %d applied tables\n",
+                  controls_.size(), tablePipelines_.size());
+}
+
+// header.field words of a condition
+static void readFields(const vector<BodyWordNode*>& words, size_t begin,
+                       std::set<std::string>* fields) {
+    for (size_t i = begin; i + 2 < words.size(); i++) {
+        if (words[i+1]->contents_->toString() == "." &&
+            words[i]->wordType_ == BodyWordNode::NAME && words[i+2]->wordType_ == BodyWordNode::NAME) {
+            fields->insert(words[i]->contents_->toString() + "." + words[i+2]->contents_->toString());
+        }
+    }
+}
+
+void ApplyGraph::scan(P4ExprNode* control, BodyNode* body, const std::set<std::string>& conditions) {
+    // Bodies are left-recursive, so collect the outer chain first instead of
+    // recursing on it.  Words are gathered up to the next block.
+    vector<BodyNode*> chain;
+    for (BodyNode* b = body; b != NULL; b = b->bodyOuter_) {
+        chain.push_back(b);
+    }
+    vector<BodyWordNode*> words;
+    // Fields read by the conditions of the if / else if / else chain so far,
+    // every branch depends on all of them
+    std::set<std::string> branch;
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+        if ((*it)->str_) {
+            words.push_back((*it)->str_);
+            continue;
+        }
+        if ((*it)->bodyInner_ == NULL) {
+            continue;
+        }
+        scanWords(control, words, conditions);
+        if (words.empty() || words.front()->contents_->toString() != "else") {
+            branch.clear();
+        }
+        for (size_t i = 0; i < words.size(); i++) {
+            if (words[i]->contents_->toString() == "if") {
+                readFields(words, i + 1, &branch);
+                break;
+            }
+        }
+        std::set<std::string> inner = conditions;
+        inner.insert(branch.begin(), branch.end());
+        scan(control, (*it)->bodyInner_, inner);
+        words.clear();
+    }
+    scanWords(control, words, conditions);
+}
+
+void ApplyGraph::scanWords(P4ExprNode* control, const vector<BodyWordNode*>& words,
+                           const std::set<std::string>& conditions) {
+    for (int i = 0; i + 1 < words.size(); i++) {
+        string word = words[i]->contents_->toString();
+        if (words[i+1]->contents_->toString() != "(") {
+            continue;
+        }
+        // apply ( <table name> )
+        if (word == "apply" && i + 3 < words.size() &&
+            words[i+3]->contents_->toString() == ")") {
+            string tableName = words[i+2]->contents_->toString();
+            applies_[control].push_back(tableName);
+            steps_[control].push_back({tableName, NULL, conditions});
+            applySites_[tableName].push_back({control, words[i+2]});
+            i += 3;
+            continue;
+        }
+        // <control name> ( )
+        auto callee = byName_.find(word);
+        if (callee != byName_.end()) {
+            calls_[control].push_back(callee->second);
+            steps_[control].push_back({"", callee->second, conditions});
+        }
+    }
+}
+
+void ApplyGraph::gate(P4ExprNode* control, const std::set<std::string>& conditions,
+                      std::vector<P4ExprNode*>* stack) {
+    if (std::find(stack->begin(), stack->end(), control) != stack->end()) {
+        return;
+    }
+    auto steps = steps_.find(control);
+    if (steps == steps_.end()) {
+        return;
+    }
+    stack->push_back(control);
+    for (const Step& step : steps->second) {
+        std::set<std::string> fields = conditions;
+        fields.insert(step.conditions.begin(), step.conditions.end());
+        if (step.callee != NULL) {
+            gate(step.callee, fields, stack);
+        } else {
+            conditionFields_[step.table].insert(fields.begin(), fields.end());
+        }
+    }
+    stack->pop_back();
+}
+
+void ApplyGraph::place(P4ExprNode* control, Pipeline pipeline) {
+    unsigned int& placed = controlPipelines_[control];
+    if (placed & pipeline) {
+        return;
+    }
+    placed |= pipeline;
+
+    for (const string& tableName : applies_[control]) {
+        tablePipelines_[tableName] |= pipeline;
+    }
+    for (auto callee : calls_[control]) {
+        place(callee, pipeline);
+    }
+}
+
+unsigned int ApplyGraph::pipelines(const std::string& tableName) const {
+    auto it = tablePipelines_.find(tableName);
+    return it == tablePipelines_.end() ? NONE : it->second;
+}
+
+const std::vector<ApplyGraph::ApplySite>& ApplyGraph::applySites(const std::string& tableName) const {
+    auto it = applySites_.find(tableName);
+    return it == applySites_.end() ? kNoSites : it->second;
+}
+
+const std::set<std::string>& ApplyGraph::conditionFields(const std::string& tableName) const {
+    auto it = conditionFields_.find(tableName);
+    return it == conditionFields_.end() ? kNoFields : it->second;
+}
+
+const std::vector<P4ExprNode*>& ApplyGraph::callees(P4ExprNode* control) const {
+    auto it = calls_.find(control);
+    return it == calls_.end() ? kNoControls : it->second;
+}
+
+std::vector<std::string> ApplyGraph::tableOrder(Pipeline pipeline) const {
+    std::vector<std::string> tables;
+    auto root = byName_.find(pipeline == INGRESS ? "ingress" : "egress");
+    if (root != byName_.end()) {
+        std::vector<P4ExprNode*> stack;
+        order(root->second, &stack, &tables);
+    }
+    return tables;
+}
+
+void ApplyGraph::order(P4ExprNode* control, std::vector<P4ExprNode*>* stack,
+                       std::vector<std::string>* tables) const {
+    // A recursive call applies nothing new
+    if (std::find(stack->begin(), stack->end(), control) != stack->end()) {
+        return;
+    }
+    auto steps = steps_.find(control);
+    if (steps == steps_.end()) {
+        return;
+    }
+    stack->push_back(control);
+    for (const Step& step : steps->second) {
+        if (step.callee != NULL) {
+            order(step.callee, stack, tables);
+        } else if (std::find(tables->begin(), tables->end(), step.table) == tables->end()) {
+            tables->push_back(step.table);
+        }
+    }
+    stack->pop_back();
+}
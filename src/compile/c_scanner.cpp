@@ -0,0 +1,171 @@
+/* Copyright 2020-present University of Pennsylvania
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cctype>
+
+#include "c_scanner.h"
+
+using namespace std;
+
+static bool isIdentChar(char c) {
+    return isalnum((unsigned char)c) || c == '_';
+}
+
+vector<CToken> scanCTokens(const string& src) {
+    vector<CToken> tokens;
+    size_t n = src.size();
+    size_t i = 0;
+    while (i < n) {
+        char c = src[i];
+        if (isspace((unsigned char)c)) {
+            i++;
+            continue;
+        }
+        // Comments
+        if (c == '/' && i + 1 < n && src[i+1] == '/') {
+            while (i < n && src[i] != '\n') {
+                i++;
+            }
+            continue;
+        }
+        if (c == '/' && i + 1 < n && src[i+1] == '*') {
+            size_t close = src.find("*/", i + 2);
+            i = close == string::npos ? n : close + 2;
+            continue;
+        }
+
+        size_t begin = i;
+        CToken::Kind kind;
+        if (isalpha((unsigned char)c) || c == '_') {
+            kind = CToken::IDENT;
+            while (i < n && isIdentChar(src[i])) {
+                i++;
+            }
+        } else if (isdigit((unsigned char)c)) {
+            // Also swallows suffixes, hex digits and fractions
+            kind = CToken::NUMBER;
+            while (i < n && (isIdentChar(src[i]) || src[i] == '.')) {
+                i++;
+            }
+        } else if (c == '"' || c == '\'') {
+            kind = CToken::LITERAL;
+            i++;
+            while (i < n && src[i] != c) {
+                i += src[i] == '\\' ? 2 : 1;
+            }
+            i = i < n ? i + 1 : n;
+        } else if (c == '$' && i + 1 < n && src[i+1] == '{' &&
+                   src.find('}', i) != string::npos) {
+            kind = CToken::VARREF;
+            i = src.find('}', i) + 1;
+        } else {
+            kind = CToken::PUNCT;
+            i++;
+        }
+        tokens.push_back({kind, begin, i});
+    }
+    return tokens;
+}
+
+UserCode rewriteUserCode(const string& src,
+                         const unordered_set<string>& tableOps,
+                         const unordered_set<string>& fieldArgs) {
+    vector<CToken> tokens = scanCTokens(src);
+    int n = tokens.size();
+
+    auto text = [&](int i) {
+        return src.substr(tokens[i].begin, tokens[i].end - tokens[i].begin);
+    };
+    auto isPunct = [&](int i, char c) {
+        return i >= 0 && i < n && tokens[i].kind == CToken::PUNCT && src[tokens[i].begin] == c;
+    };
+    auto isIdent = [&](int i) {
+        return i < n && tokens[i].kind == CToken::IDENT;
+    };
+
+    UserCode ret;
+    ret.code.reserve(src.size());
+    // Source up to here is already in ret.code
+    size_t copied = 0;
+    auto copyUpTo = [&](size_t pos) {
+        ret.code.append(src, copied, pos - copied);
+        copied = pos;
+    };
+
+    // Open table calls, as (start in ret.code, paren depth of the call)
+    vector<pair<size_t, int>> calls;
+    int depth = 0;
+
+    for (int i = 0; i < n; i++) {
+        const CToken& tok = tokens[i];
+
+        // ${var} = <header>.<field>;  or  ${var} = <expr>;
+        if (tok.kind == CToken::VARREF && isPunct(i+1, '=') && !isPunct(i+2, '=')) {
+            int semi = i + 2;
+            while (semi < n && !isPunct(semi, ';')) {
+                semi++;
+            }
+            if (semi < n && semi > i + 2) {
+                string var = src.substr(tok.begin + 2, tok.end - tok.begin - 3);
+                copyUpTo(tok.begin);
+                if (semi == i + 5 && isIdent(i+2) && isPunct(i+3, '.') && isIdent(i+4)) {
+                    ret.code += "__mantis__mod_var_" + var + "_" + text(i+2) + "_" + text(i+4) + ";";
+                } else {
+                    ret.code += "__mantis__mod_var_" + var + "("
+                             + src.substr(tokens[i+2].begin, tokens[semi-1].end - tokens[i+2].begin)
+                             + ");";
+                }
+                copied = tokens[semi].end;
+                i = semi;
+                continue;
+            }
+        }
+
+        if (tok.kind == CToken::IDENT) {
+            // <header>.<field> passed as reaction argument
+            if (!fieldArgs.empty() && isPunct(i+1, '.') && isIdent(i+2) &&
+                !isPunct(i-1, '.') && !isPunct(i-1, '>')) {
+                string header = text(i);
+                string field = text(i+2);
+                if (fieldArgs.count(header + "." + field) != 0) {
+                    copyUpTo(tok.begin);
+                    ret.code += header + "_" + field;
+                    copied = tokens[i+2].end;
+                    i += 2;
+                    continue;
+                }
+            }
+            // <table>_{add,mod,del}_<action>(
+            if (isPunct(i+1, '(') && tableOps.count(text(i)) != 0) {
+                copyUpTo(tok.begin);
+                calls.push_back({ret.code.size(), depth});
+            }
+            continue;
+        }
+
+        if (isPunct(i, '(')) {
+            depth++;
+        } else if (isPunct(i, ')')) {
+            depth--;
+            if (!calls.empty() && calls.back().second == depth) {
+                copyUpTo(tok.end);
+                ret.tableCalls.push_back(ret.code.substr(calls.back().first));
+                calls.pop_back();
+            }
+        }
+    }
+    copyUpTo(src.size());
+    return ret;
+}
@@ -0,0 +1,51 @@
+/* Copyright 2020-present University of Pennsylvania
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_SCANNER_H
+#define C_SCANNER_H
+
+#include <string>
+#include <vector>
+#include <unordered_set>
+
+// Token of user C code, as a span of the source it was scanned from
+struct CToken {
+    enum Kind { IDENT, NUMBER, LITERAL, VARREF, PUNCT };
+    Kind kind;
+    size_t begin;
+    size_t end;
+};
+
+// Splits C code into tokens, skipping whitespace and comments.  String and
+// char literals are single tokens, as is a ${var} reference.
+std::vector<CToken> scanCTokens(const std::string& src);
+
+// User code of a reaction or init_block after one rewriting pass
+struct UserCode {
+    // ${var} = x; assignments replaced by the update macros, and field
+    // arguments <header>.<field> by their C variables <header>_<field>
+    std::string code;
+    // <table>_{add,mod,del}_<action>(...) calls, in source order and as
+    // they read in code
+    std::vector<std::string> tableCalls;
+};
+
+// tableOps holds the call names to collect, fieldArgs the "<header>.<field>"
+// names to rewrite
+UserCode rewriteUserCode(const std::string& src,
+                         const std::unordered_set<std::string>& tableOps,
+                         const std::unordered_set<std::string>& fieldArgs);
+
+#endif
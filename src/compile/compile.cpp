@@ -15,7 +15,6 @@
 
 #include <unordered_map>
 #include <vector>
-#include <regex>
 #include <boost/format.hpp>
 #include <fstream>
 
@@ -26,117 +25,257 @@
 #include "compile_const.h"
 #include "compile_p4.h"
 #include "compile_c.h"
+#include "stage_plan.h"
 
-static int ing_iso_opt = -1;
-static int egr_iso_opt = -1;
-static int num_init_mbls_ing = -1;
-static int num_init_mbls_egr = -1;
-static vector<ReactionArgBin> global_ing_bins;
-static vector<ReactionArgBin> global_egr_bins;
-static unordered_map<string, int> mblUsages;
-static unordered_map<string, P4RMalleableValueNode*> mblValues;
-static unordered_map<string, P4RMalleableFieldNode*> mblFields;
-static unordered_map<string, P4RMalleableTableNode*> mblTables;
-static unordered_map<string, vector<string>> tableMbls;
-static unordered_map<string, vector<string>> actionMbls;
-
-
-vector<AstNode*> compileP4Code(vector<AstNode*>* nodeArray) {
-
-    ing_iso_opt = inferIsoOptForIng(nodeArray, true);
-    egr_iso_opt = inferIsoOptForIng(nodeArray, false);
-
-    transformPragma(nodeArray);
-
-    findAndRemoveMalleables(&mblValues, &mblFields, &mblTables, *nodeArray);
-
+// Results one P4 pass leaves for later ones
+struct P4PassState {
     vector<MblRefNode*> mblRefs;
-    findMalleableRefs(&mblRefs, *nodeArray);
+    HeaderDecsMap headerDecsMap;
+    vector<ReactionArgNode*> reactionArgs;
+};
 
-    // Visitor pass to find the corresponding usage
-    findMalleableUsage(mblRefs, mblValues, mblFields, nodeArray, &mblUsages);
+void addP4Passes(PassManager* pm, CompileContext* ctx) {
+    auto state = make_shared<P4PassState>();
 
-    // Transform all references to mbls into references to the appropriate metadata
-    transformMalleableRefs(&mblRefs, mblValues, mblFields, nodeArray);
+    pm->add("p4", "buildSymbols", RES_TREE, RES_SYMBOLS, [ctx](PassOutput*) {
+        ctx->symbols_.build(ctx->nodes_);
+    });
 
-    transformMalleableTables(&mblTables, *nodeArray, ing_iso_opt, egr_iso_opt);
+    pm->add("p4", "inferIsoOptIng", RES_TREE | RES_SYMBOLS, RES_ING_ISO_OPT, [ctx](PassOutput*) {
+        ctx->ingIsoOpt_ = inferIsoOptForIng(ctx->nodes_, ctx->symbols_, true);
+    });
+    pm->add("p4", "inferIsoOptEgr", RES_TREE | RES_SYMBOLS, RES_EGR_ISO_OPT, [ctx](PassOutput*) {
+        ctx->egrIsoOpt_ = inferIsoOptForIng(ctx->nodes_, ctx->symbols_, false);
+    });
 
-    auto newNodes = vector<AstNode*>();
+    pm->add("p4", "findAndRemoveMalleables", 0, RES_TREE | RES_MBLS, [ctx](PassOutput*) {
+        findAndRemoveMalleables(&ctx->mblValues_, &ctx->mblFields_, &ctx->mblTables_, ctx->nodes_);
+    });
 
-    generateMetadata(&newNodes, mblValues, mblFields, ing_iso_opt, egr_iso_opt);
-    num_init_mbls_ing = generateInitTableForIng(&mblUsages, &newNodes, mblValues, mblFields, ing_iso_opt, true);
-    num_init_mbls_egr = generateInitTableForIng(&mblUsages, &newNodes, mblValues, mblFields, egr_iso_opt, false);
+    pm->add("p4", "findMalleableRefs", RES_TREE, RES_MBL_REFS, [ctx, state](PassOutput*) {
+        findMalleableRefs(&state->mblRefs, ctx->nodes_);
+    });
 
-    generateSetvarControl(&newNodes);
+    // Visitor pass to find the corresponding usage
+    pm->add("p4", "findMalleableUsage", RES_TREE | RES_SYMBOLS | RES_MBL_REFS, RES_MBL_USAGES, [ctx, state](PassOutput*) {
+        findMalleableUsage(state->mblRefs, ctx->symbols_, &ctx->mblUsages_);
+    });
+
+    // Before they are duplicated, actions reading many malleable fields read
+    // the selected alts instead
+    pm->add("p4", "factorMalleableActions", RES_SYMBOLS | RES_MBL_REFS, RES_TREE | RES_MBLS, [ctx, state](PassOutput*) {
+        factorMalleableActions(state->mblRefs, ctx->mblFields_, ctx->symbols_, ctx->maxActionCopies_,
+                               &ctx->factoredActions_);
+    });
+
+    // Transform all references to mbls into references to the appropriate
+    // metadata, counting the exact reads kept on the mbls
+    pm->add("p4", "transformMalleableRefs", 0, RES_TREE | RES_SYMBOLS | RES_MBL_REFS | RES_MBLS, [ctx, state](PassOutput*) {
+        transformMalleableRefs(&state->mblRefs, ctx->mblValues_, ctx->mblFields_, &ctx->symbols_);
+    });
+
+    pm->add("p4", "transformMalleableTables", RES_SYMBOLS | RES_MBLS | RES_ISO_OPTS, RES_TREE, [ctx](PassOutput*) {
+        transformMalleableTables(&ctx->mblTables_, ctx->symbols_, ctx->ingIsoOpt_, ctx->egrIsoOpt_);
+    });
+
+    pm->add("p4", "generateMetadata", RES_TREE | RES_MBLS | RES_ISO_OPTS, outputRes(OUT_P4_NODES), [ctx](PassOutput* out) {
+        generateMetadata(&out->nodes(OUT_P4_NODES), ctx->mblValues_, ctx->mblFields_, ctx->ingIsoOpt_, ctx->egrIsoOpt_);
+    });
+
+    pm->add("p4", "generateInitTableIng", RES_TREE | RES_MBLS | RES_MBL_USAGES | RES_ING_ISO_OPT,
+            RES_NUM_INIT_MBLS_ING | outputRes(OUT_P4_NODES), [ctx](PassOutput* out) {
+        ctx->numInitMblsIng_ = generateInitTableForIng(&ctx->mblUsages_, &out->nodes(OUT_P4_NODES), ctx->mblValues_, ctx->mblFields_, ctx->ingIsoOpt_, true);
+    });
+    pm->add("p4", "generateInitTableEgr", RES_TREE | RES_MBLS | RES_MBL_USAGES | RES_EGR_ISO_OPT,
+            RES_NUM_INIT_MBLS_EGR | outputRes(OUT_P4_NODES), [ctx](PassOutput* out) {
+        ctx->numInitMblsEgr_ = generateInitTableForIng(&ctx->mblUsages_, &out->nodes(OUT_P4_NODES), ctx->mblValues_, ctx->mblFields_, ctx->egrIsoOpt_, false);
+    });
+
+    // After the tables reading malleable fields are transformed
+    pm->add("p4", "generateSetvarControl", RES_TREE | RES_MBLS, outputRes(OUT_P4_NODES), [ctx](PassOutput* out) {
+        generateSetvarControl(&out->nodes(OUT_P4_NODES), ctx->mblFields_);
+    });
 
     // Measurement code
-    HeaderDecsMap headerDecsMap = findHeaderDecs(*nodeArray);
-    vector<ReactionArgNode*> reaction_args = findReactionArgs(*nodeArray);
-
-    global_ing_bins = generateIngDigestPacking(&newNodes, reaction_args, headerDecsMap,
-                    mblValues, mblFields, *nodeArray, &ing_iso_opt);
-    global_egr_bins = generateEgrDigestPacking(&newNodes, reaction_args, headerDecsMap,
-                    mblValues, mblFields, *nodeArray, &egr_iso_opt);    
-
-    // After packing, iso_opt is firm
-    augmentRegisterArgProgForIng(&newNodes, nodeArray, reaction_args, ing_iso_opt, true);   
-    augmentRegisterArgProgForIng(&newNodes, nodeArray, reaction_args, egr_iso_opt, false);  
-
-    generateDupRegArgProg(&newNodes, nodeArray, reaction_args, ing_iso_opt, egr_iso_opt);
-
-    generateRegArgGateControl(&newNodes, nodeArray, reaction_args, ing_iso_opt, egr_iso_opt);
-
-    generateExportControl(&newNodes, global_ing_bins, global_egr_bins);
+    pm->add("p4", "findHeaderDecs", RES_TREE, RES_REACTION_ARGS, [ctx, state](PassOutput*) {
+        state->headerDecsMap = findHeaderDecs(ctx->nodes_);
+        state->reactionArgs = findReactionArgs(ctx->nodes_);
+    });
+
+    // The malleable refs among the arguments of one half are only marked as
+    // being in the reaction, the halves leave each other's nodes alone
+    pm->add("p4", "generateDigestPackingIng", RES_TREE | RES_SYMBOLS | RES_MBLS | RES_REACTION_ARGS,
+            RES_ING_ISO_OPT | RES_ING_BINS | outputRes(OUT_P4_NODES), [ctx, state](PassOutput* out) {
+        ctx->ingBins_ = generateIngDigestPacking(&out->nodes(OUT_P4_NODES), state->reactionArgs, state->headerDecsMap,
+                        ctx->mblValues_, ctx->mblFields_, &ctx->symbols_, &ctx->ingIsoOpt_, ctx->pairArgBins_, ctx->mergeArgTables_);
+    });
+    pm->add("p4", "generateDigestPackingEgr", RES_TREE | RES_SYMBOLS | RES_MBLS | RES_REACTION_ARGS,
+            RES_EGR_ISO_OPT | RES_EGR_BINS | outputRes(OUT_P4_NODES), [ctx, state](PassOutput* out) {
+        ctx->egrBins_ = generateEgrDigestPacking(&out->nodes(OUT_P4_NODES), state->reactionArgs, state->headerDecsMap,
+                        ctx->mblValues_, ctx->mblFields_, &ctx->symbols_, &ctx->egrIsoOpt_, ctx->pairArgBins_, ctx->mergeArgTables_);
+    });
+
+    // After packing, iso_opt is firm.  Both halves extend every blackbox
+    // program, they run one after the other.
+    pm->add("p4", "augmentRegisterArgProgIng", RES_SYMBOLS | RES_REACTION_ARGS | RES_ING_ISO_OPT,
+            RES_TREE | outputRes(OUT_P4_NODES), [ctx, state](PassOutput* out) {
+        augmentRegisterArgProgForIng(&out->nodes(OUT_P4_NODES), ctx->symbols_, state->reactionArgs, ctx->ingIsoOpt_, true,
+                                     ctx->dirtyBlock_);
+    });
+    pm->add("p4", "augmentRegisterArgProgEgr", RES_SYMBOLS | RES_REACTION_ARGS | RES_EGR_ISO_OPT,
+            RES_TREE | outputRes(OUT_P4_NODES), [ctx, state](PassOutput* out) {
+        augmentRegisterArgProgForIng(&out->nodes(OUT_P4_NODES), ctx->symbols_, state->reactionArgs, ctx->egrIsoOpt_, false,
+                                     ctx->dirtyBlock_);
+    });
+
+    pm->add("p4", "generateDupRegArgProg", RES_TREE | RES_SYMBOLS | RES_REACTION_ARGS | RES_ISO_OPTS,
+            outputRes(OUT_P4_NODES), [ctx, state](PassOutput* out) {
+        generateDupRegArgProg(&out->nodes(OUT_P4_NODES), ctx->symbols_, state->reactionArgs, ctx->ingIsoOpt_, ctx->egrIsoOpt_,
+                              ctx->singleRegReplica_, ctx->dirtyBlock_);
+    });
+
+    pm->add("p4", "generateRegArgGateControl", RES_TREE | RES_SYMBOLS | RES_REACTION_ARGS | RES_ISO_OPTS,
+            outputRes(OUT_P4_NODES), [ctx, state](PassOutput* out) {
+        generateRegArgGateControl(&out->nodes(OUT_P4_NODES), ctx->symbols_, state->reactionArgs, ctx->ingIsoOpt_, ctx->egrIsoOpt_,
+                                  ctx->singleRegReplica_);
+    });
+
+    // Once every injected table is known, place them with the user tables
+    // and rewrite the stage pragmas
+    pm->add("p4", "planStages", RES_SYMBOLS | RES_MBLS | RES_REACTION_ARGS | RES_ISO_OPTS | RES_BINS,
+            RES_TREE, [ctx, state](PassOutput*) {
+        planStages(ctx->nodes_, ctx->symbols_, ctx->mblFields_, state->reactionArgs, ctx->ingBins_, ctx->egrBins_,
+                   ctx->ingIsoOpt_, ctx->egrIsoOpt_, ctx->pairArgBins_, ctx->mergeArgTables_, ctx->singleRegReplica_,
+                   ctx->dirtyBlock_, &ctx->ingStages_, &ctx->egrStages_);
+    });
+
+    pm->add("p4", "generateExportControl", RES_BINS, outputRes(OUT_P4_NODES), [ctx](PassOutput* out) {
+        generateExportControl(&out->nodes(OUT_P4_NODES), ctx->ingBins_, ctx->egrBins_, ctx->pairArgBins_, ctx->mergeArgTables_);
+        ctx->argExport_ = argExportCost(ctx->ingBins_, ctx->egrBins_, ctx->pairArgBins_, ctx->mergeArgTables_);
+        ctx->argExportPerRegister_ = argExportCost(ctx->ingBins_, ctx->egrBins_, ctx->pairArgBins_, false);
+    });
 
     // Finally, assemble ingress/egress
-    augmentIngress(nodeArray);
-    augmentEgress(nodeArray); 
-
-    return newNodes;
+    pm->add("p4", "augmentIngress", 0, RES_TREE, [ctx](PassOutput*) {
+        augmentIngress(&ctx->nodes_);
+    });
+    pm->add("p4", "augmentEgress", 0, RES_TREE, [ctx](PassOutput*) {
+        augmentEgress(&ctx->nodes_);
+    });
+
+    pm->add("p4", "findAndRemoveReactions", 0, RES_TREE, [ctx](PassOutput*) {
+        vector<P4RReactionNode*> reactions;
+        findAndRemoveReactions(&reactions, ctx->nodes_);
+    });
 }
 
-vector<UnanchoredNode *> compileCCode(std::vector<AstNode*> nodeArray, char * outFnBase) {
-	vector<UnanchoredNode *> ret_vec = vector<UnanchoredNode *>(); 
-    
-    string out_fn_base_str = string(outFnBase);
-    string base_fn = out_fn_base_str.substr(out_fn_base_str.find_last_of("/\\") + 1);
-    PRINT_VERBOSE("Output filename base: %s\n", base_fn.c_str());    
-    string prefix_str = "p4_pd_" + string(base_fn) + "_mantis_";
-
-    ostringstream oss_preprocessor;
-    ostringstream oss_mbl_init;
-    ostringstream oss_init_end;
-    ostringstream oss_reaction_mirror;
-    ostringstream oss_reaction_update;
-
-    extractReactionMacro(nodeArray, oss_preprocessor, string(outFnBase));
-
-    generateMacroNonMblTable(nodeArray, oss_preprocessor, prefix_str);
- 
-    generatePrologueEnd(nodeArray, oss_init_end, ing_iso_opt, egr_iso_opt);
-
-    generateHdlPool(nodeArray, oss_mbl_init, ing_iso_opt, egr_iso_opt);
-
-    generateMacroInitMblsForIng(nodeArray, &mblUsages, oss_mbl_init, oss_reaction_mirror, oss_preprocessor, num_init_mbls_ing, ing_iso_opt, prefix_str, true);
-    generateMacroInitMblsForIng(nodeArray, &mblUsages, oss_mbl_init, oss_reaction_mirror, oss_preprocessor, num_init_mbls_egr, egr_iso_opt, prefix_str, false);
-
-    generateMacroXorVersionBits(oss_reaction_mirror, oss_preprocessor, ing_iso_opt, egr_iso_opt);
-
-    generateDialogueArgStart(oss_reaction_mirror, ing_iso_opt, egr_iso_opt);
-
-    mirrorFieldArg(nodeArray, oss_reaction_mirror, oss_preprocessor, global_ing_bins, prefix_str, true);
-    mirrorFieldArg(nodeArray, oss_reaction_mirror, oss_preprocessor, global_egr_bins, prefix_str, false);
-
-    mirrorRegisterArgForIng(nodeArray, oss_reaction_mirror, ing_iso_opt, prefix_str, true);
-    mirrorRegisterArgForIng(nodeArray, oss_reaction_mirror, egr_iso_opt, prefix_str, false);
-
-    generateMacroMblTable(nodeArray, oss_preprocessor, prefix_str, ing_iso_opt, egr_iso_opt, oss_reaction_mirror);
-
-    generateDialogueEnd(nodeArray, oss_reaction_update, ing_iso_opt, egr_iso_opt);
-
-    ret_vec.push_back(generateMacroNode(oss_preprocessor));
-    ret_vec.push_back(generatePrologueNode(nodeArray, oss_mbl_init, oss_init_end));
-    ret_vec.push_back(generateDialogueNode(nodeArray, oss_reaction_mirror, oss_reaction_update));    
+// Results one C pass leaves for later ones
+struct CPassState {
+    string prefix;
+    UserCode initCode;
+    UserCode reactionCode;
+};
+
+// Key of a pass depending on the isolation options and the malleable table
+// operations of the user code only
+static string isoOptKey(CompileContext* ctx, const UserCode* code = NULL) {
+    string key = to_string(ctx->ingIsoOpt_) + " " + to_string(ctx->egrIsoOpt_);
+    if (code != NULL) {
+        for (const string& call : code->tableCalls) {
+            key += "\n" + call;
+        }
+    }
+    return key;
+}
 
-	return ret_vec;
-}
\ No newline at end of file
+void addCPasses(PassManager* pm, CompileContext* ctx, const string& progName) {
+    auto state = make_shared<CPassState>();
+    PRINT_VERBOSE("Program name: %s\n", progName.c_str());
+    state->prefix = "p4_pd_" + progName + "_mantis_";
+
+    // Single pass over the user code, later steps only consume the result
+    pm->add("c", "rewriteInitBlock", RES_TREE, RES_INIT_CODE, [ctx, state](PassOutput*) {
+        state->initCode = rewriteInitBlock(ctx->nodes_);
+    });
+    pm->add("c", "rewriteReaction", RES_TREE, RES_REACTION_CODE, [ctx, state](PassOutput*) {
+        state->reactionCode = rewriteReaction(ctx->nodes_);
+    });
+
+    pm->add("c", "generateMacroNonMblTable", RES_TREE | RES_SYMBOLS | RES_NUM_MAX_ALTS,
+            outputRes(OUT_PREPROCESSOR), [ctx, state](PassOutput* out) {
+        generateMacroNonMblTable(ctx->symbols_, out->stream(OUT_PREPROCESSOR), state->prefix, ctx->numMaxAlts_);
+    });
+
+    pm->addCached("c", "generatePrologueEnd", RES_INIT_CODE | RES_ISO_OPTS, outputRes(OUT_INIT_END),
+                  [ctx, state]() { return isoOptKey(ctx, &state->initCode); },
+                  [ctx, state](PassOutput* out) {
+        generatePrologueEnd(state->initCode, out->stream(OUT_INIT_END), ctx->ingIsoOpt_, ctx->egrIsoOpt_);
+    });
+
+    pm->add("c", "generateHdlPool", RES_TREE | RES_ISO_OPTS, RES_NUM_MAX_ALTS | outputRes(OUT_MBL_INIT), [ctx](PassOutput* out) {
+        generateHdlPool(ctx->nodes_, out->stream(OUT_MBL_INIT), ctx->ingIsoOpt_, ctx->egrIsoOpt_, &ctx->numMaxAlts_);
+    });
+
+    uint64_t initMblsReads = RES_TREE | RES_MBL_USAGES | RES_NUM_MAX_ALTS;
+    uint64_t initMblsWrites = outputRes(OUT_MBL_INIT) | outputRes(OUT_REACTION_MIRROR) | outputRes(OUT_PREPROCESSOR);
+    pm->add("c", "generateMacroInitMblsIng", initMblsReads | RES_NUM_INIT_MBLS_ING | RES_ING_ISO_OPT, initMblsWrites, [ctx, state](PassOutput* out) {
+        generateMacroInitMblsForIng(ctx->nodes_, &ctx->mblUsages_, out->stream(OUT_MBL_INIT), out->stream(OUT_REACTION_MIRROR), out->stream(OUT_PREPROCESSOR),
+                                    ctx->numInitMblsIng_, ctx->ingIsoOpt_, state->prefix, true, ctx->numMaxAlts_);
+    });
+    pm->add("c", "generateMacroInitMblsEgr", initMblsReads | RES_NUM_INIT_MBLS_EGR | RES_EGR_ISO_OPT, initMblsWrites, [ctx, state](PassOutput* out) {
+        generateMacroInitMblsForIng(ctx->nodes_, &ctx->mblUsages_, out->stream(OUT_MBL_INIT), out->stream(OUT_REACTION_MIRROR), out->stream(OUT_PREPROCESSOR),
+                                    ctx->numInitMblsEgr_, ctx->egrIsoOpt_, state->prefix, false, ctx->numMaxAlts_);
+    });
+
+    pm->addCached("c", "generateMacroXorVersionBits", RES_ISO_OPTS, outputRes(OUT_REACTION_MIRROR) | outputRes(OUT_PREPROCESSOR),
+                  [ctx]() { return isoOptKey(ctx); },
+                  [ctx](PassOutput* out) {
+        generateMacroXorVersionBits(out->stream(OUT_REACTION_MIRROR), out->stream(OUT_PREPROCESSOR), ctx->ingIsoOpt_, ctx->egrIsoOpt_);
+    });
+
+    pm->addCached("c", "generateDialogueArgStart", RES_ISO_OPTS, outputRes(OUT_REACTION_MIRROR),
+                  [ctx]() { return isoOptKey(ctx); },
+                  [ctx](PassOutput* out) {
+        generateDialogueArgStart(out->stream(OUT_REACTION_MIRROR), ctx->ingIsoOpt_, ctx->egrIsoOpt_);
+    });
+
+    uint64_t mirrorWrites = outputRes(OUT_REACTION_MIRROR) | outputRes(OUT_PREPROCESSOR);
+    pm->add("c", "mirrorFieldArgIng", RES_TREE | RES_ING_BINS, mirrorWrites, [ctx, state](PassOutput* out) {
+        mirrorFieldArg(ctx->nodes_, out->stream(OUT_REACTION_MIRROR), out->stream(OUT_PREPROCESSOR), ctx->ingBins_, state->prefix, true, ctx->pairArgBins_);
+    });
+    pm->add("c", "mirrorFieldArgEgr", RES_TREE | RES_EGR_BINS, mirrorWrites, [ctx, state](PassOutput* out) {
+        mirrorFieldArg(ctx->nodes_, out->stream(OUT_REACTION_MIRROR), out->stream(OUT_PREPROCESSOR), ctx->egrBins_, state->prefix, false, ctx->pairArgBins_);
+    });
+
+    pm->add("c", "mirrorRegisterArgIng", RES_TREE | RES_SYMBOLS | RES_ING_ISO_OPT, outputRes(OUT_REACTION_MIRROR), [ctx, state](PassOutput* out) {
+        mirrorRegisterArgForIng(ctx->symbols_, out->stream(OUT_REACTION_MIRROR), ctx->ingIsoOpt_, state->prefix, true,
+                                ctx->singleRegReplica_, ctx->dirtyBlock_);
+    });
+    pm->add("c", "mirrorRegisterArgEgr", RES_TREE | RES_SYMBOLS | RES_EGR_ISO_OPT, outputRes(OUT_REACTION_MIRROR), [ctx, state](PassOutput* out) {
+        mirrorRegisterArgForIng(ctx->symbols_, out->stream(OUT_REACTION_MIRROR), ctx->egrIsoOpt_, state->prefix, false,
+                                ctx->singleRegReplica_, ctx->dirtyBlock_);
+    });
+
+    pm->add("c", "generateMacroMblTable", RES_TREE | RES_SYMBOLS | RES_ISO_OPTS | RES_NUM_MAX_ALTS,
+            outputRes(OUT_PREPROCESSOR) | outputRes(OUT_REACTION_MIRROR), [ctx, state](PassOutput* out) {
+        generateMacroMblTable(ctx->symbols_, out->stream(OUT_PREPROCESSOR), state->prefix, ctx->ingIsoOpt_, ctx->egrIsoOpt_, out->stream(OUT_REACTION_MIRROR), ctx->numMaxAlts_);
+    });
+
+    pm->addCached("c", "generateDialogueEnd", RES_REACTION_CODE | RES_ISO_OPTS, outputRes(OUT_REACTION_UPDATE),
+                  [ctx, state]() { return isoOptKey(ctx, &state->reactionCode); },
+                  [ctx, state](PassOutput* out) {
+        generateDialogueEnd(state->reactionCode, out->stream(OUT_REACTION_UPDATE), ctx->ingIsoOpt_, ctx->egrIsoOpt_);
+    });
+
+    // Expand the generated macros in place, the agent code is ready to compile as is
+    uint64_t expandReads = RES_TREE | RES_INIT_CODE | RES_REACTION_CODE |
+                           outputRes(OUT_PREPROCESSOR) | outputRes(OUT_MBL_INIT) | outputRes(OUT_INIT_END) |
+                           outputRes(OUT_REACTION_MIRROR) | outputRes(OUT_REACTION_UPDATE);
+    pm->add("c", "expandMacros", expandReads, outputRes(OUT_C_NODES), [pm, ctx, state](PassOutput* out) {
+        MacroExpander macros(pm->str(OUT_PREPROCESSOR));
+        vector<AstNode*>& cNodes = out->nodes(OUT_C_NODES);
+        cNodes.push_back(generateHeaderNode(ctx->nodes_));
+        cNodes.push_back(generatePrologueNode(macros, state->initCode, pm->str(OUT_MBL_INIT), pm->str(OUT_INIT_END)));
+        cNodes.push_back(generateDialogueNode(macros, state->reactionCode, pm->str(OUT_REACTION_MIRROR), pm->str(OUT_REACTION_UPDATE)));
+    });
+}
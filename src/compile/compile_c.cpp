@@ -14,8 +14,9 @@
  */
 
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
-#include <regex>
+#include <algorithm>
 #include <boost/format.hpp>
 #include <fstream>
 
@@ -24,17 +25,18 @@
 
 #include "compile_const.h"
 #include "compile_p4.h"
+#include "c_scanner.h"
+#include "macro_expander.h"
 
 using namespace std;
 
-static int num_max_alts = 1;
-
 // Process include/define macros in reaction
-void extractReactionMacro(std::vector<AstNode*> nodeArray, ostringstream& oss_preprocessor, string out_fn_base) {
+// Both stay at the top of the agent code, ahead of the PD api header
+UnanchoredNode* generateHeaderNode(const NodeRegistry& nodeArray) {
     string cinclude_str = "";
     string cdefine_str = "";
 	for (auto node : nodeArray) {
-        if(typeContains(node, "IncludeNode")) {
+        if(node->isKind(INCLUDE_NODE)) {
             IncludeNode* includenode = dynamic_cast<IncludeNode*>(node);
             if(includenode->macrotype_==IncludeNode::C) {
                 if(includenode->toString().find("include")!=string::npos) {
@@ -48,184 +50,159 @@ void extractReactionMacro(std::vector<AstNode*> nodeArray, ostringstream& oss_pr
         }
     }
 
-    // Keep preprocessor other than include
-    oss_preprocessor << cdefine_str;
-    // Include preprocessor goes to seperate tmp file
-    std::ofstream os;
-    os.open(out_fn_base+"_mantis.include");
-    os << cinclude_str << endl;
-    os.close();
+    string header_str = cinclude_str + "#include \"pd.h\"\n\n" + cdefine_str;
+    UnanchoredNode* header_cnode = new UnanchoredNode(header_str, "header", "header");
+    return header_cnode;
 }
 
-UnanchoredNode* generatePrologueNode(std::vector<AstNode*> nodeArray, ostringstream& oss_mbl_init, ostringstream& oss_init_end) {
-
-    P4RInitBlockNode * init_node = findInitBlock(nodeArray);
-
-    string * prologue_str = NULL;
-    if (init_node != 0) {
-        prologue_str = new string(
-            str(boost::format(kPrologueT) % oss_mbl_init.str() % init_node -> body_ -> toString() % oss_init_end.str()));
-    } else {
-        // if no init_block
-        prologue_str = new string(
-            str(boost::format(kPrologueT) % oss_mbl_init.str() % "" % oss_init_end.str()));
-    }
-
-    UnanchoredNode* prologue_cnode = new UnanchoredNode(prologue_str, new string ("prologue"), new string("pd_prologue"));
+UnanchoredNode* generatePrologueNode(const MacroExpander& macros, const UserCode& initCode, const string& mbl_init, const string& init_end) {
+    string prologue_str = macros.expand(str(boost::format(kPrologueT) % mbl_init % initCode.code % init_end));
+    UnanchoredNode* prologue_cnode = new UnanchoredNode(prologue_str, "prologue", "pd_prologue");
     return prologue_cnode;
 }
 
-UnanchoredNode* generateDialogueNode(std::vector<AstNode*> nodeArray, ostringstream& oss_reaction_mirror, ostringstream& oss_reaction_update) {
+UnanchoredNode* generateDialogueNode(const MacroExpander& macros, const UserCode& reactionCode, const string& reaction_mirror, const string& reaction_update) {
+    string dialogue_str = macros.expand(str(boost::format(kDialogueT) % reaction_mirror % reactionCode.code % reaction_update));
+    UnanchoredNode * dialogue_cnode = new UnanchoredNode(dialogue_str, "dialogue", "pd_dialogue");
+    return dialogue_cnode;
+}
 
-	// Assume single global reaction and initialization node (if any)
-	P4RReactionNode * react_node = findReaction(nodeArray);
-    string * dialogue_str = NULL;
-    string p4r_reaction_user_str = "";
-    if (react_node != 0) {
-        p4r_reaction_user_str = react_node->body_->toString();
+// Names of the user operations on malleable tables, <table>_{add,mod,del}_<action>
+static unordered_set<string> mblTableOps(const NodeRegistry& nodeArray) {
+    unordered_set<string> ops;
+    for (auto node : nodeArray.ofKind(P4R_MALLEABLE_TABLE_NODE)) {
+        TableNode* table = dynamic_cast<P4RMalleableTableNode*>(node)->table_;
+        for (TableActionStmtNode* tas : *table->actions_->list_) {
+            for (const char* op : {"_add_", "_mod_", "_del_"}) {
+                ops.insert(*table->name_->word_ + op + *tas->name_->word_);
+            }
+        }
     }
+    return ops;
+}
 
-    // Translate mantis style variable assignment to macros to be further processed by C preprocessor
-    // regrex matching ${var} = <alter>;
-    std::regex e_val ("\\$\\{([^ ]*)\\}\\s*[=]\\s*([^\\; ]*)\\s*\\;");
-    p4r_reaction_user_str = std::regex_replace (p4r_reaction_user_str, e_val, "__mantis__mod_var_$1($2);");
-    // regrex matching ${var} = <header>.<field>;
-    std::regex e_field ("\\$\\{([^ ]*)\\}\\s*[=]\\s*([^\\. ]*)\\s*\\.\\s*([^\\; ]*)\\s*\\;");
-    p4r_reaction_user_str = std::regex_replace (p4r_reaction_user_str, e_field, "__mantis__mod_var_$1_$2_$3;");
-
-    // Change field arg format to C compatible variable
-    vector<ReactionArgNode*> reaction_args = findReactionArgs(nodeArray);
-    for (auto ra : reaction_args) {    
-        if (ra->argType_==ReactionArgNode::INGRESS_FIELD) {
-            FieldNode* fieldnode = dynamic_cast<FieldNode*>(ra->arg_);
-            std::regex e_fieldarg (fieldnode->headerName_->toString()+"\\s*([^\\. ]*)\\s*\\.\\s*"+fieldnode->fieldName_->toString());
-            p4r_reaction_user_str = std::regex_replace (p4r_reaction_user_str, e_fieldarg, fieldnode->headerName_->toString()+"_"+fieldnode->fieldName_->toString());
-        }    
+UserCode rewriteInitBlock(const NodeRegistry& nodeArray) {
+    // Assume single global initialization node (if any)
+    P4RInitBlockNode * init_node = findInitBlock(nodeArray);
+    if (init_node == 0) {
+        return UserCode();
     }
+    return rewriteUserCode(init_node->body_->toString(), mblTableOps(nodeArray), unordered_set<string>());
+}
 
-    if (react_node != 0) {
-        dialogue_str = new string(
-            str(boost::format(kDialogueT) % oss_reaction_mirror.str() % p4r_reaction_user_str % oss_reaction_update.str()));
-    } else {
-        dialogue_str = new string(
-            str(boost::format(kDialogueT) % oss_reaction_mirror.str() % "" % oss_reaction_update.str()));
+UserCode rewriteReaction(const NodeRegistry& nodeArray) {
+    // Assume single global reaction node (if any)
+    P4RReactionNode * react_node = findReaction(nodeArray);
+    if (react_node == 0) {
+        return UserCode();
     }
 
-    UnanchoredNode * dialogue_cnode = new UnanchoredNode(dialogue_str, new string ("dialogue"), new string("pd_dialogue"));
-    return dialogue_cnode;
-}
-
-UnanchoredNode * generateMacroNode(ostringstream& oss_preprocessor) {
-    string* oss_preprocessor_p = new string(oss_preprocessor.str());
-    UnanchoredNode * macro_cnode = new UnanchoredNode(oss_preprocessor_p, new string("macro"), new string("macro"));
-    return macro_cnode;
+    // Field args become C compatible variables
+    unordered_set<string> field_args;
+    for (auto ra : findReactionArgs(nodeArray)) {
+        if (ra->argType_==ReactionArgNode::INGRESS_FIELD || ra->argType_==ReactionArgNode::EGRESS_FIELD) {
+            FieldNode* fieldnode = dynamic_cast<FieldNode*>(ra->arg_);
+            field_args.insert(fieldnode->headerName_->toString() + "." + fieldnode->fieldName_->toString());
+        }
+    }
+    return rewriteUserCode(react_node->body_->toString(), mblTableOps(nodeArray), field_args);
 }
 
 // Currently not mirroring mbl field arg
-void mirrorFieldArg(std::vector<AstNode*> nodeArray, ostringstream& oss_reaction_mirror, 
+void mirrorFieldArg(const NodeRegistry& nodeArray, ostringstream& oss_reaction_mirror, 
                     ostringstream& oss_preprocessor, vector<ReactionArgBin> bins,
-                    string prefix_str, bool forIng) {
-    for (int i = 0; i < bins.size(); ++i) {
+                    string prefix_str, bool forIng, bool paired) {
+    string values_base = forIng ? "__mantis__values_riSetArgs_" : "__mantis__values_reSetArgs_";
+    for (int i = 0; i < numArgRegisters(bins, paired); ++i) {
+        // Bins in the register, lo and hi half of a 64-bit one
+        int lo = paired ? 2*i : i;
+        bool pair = paired && lo+1 < bins.size();
+        int hi = pair ? lo+1 : lo;
         // Applies to both cases with/without isolation by indexing __mv
-        if(forIng) {
-            oss_reaction_mirror << str(boost::format(kIngFieldArgPollT) % std::to_string(bins[i].second) % std::to_string(i) % prefix_str);
+        if(pair) {
+            oss_reaction_mirror << str(boost::format(forIng ? kIngFieldArgPairPollT : kEgrFieldArgPairPollT) % std::to_string(i) % prefix_str);
+        } else if(forIng) {
+            oss_reaction_mirror << str(boost::format(kIngFieldArgPollT) % std::to_string(bins[lo].second) % std::to_string(i) % prefix_str);
         } else {
-            oss_reaction_mirror << str(boost::format(kEgrFieldArgPollT) % std::to_string(bins[i].second) % std::to_string(i) % prefix_str);
+            oss_reaction_mirror << str(boost::format(kEgrFieldArgPollT) % std::to_string(bins[lo].second) % std::to_string(i) % prefix_str);
         }
 
-        // Reverse order
-        for (int j = bins[i].first.size()-1; j >= 0; --j) {      
-            AstNode* arg_node = bins[i].first[j].first->arg_;
-            int width = bins[i].first[j].second;
-            std::regex e_dot2underscore ("\\.");
-            string field_arg_c = std::regex_replace(arg_node->toString(), e_dot2underscore, "_");
-
-            ostringstream oss_mask_tmp;
-            oss_mask_tmp << "0b";
-            for (int k = 0; k < width; ++k) {
-                oss_mask_tmp << "1";
+        for (int b = lo; b <= hi; ++b) {
+            string value = values_base + std::to_string(i) + "[1]";
+            if(pair) {
+                value += b == lo ? ".f1" : ".f0";
             }
-            if(forIng) {
-                oss_reaction_mirror << "\n  uint"
-                                    << width
-                                    << "_t "
-                                    << field_arg_c
-                                    << "="
-                                    << "__mantis__values_riSetArgs_"
-                                    << i
-                                    << "[1]&"
-                                    << oss_mask_tmp.str()
-                                    << ";";    
-                oss_reaction_mirror << "\n  __mantis__values_riSetArgs_"
-                                    << i
-                                    << "[1]>>"
-                                    << width
-                                    << ";";                   
-            } else {
+            // Reverse order
+            for (int j = bins[b].first.size()-1; j >= 0; --j) {      
+                AstNode* arg_node = bins[b].first[j].first->arg_;
+                int width = bins[b].first[j].second;
+                string field_arg_c = arg_node->toString();
+                std::replace(field_arg_c.begin(), field_arg_c.end(), '.', '_');
+
+                ostringstream oss_mask_tmp;
+                oss_mask_tmp << "0b";
+                for (int k = 0; k < width; ++k) {
+                    oss_mask_tmp << "1";
+                }
                 oss_reaction_mirror << "\n  uint"
                                     << width
                                     << "_t "
                                     << field_arg_c
                                     << "="
-                                    << "__mantis__values_reSetArgs_"
-                                    << i
-                                    << "[1]&"
+                                    << value
+                                    << "&"
                                     << oss_mask_tmp.str()
                                     << ";";    
-                oss_reaction_mirror << "\n  __mantis__values_reSetArgs_"
-                                    << i
-                                    << "[1]>>"
-                                    << width
-                                    << ";";   
-            }                                       
+                // Nothing left to unpack after the first field, shifting a
+                // full 32 bits out would be undefined
+                if (j > 0) {
+                    oss_reaction_mirror << "\n  "
+                                        << value
+                                        << ">>="
+                                        << width
+                                        << ";";
+                }
+            }
         }
     }
 }
 
-void mirrorRegisterArgForIng(std::vector<AstNode*> nodeArray, ostringstream& oss_reaction_mirror, int iso_opt, string prefix_str, bool forIng) {
+void mirrorRegisterArgForIng(const SymbolTable& symbols, ostringstream& oss_reaction_mirror, int iso_opt, string prefix_str, bool forIng,
+                             bool singleReplica, int dirtyBlock) {
 
-    vector<ReactionArgNode*> reaction_args = findReactionArgs(nodeArray);
+    vector<ReactionArgNode*> reaction_args = findReactionArgs(symbols.nodes());
+    const char* mirrorT = singleReplica ? kRegArgIsoMirrorSingleT : kRegArgIsoMirrorT;
+    const char* mirrorT_64 = singleReplica ? kRegArgIsoMirrorSingleT_64 : kRegArgIsoMirrorT_64;
+    if (dirtyBlock > 0) {
+        mirrorT = singleReplica ? kRegArgIsoMirrorSingleDirtyT : kRegArgIsoMirrorDirtyT;
+        mirrorT_64 = singleReplica ? kRegArgIsoMirrorSingleDirtyT_64 : kRegArgIsoMirrorDirtyT_64;
+    }
     if(((unsigned int)iso_opt) & 0b1) {
         // Read replicas based on mv for each reg arg
         for (auto ra : reaction_args) {
             if(ra->argType_==ReactionArgNode::REGISTER) {
                 if(forIng) {
-                    if(!findRegargInIng(ra, nodeArray)) {
+                    if(!findRegargInIng(ra, symbols)) {
                         // Skip egr reg
                         continue;
                     }
                 } else {
-                    if(findRegargInIng(ra, nodeArray)) {
+                    if(findRegargInIng(ra, symbols)) {
                         // Skip ing reg
                         continue;
                     }
                 }
-                bool is_valid_tmp = false;
-                P4RegisterNode* target_reg = NULL;
-                for (auto n : nodeArray) {
-                    if (typeContains(n, "P4RegisterNode")) {
-                        target_reg = dynamic_cast<P4RegisterNode*>(n);
-                        if(target_reg->name_->toString().compare(ra->arg_->toString())==0) {
-                            is_valid_tmp = true;
-                            break;
-                        }
-                    }
-                }    
-                // Currently assuming non-64b reg to isolate
+                P4RegisterNode* target_reg = symbols.reg(ra->arg_->toString());
+                bool is_valid_tmp = target_reg != NULL;
                 if(is_valid_tmp) {
-                    if(ra->index2_) {
-                        if(forIng) {
-                            oss_reaction_mirror << str(boost::format(kRegArgIsoMirrorT) % ra->arg_->toString() % std::to_string(target_reg->width_) % std::to_string(target_reg->instanceCount_) % prefix_str % std::to_string(std::stoi(ra->index2_->toString())) % "__mantis__mv_ing");
-                        } else {
-                            oss_reaction_mirror << str(boost::format(kRegArgIsoMirrorT) % ra->arg_->toString() % std::to_string(target_reg->width_) % std::to_string(target_reg->instanceCount_) % prefix_str % std::to_string(std::stoi(ra->index2_->toString())) % "__mantis__mv_egr");
-                        }
-                    } else {
-                        if(forIng) {
-                            oss_reaction_mirror << str(boost::format(kRegArgIsoMirrorT) % ra->arg_->toString() % std::to_string(target_reg->width_) % std::to_string(target_reg->instanceCount_) % prefix_str % std::to_string(target_reg->instanceCount_) % "__mantis__mv_ing");
-                        } else {
-                            oss_reaction_mirror << str(boost::format(kRegArgIsoMirrorT) % ra->arg_->toString() % std::to_string(target_reg->width_) % std::to_string(target_reg->instanceCount_) % prefix_str % std::to_string(target_reg->instanceCount_) % "__mantis__mv_egr");
-                        }
+                    int items = ra->index2_ ? std::stoi(ra->index2_->toString()) : target_reg->instanceCount_;
+                    boost::format mirror(target_reg->width_ == 64 ? mirrorT_64 : mirrorT);
+                    mirror % ra->arg_->toString() % std::to_string(target_reg->width_) % std::to_string(target_reg->instanceCount_) % prefix_str % std::to_string(items) % (forIng ? "__mantis__mv_ing" : "__mantis__mv_egr");
+                    if (dirtyBlock > 0) {
+                        int blocks = (target_reg->instanceCount_ + dirtyBlock - 1) / dirtyBlock;
+                        mirror % std::to_string(dirtyBlock) % std::to_string(blocks);
                     }
+                    oss_reaction_mirror << str(mirror);
                 } else {
                     PANIC("WARNING: Invalid register argument\n");
                 }
@@ -243,29 +220,20 @@ void mirrorRegisterArgForIng(std::vector<AstNode*> nodeArray, ostringstream& oss
         for (auto ra : reaction_args) {
             if(ra->argType_==ReactionArgNode::REGISTER) {
                 if(forIng) {
-                    if(!findRegargInIng(ra, nodeArray)) {
+                    if(!findRegargInIng(ra, symbols)) {
                         // Skip egr reg
                         continue;
                     }
                 } else {
-                    if(findRegargInIng(ra, nodeArray)) {
+                    if(findRegargInIng(ra, symbols)) {
                         // Skip ing reg
                         continue;
                     }
                 }                
-                bool is_valid_tmp = false;
-                P4RegisterNode* target_reg = NULL;
-                for (auto n : nodeArray) {
-                    if (typeContains(n, "P4RegisterNode")) {
-                        target_reg = dynamic_cast<P4RegisterNode*>(n);
-                        if(target_reg->name_->toString().compare(ra->arg_->toString())==0) {
-                            is_valid_tmp = true;
-                            break;
-                        }
-                    }
-                }              
+                P4RegisterNode* target_reg = symbols.reg(ra->arg_->toString());
+                bool is_valid_tmp = target_reg != NULL;
                 // Check the register width
-                int width = findRegargWidth(ra, nodeArray);
+                int width = findRegargWidth(ra, symbols);
                 if(is_valid_tmp) {
                     if(ra->index2_) {
                         if (width==64) {
@@ -365,15 +333,15 @@ void generateDialogueArgStart(ostringstream& oss_reaction_mirror, int ing_iso_op
 
 // Synthesizing macros for non-mbl table manipulations
 // These operations should only be used at prologue as no isolation provided
-void generateMacroNonMblTable(std::vector<AstNode*> nodeArray, ostringstream& oss_preprocessor, string prefix_str) {
+void generateMacroNonMblTable(const SymbolTable& symbols, ostringstream& oss_preprocessor, string prefix_str, int num_max_alts) {
     // <TBL_MANIPULATION_SYNTAX> ::= <TBL_NAME>_<OPERATION_TYPE>(_[ACT_name])^{0,1}([ENTRY_INDEX], <ARGS>^{0,1})
     // <ARGS> ::= <MATCH_ARGS> <ACT_ARGS>
     // Match/action arguements are intepreted in the same sequential order as in P4 match/action code
     // If the table includes ternary match, priority set is required at the end of match arguments
     ostringstream oss_macro_tmp;
     ostringstream oss_replace_tmp;
-    for (auto node : nodeArray) {
-        if(typeContains(node, "TableNode") && !typeContains(node, "P4R")) {
+    for (auto node : symbols.nodes()) {
+        if(node->isKind(TABLE_NODE)) {
             TableNode* table = dynamic_cast<TableNode*>(node);
             // Get rid of Table nodes that are actually child of variable P4R table
             if(table->isMalleable_) {
@@ -499,39 +467,33 @@ void generateMacroNonMblTable(std::vector<AstNode*> nodeArray, ostringstream& os
                     }
                     // Find the ActionNode and add action arguments
                     int action_arg_index = 0;
-                    for (auto tmp_node : nodeArray) {
-                        if(typeContains(tmp_node, "ActionNode")) {
-                            ActionNode* tmp_action_node = dynamic_cast<ActionNode*>(tmp_node);
-                            string tmp_action_name = tmp_action_node->name_->toString();
-                            if(tmp_action_name.compare(action_name)==0) {
-                                ActionParamsNode* tmp_action_params = tmp_action_node->params_;
-                                for (ActionParamNode* apn : *tmp_action_params->list_) {
-                                    if (action_arg_index==0) {
-                                        // Declare action spec data struct
-                                        oss_replace_tmp << "\t"
-                                                        << prefix_str
-                                                        << action_name
-                                                        << "_action_spec_t "
-                                                        << "__mantis__add_"
-                                                        << action_name
-                                                        << "_action_spec_##ARG_INDEX;\\\n"
-                                                        << kMantisNl;
-                                    }
-                                    oss_macro_tmp << ",ARG_ACTION_"
-                                                << std::to_string(action_arg_index);
-                                    oss_replace_tmp << "\t"
-                                                    << "__mantis__add_"
-                                                    << action_name
-                                                    << "_action_spec_##ARG_INDEX.action_"
-                                                    << apn->toString()
-                                                    << "=ARG_ACTION_"
-                                                    << std::to_string(action_arg_index)
-                                                    << ";\\\n"
-                                                    << kMantisNl;
-                                    action_arg_index++;
-                                }
-                                break;
+                    ActionNode* tmp_action_node = symbols.action(action_name);
+                    if(tmp_action_node != NULL) {
+                        ActionParamsNode* tmp_action_params = tmp_action_node->params_;
+                        for (ActionParamNode* apn : *tmp_action_params->list_) {
+                            if (action_arg_index==0) {
+                                // Declare action spec data struct
+                                oss_replace_tmp << "\t"
+                                                << prefix_str
+                                                << action_name
+                                                << "_action_spec_t "
+                                                << "__mantis__add_"
+                                                << action_name
+                                                << "_action_spec_##ARG_INDEX;\\\n"
+                                                << kMantisNl;
                             }
+                            oss_macro_tmp << ",ARG_ACTION_"
+                                        << std::to_string(action_arg_index);
+                            oss_replace_tmp << "\t"
+                                            << "__mantis__add_"
+                                            << action_name
+                                            << "_action_spec_##ARG_INDEX.action_"
+                                            << apn->toString()
+                                            << "=ARG_ACTION_"
+                                            << std::to_string(action_arg_index)
+                                            << ";\\\n"
+                                            << kMantisNl;
+                            action_arg_index++;
                         }
                     }
                     oss_macro_tmp << ")";
@@ -595,38 +557,32 @@ void generateMacroNonMblTable(std::vector<AstNode*> nodeArray, ostringstream& os
                                 << action_name
                                 << "(ARG_INDEX";
                     action_arg_index = 0;
-                    for (auto tmp_node : nodeArray) {
-                        if(typeContains(tmp_node, "ActionNode")) {
-                            ActionNode* tmp_action_node = dynamic_cast<ActionNode*>(tmp_node);
-                            string tmp_action_name = tmp_action_node->name_->toString();
-                            if(tmp_action_name.compare(action_name)==0) {
-                                ActionParamsNode* tmp_action_params = tmp_action_node->params_;
-                                for (ActionParamNode* apn : *tmp_action_params->list_) {
-                                    if(action_arg_index==0) {
-                                        oss_replace_tmp << "\t"
-                                                        << prefix_str
-                                                        << action_name
-                                                        << "_action_spec_t "
-                                                        << "__mantis__mod_"
-                                                        << action_name
-                                                        << "_action_spec_##ARG_INDEX;\\\n"
-                                                        << kMantisNl;
-                                    }
-                                    oss_macro_tmp << ",ARG_ACTION_"
-                                                << std::to_string(action_arg_index);
-                                    oss_replace_tmp << "\t"
-                                                    << "__mantis__mod_"
-                                                    << action_name
-                                                    << "_action_spec_##ARG_INDEX.action_"
-                                                    << apn->toString()
-                                                    << "=ARG_ACTION_"
-                                                    << std::to_string(action_arg_index)
-                                                    << ";\\\n"
-                                                    << kMantisNl;
-                                    action_arg_index += 1;
-                                }
-                                break;
+                    tmp_action_node = symbols.action(action_name);
+                    if(tmp_action_node != NULL) {
+                        ActionParamsNode* tmp_action_params = tmp_action_node->params_;
+                        for (ActionParamNode* apn : *tmp_action_params->list_) {
+                            if(action_arg_index==0) {
+                                oss_replace_tmp << "\t"
+                                                << prefix_str
+                                                << action_name
+                                                << "_action_spec_t "
+                                                << "__mantis__mod_"
+                                                << action_name
+                                                << "_action_spec_##ARG_INDEX;\\\n"
+                                                << kMantisNl;
                             }
+                            oss_macro_tmp << ",ARG_ACTION_"
+                                        << std::to_string(action_arg_index);
+                            oss_replace_tmp << "\t"
+                                            << "__mantis__mod_"
+                                            << action_name
+                                            << "_action_spec_##ARG_INDEX.action_"
+                                            << apn->toString()
+                                            << "=ARG_ACTION_"
+                                            << std::to_string(action_arg_index)
+                                            << ";\\\n"
+                                            << kMantisNl;
+                            action_arg_index += 1;
                         }
                     }
                     oss_macro_tmp << ")";
@@ -670,37 +626,31 @@ void generateMacroNonMblTable(std::vector<AstNode*> nodeArray, ostringstream& os
                                 << action_name
                                 << "(ARG_INDEX";
                     int action_arg_index = 0;                                
-                    for (auto tmp_node : nodeArray) {
-                        if(typeContains(tmp_node, "ActionNode")) {
-                            ActionNode* tmp_action_node = dynamic_cast<ActionNode*>(tmp_node);
-                            string tmp_action_name = tmp_action_node->name_->toString();
-                            if(tmp_action_name.compare(action_name)==0) {
-                                ActionParamsNode* tmp_action_params = tmp_action_node->params_;
-                                for (ActionParamNode* apn : *tmp_action_params->list_) {
-                                    if(action_arg_index==0) {
-                                        // if no arguments, don't synthesize action_spec
-                                        oss_replace_tmp << "\t"
-                                                        << prefix_str
-                                                        << action_name
-                                                        << "_action_spec_t "
-                                                        << action_name
-                                                        << "_action_spec;\\\n"
-                                                        << kMantisNl;                                        
-                                    }
-                                    oss_macro_tmp << ",ARG_ACTION_"
-                                                << std::to_string(action_arg_index);                                        
-                                    oss_replace_tmp << "\t"
-                                                    << action_name
-                                                    << "_action_spec.action_"
-                                                    << apn->toString()
-                                                    << "=ARG_ACTION_"
-                                                    << std::to_string(action_arg_index)
-                                                    << ";\\\n"
-                                                    << kMantisNl;
-                                    action_arg_index++;
-                                }
-                                break;
+                    ActionNode* tmp_action_node = symbols.action(action_name);
+                    if(tmp_action_node != NULL) {
+                        ActionParamsNode* tmp_action_params = tmp_action_node->params_;
+                        for (ActionParamNode* apn : *tmp_action_params->list_) {
+                            if(action_arg_index==0) {
+                                // if no arguments, don't synthesize action_spec
+                                oss_replace_tmp << "\t"
+                                                << prefix_str
+                                                << action_name
+                                                << "_action_spec_t "
+                                                << action_name
+                                                << "_action_spec;\\\n"
+                                                << kMantisNl;                                        
                             }
+                            oss_macro_tmp << ",ARG_ACTION_"
+                                        << std::to_string(action_arg_index);                                        
+                            oss_replace_tmp << "\t"
+                                            << action_name
+                                            << "_action_spec.action_"
+                                            << apn->toString()
+                                            << "=ARG_ACTION_"
+                                            << std::to_string(action_arg_index)
+                                            << ";\\\n"
+                                            << kMantisNl;
+                            action_arg_index++;
                         }
                     }
                     oss_macro_tmp << ")";
@@ -746,7 +696,7 @@ void generateMacroNonMblTable(std::vector<AstNode*> nodeArray, ostringstream& os
 }
 
 // For the user, same syntax as non-mbl table
-void generateMacroMblTable(std::vector<AstNode*> nodeArray, ostringstream& oss_preprocessor, string prefix_str, int ing_iso_opt, int egr_iso_opt, ostringstream& oss_reaction_mirror) {
+void generateMacroMblTable(const SymbolTable& symbols, ostringstream& oss_preprocessor, string prefix_str, int ing_iso_opt, int egr_iso_opt, ostringstream& oss_reaction_mirror, int num_max_alts) {
 
     // With isolation, we need an array indicating whether the handler is triggered in the dialogue for later mirroring
     if(((unsigned int)ing_iso_opt) & 0b10 || ((unsigned int)egr_iso_opt) & 0b10) {
@@ -757,456 +707,442 @@ void generateMacroMblTable(std::vector<AstNode*> nodeArray, ostringstream& oss_p
     ostringstream oss_macro_tmp;
     ostringstream oss_replace_tmp;
     // mbl table + mbl field in action is an uncommon usage, currently not supported
-    for (auto node : nodeArray) {
-        if(typeContains(node, "P4RMalleableTableNode")) {
-            TableNode* table = dynamic_cast<P4RMalleableTableNode*>(node)->table_;
-            string table_name = *(table->name_->word_);
-
-            TableActionStmtsNode* actions = table->actions_;
-            TableReadStmtsNode* reads = table->reads_;
-
-            // Mbl table always has reads
-            // Check if constains ternary match (needs priority)
-            bool with_ternary = false;
+    for (auto node : symbols.nodes().ofKind(P4R_MALLEABLE_TABLE_NODE)) {
+        TableNode* table = dynamic_cast<P4RMalleableTableNode*>(node)->table_;
+        string table_name = *(table->name_->word_);
+
+        TableActionStmtsNode* actions = table->actions_;
+        TableReadStmtsNode* reads = table->reads_;
+
+        // Mbl table always has reads
+        // Check if constains ternary match (needs priority)
+        bool with_ternary = false;
+        for (TableReadStmtNode* trs : *reads->list_) {
+            string match_field_name = trs->field_->toString();
+            TableReadStmtNode::MatchType matchType = trs->matchType_;
+            if(matchType==TableReadStmtNode::TERNARY) {
+                with_ternary = true;
+                break;
+            }
+        }                
+
+        // All operations are attached to a specific action
+        for (TableActionStmtNode* tas : *actions->list_) {
+            string action_name = *tas->name_->word_;
+            oss_replace_tmp.str("");
+            oss_macro_tmp.str("");
+            
+            ////////////////////////////////
+            // Add: declare match spec data struct
+            oss_macro_tmp << table_name
+                        << "_add_"
+                        << action_name
+                        << "(ARG_INDEX,";
+            oss_replace_tmp << prefix_str
+                            << table_name
+                            << "_match_spec_t "
+                            << table_name
+                            << "_match_spec_##ARG_INDEX;\\\n"
+                            << kMantisNl;                                   
+            int arg_index = 0;
             for (TableReadStmtNode* trs : *reads->list_) {
                 string match_field_name = trs->field_->toString();
+                std::replace(match_field_name.begin(), match_field_name.end(), '.', '_');
                 TableReadStmtNode::MatchType matchType = trs->matchType_;
-                if(matchType==TableReadStmtNode::TERNARY) {
-                    with_ternary = true;
-                    break;
-                }
-            }                
-
-            // All operations are attached to a specific action
-            for (TableActionStmtNode* tas : *actions->list_) {
-                string action_name = *tas->name_->word_;
-                oss_replace_tmp.str("");
-                oss_macro_tmp.str("");
-                
-                ////////////////////////////////
-                // Add: declare match spec data struct
-                oss_macro_tmp << table_name
-                            << "_add_"
-                            << action_name
-                            << "(ARG_INDEX,";
-                oss_replace_tmp << prefix_str
-                                << table_name
-                                << "_match_spec_t "
-                                << table_name
-                                << "_match_spec_##ARG_INDEX;\\\n"
-                                << kMantisNl;                                   
-                int arg_index = 0;
-                for (TableReadStmtNode* trs : *reads->list_) {
-                    string match_field_name = trs->field_->toString();
-                    std::replace(match_field_name.begin(), match_field_name.end(), '.', '_');
-                    TableReadStmtNode::MatchType matchType = trs->matchType_;
-                    if(arg_index == 0) {
-                        if(matchType==TableReadStmtNode::TERNARY) {
-                            oss_macro_tmp << "ARG_"
+                if(arg_index == 0) {
+                    if(matchType==TableReadStmtNode::TERNARY) {
+                        oss_macro_tmp << "ARG_"
+                                    << std::to_string(arg_index)
+                                    << ",ARG_"
+                                    << std::to_string(arg_index)
+                                    << "_MASK";
+                        oss_replace_tmp << "\t"
+                                        << table_name
+                                        << "_match_spec_##ARG_INDEX."
+                                        << match_field_name
+                                        << "=ARG_"
                                         << std::to_string(arg_index)
-                                        << ",ARG_"
+                                        << ";\\\n"
+                                        << kMantisNl;
+                        oss_replace_tmp << "\t"
+                                        << table_name
+                                        << "_match_spec_##ARG_INDEX."
+                                        << match_field_name+"_mask=ARG_"
                                         << std::to_string(arg_index)
-                                        << "_MASK";
+                                        << "_MASK;\\\n"
+                                        << kMantisNl;
+                        arg_index++;
+                    }
+                    if(matchType==TableReadStmtNode::EXACT) {
+                        // Mbl table was transformed to add exact match on vv
+                        // If the match field is the newly extended __vv
+                        if(findTblInIng(table_name, symbols) && match_field_name.compare(string(kP4rIngMetadataName)+"_"+"__vv")==0) {
                             oss_replace_tmp << "\t"
-                                            << table_name
-                                            << "_match_spec_##ARG_INDEX."
-                                            << match_field_name
-                                            << "=ARG_"
-                                            << std::to_string(arg_index)
-                                            << ";\\\n"
-                                            << kMantisNl;
+                                        << table_name
+                                        << "_match_spec_##ARG_INDEX."
+                                        << match_field_name+"="
+                                        << "__mantis__vv_ing"
+                                        << ";\\\n"
+                                        << kMantisNl;
+                            // Note programmar does not provide the argument
+                        } 
+                        else if(!findTblInIng(table_name, symbols) && match_field_name.compare(string(kP4rEgrMetadataName)+"_"+"__vv")==0) {
                             oss_replace_tmp << "\t"
-                                            << table_name
-                                            << "_match_spec_##ARG_INDEX."
-                                            << match_field_name+"_mask=ARG_"
-                                            << std::to_string(arg_index)
-                                            << "_MASK;\\\n"
-                                            << kMantisNl;
+                                        << table_name
+                                        << "_match_spec_##ARG_INDEX."
+                                        << match_field_name+"="
+                                        << "__mantis__vv_egr"
+                                        << ";\\\n"
+                                        << kMantisNl;
+                        } else {
+                            oss_replace_tmp << "\t"
+                                        << table_name
+                                        << "_match_spec_##ARG_INDEX."
+                                        << match_field_name+"=ARG_"
+                                        << std::to_string(arg_index)
+                                        << ";\\\n"
+                                        << kMantisNl; 
+                            oss_macro_tmp << ("ARG_"+std::to_string(arg_index));
                             arg_index++;
                         }
-                        if(matchType==TableReadStmtNode::EXACT) {
-                            // Mbl table was transformed to add exact match on vv
-                            // If the match field is the newly extended __vv
-                            if(findTblInIng(table_name, nodeArray) && match_field_name.compare(string(kP4rIngMetadataName)+"_"+"__vv")==0) {
-                                oss_replace_tmp << "\t"
-                                            << table_name
-                                            << "_match_spec_##ARG_INDEX."
-                                            << match_field_name+"="
-                                            << "__mantis__vv_ing"
-                                            << ";\\\n"
-                                            << kMantisNl;
-                                // Note programmar does not provide the argument
-                            } 
-                            else if(!findTblInIng(table_name, nodeArray) && match_field_name.compare(string(kP4rEgrMetadataName)+"_"+"__vv")==0) {
-                                oss_replace_tmp << "\t"
-                                            << table_name
-                                            << "_match_spec_##ARG_INDEX."
-                                            << match_field_name+"="
-                                            << "__mantis__vv_egr"
-                                            << ";\\\n"
-                                            << kMantisNl;
-                            } else {
-                                oss_replace_tmp << "\t"
-                                            << table_name
-                                            << "_match_spec_##ARG_INDEX."
-                                            << match_field_name+"=ARG_"
-                                            << std::to_string(arg_index)
-                                            << ";\\\n"
-                                            << kMantisNl; 
-                                oss_macro_tmp << ("ARG_"+std::to_string(arg_index));
-                                arg_index++;
-                            }
-                        }
-                    } else {
-                        if(matchType==TableReadStmtNode::TERNARY) {
-                            oss_macro_tmp << ",ARG_"
+                    }
+                } else {
+                    if(matchType==TableReadStmtNode::TERNARY) {
+                        oss_macro_tmp << ",ARG_"
+                                    << std::to_string(arg_index)
+                                    << ",ARG_"
+                                    << std::to_string(arg_index)
+                                    << "_MASK";
+                        oss_replace_tmp << "\t"
+                                        << table_name
+                                        << "_match_spec_##ARG_INDEX."
+                                        << match_field_name+"=ARG_"
                                         << std::to_string(arg_index)
-                                        << ",ARG_"
+                                        << ";\\\n"
+                                        << kMantisNl;
+                        oss_replace_tmp << "\t"
+                                        << table_name
+                                        << "_match_spec_##ARG_INDEX."
+                                        << match_field_name+"_mask=ARG_"
                                         << std::to_string(arg_index)
-                                        << "_MASK";
+                                        << "_MASK;\\\n"
+                                        << kMantisNl;
+                        arg_index++;
+                    }
+                    if(matchType==TableReadStmtNode::EXACT) { 
+                        if(findTblInIng(table_name, symbols) && match_field_name.compare(string(kP4rIngMetadataName)+"_"+"__vv")==0) {
                             oss_replace_tmp << "\t"
-                                            << table_name
-                                            << "_match_spec_##ARG_INDEX."
-                                            << match_field_name+"=ARG_"
-                                            << std::to_string(arg_index)
-                                            << ";\\\n"
-                                            << kMantisNl;
+                                        << table_name
+                                        << "_match_spec_##ARG_INDEX."
+                                        << match_field_name+"="
+                                        << "__mantis__vv_ing"
+                                        << ";\\\n"
+                                        << kMantisNl;
+                        } 
+                        else if(!findTblInIng(table_name, symbols) && match_field_name.compare(string(kP4rEgrMetadataName)+"_"+"__vv")==0) {
                             oss_replace_tmp << "\t"
-                                            << table_name
-                                            << "_match_spec_##ARG_INDEX."
-                                            << match_field_name+"_mask=ARG_"
-                                            << std::to_string(arg_index)
-                                            << "_MASK;\\\n"
-                                            << kMantisNl;
+                                        << table_name
+                                        << "_match_spec_##ARG_INDEX."
+                                        << match_field_name+"="
+                                        << "__mantis__vv_egr"
+                                        << ";\\\n"
+                                        << kMantisNl;
+                        } else {
+                            oss_replace_tmp << "\t"
+                                        << table_name
+                                        << "_match_spec_##ARG_INDEX."
+                                        << match_field_name+"=ARG_"
+                                        << std::to_string(arg_index)
+                                        << ";\\\n"
+                                        << kMantisNl; 
+                            oss_macro_tmp << (",ARG_"+std::to_string(arg_index));
                             arg_index++;
-                        }
-                        if(matchType==TableReadStmtNode::EXACT) { 
-                            if(findTblInIng(table_name, nodeArray) && match_field_name.compare(string(kP4rIngMetadataName)+"_"+"__vv")==0) {
-                                oss_replace_tmp << "\t"
-                                            << table_name
-                                            << "_match_spec_##ARG_INDEX."
-                                            << match_field_name+"="
-                                            << "__mantis__vv_ing"
-                                            << ";\\\n"
-                                            << kMantisNl;
-                            } 
-                            else if(!findTblInIng(table_name, nodeArray) && match_field_name.compare(string(kP4rEgrMetadataName)+"_"+"__vv")==0) {
-                                oss_replace_tmp << "\t"
-                                            << table_name
-                                            << "_match_spec_##ARG_INDEX."
-                                            << match_field_name+"="
-                                            << "__mantis__vv_egr"
-                                            << ";\\\n"
-                                            << kMantisNl;
-                            } else {
-                                oss_replace_tmp << "\t"
-                                            << table_name
-                                            << "_match_spec_##ARG_INDEX."
-                                            << match_field_name+"=ARG_"
-                                            << std::to_string(arg_index)
-                                            << ";\\\n"
-                                            << kMantisNl; 
-                                oss_macro_tmp << (",ARG_"+std::to_string(arg_index));
-                                arg_index++;
-                            }                                                           
-                        }
+                        }                                                           
                     }
                 }
-                if(with_ternary) {
-                    oss_macro_tmp << ",ARG_PRIO";
-                    oss_replace_tmp << "\tint priority_##ARG_INDEX=ARG_PRIO;\\\n"
-                                    << kMantisNl;
-                }
-                // Find the ActionNode and add action arguments
-                int action_arg_index = 0;
-                for (auto tmp_node : nodeArray) {
-                    // Currently addressing action without mbl fields
-                    if(typeContains(tmp_node, "ActionNode")) {
-                        ActionNode* tmp_action_node = dynamic_cast<ActionNode*>(tmp_node);
-                        string tmp_action_name = tmp_action_node->name_->toString();
-                        if(tmp_action_name.compare(action_name)==0) {
-                            ActionParamsNode* tmp_action_params = tmp_action_node->params_;
-                            for (ActionParamNode* apn : *tmp_action_params->list_) {
-                                if(action_arg_index==0) {
-                                    oss_replace_tmp << "\t"
-                                                    << prefix_str
-                                                    << action_name
-                                                    << "_action_spec_t "
-                                                    << "__mantis__add_"
-                                                    << action_name
-                                                    << "_action_spec_##ARG_INDEX;\\\n"
-                                                    << kMantisNl;
-                                }
-                                oss_macro_tmp << ",ARG_ACTION_"
-                                            << std::to_string(action_arg_index);
-                                oss_replace_tmp << "\t"
-                                                << "__mantis__add_"
-                                                << action_name
-                                                << "_action_spec_##ARG_INDEX.action_"
-                                                << apn->toString()
-                                                << "=ARG_ACTION_"
-                                                << std::to_string(action_arg_index)
-                                                << ";\\\n"
-                                                << kMantisNl;
-                                action_arg_index++;
-                            }
-                            break;
-                        }
+            }
+            if(with_ternary) {
+                oss_macro_tmp << ",ARG_PRIO";
+                oss_replace_tmp << "\tint priority_##ARG_INDEX=ARG_PRIO;\\\n"
+                                << kMantisNl;
+            }
+            // Find the ActionNode and add action arguments
+            int action_arg_index = 0;
+            // Currently addressing action without mbl fields
+            ActionNode* tmp_action_node = symbols.action(action_name);
+            if(tmp_action_node != NULL) {
+                ActionParamsNode* tmp_action_params = tmp_action_node->params_;
+                for (ActionParamNode* apn : *tmp_action_params->list_) {
+                    if(action_arg_index==0) {
+                        oss_replace_tmp << "\t"
+                                        << prefix_str
+                                        << action_name
+                                        << "_action_spec_t "
+                                        << "__mantis__add_"
+                                        << action_name
+                                        << "_action_spec_##ARG_INDEX;\\\n"
+                                        << kMantisNl;
                     }
-                }
-                oss_macro_tmp << ")";
-                // Finally call the entry add api
-                oss_replace_tmp << "\t__mantis__status_tmp="
-                                << prefix_str
-                                << table_name
-                                << "_table_add_with_"
-                                << action_name
-                                << "(sess_hdl,pipe_mgr_dev_tgt,&"
-                                << table_name
-                                << "_match_spec_##ARG_INDEX,priority_##ARG_INDEX,";
-                if(action_arg_index != 0) {
-                    oss_replace_tmp  << "&__mantis__add_"
-                                << action_name
-                                << "_action_spec_##ARG_INDEX,";
-                }
-                oss_replace_tmp << "&hdls["
-                                << std::to_string(num_max_alts) << "*(2*(ARG_INDEX+"
-                                << std::to_string(kHandlerOffset);
-                if(findTblInIng(table_name, nodeArray)) {
-                    oss_replace_tmp << ")+__mantis__vv_ing)]);\\\n"
-                                    << kMantisNl
-                                    << "\t"
-                                    << "__mantis__mbl_updated_ing=1;\\\n"
-                                    << kMantisNl;
-                } else {
-                    oss_replace_tmp << ")+__mantis__vv_egr]);\\\n"
-                                    << kMantisNl
-                                    << "\t"
-                                    << "__mantis__mbl_updated_egr=1;\\\n"
+                    oss_macro_tmp << ",ARG_ACTION_"
+                                << std::to_string(action_arg_index);
+                    oss_replace_tmp << "\t"
+                                    << "__mantis__add_"
+                                    << action_name
+                                    << "_action_spec_##ARG_INDEX.action_"
+                                    << apn->toString()
+                                    << "=ARG_ACTION_"
+                                    << std::to_string(action_arg_index)
+                                    << ";\\\n"
                                     << kMantisNl;
+                    action_arg_index++;
                 }
-
-                // Mirror macro, wrap it with conditionals and reset
-                oss_preprocessor << "\n#define "
-                                << "__mantis__mirror_"
-                                << oss_macro_tmp.str()
-                                << " "
-                                << "if(__mantis__indicator_hdls[ARG_INDEX+"
-                                << std::to_string(kHandlerOffset)
-                                << "]==1) {\\\n"
+            }
+            oss_macro_tmp << ")";
+            // Finally call the entry add api
+            oss_replace_tmp << "\t__mantis__status_tmp="
+                            << prefix_str
+                            << table_name
+                            << "_table_add_with_"
+                            << action_name
+                            << "(sess_hdl,pipe_mgr_dev_tgt,&"
+                            << table_name
+                            << "_match_spec_##ARG_INDEX,priority_##ARG_INDEX,";
+            if(action_arg_index != 0) {
+                oss_replace_tmp  << "&__mantis__add_"
+                            << action_name
+                            << "_action_spec_##ARG_INDEX,";
+            }
+            oss_replace_tmp << "&hdls["
+                            << std::to_string(num_max_alts) << "*(2*(ARG_INDEX+"
+                            << std::to_string(kHandlerOffset);
+            if(findTblInIng(table_name, symbols)) {
+                oss_replace_tmp << ")+__mantis__vv_ing)]);\\\n"
                                 << kMantisNl
                                 << "\t"
-                                << oss_replace_tmp.str()
-                                << "\t"
-                                << kErrorCheckStr
-                                << "\t"
-                                << "__mantis__indicator_hdls[ARG_INDEX+"
-                                << std::to_string(kHandlerOffset)
-                                << "]=0;"
-                                << kMantisNl
-                                << "\t}"
-                                << kMantisNl
-                                << "\n";
-
-                // Set the indicator array
-                oss_replace_tmp << "\t__mantis__indicator_hdls[ARG_INDEX+"
-                                << std::to_string(kHandlerOffset)
-                                << "]=1;\\\n"
+                                << "__mantis__mbl_updated_ing=1;\\\n"
                                 << kMantisNl;
-                // User macro during prepare phase
-                oss_preprocessor << "\n#define "
-                                << oss_macro_tmp.str()
-                                << " "
-                                << oss_replace_tmp.str()
-                                << "\t"
-                                << kErrorCheckStr;  
-
-                ////////////////////////////////
-                // Delete operation
-                oss_macro_tmp.str("");
-                oss_replace_tmp.str("");
-                oss_macro_tmp << table_name
-                            << "_del_"
-                            << action_name
-                            << "(ARG_INDEX)";
-                oss_replace_tmp << "\t__mantis__status_tmp="
-                                << prefix_str
-                                << table_name
-                                << "_table_delete"
-                                << "(sess_hdl,pipe_mgr_dev_tgt.device_id,hdls["
-                                << std::to_string(num_max_alts) << "*(2*(ARG_INDEX+"
-                                << std::to_string(kHandlerOffset);
-                if(findTblInIng(table_name, nodeArray)) {
-                    oss_replace_tmp << ")+__mantis__vv_ing)]);\\\n"
-                                    << kMantisNl
-                                    << "\t"
-                                    << "__mantis__mbl_updated_ing=1;\\\n"
-                                    << kMantisNl; 
-                } else {
-                    oss_replace_tmp << ")+__mantis__vv_egr]);\\\n"
-                                    << kMantisNl
-                                    << "\t"
-                                    << "__mantis__mbl_updated_egr=1;\\\n"
-                                    << kMantisNl;                 
-                }
-                // Mirror macro, wrap it with conditionals and reset
-                oss_preprocessor << "\n#define "
-                                << "__mantis__mirror_"
-                                << oss_macro_tmp.str()
-                                << " "
-                                << "if(__mantis__indicator_hdls[ARG_INDEX+"
-                                << std::to_string(kHandlerOffset)
-                                << "]==1) {\\\n"
+            } else {
+                oss_replace_tmp << ")+__mantis__vv_egr]);\\\n"
                                 << kMantisNl
                                 << "\t"
-                                << oss_replace_tmp.str()
-                                << "\t"
-                                << kErrorCheckStr
-                                << "\t"
-                                << "__mantis__indicator_hdls[ARG_INDEX+"
-                                << std::to_string(kHandlerOffset)
-                                << "]=0;"
+                                << "__mantis__mbl_updated_egr=1;\\\n"
+                                << kMantisNl;
+            }
+
+            // Mirror macro, wrap it with conditionals and reset
+            oss_preprocessor << "\n#define "
+                            << "__mantis__mirror_"
+                            << oss_macro_tmp.str()
+                            << " "
+                            << "if(__mantis__indicator_hdls[ARG_INDEX+"
+                            << std::to_string(kHandlerOffset)
+                            << "]==1) {\\\n"
+                            << kMantisNl
+                            << "\t"
+                            << oss_replace_tmp.str()
+                            << "\t"
+                            << kErrorCheckStr
+                            << "\t"
+                            << "__mantis__indicator_hdls[ARG_INDEX+"
+                            << std::to_string(kHandlerOffset)
+                            << "]=0;"
+                            << kMantisNl
+                            << "\t}"
+                            << kMantisNl
+                            << "\n";
+
+            // Set the indicator array
+            oss_replace_tmp << "\t__mantis__indicator_hdls[ARG_INDEX+"
+                            << std::to_string(kHandlerOffset)
+                            << "]=1;\\\n"
+                            << kMantisNl;
+            // User macro during prepare phase
+            oss_preprocessor << "\n#define "
+                            << oss_macro_tmp.str()
+                            << " "
+                            << oss_replace_tmp.str()
+                            << "\t"
+                            << kErrorCheckStr;  
+
+            ////////////////////////////////
+            // Delete operation
+            oss_macro_tmp.str("");
+            oss_replace_tmp.str("");
+            oss_macro_tmp << table_name
+                        << "_del_"
+                        << action_name
+                        << "(ARG_INDEX)";
+            oss_replace_tmp << "\t__mantis__status_tmp="
+                            << prefix_str
+                            << table_name
+                            << "_table_delete"
+                            << "(sess_hdl,pipe_mgr_dev_tgt.device_id,hdls["
+                            << std::to_string(num_max_alts) << "*(2*(ARG_INDEX+"
+                            << std::to_string(kHandlerOffset);
+            if(findTblInIng(table_name, symbols)) {
+                oss_replace_tmp << ")+__mantis__vv_ing)]);\\\n"
                                 << kMantisNl
-                                << "\t}"
+                                << "\t"
+                                << "__mantis__mbl_updated_ing=1;\\\n"
+                                << kMantisNl; 
+            } else {
+                oss_replace_tmp << ")+__mantis__vv_egr]);\\\n"
                                 << kMantisNl
-                                << "\n";
-
-                // Set the indicator array
-                oss_replace_tmp << "\t__mantis__indicator_hdls[ARG_INDEX+"
-                                << std::to_string(kHandlerOffset)
-                                << "]=1;\\\n"
-                                << kMantisNl;
-                // User macro during prepare phase
-                oss_preprocessor << "\n#define "
-                                << oss_macro_tmp.str()
-                                << " "
-                                << oss_replace_tmp.str()
                                 << "\t"
-                                << kErrorCheckStr;  
-
-                ////////////////////////////////
-                // Modify operation
-                oss_macro_tmp.str("");
-                oss_replace_tmp.str("");
-                oss_macro_tmp << table_name
-                            << "_mod_"
-                            << action_name
-                            << "(ARG_INDEX";
-                action_arg_index = 0;                               
-                for (auto tmp_node : nodeArray) {
-                    if(typeContains(tmp_node, "ActionNode")) {
-                        ActionNode* tmp_action_node = dynamic_cast<ActionNode*>(tmp_node);
-                        string tmp_action_name = tmp_action_node->name_->toString();
-                        if(tmp_action_name.compare(action_name)==0) {
-                            ActionParamsNode* tmp_action_params = tmp_action_node->params_;
-                            for (ActionParamNode* apn : *tmp_action_params->list_) {
-                                if(action_arg_index==0) {
-                                    oss_replace_tmp << "\t"
-                                         << prefix_str
-                                         << action_name
-                                         << "_action_spec_t "
-                                         << "__mantis__mod_"
-                                         << action_name
-                                         << "_action_spec_##ARG_INDEX;\\\n"
-                                         << kMantisNl; 
-                                }
-                                oss_macro_tmp << ",ARG_ACTION_"
-                                            << std::to_string(action_arg_index);
-                                oss_replace_tmp << "\t"
-                                                << "__mantis__mod_"
-                                                << action_name
-                                                << "_action_spec_##ARG_INDEX.action_"
-                                                << apn->toString()
-                                                << "=ARG_ACTION_"
-                                                << std::to_string(action_arg_index)
-                                                << ";\\\n"
-                                                << kMantisNl;
-                                action_arg_index += 1;
-                            }
-                            break;
-                        }
-                    }
-                }
-                oss_macro_tmp << ")";
-                // Finally call the entry modification api
-                oss_replace_tmp << "\t__mantis__status_tmp="
-                                << prefix_str
-                                << table_name
-                                << "_table_modify_with_"
-                                << action_name
-                                << "(sess_hdl,pipe_mgr_dev_tgt.device_id,hdls["
-                                << std::to_string(num_max_alts) << "*(2*(ARG_INDEX+"
-                                << std::to_string(kHandlerOffset);
-                if(findTblInIng(table_name, nodeArray)) {
-                    oss_replace_tmp << ")+__mantis__vv_ing)]";
-                    if (action_arg_index != 0) {
-                        oss_replace_tmp << ",&__mantis__mod_"
-                                    << action_name
-                                    << "_action_spec_##ARG_INDEX";
+                                << "__mantis__mbl_updated_egr=1;\\\n"
+                                << kMantisNl;                 
+            }
+            // Mirror macro, wrap it with conditionals and reset
+            oss_preprocessor << "\n#define "
+                            << "__mantis__mirror_"
+                            << oss_macro_tmp.str()
+                            << " "
+                            << "if(__mantis__indicator_hdls[ARG_INDEX+"
+                            << std::to_string(kHandlerOffset)
+                            << "]==1) {\\\n"
+                            << kMantisNl
+                            << "\t"
+                            << oss_replace_tmp.str()
+                            << "\t"
+                            << kErrorCheckStr
+                            << "\t"
+                            << "__mantis__indicator_hdls[ARG_INDEX+"
+                            << std::to_string(kHandlerOffset)
+                            << "]=0;"
+                            << kMantisNl
+                            << "\t}"
+                            << kMantisNl
+                            << "\n";
+
+            // Set the indicator array
+            oss_replace_tmp << "\t__mantis__indicator_hdls[ARG_INDEX+"
+                            << std::to_string(kHandlerOffset)
+                            << "]=1;\\\n"
+                            << kMantisNl;
+            // User macro during prepare phase
+            oss_preprocessor << "\n#define "
+                            << oss_macro_tmp.str()
+                            << " "
+                            << oss_replace_tmp.str()
+                            << "\t"
+                            << kErrorCheckStr;  
+
+            ////////////////////////////////
+            // Modify operation
+            oss_macro_tmp.str("");
+            oss_replace_tmp.str("");
+            oss_macro_tmp << table_name
+                        << "_mod_"
+                        << action_name
+                        << "(ARG_INDEX";
+            action_arg_index = 0;                               
+            tmp_action_node = symbols.action(action_name);
+            if(tmp_action_node != NULL) {
+                ActionParamsNode* tmp_action_params = tmp_action_node->params_;
+                for (ActionParamNode* apn : *tmp_action_params->list_) {
+                    if(action_arg_index==0) {
+                        oss_replace_tmp << "\t"
+                             << prefix_str
+                             << action_name
+                             << "_action_spec_t "
+                             << "__mantis__mod_"
+                             << action_name
+                             << "_action_spec_##ARG_INDEX;\\\n"
+                             << kMantisNl; 
                     }
-                    oss_replace_tmp << ");\\\n"
-                                    << kMantisNl
-                                    << "\t"
-                                    << "__mantis__mbl_updated_ing=1;\\\n"
-                                    << kMantisNl;
-                } else {
-                    oss_replace_tmp << ")+__mantis__vv_egr]";
-                    if (action_arg_index != 0) {
-                        oss_replace_tmp << ",&__mantis__mod_"
+                    oss_macro_tmp << ",ARG_ACTION_"
+                                << std::to_string(action_arg_index);
+                    oss_replace_tmp << "\t"
+                                    << "__mantis__mod_"
                                     << action_name
-                                    << "_action_spec_##ARG_INDEX";
-                    }
-                    oss_replace_tmp << ");\\\n"
-                                    << kMantisNl
-                                    << "\t"
-                                    << "__mantis__mbl_updated_egr=1;\\\n"
+                                    << "_action_spec_##ARG_INDEX.action_"
+                                    << apn->toString()
+                                    << "=ARG_ACTION_"
+                                    << std::to_string(action_arg_index)
+                                    << ";\\\n"
                                     << kMantisNl;
+                    action_arg_index += 1;
                 }
-                                
-
-                // Mirror macro, wrap it with conditionals and reset
-                oss_preprocessor << "\n#define "
-                                << "__mantis__mirror_"
-                                << oss_macro_tmp.str()
-                                << " "
-                                << "if(__mantis__indicator_hdls[ARG_INDEX+"
-                                << std::to_string(kHandlerOffset)
-                                << "]==1) {\\\n"
+            }
+            oss_macro_tmp << ")";
+            // Finally call the entry modification api
+            oss_replace_tmp << "\t__mantis__status_tmp="
+                            << prefix_str
+                            << table_name
+                            << "_table_modify_with_"
+                            << action_name
+                            << "(sess_hdl,pipe_mgr_dev_tgt.device_id,hdls["
+                            << std::to_string(num_max_alts) << "*(2*(ARG_INDEX+"
+                            << std::to_string(kHandlerOffset);
+            if(findTblInIng(table_name, symbols)) {
+                oss_replace_tmp << ")+__mantis__vv_ing)]";
+                if (action_arg_index != 0) {
+                    oss_replace_tmp << ",&__mantis__mod_"
+                                << action_name
+                                << "_action_spec_##ARG_INDEX";
+                }
+                oss_replace_tmp << ");\\\n"
                                 << kMantisNl
                                 << "\t"
-                                << oss_replace_tmp.str()
-                                << "\t"
-                                << kErrorCheckStr
-                                << "\t"
-                                << "__mantis__indicator_hdls[ARG_INDEX+"
-                                << std::to_string(kHandlerOffset)
-                                << "]=0;"
-                                << kMantisNl
-                                << "\t}"
-                                << kMantisNl
-                                << "\n";
-
-                // Set the indicator array
-                oss_replace_tmp << "\t__mantis__indicator_hdls[ARG_INDEX+"
-                                << std::to_string(kHandlerOffset)
-                                << "]=1;\\\n"
+                                << "__mantis__mbl_updated_ing=1;\\\n"
                                 << kMantisNl;
-                // User macro during prepare phase
-                oss_preprocessor << "\n#define "
-                                << oss_macro_tmp.str()
-                                << " "
-                                << oss_replace_tmp.str()
+            } else {
+                oss_replace_tmp << ")+__mantis__vv_egr]";
+                if (action_arg_index != 0) {
+                    oss_replace_tmp << ",&__mantis__mod_"
+                                << action_name
+                                << "_action_spec_##ARG_INDEX";
+                }
+                oss_replace_tmp << ");\\\n"
+                                << kMantisNl
                                 << "\t"
-                                << kErrorCheckStr;  
-            }   
-        }
+                                << "__mantis__mbl_updated_egr=1;\\\n"
+                                << kMantisNl;
+            }
+                            
+
+            // Mirror macro, wrap it with conditionals and reset
+            oss_preprocessor << "\n#define "
+                            << "__mantis__mirror_"
+                            << oss_macro_tmp.str()
+                            << " "
+                            << "if(__mantis__indicator_hdls[ARG_INDEX+"
+                            << std::to_string(kHandlerOffset)
+                            << "]==1) {\\\n"
+                            << kMantisNl
+                            << "\t"
+                            << oss_replace_tmp.str()
+                            << "\t"
+                            << kErrorCheckStr
+                            << "\t"
+                            << "__mantis__indicator_hdls[ARG_INDEX+"
+                            << std::to_string(kHandlerOffset)
+                            << "]=0;"
+                            << kMantisNl
+                            << "\t}"
+                            << kMantisNl
+                            << "\n";
+
+            // Set the indicator array
+            oss_replace_tmp << "\t__mantis__indicator_hdls[ARG_INDEX+"
+                            << std::to_string(kHandlerOffset)
+                            << "]=1;\\\n"
+                            << kMantisNl;
+            // User macro during prepare phase
+            oss_preprocessor << "\n#define "
+                            << oss_macro_tmp.str()
+                            << " "
+                            << oss_replace_tmp.str()
+                            << "\t"
+                            << kErrorCheckStr;  
+        }   
     }
 
 }
 
 // Generate mantis-syntax single mbl mod macros and __mantis__add_vars_ing, __mantis__mod_vars_ing, __mantis__add_vars_egr, __mantis__mod_vars_egr
-void generateMacroInitMblsForIng(std::vector<AstNode*> nodeArray, unordered_map<string, int>* mblUsages, ostringstream& oss_mbl_init, ostringstream& oss_reaction_mirror, 
-                             ostringstream& oss_preprocessor, int num_mbls, int iso_opt, string prefix_str, bool forIng) {
+void generateMacroInitMblsForIng(const NodeRegistry& nodeArray, unordered_map<string, int>* mblUsages, ostringstream& oss_mbl_init, ostringstream& oss_reaction_mirror, 
+                             ostringstream& oss_preprocessor, int num_mbls, int iso_opt, string prefix_str, bool forIng, int num_max_alts) {
 
     // Both the same for monolithic master init table (even with update isolation)
     ostringstream oss_replace_mantis_add_vars;
@@ -1306,7 +1242,7 @@ void generateMacroInitMblsForIng(std::vector<AstNode*> nodeArray, unordered_map<
     // Assign init value calling the macro
     // Synthesize mantis_mod_var macro along the way
     for (auto n : nodeArray) {
-        if (typeContains(n, "P4RMalleableValueNode")) {
+        if (n->isKind(P4R_MALLEABLE_VALUE_NODE)) {
             auto v = dynamic_cast<P4RMalleableValueNode*>(n);
             string var_name = *v->name_->word_;
 
@@ -1402,7 +1338,7 @@ void generateMacroInitMblsForIng(std::vector<AstNode*> nodeArray, unordered_map<
             } else {
                 PANIC("Invalid usage of %s\n", var_name.c_str());
             }
-        } else if (typeContains(n, "P4RMalleableFieldNode")) {
+        } else if (n->isKind(P4R_MALLEABLE_FIELD_NODE)) {
             auto v = dynamic_cast<P4RMalleableFieldNode*>(n);
             string var_name = *v->name_->word_;
 
@@ -1589,10 +1525,10 @@ void generateMacroInitMblsForIng(std::vector<AstNode*> nodeArray, unordered_map<
     }                             
 }
 
-void generateHdlPool(std::vector<AstNode*> nodeArray, ostringstream& oss_mbl_init, int ing_iso_opt, int egr_iso_opt) {
+void generateHdlPool(const NodeRegistry& nodeArray, ostringstream& oss_mbl_init, int ing_iso_opt, int egr_iso_opt, int* num_max_alts) {
     // Max number of alts
     for (auto n : nodeArray) {
-        if (typeContains(n, "P4RMalleableFieldNode")) {
+        if (n->isKind(P4R_MALLEABLE_FIELD_NODE)) {
             auto v = dynamic_cast<P4RMalleableFieldNode*>(n);
 
             string var_name = *v->name_->word_;
@@ -1603,8 +1539,8 @@ void generateHdlPool(std::vector<AstNode*> nodeArray, ostringstream& oss_mbl_ini
                 num_alt += 1;
             }
             PRINT_VERBOSE("Number of alts for %s: %d \n", var_name.c_str(), num_alt);
-            if(num_alt > num_max_alts) {
-                num_max_alts = num_alt;
+            if(num_alt > *num_max_alts) {
+                *num_max_alts = num_alt;
             }            
        }
     }
@@ -1620,7 +1556,7 @@ void generateHdlPool(std::vector<AstNode*> nodeArray, ostringstream& oss_mbl_ini
     //              << ");\n\n";
 }
 
-void generatePrologueEnd(std::vector<AstNode*> nodeArray, ostringstream& oss_init_end, int ing_iso_opt, int egr_iso_opt) {
+void generatePrologueEnd(const UserCode& initCode, ostringstream& oss_init_end, int ing_iso_opt, int egr_iso_opt) {
 
     oss_init_end << "  __mantis__add_vars_ing;\n";
     oss_init_end << "  __mantis__add_vars_egr;\n";
@@ -1633,73 +1569,11 @@ void generatePrologueEnd(std::vector<AstNode*> nodeArray, ostringstream& oss_ini
         oss_init_end << "\n  __mantis__flip_vv_egr;\n\n";
     }    
 
-    P4RInitBlockNode * init_node = findInitBlock(nodeArray);
-    string p4r_init_user_str = "";
-    if (init_node != 0) {
-        p4r_init_user_str = init_node->body_->toString();
-    }
-
-    for (auto node : nodeArray) {
-        // For each mbl table
-        if(typeContains(node, "P4RMalleableTableNode")) {
-            TableNode* table = dynamic_cast<P4RMalleableTableNode*>(node)->table_;
-            string table_name = *(table->name_->word_);
-
-            // Whenever mbl table(s) present, isolation required
-
-            TableActionStmtsNode* actions = table->actions_;
-
-            // Mbl tables are always with With matches (at least match on __vv)
-            // For each action
-            for (TableActionStmtNode* tas : *actions->list_) {
-                string action_name = *tas->name_->word_;
-
-                string str_prepare_macro_func;
-                string str_mirror_macro_func;
-
-                std::smatch result;
-
-                // Construct match regrex for add
-                str_prepare_macro_func = table_name + "_add_" + action_name;
-                std::regex e_add (str_prepare_macro_func+"\\s*\\("+"([^\\)]*)"+"\\)");   // matches words beginning by "sub"
-
-                // Stop after first match
-                while (std::regex_search (p4r_init_user_str, result, e_add)) {
-                    
-                    str_prepare_macro_func = result[0];
-                    str_mirror_macro_func = "__mantis__mirror_" + str_prepare_macro_func;
-                    // Call corresponding mirror macros
-                    oss_init_end << "\n  "
-                                        << str_mirror_macro_func
-                                        << ";\n\n";
-
-                    // Search remaining string of p4r_reaction_user_str
-                    p4r_init_user_str = result.suffix().str();
-                }
-                // Mod
-                str_prepare_macro_func = table_name + "_mod_" + action_name;
-                std::regex e_mod (str_prepare_macro_func+"\\s*\\("+"([^\\)]*)"+"\\)");   // matches words beginning by "sub"
-                while (std::regex_search (p4r_init_user_str, result, e_mod)) {
-                    str_prepare_macro_func = result[0];
-                    str_mirror_macro_func = "__mantis__mirror_" + str_prepare_macro_func;
-                    oss_init_end << "\n  "
-                                        << str_mirror_macro_func
-                                        << ";\n\n";
-                    p4r_init_user_str = result.suffix().str();
-                }
-                // Del
-                str_prepare_macro_func = table_name + "_del_" + action_name;
-                std::regex e_del (str_prepare_macro_func+"\\s*\\("+"([^\\)]*)"+"\\)");   // matches words beginning by "sub"
-                while (std::regex_search (p4r_init_user_str, result, e_del)) {
-                    str_prepare_macro_func = result[0];
-                    str_mirror_macro_func = "__mantis__mirror_" + str_prepare_macro_func;
-                    oss_init_end << "\n  "
-                                << str_mirror_macro_func
-                                << ";\n\n";
-                    p4r_init_user_str = result.suffix().str();
-                }
-            }   
-        }
+    // Under isolation, call mirror macros to mirror shallow copies for mbl table operations
+    for (const string& call : initCode.tableCalls) {
+        oss_init_end << "\n  "
+                     << "__mantis__mirror_" << call
+                     << ";\n\n";
     }
 
     // Point __vv back to working copy for dialogue
@@ -1712,7 +1586,7 @@ void generatePrologueEnd(std::vector<AstNode*> nodeArray, ostringstream& oss_ini
 }
 
 
-void generateDialogueEnd(std::vector<AstNode*> nodeArray, ostringstream& oss_reaction_update, int ing_iso_opt, int egr_iso_opt) {
+void generateDialogueEnd(const UserCode& reactionCode, ostringstream& oss_reaction_update, int ing_iso_opt, int egr_iso_opt) {
 
     // __vv points to shallow copy under isolation, now update version bit commit together with other mbls)
     oss_reaction_update << "\n  __mantis__mod_vars_ing;\n";
@@ -1727,73 +1601,11 @@ void generateDialogueEnd(std::vector<AstNode*> nodeArray, ostringstream& oss_rea
     }
 
     // Under isolation, call mirror macros to mirror shallow copies for mbl table operations
-    // Get the reaction string and find all user macros
-    P4RReactionNode * react_node = findReaction(nodeArray);
-    string p4r_reaction_user_str = "";
-    if (react_node != 0) {
-        p4r_reaction_user_str = react_node->body_->toString();
-    }
-
     // No need to check isolation opt and ing/egr, just mirror user-specified operations in prepare
-    for (auto node : nodeArray) {
-        // For each mbl table
-        if(typeContains(node, "P4RMalleableTableNode")) {
-            TableNode* table = dynamic_cast<P4RMalleableTableNode*>(node)->table_;
-            string table_name = *(table->name_->word_);
-
-            TableActionStmtsNode* actions = table->actions_;
-
-            // Mbl tables are always with With matches (at least match on __vv)
-            // For each action
-            for (TableActionStmtNode* tas : *actions->list_) {
-                string action_name = *tas->name_->word_;
-
-                string str_prepare_macro_func;
-                string str_mirror_macro_func;
-
-                std::smatch result;
-
-                // Construct match regrex for add
-                str_prepare_macro_func = table_name + "_add_" + action_name;
-                std::regex e_add (str_prepare_macro_func+"\\s*\\("+"([^\\)]*)"+"\\)");   // matches words beginning by "sub"
-
-                // Stop after first match
-                while (std::regex_search (p4r_reaction_user_str, result, e_add)) {
-                    
-                    str_prepare_macro_func = result[0];
-                    str_mirror_macro_func = "__mantis__mirror_" + str_prepare_macro_func;
-                    // Call corresponding mirror macros
-                    oss_reaction_update << "\n  "
-                                        << str_mirror_macro_func
-                                        << ";\n\n";
-
-                    // Search remaining string of p4r_reaction_user_str
-                    p4r_reaction_user_str = result.suffix().str();
-                }
-                // Mod
-                str_prepare_macro_func = table_name + "_mod_" + action_name;
-                std::regex e_mod (str_prepare_macro_func+"\\s*\\("+"([^\\)]*)"+"\\)");   // matches words beginning by "sub"
-                while (std::regex_search (p4r_reaction_user_str, result, e_mod)) {
-                    str_prepare_macro_func = result[0];
-                    str_mirror_macro_func = "__mantis__mirror_" + str_prepare_macro_func;
-                    oss_reaction_update << "\n  "
-                                        << str_mirror_macro_func
-                                        << ";\n\n";
-                    p4r_reaction_user_str = result.suffix().str();
-                }
-                // Del
-                str_prepare_macro_func = table_name + "_del_" + action_name;
-                std::regex e_del (str_prepare_macro_func+"\\s*\\("+"([^\\)]*)"+"\\)");   // matches words beginning by "sub"
-                while (std::regex_search (p4r_reaction_user_str, result, e_del)) {
-                    str_prepare_macro_func = result[0];
-                    str_mirror_macro_func = "__mantis__mirror_" + str_prepare_macro_func;
-                    oss_reaction_update << "\n  "
-                                        << str_mirror_macro_func
-                                        << ";\n\n";
-                    p4r_reaction_user_str = result.suffix().str();
-                }
-            }   
-        }
+    for (const string& call : reactionCode.tableCalls) {
+        oss_reaction_update << "\n  "
+                            << "__mantis__mirror_" << call
+                            << ";\n\n";
     }
 
     // Point __vv back to working copy for next dialogue
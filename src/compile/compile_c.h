@@ -19,35 +19,41 @@
 #include <unordered_map>
 #include <vector>
 
-void extractReactionMacro(std::vector<AstNode*> nodeArray, ostringstream& oss_preprocessor, string out_fn_base);
+#include "c_scanner.h"
+#include "macro_expander.h"
 
-UnanchoredNode* generatePrologueNode(std::vector<AstNode*> nodeArray, ostringstream& oss_variable_init, ostringstream& oss_init_end);
+UnanchoredNode* generateHeaderNode(const NodeRegistry& nodeArray);
 
-UnanchoredNode* generateDialogueNode(std::vector<AstNode*> nodeArray, ostringstream& oss_reaction_start, ostringstream& oss_reaction_end);
+UnanchoredNode* generatePrologueNode(const MacroExpander& macros, const UserCode& initCode, const string& mbl_init, const string& init_end);
 
-UnanchoredNode * generateMacroNode(ostringstream& oss_preprocessor);
+UnanchoredNode* generateDialogueNode(const MacroExpander& macros, const UserCode& reactionCode, const string& reaction_mirror, const string& reaction_update);
 
-void mirrorFieldArg(std::vector<AstNode*> nodeArray, ostringstream& oss_reaction_start, 
+UserCode rewriteInitBlock(const NodeRegistry& nodeArray);
+
+UserCode rewriteReaction(const NodeRegistry& nodeArray);
+
+void mirrorFieldArg(const NodeRegistry& nodeArray, ostringstream& oss_reaction_start, 
                     ostringstream& oss_preprocessor, vector<ReactionArgBin> bins,
-                    string prefix_str, bool forIng);
+                    string prefix_str, bool forIng, bool paired);
 
-void mirrorRegisterArgForIng(std::vector<AstNode*> nodeArray, ostringstream& oss_reaction_start, int iso_opt, string prefix_str, bool forIng);
+void mirrorRegisterArgForIng(const SymbolTable& symbols, ostringstream& oss_reaction_start, int iso_opt, string prefix_str, bool forIng,
+                             bool singleReplica, int dirtyBlock);
 
 void generateMacroXorVersionBits(ostringstream& oss_reaction_start, ostringstream& oss_preprocessor, int ing_iso_opt, int egr_iso_opt);
 
 void generateDialogueArgStart(ostringstream& oss_reaction_start, int ing_iso_opt, int egr_iso_opt);
 
-void generateMacroNonMblTable(std::vector<AstNode*> nodeArray, ostringstream& oss_preprocessor, string prefix_str);
+void generateMacroNonMblTable(const SymbolTable& symbols, ostringstream& oss_preprocessor, string prefix_str, int num_max_alts);
 
-void generateMacroMblTable(std::vector<AstNode*> nodeArray, ostringstream& oss_preprocessor, string prefix_str, int ing_iso_opt, int egr_iso_opt, ostringstream& oss_reaction_mirror);
+void generateMacroMblTable(const SymbolTable& symbols, ostringstream& oss_preprocessor, string prefix_str, int ing_iso_opt, int egr_iso_opt, ostringstream& oss_reaction_mirror, int num_max_alts);
 
-void generateMacroInitMblsForIng(std::vector<AstNode*> nodeArray, unordered_map<string, int>* mblUsages, ostringstream& oss_variable_init, ostringstream& oss_reaction_start, 
-                             ostringstream& oss_preprocessor, int num_vars, int iso_opt, string prefix_str, bool forIng);
+void generateMacroInitMblsForIng(const NodeRegistry& nodeArray, unordered_map<string, int>* mblUsages, ostringstream& oss_variable_init, ostringstream& oss_reaction_start, 
+                             ostringstream& oss_preprocessor, int num_vars, int iso_opt, string prefix_str, bool forIng, int num_max_alts);
 
-void generateHdlPool(std::vector<AstNode*> nodeArray, ostringstream& oss_mbl_init, int ing_iso_opt, int egr_iso_opt);
+void generateHdlPool(const NodeRegistry& nodeArray, ostringstream& oss_mbl_init, int ing_iso_opt, int egr_iso_opt, int* num_max_alts);
 
-void generatePrologueEnd(std::vector<AstNode*> nodeArray, ostringstream& oss_init_end, int ing_iso_opt, int egr_iso_opt);
+void generatePrologueEnd(const UserCode& initCode, ostringstream& oss_init_end, int ing_iso_opt, int egr_iso_opt);
 
-void generateDialogueEnd(std::vector<AstNode*> nodeArray, ostringstream& oss_reaction_end, int ing_iso_opt, int egr_iso_opt);
+void generateDialogueEnd(const UserCode& reactionCode, ostringstream& oss_reaction_end, int ing_iso_opt, int egr_iso_opt);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,106 @@
+/* Copyright 2020-present University of Pennsylvania
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fstream>
+#include <unordered_map>
+
+#include "../../include/compile_cache.h"
+
+using namespace std;
+
+static const char* kCacheHeader = "# mantis compile cache 1";
+
+static string packedArgsStr(const PackedArgs& args) {
+    string ret;
+    for (auto& arg : args) {
+        ret += (ret.empty() ? "" : " ") + arg.first + ":" + to_string(arg.second);
+    }
+    return ret;
+}
+
+CompileCache::CompileCache(const CompileMetadata& meta) {
+    facts_.emplace_back("p4_hash", meta.p4Hash_);
+    facts_.emplace_back("ing_iso_opt", to_string(meta.ingIsoOpt_));
+    facts_.emplace_back("egr_iso_opt", to_string(meta.egrIsoOpt_));
+    facts_.emplace_back("num_init_mbls_ing", to_string(meta.numInitMblsIng_));
+    facts_.emplace_back("num_init_mbls_egr", to_string(meta.numInitMblsEgr_));
+    facts_.emplace_back("num_max_alts", to_string(meta.numMaxAlts_));
+    for (auto& usage : meta.mblUsages_) {
+        facts_.emplace_back("mbl_usage." + usage.first, to_string(usage.second));
+    }
+    for (size_t i = 0; i < meta.ingBins_.size(); i++) {
+        facts_.emplace_back("ing_bin." + to_string(i), packedArgsStr(meta.ingBins_[i]));
+    }
+    for (size_t i = 0; i < meta.egrBins_.size(); i++) {
+        facts_.emplace_back("egr_bin." + to_string(i), packedArgsStr(meta.egrBins_[i]));
+    }
+}
+
+bool CompileCache::load(const string& path) {
+    ifstream is(path);
+    string line;
+    if (!getline(is, line) || line != kCacheHeader) {
+        return false;
+    }
+    facts_.clear();
+    while (getline(is, line)) {
+        size_t space = line.find(' ');
+        if (space == string::npos) {
+            facts_.emplace_back(line, "");
+        } else {
+            facts_.emplace_back(line.substr(0, space), line.substr(space + 1));
+        }
+    }
+    return true;
+}
+
+bool CompileCache::save(const string& path) const {
+    ofstream os(path);
+    os << kCacheHeader << "\n";
+    for (auto& fact : facts_) {
+        os << fact.first << " " << fact.second << "\n";
+    }
+    os.close();
+    return !os.fail();
+}
+
+string CompileCache::p4Hash() const {
+    for (auto& fact : facts_) {
+        if (fact.first == "p4_hash") {
+            return fact.second;
+        }
+    }
+    return "";
+}
+
+vector<string> CompileCache::changesFrom(const CompileCache& old) const {
+    unordered_map<string, string> oldFacts(old.facts_.begin(), old.facts_.end());
+    unordered_map<string, string> newFacts(facts_.begin(), facts_.end());
+    vector<string> ret;
+    for (auto& fact : facts_) {
+        auto it = oldFacts.find(fact.first);
+        if (it == oldFacts.end()) {
+            ret.push_back(fact.first + ": (none) -> " + fact.second);
+        } else if (it->second != fact.second) {
+            ret.push_back(fact.first + ": " + it->second + " -> " + fact.second);
+        }
+    }
+    for (auto& fact : old.facts_) {
+        if (newFacts.find(fact.first) == newFacts.end()) {
+            ret.push_back(fact.first + ": " + fact.second + " -> (none)");
+        }
+    }
+    return ret;
+}
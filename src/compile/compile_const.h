@@ -30,16 +30,24 @@ const char* const kP4rEgrMetadataType = "__P4REgrMeta_t";
 const char* const kP4rEgrMetadataName = "__P4REgrMeta";
 const char* const kP4rRegReplicasSuffix0 = "__P4Rreplicas0";
 const char* const kP4rRegReplicasSuffix1 = "__P4Rreplicas1";
+const char* const kP4rRegReplicasSuffix = "__P4Rreplicas";
 const char* const kP4rRegReplicasTablePrefix = "__tr__";
 const char* const kP4rRegReplicasBlackboxPrefix = "__br__";
 const char* const kP4rRegReplicasActionPrefix = "__ar__";
+const char* const kP4rRegReplicasFlPrefix = "__flr__";
+const char* const kP4rRegReplicasFlcPrefix = "__flcr__";
 const char* const kP4rIngRegMetadataType = "__P4RIngRegMeta_t";
 const char* const kP4rIngRegMetadataName = "__P4RIngRegMeta";
 const char* const kP4rEgrRegMetadataType = "__P4REgrRegMeta_t";
 const char* const kP4rEgrRegMetadataName = "__P4REgrRegMeta";
 const char* const kP4rRegMetadataOutputSuffix = "__output";
+const char* const kP4rRegMetadataOutputHiSuffix = "__output_hi";
 const char* const kP4rRegMetadataIndexSuffix = "__index";
+const char* const kP4rRegMetadataBlockSuffix = "__block";
+const char* const kP4rRegDirtySuffix = "__P4Rdirty";
+const char* const kP4rRegVersionSuffix = "__P4Rversion";
 const char* const kP4rIndexSuffix = "__alt";
+const char* const kP4rSelectSuffix = "__sel";
 const char* const kP4rIngInitAction= "__aiSetVars";
 const char* const kP4rEgrInitAction= "__aeSetVars";
 const char* const kP4rIngArghdrType = "__packedIngArgs_t";
@@ -97,7 +105,7 @@ R"(
   }
 )";
 
-// For 32b reg arg only
+// For 32b reg args, kRegArgIsoMirrorT_64 below mirrors 64b ones
 // %1%: reg arg name
 // %2%: reg arg width
 // %3%: reg arg size
@@ -137,6 +145,272 @@ R"(
   }
 )";
 
+// Same as kRegArgIsoMirrorT for the single replica, entry (i << 1) | mv
+// mirrors item i for mv
+const char * const kRegArgIsoMirrorSingleT =
+R"(
+  // Mirror %1%
+  uint%2%_t %1%[%3%];
+  static uint32_t %1%__tstamp__P4Rreplicas[2*%3%];
+  %4%%1%__P4Rreplicas_value_t __mantis__values_%1%__P4Rreplicas[8*%3%];
+  __mantis__status_tmp = %4%register_range_read_%1%__P4Rreplicas(sess_hdl, pipe_mgr_dev_tgt, 0, 2*%5%, __mantis__reg_flags, &__mantis__num_actually_read, __mantis__values_%1%__P4Rreplicas, &__mantis__value_count);
+  if(__mantis__status_tmp!=0) {
+    return false;
+  }
+  for (__mantis__i=0; __mantis__i < %5%; __mantis__i++) {
+    int __mantis__entry = (__mantis__i << 1) | %6%;
+    if(__mantis__values_%1%__P4Rreplicas[1+__mantis__entry*2].f0 > %1%__tstamp__P4Rreplicas[__mantis__entry]) {
+      %1%[__mantis__i] = __mantis__values_%1%__P4Rreplicas[1+__mantis__entry*2].f1;
+      %1%__tstamp__P4Rreplicas[__mantis__entry] = __mantis__values_%1%__P4Rreplicas[1+__mantis__entry*2].f0;
+    }
+  }
+)";
+
+// Same as kRegArgIsoMirrorT, reading only the blocks whose dirty bit is set
+// for the mv, the bit is cleared as the mv replicas are idle.  The mirror
+// keeps the values of the clean blocks from the last dialogues.
+// %7%: entries per block
+// %8%: number of blocks
+const char * const kRegArgIsoMirrorDirtyT =
+R"(
+  // Mirror %1%
+  static uint%2%_t %1%[%3%];
+  static uint32_t %1%__tstamp__P4Rreplicas0[%3%];
+  static uint32_t %1%__tstamp__P4Rreplicas1[%3%];
+  uint8_t __mantis__dirty_%1%[8*%8%];
+  __mantis__status_tmp = %4%register_range_read_%1%__P4Rdirty(sess_hdl, pipe_mgr_dev_tgt, 0, 2*%8%, __mantis__reg_flags, &__mantis__num_actually_read, __mantis__dirty_%1%, &__mantis__value_count);
+  if(__mantis__status_tmp!=0) {
+    return false;
+  }
+  %4%%1%__P4Rreplicas0_value_t __mantis__values_%1%[4*%7%];
+  uint32_t* __mantis__tstamp_%1% = %6%==0 ? %1%__tstamp__P4Rreplicas0 : %1%__tstamp__P4Rreplicas1;
+  for (int __mantis__b=0; __mantis__b*%7% < %5%; __mantis__b++) {
+    int __mantis__bit = (__mantis__b << 1) | %6%;
+    if(__mantis__dirty_%1%[1+__mantis__bit*2]==0) {
+      continue;
+    }
+    uint8_t __mantis__clean = 0;
+    __mantis__status_tmp = %4%register_write_%1%__P4Rdirty(sess_hdl, pipe_mgr_dev_tgt, __mantis__bit, &__mantis__clean);
+    if(__mantis__status_tmp!=0) {
+      return false;
+    }
+    int __mantis__first = __mantis__b*%7%;
+    int __mantis__count = %5%-__mantis__first < %7% ? %5%-__mantis__first : %7%;
+    if(%6%==0) {
+      __mantis__status_tmp = %4%register_range_read_%1%__P4Rreplicas0(sess_hdl, pipe_mgr_dev_tgt, __mantis__first, __mantis__count, __mantis__reg_flags, &__mantis__num_actually_read, __mantis__values_%1%, &__mantis__value_count);
+    } else {
+      __mantis__status_tmp = %4%register_range_read_%1%__P4Rreplicas1(sess_hdl, pipe_mgr_dev_tgt, __mantis__first, __mantis__count, __mantis__reg_flags, &__mantis__num_actually_read, __mantis__values_%1%, &__mantis__value_count);
+    }
+    if(__mantis__status_tmp!=0) {
+      return false;
+    }
+    for (__mantis__i=0; __mantis__i < __mantis__count; __mantis__i++) {
+      if(__mantis__values_%1%[1+__mantis__i*2].f0 > __mantis__tstamp_%1%[__mantis__first+__mantis__i]) {
+        %1%[__mantis__first+__mantis__i] = __mantis__values_%1%[1+__mantis__i*2].f1;
+        __mantis__tstamp_%1%[__mantis__first+__mantis__i] = __mantis__values_%1%[1+__mantis__i*2].f0;
+      }
+    }
+  }
+)";
+
+// Same as kRegArgIsoMirrorDirtyT for the single replica
+const char * const kRegArgIsoMirrorSingleDirtyT =
+R"(
+  // Mirror %1%
+  static uint%2%_t %1%[%3%];
+  static uint32_t %1%__tstamp__P4Rreplicas[2*%3%];
+  uint8_t __mantis__dirty_%1%[8*%8%];
+  __mantis__status_tmp = %4%register_range_read_%1%__P4Rdirty(sess_hdl, pipe_mgr_dev_tgt, 0, 2*%8%, __mantis__reg_flags, &__mantis__num_actually_read, __mantis__dirty_%1%, &__mantis__value_count);
+  if(__mantis__status_tmp!=0) {
+    return false;
+  }
+  %4%%1%__P4Rreplicas_value_t __mantis__values_%1%__P4Rreplicas[8*%7%];
+  for (int __mantis__b=0; __mantis__b*%7% < %5%; __mantis__b++) {
+    int __mantis__bit = (__mantis__b << 1) | %6%;
+    if(__mantis__dirty_%1%[1+__mantis__bit*2]==0) {
+      continue;
+    }
+    uint8_t __mantis__clean = 0;
+    __mantis__status_tmp = %4%register_write_%1%__P4Rdirty(sess_hdl, pipe_mgr_dev_tgt, __mantis__bit, &__mantis__clean);
+    if(__mantis__status_tmp!=0) {
+      return false;
+    }
+    int __mantis__first = __mantis__b*%7%;
+    int __mantis__count = %5%-__mantis__first < %7% ? %5%-__mantis__first : %7%;
+    __mantis__status_tmp = %4%register_range_read_%1%__P4Rreplicas(sess_hdl, pipe_mgr_dev_tgt, __mantis__first << 1, 2*__mantis__count, __mantis__reg_flags, &__mantis__num_actually_read, __mantis__values_%1%__P4Rreplicas, &__mantis__value_count);
+    if(__mantis__status_tmp!=0) {
+      return false;
+    }
+    for (__mantis__i=0; __mantis__i < __mantis__count; __mantis__i++) {
+      int __mantis__entry = (__mantis__i << 1) | %6%;
+      int __mantis__item = __mantis__first+__mantis__i;
+      if(__mantis__values_%1%__P4Rreplicas[1+__mantis__entry*2].f0 > %1%__tstamp__P4Rreplicas[(__mantis__item << 1) | %6%]) {
+        %1%[__mantis__item] = __mantis__values_%1%__P4Rreplicas[1+__mantis__entry*2].f1;
+        %1%__tstamp__P4Rreplicas[(__mantis__item << 1) | %6%] = __mantis__values_%1%__P4Rreplicas[1+__mantis__entry*2].f0;
+      }
+    }
+  }
+)";
+
+// 64b reg args, the replicas hold both halves of the value, f0 the hi and
+// f1 the lo half, and their version registers count its updates.  Same
+// parameters as the templates for 32b reg args, %2% is not used.
+const char * const kRegArgIsoMirrorT_64 =
+R"(
+  // Mirror %1%
+  static %4%%1%_value_t %1%[%3%];
+  static uint32_t %1%__tstamp__P4Rreplicas0[%3%];
+  static uint32_t %1%__tstamp__P4Rreplicas1[%3%];
+  %4%%1%__P4Rreplicas0_value_t __mantis__values_%1%[4*%3%];
+  uint32_t __mantis__versions_%1%[4*%3%];
+  uint32_t* __mantis__tstamp_%1% = %1%__tstamp__P4Rreplicas0;
+  if(%6%==0) {
+    __mantis__status_tmp = %4%register_range_read_%1%__P4Rreplicas0(sess_hdl, pipe_mgr_dev_tgt, 0, %5%, __mantis__reg_flags, &__mantis__num_actually_read, __mantis__values_%1%, &__mantis__value_count);
+    if(__mantis__status_tmp!=0) {
+      return false;
+    }
+    __mantis__status_tmp = %4%register_range_read_%1%__P4Rreplicas0__P4Rversion(sess_hdl, pipe_mgr_dev_tgt, 0, %5%, __mantis__reg_flags, &__mantis__num_actually_read, __mantis__versions_%1%, &__mantis__value_count);
+  } else {
+    __mantis__status_tmp = %4%register_range_read_%1%__P4Rreplicas1(sess_hdl, pipe_mgr_dev_tgt, 0, %5%, __mantis__reg_flags, &__mantis__num_actually_read, __mantis__values_%1%, &__mantis__value_count);
+    if(__mantis__status_tmp!=0) {
+      return false;
+    }
+    __mantis__status_tmp = %4%register_range_read_%1%__P4Rreplicas1__P4Rversion(sess_hdl, pipe_mgr_dev_tgt, 0, %5%, __mantis__reg_flags, &__mantis__num_actually_read, __mantis__versions_%1%, &__mantis__value_count);
+    __mantis__tstamp_%1% = %1%__tstamp__P4Rreplicas1;
+  }
+  if(__mantis__status_tmp!=0) {
+    return false;
+  }
+  for (__mantis__i=0; __mantis__i < %5%; __mantis__i++) {
+    if(__mantis__versions_%1%[1+__mantis__i*2] > __mantis__tstamp_%1%[__mantis__i]) {
+      %1%[__mantis__i].f0 = __mantis__values_%1%[1+__mantis__i*2].f0;
+      %1%[__mantis__i].f1 = __mantis__values_%1%[1+__mantis__i*2].f1;
+      __mantis__tstamp_%1%[__mantis__i] = __mantis__versions_%1%[1+__mantis__i*2];
+    }
+  }
+)";
+
+const char * const kRegArgIsoMirrorSingleT_64 =
+R"(
+  // Mirror %1%
+  static %4%%1%_value_t %1%[%3%];
+  static uint32_t %1%__tstamp__P4Rreplicas[2*%3%];
+  %4%%1%__P4Rreplicas_value_t __mantis__values_%1%__P4Rreplicas[8*%3%];
+  uint32_t __mantis__versions_%1%[8*%3%];
+  __mantis__status_tmp = %4%register_range_read_%1%__P4Rreplicas(sess_hdl, pipe_mgr_dev_tgt, 0, 2*%5%, __mantis__reg_flags, &__mantis__num_actually_read, __mantis__values_%1%__P4Rreplicas, &__mantis__value_count);
+  if(__mantis__status_tmp!=0) {
+    return false;
+  }
+  __mantis__status_tmp = %4%register_range_read_%1%__P4Rreplicas__P4Rversion(sess_hdl, pipe_mgr_dev_tgt, 0, 2*%5%, __mantis__reg_flags, &__mantis__num_actually_read, __mantis__versions_%1%, &__mantis__value_count);
+  if(__mantis__status_tmp!=0) {
+    return false;
+  }
+  for (__mantis__i=0; __mantis__i < %5%; __mantis__i++) {
+    int __mantis__entry = (__mantis__i << 1) | %6%;
+    if(__mantis__versions_%1%[1+__mantis__entry*2] > %1%__tstamp__P4Rreplicas[__mantis__entry]) {
+      %1%[__mantis__i].f0 = __mantis__values_%1%__P4Rreplicas[1+__mantis__entry*2].f0;
+      %1%[__mantis__i].f1 = __mantis__values_%1%__P4Rreplicas[1+__mantis__entry*2].f1;
+      %1%__tstamp__P4Rreplicas[__mantis__entry] = __mantis__versions_%1%[1+__mantis__entry*2];
+    }
+  }
+)";
+
+const char * const kRegArgIsoMirrorDirtyT_64 =
+R"(
+  // Mirror %1%
+  static %4%%1%_value_t %1%[%3%];
+  static uint32_t %1%__tstamp__P4Rreplicas0[%3%];
+  static uint32_t %1%__tstamp__P4Rreplicas1[%3%];
+  uint8_t __mantis__dirty_%1%[8*%8%];
+  __mantis__status_tmp = %4%register_range_read_%1%__P4Rdirty(sess_hdl, pipe_mgr_dev_tgt, 0, 2*%8%, __mantis__reg_flags, &__mantis__num_actually_read, __mantis__dirty_%1%, &__mantis__value_count);
+  if(__mantis__status_tmp!=0) {
+    return false;
+  }
+  %4%%1%__P4Rreplicas0_value_t __mantis__values_%1%[4*%7%];
+  uint32_t __mantis__versions_%1%[4*%7%];
+  uint32_t* __mantis__tstamp_%1% = %6%==0 ? %1%__tstamp__P4Rreplicas0 : %1%__tstamp__P4Rreplicas1;
+  for (int __mantis__b=0; __mantis__b*%7% < %5%; __mantis__b++) {
+    int __mantis__bit = (__mantis__b << 1) | %6%;
+    if(__mantis__dirty_%1%[1+__mantis__bit*2]==0) {
+      continue;
+    }
+    uint8_t __mantis__clean = 0;
+    __mantis__status_tmp = %4%register_write_%1%__P4Rdirty(sess_hdl, pipe_mgr_dev_tgt, __mantis__bit, &__mantis__clean);
+    if(__mantis__status_tmp!=0) {
+      return false;
+    }
+    int __mantis__first = __mantis__b*%7%;
+    int __mantis__count = %5%-__mantis__first < %7% ? %5%-__mantis__first : %7%;
+    if(%6%==0) {
+      __mantis__status_tmp = %4%register_range_read_%1%__P4Rreplicas0(sess_hdl, pipe_mgr_dev_tgt, __mantis__first, __mantis__count, __mantis__reg_flags, &__mantis__num_actually_read, __mantis__values_%1%, &__mantis__value_count);
+      if(__mantis__status_tmp!=0) {
+        return false;
+      }
+      __mantis__status_tmp = %4%register_range_read_%1%__P4Rreplicas0__P4Rversion(sess_hdl, pipe_mgr_dev_tgt, __mantis__first, __mantis__count, __mantis__reg_flags, &__mantis__num_actually_read, __mantis__versions_%1%, &__mantis__value_count);
+    } else {
+      __mantis__status_tmp = %4%register_range_read_%1%__P4Rreplicas1(sess_hdl, pipe_mgr_dev_tgt, __mantis__first, __mantis__count, __mantis__reg_flags, &__mantis__num_actually_read, __mantis__values_%1%, &__mantis__value_count);
+      if(__mantis__status_tmp!=0) {
+        return false;
+      }
+      __mantis__status_tmp = %4%register_range_read_%1%__P4Rreplicas1__P4Rversion(sess_hdl, pipe_mgr_dev_tgt, __mantis__first, __mantis__count, __mantis__reg_flags, &__mantis__num_actually_read, __mantis__versions_%1%, &__mantis__value_count);
+    }
+    if(__mantis__status_tmp!=0) {
+      return false;
+    }
+    for (__mantis__i=0; __mantis__i < __mantis__count; __mantis__i++) {
+      if(__mantis__versions_%1%[1+__mantis__i*2] > __mantis__tstamp_%1%[__mantis__first+__mantis__i]) {
+        %1%[__mantis__first+__mantis__i].f0 = __mantis__values_%1%[1+__mantis__i*2].f0;
+        %1%[__mantis__first+__mantis__i].f1 = __mantis__values_%1%[1+__mantis__i*2].f1;
+        __mantis__tstamp_%1%[__mantis__first+__mantis__i] = __mantis__versions_%1%[1+__mantis__i*2];
+      }
+    }
+  }
+)";
+
+const char * const kRegArgIsoMirrorSingleDirtyT_64 =
+R"(
+  // Mirror %1%
+  static %4%%1%_value_t %1%[%3%];
+  static uint32_t %1%__tstamp__P4Rreplicas[2*%3%];
+  uint8_t __mantis__dirty_%1%[8*%8%];
+  __mantis__status_tmp = %4%register_range_read_%1%__P4Rdirty(sess_hdl, pipe_mgr_dev_tgt, 0, 2*%8%, __mantis__reg_flags, &__mantis__num_actually_read, __mantis__dirty_%1%, &__mantis__value_count);
+  if(__mantis__status_tmp!=0) {
+    return false;
+  }
+  %4%%1%__P4Rreplicas_value_t __mantis__values_%1%__P4Rreplicas[8*%7%];
+  uint32_t __mantis__versions_%1%[8*%7%];
+  for (int __mantis__b=0; __mantis__b*%7% < %5%; __mantis__b++) {
+    int __mantis__bit = (__mantis__b << 1) | %6%;
+    if(__mantis__dirty_%1%[1+__mantis__bit*2]==0) {
+      continue;
+    }
+    uint8_t __mantis__clean = 0;
+    __mantis__status_tmp = %4%register_write_%1%__P4Rdirty(sess_hdl, pipe_mgr_dev_tgt, __mantis__bit, &__mantis__clean);
+    if(__mantis__status_tmp!=0) {
+      return false;
+    }
+    int __mantis__first = __mantis__b*%7%;
+    int __mantis__count = %5%-__mantis__first < %7% ? %5%-__mantis__first : %7%;
+    __mantis__status_tmp = %4%register_range_read_%1%__P4Rreplicas(sess_hdl, pipe_mgr_dev_tgt, __mantis__first << 1, 2*__mantis__count, __mantis__reg_flags, &__mantis__num_actually_read, __mantis__values_%1%__P4Rreplicas, &__mantis__value_count);
+    if(__mantis__status_tmp!=0) {
+      return false;
+    }
+    __mantis__status_tmp = %4%register_range_read_%1%__P4Rreplicas__P4Rversion(sess_hdl, pipe_mgr_dev_tgt, __mantis__first << 1, 2*__mantis__count, __mantis__reg_flags, &__mantis__num_actually_read, __mantis__versions_%1%, &__mantis__value_count);
+    if(__mantis__status_tmp!=0) {
+      return false;
+    }
+    for (__mantis__i=0; __mantis__i < __mantis__count; __mantis__i++) {
+      int __mantis__entry = (__mantis__i << 1) | %6%;
+      int __mantis__item = __mantis__first+__mantis__i;
+      if(__mantis__versions_%1%[1+__mantis__entry*2] > %1%__tstamp__P4Rreplicas[(__mantis__item << 1) | %6%]) {
+        %1%[__mantis__item].f0 = __mantis__values_%1%__P4Rreplicas[1+__mantis__entry*2].f0;
+        %1%[__mantis__item].f1 = __mantis__values_%1%__P4Rreplicas[1+__mantis__entry*2].f1;
+        %1%__tstamp__P4Rreplicas[(__mantis__item << 1) | %6%] = __mantis__versions_%1%[1+__mantis__entry*2];
+      }
+    }
+  }
+)";
+
 // %1%: bin size
 // %2%: bin index
 // %3%: prefix_str
@@ -158,6 +432,27 @@ R"(
   }
 )";
 
+// %1%: register index
+// %2%: prefix_str
+// Two bins in the lo (f1) and hi (f0) half of a 64-bit register
+const char * const kIngFieldArgPairPollT = 
+R"(
+  %2%__riSetArgs%1%_value_t __mantis__values_riSetArgs_%1%[4];
+  __mantis__status_tmp = %2%register_read___riSetArgs%1%(sess_hdl, pipe_mgr_dev_tgt, __mantis__mv_ing, __mantis__reg_flags, __mantis__values_riSetArgs_%1%, &__mantis__value_count);
+  if(__mantis__status_tmp!=0) {
+    return false;
+  }
+)";
+
+const char * const kEgrFieldArgPairPollT = 
+R"(
+  %2%__reSetArgs%1%_value_t __mantis__values_reSetArgs_%1%[4];
+  __mantis__status_tmp = %2%register_read___reSetArgs%1%(sess_hdl, pipe_mgr_dev_tgt, __mantis__mv_egr, __mantis__reg_flags, __mantis__values_reSetArgs_%1%, &__mantis__value_count);
+  if(__mantis__status_tmp!=0) {
+    return false;
+  }
+)";
+
 const char * const kPrologueT = 
 R"(
 bool pd_prologue(uint32_t sess_hdl, dev_target_t pipe_mgr_dev_tgt, uint32_t* hdls) {
@@ -13,36 +13,24 @@
  * limitations under the License.
  */
 
+#include <map>
 #include <unordered_map>
 #include <vector>
+#include <algorithm>
 #include <math.h>
+#include <boost/algorithm/string.hpp>
 
 #include "../../include/find_nodes.h"
 #include "../../include/helper.h"
 #include "compile_p4.h"
 #include "compile_const.h"
 
-void transformPragma(vector<AstNode*>* astNodes) {
-    // For now, a simple increment of stage index
-	for (auto node : *astNodes) {
-        if(typeContains(node, "TableNode")) {
-            if (typeContains(node, "P4R")) {
-                P4RMalleableTableNode* tablenode = dynamic_cast<P4RMalleableTableNode*>(node);
-                tablenode->transformPragma();
-            } else {
-                TableNode* tablenode = dynamic_cast<TableNode*>(node);
-                tablenode->transformPragma();
-            }
-        }
-    }    
-}
-
-int inferIsoOptForIng(vector<AstNode*>* nodeArray, bool forIng) {
+int inferIsoOptForIng(const NodeRegistry& nodeArray, const SymbolTable& symbols, bool forIng) {
 
     int inferred_iso = -1;
     bool require_meas_iso = true;
     bool require_react_iso = true;
-    vector<ReactionArgNode*> reaction_args = findReactionArgs(*nodeArray);
+    vector<ReactionArgNode*> reaction_args = findReactionArgs(nodeArray);
     int num_args = 0;
     bool has_regarg = false;
     bool has_fieldarg = false;
@@ -50,7 +38,7 @@ int inferIsoOptForIng(vector<AstNode*>* nodeArray, bool forIng) {
     for (auto ra : reaction_args) {   
         if(forIng) {
             if (ra->argType_==ReactionArgNode::REGISTER) {
-                if(findRegargInIng(ra, *nodeArray)) {
+                if(findRegargInIng(ra, symbols)) {
                     num_args += 1;
                     has_regarg = true;
                 }
@@ -61,7 +49,7 @@ int inferIsoOptForIng(vector<AstNode*>* nodeArray, bool forIng) {
             }
         } else {
             if (ra->argType_==ReactionArgNode::REGISTER) {
-                if(!findRegargInIng(ra, *nodeArray)) {
+                if(!findRegargInIng(ra, symbols)) {
                     num_args += 1;
                     has_regarg = true;
                 }
@@ -81,34 +69,32 @@ int inferIsoOptForIng(vector<AstNode*>* nodeArray, bool forIng) {
     }
 
     // Simple static analysis to differentiate the case requiring no update isolation
-    P4RReactionNode * react_node = findReaction(*nodeArray);
+    P4RReactionNode * react_node = findReaction(nodeArray);
     string user_dialogue = "";
     if (react_node != 0) {
         user_dialogue = react_node->body_->toString();
     }
     bool foundMblOperation = false;
     // If malleable table operations specified, break if any
-    for (auto node : *nodeArray) {
-        if(typeContains(node, "P4RMalleableTableNode")) {
-            P4RMalleableTableNode* table = dynamic_cast<P4RMalleableTableNode*>(node);
-            string table_name = *(table->table_->name_->word_);
+    for (auto node : nodeArray.ofKind(P4R_MALLEABLE_TABLE_NODE)) {
+        P4RMalleableTableNode* table = dynamic_cast<P4RMalleableTableNode*>(node);
+        string table_name = *(table->table_->name_->word_);
 
-            if(forIng) {
-                if(!findTblInIng(table_name, *nodeArray)) {
-                    continue;
-                }
-            } else {
-                if(findTblInIng(table_name, *nodeArray)) {
-                    continue;
-                }
+        if(forIng) {
+            if(!findTblInIng(table_name, symbols)) {
+                continue;
             }
-            
-            if(user_dialogue.find(table_name+"_mod")!=std::string::npos || user_dialogue.find(table_name+"_add")!=std::string::npos || user_dialogue.find(table_name+"_del")!=std::string::npos) {
-                foundMblOperation = true;
-                break;
+        } else {
+            if(findTblInIng(table_name, symbols)) {
+                continue;
             }
         }
-    } 
+        
+        if(user_dialogue.find(table_name+"_mod")!=std::string::npos || user_dialogue.find(table_name+"_add")!=std::string::npos || user_dialogue.find(table_name+"_del")!=std::string::npos) {
+            foundMblOperation = true;
+            break;
+        }
+    }
 
     if (!foundMblOperation) {
         require_react_iso = false;
@@ -134,16 +120,15 @@ int inferIsoOptForIng(vector<AstNode*>* nodeArray, bool forIng) {
 }
 
 // Wrap ingress with calls to setup and finalize
-bool augmentIngress(vector<AstNode*>* astNodes) {
+bool augmentIngress(NodeRegistry* astNodes) {
     // Fetch ingress
     P4ExprNode* ingressNode = findIngress(*astNodes);
     if (!ingressNode) {
         PANIC("Error: could not find the egress control block. Perhaps you didn't call it 'ingress'?\n");
-        exit(1);
     }
 
     // Rename ingress
-    ingressNode->name1_->word_ = new string(kOrigIngControlName);
+    ingressNode->name1_->word_ = intern(kOrigIngControlName);
 
     // Generate new ingress function that wraps original
     ostringstream oss;
@@ -154,7 +139,7 @@ bool augmentIngress(vector<AstNode*>* astNodes) {
             << "  " << kSetargsIngControlName << "();\n"
             << "  " << kRegArgGateIngControlName << "();\n"            
         << "}\n\n";
-    StrNode* newIngressNode = new StrNode(new string(oss.str()));
+    StrNode* newIngressNode = new StrNode(intern(oss.str()));
 
     // Inject wrapper right before original
     InputNode* firstInput = dynamic_cast<InputNode*>(ingressNode->parent_);
@@ -170,16 +155,15 @@ bool augmentIngress(vector<AstNode*>* astNodes) {
 }
 
 // Wrap ingress with calls to setup and finalize
-bool augmentEgress(vector<AstNode*>* astNodes) {
+bool augmentEgress(NodeRegistry* astNodes) {
     // Fetch egress
     P4ExprNode* egressNode = findEgress(*astNodes);
     if (!egressNode) {
         PANIC("Error: could not find the egress control block. Perhaps you didn't call it 'egress'?\n");
-        exit(1);
     }
 
     // Rename egress
-    egressNode->name1_->word_ = new string(kOrigEgrControlName);
+    egressNode->name1_->word_ = intern(kOrigEgrControlName);
 
     // Generate new ingress function that wraps original
     ostringstream oss;
@@ -189,7 +173,7 @@ bool augmentEgress(vector<AstNode*>* astNodes) {
             << "  " << kSetargsEgrControlName << "();\n"
             << "  " << kRegArgGateEgrControlName << "();\n"
         << "}\n\n";
-    StrNode* newEgressNode = new StrNode(new string(oss.str()));
+    StrNode* newEgressNode = new StrNode(intern(oss.str()));
 
     // Inject wrapper right before original
     InputNode* firstInput = dynamic_cast<InputNode*>(egressNode->parent_);
@@ -204,13 +188,131 @@ bool augmentEgress(vector<AstNode*>* astNodes) {
     return true;
 }
 
-// Current generic approach can be expensive in terms of TCAM usage (even when user uses exact match for the mbl field)
-// Alternatives:
-// 1. Use dynamic masking of exact match table (tofino feature)
-// 2. Match on a given-width helper meta data and in the preceeding table (extra table cost), assign corresponding values to it
+// Whether an action may write an alt of variable or its header.  A
+// malleable field not resolved yet writes its alts, any alt when mblFields
+// is not given.
+static bool actionWritesAlt(ActionNode* action, const P4RMalleableFieldNode& variable,
+                            const SymbolTable& symbols,
+                            const unordered_map<string, P4RMalleableFieldNode*>* mblFields = NULL) {
+    vector<string> alts;
+    for (FieldNode* fn : findAllAlts(variable)) {
+        alts.push_back(*fn->headerName_->word_ + "." + *fn->fieldName_->word_);
+    }
+    for (ActionStmtNode* stmt : *action->stmts_->list_) {
+        vector<string> written;
+        P4StatefulAluNode* blackbox = stmt->executesStatefulAlu() ? symbols.blackbox(*stmt->name1_->word_) : NULL;
+        P4AttributeNode* outputDst = blackbox == NULL ? NULL : blackbox->attribute("output_dst");
+        if (outputDst != NULL) {
+            string field;
+            for (BodyWordNode* word : outputDst->value_) {
+                field += word->contents_->toString();
+            }
+            written.push_back(boost::algorithm::trim_copy(field));
+        }
+        if (stmt->args_ != NULL) {
+            for (BodyWordNode* word : *stmt->args_->list_) {
+                if (!findArgWritten(stmt, word)) {
+                    continue;
+                }
+                MblRefNode* ref = dynamic_cast<MblRefNode*>(word->contents_);
+                if (ref != NULL && !ref->transformed_) {
+                    if (mblFields == NULL || mblFields->find(*ref->name_->word_) == mblFields->end()) {
+                        return true;
+                    }
+                    for (FieldNode* fn : findAllAlts(*mblFields->at(*ref->name_->word_))) {
+                        written.push_back(*fn->headerName_->word_ + "." + *fn->fieldName_->word_);
+                    }
+                    continue;
+                }
+                written.push_back(boost::algorithm::trim_copy(word->contents_->toString()));
+            }
+        }
+        for (const string& field : written) {
+            for (const string& alt : alts) {
+                if (alt == field || alt.compare(0, field.size() + 1, field + ".") == 0) {
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+// Whether an ingress table applied before tableName may write an alt of
+// variable.  The selected alt is copied once at the start of ingress, a
+// read of the copy after such a table would see the stale value.
+static bool altWrittenBefore(const string& tableName, const P4RMalleableFieldNode& variable,
+                             const SymbolTable& symbols) {
+    for (const string& name : symbols.applyGraph().tableOrder(ApplyGraph::INGRESS)) {
+        if (name == tableName) {
+            return false;
+        }
+        TableNode* table = symbols.table(name);
+        if (table == NULL) {
+            continue;
+        }
+        for (TableActionStmtNode* entry : *table->actions_->list_) {
+            ActionNode* action = symbols.action(*entry->name_->word_);
+            if (action != NULL && actionWritesAlt(action, variable, symbols)) {
+                return true;
+            }
+        }
+    }
+    return true;
+}
+
+// Sum of the widths of the alts when each is known and fits the helper field
+// of the width of variable the selected alt is copied to, 0 otherwise
+static int altBitsFitting(const P4RMalleableFieldNode& variable, const SymbolTable& symbols) {
+    int width = atoi(variable.varWidth_->val_->word_->c_str());
+    int altBits = 0;
+    for (FieldNode* fn : findAllAlts(variable)) {
+        int altWidth = symbols.fieldWidth(*fn->headerName_->word_, *fn->fieldName_->word_);
+        if (altWidth <= 0 || altWidth > width) {
+            return 0;
+        }
+        altBits += altWidth;
+    }
+    return altBits;
+}
+
+// Sum of the widths of the alts when an exact read can stay exact, 0
+// otherwise.  That needs the alt selected before the table, i.e. in the
+// ingress where __tiSetVars sets it, no table before it writing an alt,
+// and every alt to fit the field.
+static int exactReadAltBits(TableReadStmtNode* readStmt, TableNode* table,
+                            const P4RMalleableFieldNode& variable,
+                            const SymbolTable& symbols) {
+    if (readStmt->matchType_ != TableReadStmtNode::EXACT ||
+        !findTblInIng(*table->name_->word_, symbols) ||
+        altWrittenBefore(*table->name_->word_, variable, symbols)) {
+        return 0;
+    }
+    return altBitsFitting(variable, symbols);
+}
+
+// An exact read keeps its exact match, on a helper metadata field the
+// selected alt is copied to before the table (see generateSetvarControl),
+// when exactReadAltBits allows.  Otherwise the generic approach, expensive
+// in terms of TCAM usage: a ternary match on every alt and an exact match
+// on the alt index.
+// Another alternative would be dynamic masking of an exact match table
+// (tofino feature).
 static void transformTableWithRefRead(MblRefNode* ref, TableNode* table,
-                               const P4RMalleableFieldNode& variable) {
+                               P4RMalleableFieldNode& variable,
+                               const SymbolTable& symbols) {
     auto readStmtsNode = dynamic_cast<TableReadStmtsNode*>(ref->parent_->parent_);
+    const string variableName = *ref->name_->word_;
+
+    int altBits = exactReadAltBits(dynamic_cast<TableReadStmtNode*>(ref->parent_), table, variable, symbols);
+    if (altBits > 0) {
+        ref->transform(kP4rIngMetadataName, variableName + kP4rSelectSuffix);
+        variable.numExactReads_++;
+        variable.tcamBitsSaved_ += altBits;
+        PRINT_VERBOSE("Exact read of %s kept in %s, %d ternary bits saved\n",
+                      variableName.c_str(), table->name_->word_->c_str(), altBits);
+        return;
+    }
 
     // Assemble list of alts
     vector<FieldNode*> alts = findAllAlts(variable);
@@ -237,13 +339,12 @@ static void transformTableWithRefRead(MblRefNode* ref, TableNode* table,
     }
 
     // Add exact match bit for the meta field of the variable
-    const string variableName = *ref->name_->word_;
     ostringstream oss;
     oss << kP4rIngMetadataName << "." << variableName << kP4rIndexSuffix;
     if (!findTableReadStmt(*table, oss.str())) {
         auto newReadStmtNode =
             new TableReadStmtNode(TableReadStmtNode::EXACT,
-                                  new StrNode(new string(oss.str())));
+                                  new StrNode(intern(oss.str())));
         table->reads_->push_back(newReadStmtNode);
     }    
 }
@@ -252,7 +353,7 @@ static void transformTableWithRefRead(MblRefNode* ref, TableNode* table,
 // Even when multiple mbls are used, one typically splits the usage into separate tables
 static void duplicateActions(MblRefNode* ref, ActionNode* action,
                       vector<MblRefNode*>* mblRefs,
-                      vector<AstNode*>* nodeArray,
+                      SymbolTable* symbols,
                       const P4RMalleableFieldNode& variable) {
     const string actionName = *action->name_->word_;
     const string variableName = *ref->name_->word_;
@@ -275,7 +376,7 @@ static void duplicateActions(MblRefNode* ref, ActionNode* action,
             altNames.push_back(oss.str());
 
             // Change action to the instantiated name
-            *action->name_->word_ = oss.str();
+            action->name_->word_ = intern(oss.str());
 
             // Replace the varref inside the alt with an actual ref
             findAndTransformMblRefsInAction(action, NULL, variableName,
@@ -289,7 +390,8 @@ static void duplicateActions(MblRefNode* ref, ActionNode* action,
             altNames.push_back(oss.str());
 
             // Create action with the instantiated name
-            ActionNode* newAction = action->duplicateAction(oss.str());
+            ActionNode* newAction = action->duplicateAction(oss.str(), variableName);
+            symbols->addAction(newAction);
 
             // Inject Action right after the first
             InputNode* firstInput = dynamic_cast<InputNode*>(action->parent_);
@@ -305,18 +407,19 @@ static void duplicateActions(MblRefNode* ref, ActionNode* action,
     }
 
     // Modify all tables that use the original action
-    auto actionStmtMap = findTableActionStmts(*nodeArray, actionName);
+    auto actionStmtMap = findTableActionStmts(*symbols, actionName);
     for (auto kv : actionStmtMap) {
         // Change all tables to have all possible actions
         first = true;
         for (auto altName : altNames) {
             if (first) {
-                *kv.first->name_->word_ = altName;
+                kv.first->name_->word_ = intern(altName);
                 first = false;
             } else {
                 auto newActionStmtNode =
-                    new TableActionStmtNode(new NameNode(new string(altName)));
+                    new TableActionStmtNode(new NameNode(intern(altName)));
                 kv.second->actions_->push_back(newActionStmtNode);
+                symbols->addTableAction(kv.second, altName);
             }
         }
 
@@ -327,105 +430,182 @@ static void duplicateActions(MblRefNode* ref, ActionNode* action,
         if (!findTableReadStmt(*kv.second, oss.str())) {
             auto newReadStmtNode =
                 new TableReadStmtNode(TableReadStmtNode::EXACT,
-                                      new StrNode(new string(oss.str())));
+                                      new StrNode(intern(oss.str())));
             kv.second->reads_->push_back(newReadStmtNode);
         }
     }
+
+    // The original action now carries the first alt name
+    symbols->renameAction(actionName, altNames[0]);
+}
+
+// Whether the statement the ref is an argument of writes it
+static bool writesMblRef(MblRefNode* ref) {
+    auto word = dynamic_cast<BodyWordNode*>(ref->parent_);
+    auto args = word == NULL ? NULL : dynamic_cast<ArgsNode*>(word->parent_);
+    auto stmt = args == NULL ? NULL : dynamic_cast<ActionStmtNode*>(args->parent_);
+    if (stmt == NULL) {
+        return true;
+    }
+    return findArgWritten(stmt, word);
+}
+
+void factorMalleableActions(const vector<MblRefNode*>& mblRefs,
+                            const unordered_map<string, P4RMalleableFieldNode*>& mblFields,
+                            const SymbolTable& symbols, int maxActionCopies,
+                            vector<pair<string, int> >* factoredActions) {
+    // Field refs of each action, actions in order of first reference
+    vector<ActionNode*> actions;
+    unordered_map<ActionNode*, vector<MblRefNode*> > actionRefs;
+    for (MblRefNode* ref : mblRefs) {
+        if (ref->transformed_ || mblFields.find(*ref->name_->word_) == mblFields.end()) {
+            continue;
+        }
+        for (AstNode* parent = ref->parent_; parent != NULL; parent = parent->parent_) {
+            if (parent->isKind(ACTION_NODE)) {
+                ActionNode* action = dynamic_cast<ActionNode*>(parent);
+                if (actionRefs.find(action) == actionRefs.end()) {
+                    actions.push_back(action);
+                }
+                actionRefs[action].push_back(ref);
+                break;
+            } else if (parent->isKind(TABLE_NODE) || parent->isKind(P4R_REACTION_NODE)) {
+                break;
+            }
+        }
+    }
+
+    for (ActionNode* action : actions) {
+        const string& actionName = *action->name_->word_;
+        // Fields of the action by name, and whether it writes them
+        map<string, bool> writes;
+        for (MblRefNode* ref : actionRefs[action]) {
+            writes[*ref->name_->word_] |= writesMblRef(ref);
+        }
+        int copies = 1;
+        for (auto& kv : writes) {
+            copies *= findAllAlts(*mblFields.at(kv.first)).size();
+        }
+        if (copies <= maxActionCopies) {
+            continue;
+        }
+
+        // The helper fields are set in ingress, where nothing before the
+        // action may write the alts copied to them
+        bool inIngress = true;
+        for (TableNode* table : symbols.tablesListing(actionName)) {
+            inIngress = inIngress && findTblInIng(*table->name_->word_, symbols);
+        }
+        map<string, bool> factored;
+        int remainingCopies = 1;
+        for (auto& kv : writes) {
+            const P4RMalleableFieldNode& variable = *mblFields.at(kv.first);
+            bool factor = !kv.second && inIngress && !actionWritesAlt(action, variable, symbols, &mblFields);
+            for (TableNode* table : symbols.tablesListing(actionName)) {
+                factor = factor && !altWrittenBefore(*table->name_->word_, variable, symbols);
+            }
+            if (factor && altBitsFitting(variable, symbols) == 0) {
+                PRINT_VERBOSE("Action %s duplicated for %s, an alt does not fit its width\n",
+                              actionName.c_str(), kv.first.c_str());
+                factor = false;
+            }
+            factored[kv.first] = factor;
+            if (!factor) {
+                remainingCopies *= findAllAlts(variable).size();
+            }
+        }
+        if (remainingCopies == copies) {
+            PRINT_VERBOSE("Action %s takes %d copies, its malleable fields are written, written before, narrower than an alt or in egress\n",
+                          actionName.c_str(), copies);
+            continue;
+        }
+
+        for (MblRefNode* ref : actionRefs[action]) {
+            if (factored[*ref->name_->word_]) {
+                ref->transform(kP4rIngMetadataName, *ref->name_->word_ + kP4rSelectSuffix);
+            }
+        }
+        for (auto& kv : factored) {
+            if (kv.second) {
+                mblFields.at(kv.first)->numFactoredActions_++;
+            }
+        }
+        factoredActions->emplace_back(actionName, copies - remainingCopies);
+        PRINT_VERBOSE("Action %s reads the selected alts, %d copies instead of %d\n",
+                      actionName.c_str(), remainingCopies, copies);
+    }
 }
 
 static void transformMalleableFieldRef(MblRefNode* ref, vector<MblRefNode*>* mblRefs,
-                               vector<AstNode*>* nodeArray,
-                               const P4RMalleableFieldNode& variable) {
+                               SymbolTable* symbols,
+                               P4RMalleableFieldNode& variable) {
     // malleable field references can be in (1) actions, (2) table match fields,
     // and (3) reaction arguments
     AstNode* parent = ref->parent_;
     while (parent != NULL) {
-        if (typeContains(parent, "ActionNode")) {
+        if (parent->isKind(ACTION_NODE)) {
             ActionNode* action = dynamic_cast<ActionNode*>(parent);
-            duplicateActions(ref, action, mblRefs, nodeArray, variable);
+            duplicateActions(ref, action, mblRefs, symbols, variable);
             return;
-        } else if (typeContains(parent, "TableNode")) {
+        } else if (parent->isKind(TABLE_NODE)) {
             TableNode* table = dynamic_cast<TableNode*>(parent);
-            transformTableWithRefRead(ref, table, variable);
+            transformTableWithRefRead(ref, table, variable, *symbols);
             return;
-        } else if (typeContains(parent, "P4RReactionNode")) {
+        } else if (parent->isKind(P4R_REACTION_NODE)) {
             return;
         }
         parent = parent->parent_;
     }
 
     PANIC("Syntax Error: Could not find parent of variable reference\n");
-    exit(1);
 }
 
 void findMalleableUsage(
-            vector<MblRefNode*> mblRefs,
-            const unordered_map<string, P4RMalleableValueNode*> mblValues,
-            const unordered_map<string, P4RMalleableFieldNode*> mblFields,
-            vector<AstNode*>* nodeArray,
+            const vector<MblRefNode*>& mblRefs,
+            const SymbolTable& symbols,
             unordered_map<string, int>* mblUsage) {
 
-    while (!mblRefs.empty()) {
-        MblRefNode* varRef = mblRefs.front();
-        mblRefs.erase(mblRefs.begin());
-
-        string* varName = varRef->name_->word_;
-
-        if(mblUsage->find(*varName) != mblUsage->end()) {
-            continue;
+    // Side bits per var: 0b01 - ingress, 0b10 - egress, in order of first reference
+    vector<string> varNames;
+    unordered_map<string, unsigned int> sides;
+    for (MblRefNode* varRef : mblRefs) {
+        const string& varName = *varRef->name_->word_;
+        if (sides.find(varName) == sides.end()) {
+            varNames.push_back(varName);
+            sides.emplace(varName, 0);
         }
 
-        // Find the usage index: 0 - ingress, 1 - egress, 2 - both
-        bool in_ingress = false;
-        bool in_egress = false;
-        // One var could be used in multiple tbls
-        for (auto node : *nodeArray) {
-            // Though filter P4RMalleableTableNode, its table node is still searched
-            if(typeContains(node, "TableNode") && !typeContains(node, "P4R")) {
-                TableNode* table = dynamic_cast<TableNode*>(node);
-                string table_name = *(table->name_->word_);
-
-                // Try to determine if the table uses the mblRef
-                bool useMblRef = false;
-                if(table->toString().find(*varName) != string::npos) {
-                    useMblRef = true;
-                } else {
-                    // Check if used actions
-                    for (auto action : *table->actions_->list_) {
-                        for (auto tmp_node : *nodeArray) {
-                            if(typeContains(tmp_node, "ActionNode")) {
-                                ActionNode* tmp_action_node = dynamic_cast<ActionNode*>(tmp_node);
-                                string tmp_action_name = tmp_action_node->name_->toString();
-                                if(tmp_action_name.compare(action->name_->toString())==0) {
-                                    if(tmp_action_node->toString().find(*varName) != string::npos) {
-                                        useMblRef = true;
-                                        break;
-                                    }
-                                }
-                            }
-                        }
-                        if(useMblRef) {
-                            break;
-                        }                        
-                    }
-                }
-                if(useMblRef) {
-                    if(findTblInIng(table_name, *nodeArray)) {
-                        in_ingress = true;
-                    } else {
-                        in_egress = true;
-                    }
-                }
+        // A var could be used in match fields or in actions of multiple tbls
+        vector<TableNode*> tables;
+        for (AstNode* parent = varRef->parent_; parent != NULL; parent = parent->parent_) {
+            if (parent->isKind(TABLE_NODE)) {
+                tables.push_back(dynamic_cast<TableNode*>(parent));
+                break;
+            } else if (parent->isKind(ACTION_NODE)) {
+                ActionNode* action = dynamic_cast<ActionNode*>(parent);
+                tables = symbols.tablesListing(action->name_->toString());
+                break;
             }
         }
-        if(in_ingress && in_egress) {
-            mblUsage->emplace(*varName, USAGE::BOTH);
-        } else if (in_ingress) {
-            mblUsage->emplace(*varName, USAGE::INGRESS);
-        } else if (in_egress) {
-            mblUsage->emplace(*varName, USAGE::EGRESS);
-        } else {
-            PANIC("Can not find the target mblRef %s usage\n", varName->c_str());
+        for (TableNode* table : tables) {
+            sides[varName] |= findTblInIng(*table->name_->word_, symbols) ? 0b01 : 0b10;
+        }
+    }
+
+    // Find the usage index: 0 - ingress, 1 - egress, 2 - both
+    for (const string& varName : varNames) {
+        switch (sides[varName]) {
+            case 0b11:
+                mblUsage->emplace(varName, USAGE::BOTH);
+                break;
+            case 0b01:
+                mblUsage->emplace(varName, USAGE::INGRESS);
+                break;
+            case 0b10:
+                mblUsage->emplace(varName, USAGE::EGRESS);
+                break;
+            default:
+                PANIC("Can not find the target mblRef %s usage\n", varName.c_str());
         }
     }
     PRINT_VERBOSE("mbl usage dict:\n");
@@ -438,7 +618,7 @@ void transformMalleableRefs(
             vector<MblRefNode*>* mblRefs,
             const unordered_map<string, P4RMalleableValueNode*>& mblValues,
             const unordered_map<string, P4RMalleableFieldNode*>& mblFields,
-            vector<AstNode*>* nodeArray) {
+            SymbolTable* symbols) {
     while (!mblRefs->empty()) {
         MblRefNode* varRef = mblRefs->front();
         mblRefs->erase(mblRefs->begin());
@@ -449,14 +629,14 @@ void transformMalleableRefs(
             continue;
         }
 
-        string* varName = varRef->name_->word_;
+        const string* varName = varRef->name_->word_;
 
         if (mblValues.find(*varName) != mblValues.end()) {
             // we should treat variable value references in reaction and others differently
             bool is_in_reaction = false;
             AstNode* parent = varRef->parent_;
             while (parent != NULL) {
-                if (typeContains(parent, "P4RReactionNode")) {
+                if (parent->isKind(P4R_REACTION_NODE)) {
                     is_in_reaction = true;
                     break;
                 }
@@ -471,7 +651,7 @@ void transformMalleableRefs(
             }
         } else if (mblFields.find(*varName) != mblFields.end()) {
             // Reference to a variable field
-            transformMalleableFieldRef(varRef, mblRefs, nodeArray,
+            transformMalleableFieldRef(varRef, mblRefs, symbols,
                                       *mblFields.find(*varName)->second);
         } else {
             PANIC("Unknown malleable ref!");
@@ -479,20 +659,20 @@ void transformMalleableRefs(
     }
 }
 
-void transformMalleableTables(unordered_map<string, P4RMalleableTableNode*>* varTables, vector<AstNode*> nodeArray, int ing_iso_opt, int egr_iso_opt) {
+void transformMalleableTables(unordered_map<string, P4RMalleableTableNode*>* varTables, const SymbolTable& symbols, int ing_iso_opt, int egr_iso_opt) {
     for (auto t : *varTables) {
         // Check if mbl table in ing/egr
-        if(findTblInIng(t.second->table_->name_->toString(), nodeArray)) {
+        if(findTblInIng(t.second->table_->name_->toString(), symbols)) {
             if (((unsigned int)ing_iso_opt) & 0b10) {
-                auto field = new FieldNode(new NameNode(new string(kP4rIngMetadataName)),
-                                        new NameNode(new string("__vv")));
+                auto field = new FieldNode(new NameNode(intern(kP4rIngMetadataName)),
+                                        new NameNode(intern("__vv")));
                 auto readstmt = new TableReadStmtNode(TableReadStmtNode::EXACT, field);
                 t.second->table_->reads_->list_->push_back(readstmt);
             }
         } else {
             if (((unsigned int)egr_iso_opt) & 0b10) {
-                auto field = new FieldNode(new NameNode(new string(kP4rEgrMetadataName)),
-                                        new NameNode(new string("__vv")));
+                auto field = new FieldNode(new NameNode(intern(kP4rEgrMetadataName)),
+                                        new NameNode(intern("__vv")));
                 auto readstmt = new TableReadStmtNode(TableReadStmtNode::EXACT, field);
                 t.second->table_->reads_->list_->push_back(readstmt);
             }
@@ -500,48 +680,101 @@ void transformMalleableTables(unordered_map<string, P4RMalleableTableNode*>* var
     }
 }
 
+// Applies the pack tables of a pipeline, then the SetArgs tables setting
+// the registers from the packed bins
+static void applyArgTables(ostringstream& oss, const vector<ReactionArgBin>& argBins,
+                           bool pairArgBins, bool mergeArgTables, bool forIng) {
+    string packTable = forIng ? "__tiPack" : "__tePack";
+    string setArgsTable = forIng ? "__tiSetArgs" : "__teSetArgs";
+    int numRegs = numArgRegisters(argBins, pairArgBins);
+    if (mergeArgTables) {
+        if (!argBins.empty()) {
+            oss << "  apply(" << packTable << ");\n";
+        }
+        for (int g = 0; g*STATEFUL_ALUS_PER_STAGE < numRegs; ++g) {
+            oss << "  apply(" << setArgsTable << "Stage" << g << ");\n";
+        }
+        return;
+    }
+    // A register is set once the bins in its halves are packed
+    int binsPerReg = pairArgBins ? 2 : 1;
+    for (int i = 0; i < numRegs; ++i) {
+        for (int j = i*binsPerReg; j < argBins.size() && j < (i+1)*binsPerReg; ++j) {
+            oss << "  apply(" << packTable << j << ");\n";
+        }
+        oss << "  apply(" << setArgsTable << i << ");\n";
+    }
+}
+
 void generateExportControl(vector<AstNode*>* newNodes,
-                           const vector<ReactionArgBin>& argBinsIng, const vector<ReactionArgBin>& argBinsEgr){
+                           const vector<ReactionArgBin>& argBinsIng, const vector<ReactionArgBin>& argBinsEgr,
+                           bool pairArgBins, bool mergeArgTables){
     ostringstream oss;
     oss << "control " << kSetargsIngControlName << " {\n";
-    for (int i = 0; i < argBinsIng.size(); ++i) {
-        oss << "  apply(__tiPack" << i << ");\n";
-        oss << "  apply(__tiSetArgs" << i << ");\n";
-    }
+    applyArgTables(oss, argBinsIng, pairArgBins, mergeArgTables, true);
     oss << "}\n\n";
 
-    newNodes->push_back(new UnanchoredNode(new string(oss.str()),
-                                           new string("control"),
-                                           new string(kSetargsIngControlName)));
+    newNodes->push_back(new UnanchoredNode(oss.str(),
+                                           "control",
+                                           kSetargsIngControlName));
 
     oss.str("");
     oss << "control " << kSetargsEgrControlName << " {\n";
-    for (int i = 0; i < argBinsEgr.size(); ++i) {
-        oss << "  apply(__tePack" << i << ");\n";
-        oss << "  apply(__teSetArgs" << i << ");\n";
-    }
+    applyArgTables(oss, argBinsEgr, pairArgBins, mergeArgTables, false);
     oss << "}\n\n";
 
-    newNodes->push_back(new UnanchoredNode(new string(oss.str()),
-                                           new string("control"),
-                                           new string(kSetargsEgrControlName)));
+    newNodes->push_back(new UnanchoredNode(oss.str(),
+                                           "control",
+                                           kSetargsEgrControlName));
+
+}
+
+// Tables of one pipeline and the stages they take: the pack tables, then
+// the SetArgs tables executing the stateful alus, with no more than
+// TABLES_PER_STAGE tables and STATEFUL_ALUS_PER_STAGE alus in a stage
+static ArgExportCost argExportCost(const vector<ReactionArgBin>& argBins,
+                                   bool pairArgBins, bool mergeArgTables) {
+    ArgExportCost cost;
+    if (argBins.empty()) {
+        return cost;
+    }
+    int numRegs = numArgRegisters(argBins, pairArgBins);
+    int numAluStages = (numRegs + STATEFUL_ALUS_PER_STAGE - 1) / STATEFUL_ALUS_PER_STAGE;
+    int packTables = mergeArgTables ? 1 : argBins.size();
+    int setArgsTables = mergeArgTables ? numAluStages : numRegs;
+    cost.tables_ = packTables + setArgsTables;
+    cost.stages_ = (packTables + TABLES_PER_STAGE - 1) / TABLES_PER_STAGE +
+                   max(numAluStages, (setArgsTables + TABLES_PER_STAGE - 1) / TABLES_PER_STAGE);
+    return cost;
+}
 
+ArgExportCost argExportCost(const vector<ReactionArgBin>& argBinsIng, const vector<ReactionArgBin>& argBinsEgr,
+                            bool pairArgBins, bool mergeArgTables) {
+    ArgExportCost ing = argExportCost(argBinsIng, pairArgBins, mergeArgTables);
+    ArgExportCost egr = argExportCost(argBinsEgr, pairArgBins, mergeArgTables);
+    ArgExportCost cost;
+    cost.tables_ = ing.tables_ + egr.tables_;
+    cost.stages_ = max(ing.stages_, egr.stages_);
+    return cost;
 }
 
 void generateRegArgGateControl(vector<AstNode*>* newNodes,
-                         vector<AstNode*>* nodeArray,
+                         const SymbolTable& symbols,
                          const vector<ReactionArgNode*>& reaction_args,
-                         int ing_iso_opt, int egr_iso_opt) {
+                         int ing_iso_opt, int egr_iso_opt, bool singleReplica) {
 
     // Generate control flow branching on mv bit
     ostringstream oss;
     oss << "control " << kRegArgGateIngControlName << " {\n";
     
-    // An alternative is to use single reg with double the size and index elements with original_index<<1+mv
-    // Though less memory overhead but larger latency
+    // With a single replica the mv bit is part of its index, no branch
     if (((unsigned int)ing_iso_opt) & 0b1) {
         for (auto ra : reaction_args) {
-            if (ra->argType_==ReactionArgNode::REGISTER && findRegargInIng(ra, *nodeArray)) {
+            if (ra->argType_==ReactionArgNode::REGISTER && findRegargInIng(ra, symbols)) {
+                if (singleReplica) {
+                    oss << "  apply (" << kP4rRegReplicasTablePrefix << ra->toString() << kP4rRegReplicasSuffix << ");\n";
+                    continue;
+                }
                 oss << "  if (" << kP4rIngMetadataName << ".__mv == 0 ) {\n"
                 << "    apply (" << kP4rRegReplicasTablePrefix << ra->toString() << kP4rRegReplicasSuffix0 << ");\n"
                 << "  }\n"
@@ -552,16 +785,20 @@ void generateRegArgGateControl(vector<AstNode*>* newNodes,
         }    
     }
     oss << "}\n\n";
-    newNodes->push_back(new UnanchoredNode(new string(oss.str()),
-                                           new string("control"),
-                                           new string(kRegArgGateIngControlName)));  
+    newNodes->push_back(new UnanchoredNode(oss.str(),
+                                           "control",
+                                           kRegArgGateIngControlName));  
 
     oss.str("");
     oss << "control " << kRegArgGateEgrControlName << " {\n";
     
     if (((unsigned int)egr_iso_opt) & 0b1) {
         for (auto ra : reaction_args) {
-            if (ra->argType_==ReactionArgNode::REGISTER && !findRegargInIng(ra, *nodeArray)) {
+            if (ra->argType_==ReactionArgNode::REGISTER && !findRegargInIng(ra, symbols)) {
+                if (singleReplica) {
+                    oss << "  apply (" << kP4rRegReplicasTablePrefix << ra->toString() << kP4rRegReplicasSuffix << ");\n";
+                    continue;
+                }
                 oss << "  if (" << kP4rEgrMetadataName << ".__mv == 0 ) {\n"
                     << "    apply (" << kP4rRegReplicasTablePrefix << ra->toString() << kP4rRegReplicasSuffix0 << ");\n"
                     << "  }\n"
@@ -573,23 +810,173 @@ void generateRegArgGateControl(vector<AstNode*>* newNodes,
     }
     oss << "}\n\n";    
 
-    newNodes->push_back(new UnanchoredNode(new string(oss.str()),
-                                           new string("control"),
-                                           new string(kRegArgGateEgrControlName)));    
+    newNodes->push_back(new UnanchoredNode(oss.str(),
+                                           "control",
+                                           kRegArgGateEgrControlName));    
+}
+
+// What a replica of reg stores for each update: a 32-bit value in the lo
+// half and the count of its updates in the hi half, or both halves of a
+// 64-bit value, which then count their updates in a version register
+static string replicaUpdates(const string& regMeta, P4RegisterNode* reg) {
+    ostringstream oss;
+    if (reg->width_ == 64) {
+        oss << "  update_hi_1_value : " << regMeta << kP4rRegMetadataOutputHiSuffix << ";\n";
+    } else {
+        oss << "  update_hi_1_value : register_hi + 1;\n";
+    }
+    oss << "  update_lo_1_value : " << regMeta << kP4rRegMetadataOutputSuffix << ";\n";
+    return oss.str();
+}
+
+// Version register of a replica of a 64-bit reg, entry i counts the updates
+// of entry i of the replica.  Returns the statement the replica action
+// counts them with, the replica is addressed by execute.
+static string generateReplicaVersion(vector<AstNode*>* newNodes, const string& replica, int instanceCount,
+                                     const string& execute) {
+    string version = replica + kP4rRegVersionSuffix;
+    ostringstream oss;
+    oss << "register " << version << "{\n"
+        << "  width : 32;\n"
+        << "  instance_count : " << instanceCount << ";\n"
+        << "}\n\n";
+    newNodes->push_back(new UnanchoredNode(oss.str(), "register", version));
+
+    oss.str("");
+    oss << "blackbox stateful_alu " << kP4rRegReplicasBlackboxPrefix << version << "{\n"
+        << "  reg : " << version << ";\n"
+        << "  update_lo_1_value : register_lo + 1;\n"
+        << "}\n\n";
+    newNodes->push_back(new UnanchoredNode(oss.str(), "blackbox", kP4rRegReplicasBlackboxPrefix+version));
+
+    return "  " + string(kP4rRegReplicasBlackboxPrefix) + version + execute + ";\n";
+}
+
+// Blocks of dirtyBlock entries covering reg, and the width of their index
+static int dirtyBlocks(P4RegisterNode* reg, int dirtyBlock) {
+    return (reg->instanceCount_ + dirtyBlock - 1) / dirtyBlock;
+}
+
+static int dirtyBlockWidth(P4RegisterNode* reg, int dirtyBlock) {
+    return max(int(ceil(log2(dirtyBlocks(reg, dirtyBlock)))), 1);
+}
+
+// Bit (block << 1) | mv of the dirty bitmap of reg is set with every update
+// of the replica for mv, block being index / dirtyBlock.  Returns the
+// statement the replica actions set it with.
+static string generateDirtyBits(vector<AstNode*>* newNodes, P4RegisterNode* reg, bool forIng, int dirtyBlock) {
+    const string& regName = reg->name_->toString();
+    string regMeta = string(forIng ? kP4rIngRegMetadataName : kP4rEgrRegMetadataName) + "." + regName;
+    string mv = string(forIng ? kP4rIngMetadataName : kP4rEgrMetadataName) + ".__mv";
+    int numBlocks = dirtyBlocks(reg, dirtyBlock);
+    int blockWidth = dirtyBlockWidth(reg, dirtyBlock);
+    string dirty = regName + kP4rRegDirtySuffix;
+
+    ostringstream oss;
+    oss << "register " << dirty << "{\n"
+        << "  width : 1;\n"
+        << "  instance_count : " << 2*numBlocks << ";\n"
+        << "}\n\n";
+    newNodes->push_back(new UnanchoredNode(oss.str(), "register", dirty));
+
+    oss.str("");
+    oss << "blackbox stateful_alu " << kP4rRegReplicasBlackboxPrefix << dirty << "{\n"
+        << "  reg : " << dirty << ";\n"
+        << "  update_lo_1_value : set_bit;\n"
+        << "}\n\n";
+    newNodes->push_back(new UnanchoredNode(oss.str(), "blackbox", kP4rRegReplicasBlackboxPrefix+dirty));
+
+    oss.str("");
+    oss << "field_list " << kP4rRegReplicasFlPrefix << dirty << "{\n"
+        << regMeta << kP4rRegMetadataBlockSuffix << ";\n"
+        << mv << ";\n"
+        << "}\n\n"
+        << "field_list_calculation " << kP4rRegReplicasFlcPrefix << dirty << " {\n"
+        << "  input {\n"
+        << "    " << kP4rRegReplicasFlPrefix << dirty << ";\n"
+        << "  }\n"
+        << "  algorithm : identity;\n"
+        << "  output_width : " << blockWidth + 1 << ";\n"
+        << "}\n\n";
+    newNodes->push_back(new UnanchoredNode(oss.str(), "field_list_calculation", kP4rRegReplicasFlcPrefix+dirty));
+
+    return "  " + string(kP4rRegReplicasBlackboxPrefix) + dirty + ".execute_stateful_alu_from_hash(" +
+           kP4rRegReplicasFlcPrefix + dirty + ");\n";
+}
+
+// One replica of twice the entries, entry (index << 1) | mv mirrors entry
+// index for mv.  The identity hash of index and mv addresses it, so one
+// stateful alu, action and table serve both values of mv.
+static void generateSingleRegReplica(vector<AstNode*>* newNodes, P4RegisterNode* reg, bool forIng,
+                                     const string& dirtyStmt) {
+    const string& regName = reg->name_->toString();
+    string regMeta = string(forIng ? kP4rIngRegMetadataName : kP4rEgrRegMetadataName) + "." + regName;
+    string mv = string(forIng ? kP4rIngMetadataName : kP4rEgrMetadataName) + ".__mv";
+    int indexWidth = max(int(ceil(log2(reg->instanceCount_))), 1);
+    string replica = regName + kP4rRegReplicasSuffix;
+
+    ostringstream oss;
+    oss << "register " << replica << "{\n"
+        << "  width : 64;\n"
+        << "  instance_count : " << 2*reg->instanceCount_ << ";\n"
+        << "}\n\n";
+    newNodes->push_back(new UnanchoredNode(oss.str(), "register", replica));
+
+    oss.str("");
+    oss << "blackbox stateful_alu " << kP4rRegReplicasBlackboxPrefix << replica << "{\n"
+        << "  reg : " << replica << ";\n"
+        << replicaUpdates(regMeta, reg)
+        << "}\n\n";
+    newNodes->push_back(new UnanchoredNode(oss.str(), "blackbox", kP4rRegReplicasBlackboxPrefix+replica));
+
+    oss.str("");
+    oss << "field_list " << kP4rRegReplicasFlPrefix << replica << "{\n"
+        << regMeta << kP4rRegMetadataIndexSuffix << ";\n"
+        << mv << ";\n"
+        << "}\n\n"
+        << "field_list_calculation " << kP4rRegReplicasFlcPrefix << replica << " {\n"
+        << "  input {\n"
+        << "    " << kP4rRegReplicasFlPrefix << replica << ";\n"
+        << "  }\n"
+        << "  algorithm : identity;\n"
+        << "  output_width : " << indexWidth + 1 << ";\n"
+        << "}\n\n";
+    newNodes->push_back(new UnanchoredNode(oss.str(), "field_list_calculation", kP4rRegReplicasFlcPrefix+replica));
+
+    string execute = string(".execute_stateful_alu_from_hash(") + kP4rRegReplicasFlcPrefix + replica + ")";
+    string versionStmt;
+    if (reg->width_ == 64) {
+        versionStmt = generateReplicaVersion(newNodes, replica, 2*reg->instanceCount_, execute);
+    }
+
+    oss.str("");
+    oss << "action " << kP4rRegReplicasActionPrefix << replica << "(){\n"
+        << "  " << kP4rRegReplicasBlackboxPrefix << replica << execute << ";\n"
+        << versionStmt
+        << dirtyStmt
+        << "}\n\n";
+    newNodes->push_back(new UnanchoredNode(oss.str(), "action", kP4rRegReplicasActionPrefix+replica));
+
+    oss.str("");
+    oss << "table " << kP4rRegReplicasTablePrefix << replica << "{\n"
+        << "  actions {\n"
+        << "    " << kP4rRegReplicasActionPrefix << replica << ";\n"
+        << "}\n"
+        << "  default_action: " << kP4rRegReplicasActionPrefix << replica << "();\n"
+        << "}\n\n";
+    newNodes->push_back(new UnanchoredNode(oss.str(), "table", kP4rRegReplicasTablePrefix+replica));
 }
 
 void generateDupRegArgProg(vector<AstNode*>* newNodes,
-                         vector<AstNode*>* nodeArray,
+                         const SymbolTable& symbols,
                          const vector<ReactionArgNode*>& reaction_args,
-                         int ing_iso_opt, int egr_iso_opt) {
+                         int ing_iso_opt, int egr_iso_opt, bool singleReplica, int dirtyBlock) {
     ostringstream oss;
-    vector<P4RegisterNode*> regNodes = findP4RegisterNode(*nodeArray);
-    vector<P4ExprNode*> blackboxes = findBlackbox(*nodeArray);
 
     for (auto ra : reaction_args) {
         if (ra->argType_==ReactionArgNode::REGISTER) {
-            if ((findRegargInIng(ra, *nodeArray) && (((unsigned int)ing_iso_opt) & 0b1)) || 
-                (!findRegargInIng(ra, *nodeArray) && (((unsigned int)egr_iso_opt) & 0b1))
+            if ((findRegargInIng(ra, symbols) && (((unsigned int)ing_iso_opt) & 0b1)) || 
+                (!findRegargInIng(ra, symbols) && (((unsigned int)egr_iso_opt) & 0b1))
                 ) {
                 PRINT_VERBOSE("Duplicate for %s\n", ra->toString().c_str());
             } else {
@@ -598,108 +985,156 @@ void generateDupRegArgProg(vector<AstNode*>* newNodes,
         } else {
             continue;
         }
-        for(auto reg : regNodes) {
-            if(reg->name_->toString().compare(ra->toString())==0) {
-                // Duplicate registers
-                oss.str(""); 
-                oss << "register " << reg->name_->toString() << kP4rRegReplicasSuffix0
-                    << "{\n"
-                    << "  width : 64;\n"
-                    << "  instance_count : " << reg->instanceCount_ << ";\n"
-                    << "}\n\n";
-                newNodes->push_back(new UnanchoredNode(new string(oss.str()),
-                                                   new string("register"),
-                                                   new string(reg->name_->toString()+kP4rRegReplicasSuffix0)));         
-                oss.str("");
-                oss << "register " << reg->name_->toString() << kP4rRegReplicasSuffix1
-                    << "{\n"
-                    << "  width : 64;\n"
-                    << "  instance_count : " << reg->instanceCount_ << ";\n"
-                    << "}\n\n";  
-                newNodes->push_back(new UnanchoredNode(new string(oss.str()),
-                                                   new string("register"),
-                                                   new string(reg->name_->toString()+kP4rRegReplicasSuffix1)));
-
-                // Duplicate blackbox
-                // Currently assuming 32b reg with only LO, for 64b, extra tstamp reg required
-                oss.str("");
-                oss << "blackbox stateful_alu " << kP4rRegReplicasBlackboxPrefix << reg->name_->toString() << kP4rRegReplicasSuffix0
-                    << "{\n"
-                    << "  reg : " << reg->name_->toString() << kP4rRegReplicasSuffix0 << ";\n"
-                    << "  update_hi_1_value : register_hi + 1;\n"
-                    << "  update_lo_1_value : " << kP4rIngRegMetadataName << "." << reg->name_->toString() << kP4rRegMetadataOutputSuffix << ";\n"
-                    << "}\n\n";
-                newNodes->push_back(new UnanchoredNode(new string(oss.str()),
-                                                   new string("blackbox"),
-                                                   new string(kP4rRegReplicasBlackboxPrefix+reg->name_->toString()+kP4rRegReplicasSuffix0)));                        
-
-                oss.str("");
-                oss << "blackbox stateful_alu " << kP4rRegReplicasBlackboxPrefix << reg->name_->toString() << kP4rRegReplicasSuffix1
-                    << "{\n"
-                    << "  reg : " << reg->name_->toString() << kP4rRegReplicasSuffix1 << ";\n"
-                    << "  update_hi_1_value : register_hi + 1;\n"
-                    << "  update_lo_1_value : " << kP4rIngRegMetadataName << "." << reg->name_->toString() << kP4rRegMetadataOutputSuffix << ";\n"
-                    << "}\n\n";
-                newNodes->push_back(new UnanchoredNode(new string(oss.str()),
-                                                   new string("blackbox"),
-                                                   new string(kP4rRegReplicasBlackboxPrefix+reg->name_->toString()+kP4rRegReplicasSuffix1)));    
-
-                // Duplicate actions
-                oss.str("");
-                oss << "action " << kP4rRegReplicasActionPrefix << reg->name_->toString() << kP4rRegReplicasSuffix0 << "(){\n"
-                    << "  " << kP4rRegReplicasBlackboxPrefix << reg->name_->toString() << kP4rRegReplicasSuffix0 
-                    << ".execute_stateful_alu("
-                    << kP4rIngRegMetadataName << "." << reg->name_->toString() << kP4rRegMetadataIndexSuffix
-                    << ");\n"
-                    << "}\n\n";
-                newNodes->push_back(new UnanchoredNode(new string(oss.str()),
-                                                   new string("action"),
-                                                   new string(kP4rRegReplicasActionPrefix+reg->name_->toString()+kP4rRegReplicasSuffix0)));    
-
-                oss.str("");
-                oss << "action " << kP4rRegReplicasActionPrefix << reg->name_->toString() << kP4rRegReplicasSuffix1 << "(){\n"
-                    << "  " << kP4rRegReplicasBlackboxPrefix << reg->name_->toString() << kP4rRegReplicasSuffix1 
-                    << ".execute_stateful_alu("
-                    << kP4rIngRegMetadataName << "." << reg->name_->toString() << kP4rRegMetadataIndexSuffix
-                    << ");\n"
-                    << "}\n\n";
-                newNodes->push_back(new UnanchoredNode(new string(oss.str()),
-                                                   new string("action"),
-                                                   new string(kP4rRegReplicasActionPrefix+reg->name_->toString()+kP4rRegReplicasSuffix1)));    
-
-                // Duplicate tables
-                oss.str("");
-                oss << "table " << kP4rRegReplicasTablePrefix << reg->name_->toString() << kP4rRegReplicasSuffix0 << "{\n"
-                    << "  actions {\n"
-                    << "    " << kP4rRegReplicasActionPrefix << reg->name_->toString() << kP4rRegReplicasSuffix0 << ";\n"
-                    << "}\n"
-                    << "  default_action: " << kP4rRegReplicasActionPrefix << reg->name_->toString() << kP4rRegReplicasSuffix0 << "();\n"
-                    << "}\n\n";
-                newNodes->push_back(new UnanchoredNode(new string(oss.str()),
-                                                   new string("table"),
-                                                   new string(kP4rRegReplicasTablePrefix+reg->name_->toString()+kP4rRegReplicasSuffix0)));    
-
-                oss.str("");
-                oss << "table " << kP4rRegReplicasTablePrefix << reg->name_->toString() << kP4rRegReplicasSuffix1 << "{\n"
-                    << "  actions {\n"
-                    << "    " << kP4rRegReplicasActionPrefix << reg->name_->toString() << kP4rRegReplicasSuffix1 << ";\n"
-                    << "}\n"
-                    << "  default_action: " << kP4rRegReplicasActionPrefix << reg->name_->toString() << kP4rRegReplicasSuffix1 << "();\n"
-                    << "}\n\n";
-                newNodes->push_back(new UnanchoredNode(new string(oss.str()),
-                                                   new string("table"),
-                                                   new string(kP4rRegReplicasTablePrefix+reg->name_->toString()+kP4rRegReplicasSuffix1)));    
-
-                break;
-            }
+        P4RegisterNode* reg = symbols.reg(ra->toString());
+        if(reg == NULL) {
+            continue;
+        }
+        string dirtyStmt;
+        if (dirtyBlock > 0) {
+            dirtyStmt = generateDirtyBits(newNodes, reg, findRegargInIng(ra, symbols), dirtyBlock);
+        }
+        if (singleReplica) {
+            generateSingleRegReplica(newNodes, reg, findRegargInIng(ra, symbols), dirtyStmt);
+            continue;
+        }
+        // Duplicate registers
+        oss.str(""); 
+        oss << "register " << reg->name_->toString() << kP4rRegReplicasSuffix0
+            << "{\n"
+            << "  width : 64;\n"
+            << "  instance_count : " << reg->instanceCount_ << ";\n"
+            << "}\n\n";
+        newNodes->push_back(new UnanchoredNode(oss.str(),
+                                           "register",
+                                           reg->name_->toString()+kP4rRegReplicasSuffix0));         
+        oss.str("");
+        oss << "register " << reg->name_->toString() << kP4rRegReplicasSuffix1
+            << "{\n"
+            << "  width : 64;\n"
+            << "  instance_count : " << reg->instanceCount_ << ";\n"
+            << "}\n\n";  
+        newNodes->push_back(new UnanchoredNode(oss.str(),
+                                           "register",
+                                           reg->name_->toString()+kP4rRegReplicasSuffix1));
+
+        // Duplicate blackbox
+        string regMeta = string(kP4rIngRegMetadataName) + "." + reg->name_->toString();
+        oss.str("");
+        oss << "blackbox stateful_alu " << kP4rRegReplicasBlackboxPrefix << reg->name_->toString() << kP4rRegReplicasSuffix0
+            << "{\n"
+            << "  reg : " << reg->name_->toString() << kP4rRegReplicasSuffix0 << ";\n"
+            << replicaUpdates(regMeta, reg)
+            << "}\n\n";
+        newNodes->push_back(new UnanchoredNode(oss.str(),
+                                           "blackbox",
+                                           kP4rRegReplicasBlackboxPrefix+reg->name_->toString()+kP4rRegReplicasSuffix0));                        
+
+        oss.str("");
+        oss << "blackbox stateful_alu " << kP4rRegReplicasBlackboxPrefix << reg->name_->toString() << kP4rRegReplicasSuffix1
+            << "{\n"
+            << "  reg : " << reg->name_->toString() << kP4rRegReplicasSuffix1 << ";\n"
+            << replicaUpdates(regMeta, reg)
+            << "}\n\n";
+        newNodes->push_back(new UnanchoredNode(oss.str(),
+                                           "blackbox",
+                                           kP4rRegReplicasBlackboxPrefix+reg->name_->toString()+kP4rRegReplicasSuffix1));    
+
+        // 64b regs count the updates of both replicas in version registers
+        string execute = string(".execute_stateful_alu(") + regMeta + kP4rRegMetadataIndexSuffix + ")";
+        string versionStmt0, versionStmt1;
+        if (reg->width_ == 64) {
+            versionStmt0 = generateReplicaVersion(newNodes, reg->name_->toString() + kP4rRegReplicasSuffix0,
+                                                  reg->instanceCount_, execute);
+            versionStmt1 = generateReplicaVersion(newNodes, reg->name_->toString() + kP4rRegReplicasSuffix1,
+                                                  reg->instanceCount_, execute);
         }
+
+        // Duplicate actions
+        oss.str("");
+        oss << "action " << kP4rRegReplicasActionPrefix << reg->name_->toString() << kP4rRegReplicasSuffix0 << "(){\n"
+            << "  " << kP4rRegReplicasBlackboxPrefix << reg->name_->toString() << kP4rRegReplicasSuffix0 
+            << ".execute_stateful_alu("
+            << kP4rIngRegMetadataName << "." << reg->name_->toString() << kP4rRegMetadataIndexSuffix
+            << ");\n"
+            << versionStmt0
+            << dirtyStmt
+            << "}\n\n";
+        newNodes->push_back(new UnanchoredNode(oss.str(),
+                                           "action",
+                                           kP4rRegReplicasActionPrefix+reg->name_->toString()+kP4rRegReplicasSuffix0));    
+
+        oss.str("");
+        oss << "action " << kP4rRegReplicasActionPrefix << reg->name_->toString() << kP4rRegReplicasSuffix1 << "(){\n"
+            << "  " << kP4rRegReplicasBlackboxPrefix << reg->name_->toString() << kP4rRegReplicasSuffix1 
+            << ".execute_stateful_alu("
+            << kP4rIngRegMetadataName << "." << reg->name_->toString() << kP4rRegMetadataIndexSuffix
+            << ");\n"
+            << versionStmt1
+            << dirtyStmt
+            << "}\n\n";
+        newNodes->push_back(new UnanchoredNode(oss.str(),
+                                           "action",
+                                           kP4rRegReplicasActionPrefix+reg->name_->toString()+kP4rRegReplicasSuffix1));    
+
+        // Duplicate tables
+        oss.str("");
+        oss << "table " << kP4rRegReplicasTablePrefix << reg->name_->toString() << kP4rRegReplicasSuffix0 << "{\n"
+            << "  actions {\n"
+            << "    " << kP4rRegReplicasActionPrefix << reg->name_->toString() << kP4rRegReplicasSuffix0 << ";\n"
+            << "}\n"
+            << "  default_action: " << kP4rRegReplicasActionPrefix << reg->name_->toString() << kP4rRegReplicasSuffix0 << "();\n"
+            << "}\n\n";
+        newNodes->push_back(new UnanchoredNode(oss.str(),
+                                           "table",
+                                           kP4rRegReplicasTablePrefix+reg->name_->toString()+kP4rRegReplicasSuffix0));    
+
+        oss.str("");
+        oss << "table " << kP4rRegReplicasTablePrefix << reg->name_->toString() << kP4rRegReplicasSuffix1 << "{\n"
+            << "  actions {\n"
+            << "    " << kP4rRegReplicasActionPrefix << reg->name_->toString() << kP4rRegReplicasSuffix1 << ";\n"
+            << "}\n"
+            << "  default_action: " << kP4rRegReplicasActionPrefix << reg->name_->toString() << kP4rRegReplicasSuffix1 << "();\n"
+            << "}\n\n";
+        newNodes->push_back(new UnanchoredNode(oss.str(),
+                                           "table",
+                                           kP4rRegReplicasTablePrefix+reg->name_->toString()+kP4rRegReplicasSuffix1));    
+
     }                       
 }      
 
+// The value a half ("hi" or "lo") of a 64-bit register takes with every
+// update when it is a field or constant, NULL when it depends on the
+// register or on a condition
+static BodyWordNode* plainUpdate(P4StatefulAluNode* blackbox, const string& half) {
+    if (blackbox->attribute("update_" + half + "_2_value") != NULL ||
+        blackbox->attribute("update_" + half + "_1_predicate") != NULL) {
+        return NULL;
+    }
+    P4AttributeNode* update = blackbox->attribute("update_" + half + "_1_value");
+    if (update == NULL) {
+        // Never updated, the half keeps its initial value
+        update = blackbox->attribute("initial_register_" + half + "_value");
+        if (update == NULL) {
+            return new BodyWordNode(BodyWordNode::STRING, new StrNode(intern("0")));
+        }
+    }
+    // An integer, or a field as header . field
+    const vector<BodyWordNode*>& value = update->value_;
+    if (value.size() == 1 && value[0]->wordType_ == BodyWordNode::INTEGER) {
+        return value[0]->deepCopy();
+    }
+    if (value.size() == 3 && value[0]->wordType_ == BodyWordNode::NAME &&
+        value[1]->contents_->toString() == "." && value[2]->wordType_ == BodyWordNode::NAME) {
+        string field = value[0]->contents_->toString() + "." + value[2]->contents_->toString();
+        return new BodyWordNode(BodyWordNode::STRING, new StrNode(intern(field)));
+    }
+    return NULL;
+}
+
 void augmentRegisterArgProgForIng(vector<AstNode*>* newNodes,
-                         vector<AstNode*>* nodeArray,
+                         const SymbolTable& symbols,
                          const vector<ReactionArgNode*>& reaction_args,
-                         int iso_opt, bool forIng) {
+                         int iso_opt, bool forIng, int dirtyBlock) {
     string p4rRegMetadataType;
     string p4rRegMetadataName;
     if(forIng) {
@@ -715,28 +1150,42 @@ void augmentRegisterArgProgForIng(vector<AstNode*>* newNodes,
         ostringstream oss;
         oss << "header_type "<< p4rRegMetadataType << " {\n"
             << " fields {\n";        
-        vector<P4RegisterNode*> regNodes = findP4RegisterNode(*nodeArray);
+
+        // Registers whose updates also mark their block dirty, and 64b
+        // registers, mirrored in two halves
+        set<string> dirtyRegs;
+        set<string> wideRegs;
 
         for (auto ra : reaction_args) {    
             if (ra->argType_==ReactionArgNode::REGISTER) {
                 if(forIng) {
-                    if(!findRegargInIng(ra, *nodeArray)) {
+                    if(!findRegargInIng(ra, symbols)) {
                         continue;
                     }
                 } else {
-                    if(findRegargInIng(ra, *nodeArray)) {
+                    if(findRegargInIng(ra, symbols)) {
                         continue;
                     }
                 }
-                for(auto reg : regNodes) {
-                    if(reg->name_->toString().compare(ra->toString())==0) {
+                P4RegisterNode* reg = symbols.reg(ra->toString());
+                if(reg != NULL) {
+                    // A 64b register is mirrored in two 32b halves
+                    if(reg->width_ == 64) {
+                        oss << "  " << ra->toString() << kP4rRegMetadataOutputSuffix << "  : 32;\n";
+                        oss << "  " << ra->toString() << kP4rRegMetadataOutputHiSuffix << "  : 32;\n";
+                        wideRegs.insert(ra->toString());
+                    } else {
                         oss << "  " << ra->toString() << kP4rRegMetadataOutputSuffix << "  : "<< reg->width_ << ";\n";
-                        int index_width = int(ceil(log2(reg->instanceCount_)));
-                        if (index_width==0) {
-                            index_width = 1;
-                        }
-                        oss << "  " << ra->toString() << kP4rRegMetadataIndexSuffix << "  : "<< index_width << ";\n";
-                        break;
+                    }
+                    int index_width = int(ceil(log2(reg->instanceCount_)));
+                    if (index_width==0) {
+                        index_width = 1;
+                    }
+                    oss << "  " << ra->toString() << kP4rRegMetadataIndexSuffix << "  : "<< index_width << ";\n";
+                    if (dirtyBlock > 0) {
+                        oss << "  " << ra->toString() << kP4rRegMetadataBlockSuffix << "  : "
+                            << dirtyBlockWidth(reg, dirtyBlock) << ";\n";
+                        dirtyRegs.insert(ra->toString());
                     }
                 }
             }
@@ -747,33 +1196,21 @@ void augmentRegisterArgProgForIng(vector<AstNode*>* newNodes,
         oss << "metadata " << p4rRegMetadataType << " "
                            << p4rRegMetadataName << ";\n\n";
 
-        newNodes->push_back(new UnanchoredNode(new string(oss.str()),
-                                               new string("metadata"),
-                                               new string(p4rRegMetadataName)));
+        newNodes->push_back(new UnanchoredNode(oss.str(),
+                                               "metadata",
+                                               p4rRegMetadataName));
 
         // Transform original blackbox program 
-        // Currently assume the reg to isolation has no HI member and no output instruction
+        // Currently assume the reg to isolation has no output instruction, a
+        // 64b reg has one half updated with a field or constant
         // If original blackbox has output instruction already, just mirror that the output meta data
 
-        vector<P4ExprNode*> blackboxes = findBlackbox(*nodeArray);
-        for (auto blackbox : blackboxes) {
-            std::string prog_name = blackbox->name2_->toString();
-            std::stringstream ss(blackbox->body_->toString());
-            std::string reg_name;
-            std::string item;
-            while (std::getline(ss, item, ';'))
-            {
-                std::stringstream ss_(item);
-                std::string item_;
-                while (std::getline(ss_, item_, ':')) {
-                    boost::algorithm::trim(item_);
-                    if(item_.compare("reg")==0) {
-                        std::getline(ss_, item_, ':');
-                        boost::algorithm::trim(item_);
-                        reg_name = item_;
-                    }
-                }
+        for (auto blackbox : findStatefulAlus(symbols.nodes())) {
+            const std::string& prog_name = blackbox->name();
+            if (blackbox->reg() == NULL) {
+                continue;
             }
+            const std::string& reg_name = *blackbox->reg();
             ostringstream oss_dst_field, oss_index_field;
             oss_dst_field << p4rRegMetadataName
                              << "."
@@ -783,60 +1220,136 @@ void augmentRegisterArgProgForIng(vector<AstNode*>* newNodes,
                             << "."
                             << reg_name
                             << kP4rRegMetadataIndexSuffix;                                      
-            ostringstream oss_cmd;
-            oss_cmd << "  " << "output_value : alu_lo;\n"
-                    << "  " << "output_dst : "
-                    << oss_dst_field.str()
-                    << ";\n";
-            string newbodystr = blackbox->body_->toString()+oss_cmd.str();
-            blackbox->body_ = new BodyNode(NULL, NULL, new BodyWordNode(BodyWordNode::STRING, new StrNode(new string(newbodystr))));
+
+            // Of a 64b reg, the alu outputs a half depending on the register
+            // and the action copies the other half as it updates it
+            const char* output_value = "alu_lo";
+            BodyWordNode* copied = NULL;
+            string copied_field;
+            if (wideRegs.count(reg_name) > 0) {
+                copied = plainUpdate(blackbox, "hi");
+                copied_field = p4rRegMetadataName + "." + reg_name + kP4rRegMetadataOutputHiSuffix;
+                if (copied == NULL) {
+                    copied = plainUpdate(blackbox, "lo");
+                    if (copied == NULL) {
+                        PANIC("Isolating 64-bit register %s needs one half updated with a field or constant only\n",
+                              reg_name.c_str());
+                    }
+                    output_value = "alu_hi";
+                    copied_field = oss_dst_field.str();
+                    oss_dst_field.str("");
+                    oss_dst_field << p4rRegMetadataName << "." << reg_name << kP4rRegMetadataOutputHiSuffix;
+                }
+            }
+            blackbox->addAttribute(intern("output_value"), {
+                new BodyWordNode(BodyWordNode::NAME, new NameNode(intern(output_value)))});
+            blackbox->addAttribute(intern("output_dst"), {
+                new BodyWordNode(BodyWordNode::NAME, new NameNode(intern(oss_dst_field.str())))});
 
             // Singleton action that executes the prog
             // Locate the action that executes the stateful prog and mirror the index to meta
-            bool transformed = false;
-            for (auto tmp_node : *nodeArray) {
-                if(typeContains(tmp_node, "ActionNode") && !typeContains(tmp_node, "P4R")) {
-                    ActionNode* tmp_action_node = dynamic_cast<ActionNode*>(tmp_node);
-                    string tmp_action_name = tmp_action_node->name_->toString();
-                    ActionStmtsNode* actionstmts = tmp_action_node->stmts_;
-                    for (ActionStmtNode* as : *actionstmts->list_) {
-                        if(as->toString().find("execute_stateful_alu")!=string::npos &&
-                            as->toString().find(prog_name)!=string::npos) {
-                            // Extract the index or index metadata/field
-                            unsigned first = as->toString().find("(");
-                            unsigned last = as->toString().find(")");
-                            string index = as->toString().substr (first+1,last-first-1);
-                            
-                            // Mirror the index to p4r reg metadata
-                            auto tmp_args = new ArgsNode();
-                            tmp_args->push_back(new BodyWordNode(
-                                BodyWordNode::STRING,
-                                new StrNode(new string(oss_index_field.str()))));
-                            tmp_args->push_back(new BodyWordNode(
+            const vector<ActionNode*>& executing = symbols.actionsExecuting(prog_name);
+            if (executing.empty()) {
+                continue;
+            }
+            ActionStmtsNode* actionstmts = executing.front()->stmts_;
+            if (copied != NULL) {
+                auto copy_args = new ArgsNode();
+                copy_args->push_back(new BodyWordNode(BodyWordNode::STRING, new StrNode(intern(copied_field))));
+                copy_args->push_back(copied);
+                actionstmts->push_back(new ActionStmtNode(new NameNode(intern("modify_field")), copy_args,
+                                                          ActionStmtNode::NAME_ARGLIST, NULL, NULL));
+            }
+            for (ActionStmtNode* as : *actionstmts->list_) {
+                if(as->executesStatefulAlu() && *as->name1_->word_ == prog_name) {
+                    // Executed without an index, the index field keeps 0
+                    BodyWordNode* index = as->aluIndex();
+                    if (index == NULL) {
+                        break;
+                    }
+
+                    // Mirror the index to p4r reg metadata
+                    auto tmp_args = new ArgsNode();
+                    tmp_args->push_back(new BodyWordNode(
+                        BodyWordNode::STRING,
+                        new StrNode(intern(oss_index_field.str()))));
+                    tmp_args->push_back(index->deepCopy());
+                    actionstmts->push_back(new ActionStmtNode(
+                                                new NameNode(intern("modify_field")),
+                                                tmp_args,
+                                                ActionStmtNode::NAME_ARGLIST,
+                                                NULL,
+                                                NULL
+                                            ));     
+
+                    // And its block, index / dirtyBlock
+                    if (dirtyRegs.count(reg_name) > 0) {
+                        int shift = int(log2(dirtyBlock));
+                        auto block_args = new ArgsNode();
+                        block_args->push_back(new BodyWordNode(
+                            BodyWordNode::STRING,
+                            new StrNode(intern(p4rRegMetadataName + "." + reg_name + kP4rRegMetadataBlockSuffix))));
+                        block_args->push_back(index->deepCopy());
+                        if (shift > 0) {
+                            block_args->push_back(new BodyWordNode(
                                 BodyWordNode::STRING,
-                                new StrNode(new string(index))));                            
-                            actionstmts->push_back(new ActionStmtNode(
-                                                        new NameNode(new string("modify_field")),
-                                                        tmp_args,
-                                                        ActionStmtNode::NAME_ARGLIST,
-                                                        NULL,
-                                                        NULL
-                                                    ));     
-                            transformed = true;
-                            break;
+                                new StrNode(intern(to_string(shift)))));
                         }
+                        actionstmts->push_back(new ActionStmtNode(
+                                                    new NameNode(intern(shift > 0 ? "shift_right" : "modify_field")),
+                                                    block_args,
+                                                    ActionStmtNode::NAME_ARGLIST,
+                                                    NULL,
+                                                    NULL
+                                                ));
                     }
-                    if (transformed) {
-                        break;
-                    }
+                    break;
                 }
             }
         }
     }
 }
 
+// Nodes the exact packing search may visit before settling for first fit
+static const int kBinPackBudget = 1 << 20;
+
+// Places items[next..] into the bins, whose loads are fills.  Items come
+// by decreasing size, an item is not tried in a bin as full as one it was
+// already tried in, which also leaves the empty bins but the first alone.
+static bool packArgsInto(const vector<ReactionArgSize>& items, const vector<int>& sizeLeft,
+                         size_t next, vector<int>* fills, vector<int>* binOf, int* budget) {
+    if (next == items.size()) {
+        return true;
+    }
+    int space = 0;
+    for (int fill : *fills) {
+        space += REGISTER_SIZE - fill;
+    }
+    if (sizeLeft[next] > space || --(*budget) < 0) {
+        return false;
+    }
+    int size = items[next].second;
+    for (size_t b = 0; b < fills->size(); ++b) {
+        int fill = (*fills)[b];
+        if (fill + size > REGISTER_SIZE ||
+            find(fills->begin(), fills->begin() + b, fill) != fills->begin() + b) {
+            continue;
+        }
+        (*fills)[b] += size;
+        (*binOf)[next] = b;
+        if (packArgsInto(items, sizeLeft, next + 1, fills, binOf, budget)) {
+            return true;
+        }
+        (*fills)[b] -= size;
+    }
+    return false;
+}
+
+// Fewest bins of REGISTER_SIZE bits holding the field arguments of one
+// pipeline.  First fit decreasing, unless it misses the lower bound of the
+// total size and a search in the budget finds a packing with fewer bins.
 static vector<ReactionArgBin> runBinPackForIng(
-            vector<pair<ReactionArgNode*, int> >* argSizes, vector<AstNode*> nodeArray, bool forIng) {
+            vector<pair<ReactionArgNode*, int> >* argSizes, const NodeRegistry& nodeArray, bool forIng) {
 
     sort(argSizes->begin(), argSizes->end(),
             [](const pair<ReactionArgNode*, int>& l,
@@ -847,7 +1360,8 @@ static vector<ReactionArgBin> runBinPackForIng(
                 return l.first > r.first;
             });
 
-    vector<ReactionArgBin> bins;
+    vector<ReactionArgSize> items;
+    int totalSize = 0;
     for (const pair<ReactionArgNode*, int>& p : *argSizes) {
         assert(p.second <= REGISTER_SIZE);
 
@@ -861,7 +1375,12 @@ static vector<ReactionArgBin> runBinPackForIng(
                 continue;
             }
         }
+        items.push_back(p);
+        totalSize += p.second;
+    }
 
+    vector<ReactionArgBin> bins;
+    for (const ReactionArgSize& p : items) {
         bool added = false;
         for (ReactionArgBin& bin : bins) {
             if (p.second + bin.second <= REGISTER_SIZE) {
@@ -879,11 +1398,41 @@ static vector<ReactionArgBin> runBinPackForIng(
         }
     }
 
+    int lowerBound = (totalSize + REGISTER_SIZE - 1) / REGISTER_SIZE;
+    if (bins.size() <= lowerBound) {
+        return bins;
+    }
+    vector<int> sizeLeft(items.size() + 1, 0);
+    for (int i = (int)items.size() - 1; i >= 0; --i) {
+        sizeLeft[i] = sizeLeft[i + 1] + items[i].second;
+    }
+    int budget = kBinPackBudget;
+    for (int numBins = lowerBound; numBins < bins.size() && budget > 0; ++numBins) {
+        vector<int> fills(numBins, 0);
+        vector<int> binOf(items.size(), -1);
+        if (!packArgsInto(items, sizeLeft, 0, &fills, &binOf, &budget)) {
+            continue;
+        }
+        // Bins are opened in order, items keep decreasing size in each
+        vector<ReactionArgBin> packed(numBins);
+        for (size_t i = 0; i < items.size(); ++i) {
+            packed[binOf[i]].first.push_back(items[i]);
+            packed[binOf[i]].second += items[i].second;
+        }
+        PRINT_VERBOSE("Packed %d field args into %d bins, first fit took %d\n",
+                      items.size(), numBins, bins.size());
+        return packed;
+    }
     return bins;
 }
 
+int numArgRegisters(const vector<ReactionArgBin>& bins, bool paired) {
+    return paired ? (bins.size() + 1) / 2 : bins.size();
+}
+
 static void generateArgRegistersForIng(vector<AstNode*>* newNodes,
-                          const vector<ReactionArgBin>& bins, int ing_iso_opt, bool forIng) {
+                          const vector<ReactionArgBin>& bins, int ing_iso_opt, bool forIng, bool paired,
+                          bool merged) {
     string p4rArgHdrName;
     string p4rMetaName;
     string p4rSetArgsTableNameBase;
@@ -906,39 +1455,68 @@ static void generateArgRegistersForIng(vector<AstNode*>* newNodes,
         p4rSetArgsRegNameBase = "__reSetArgs";
     }
 
-    for (int i = 0; i < bins.size(); ++i) {
+    // Both copies of the registers are set under isolation
+    string aluIndex = (((unsigned int)ing_iso_opt) & 0b1) ? p4rMetaName + ".__mv" : "0";
+    int numRegs = numArgRegisters(bins, paired);
+    for (int i = 0; i < numRegs; ++i) {
+        // Bin in the lo half, and in the hi half of a 64-bit register
+        int lo = paired ? 2*i : i;
+        int hi = paired && 2*i+1 < bins.size() ? 2*i+1 : -1;
         ostringstream oss;
-        oss << "table " << p4rSetArgsTableNameBase << i << " {\n"
-            << "  actions { " << p4rSetArgsActionNameBase << i << "; }\n"
-            << "  default_action : " << p4rSetArgsActionNameBase << i << "();\n"
-            << "}\n\n"
-            << "action " << p4rSetArgsActionNameBase << i << "() {\n";
-        if (((unsigned int)ing_iso_opt) & 0b1) {
-            oss << "  " << p4rSetArgsBlackboxNameBase << i << ".execute_stateful_alu("<< p4rMetaName << ".__mv);\n";
-        } else {
-            oss << "  " << p4rSetArgsBlackboxNameBase << i << ".execute_stateful_alu(0);\n";
+        if (!merged) {
+            oss << "table " << p4rSetArgsTableNameBase << i << " {\n"
+                << "  actions { " << p4rSetArgsActionNameBase << i << "; }\n"
+                << "  default_action : " << p4rSetArgsActionNameBase << i << "();\n"
+                << "}\n\n"
+                << "action " << p4rSetArgsActionNameBase << i << "() {\n"
+                << "  " << p4rSetArgsBlackboxNameBase << i << ".execute_stateful_alu(" << aluIndex << ");\n"
+                << "}\n\n";
         }
-        oss << "}\n\n"
-            << "blackbox stateful_alu " << p4rSetArgsBlackboxNameBase << i << " {\n"
+        oss << "blackbox stateful_alu " << p4rSetArgsBlackboxNameBase << i << " {\n"
             << "  reg : " << p4rSetArgsRegNameBase << i << ";\n"
             << "  update_lo_1_value : " << p4rArgHdrName
-                                       << ".reg" << i << ";\n"
-            << "}\n\n"
+                                       << ".reg" << lo << ";\n";
+        if (hi >= 0) {
+            oss << "  update_hi_1_value : " << p4rArgHdrName
+                                           << ".reg" << hi << ";\n";
+        }
+        oss << "}\n\n"
             << "register " << p4rSetArgsRegNameBase << i << " {\n"
-            << "  width : " << bins[i].second << ";\n"
+            << "  width : " << (hi >= 0 ? 2*REGISTER_SIZE : bins[lo].second) << ";\n"
             << "  instance_count : 2;\n"
             << "}\n\n";
 
-        auto newSetArgsNode = new UnanchoredNode(new string(oss.str()),
-                                                 new string("table"),
-                                                 new string("__tiSetArgs"));
+        auto newSetArgsNode = new UnanchoredNode(oss.str(),
+                                                 "table",
+                                                 "__tiSetArgs");
         newNodes->push_back(newSetArgsNode);
     }
+    if (!merged) {
+        return;
+    }
+
+    // The alus only depend on the packing, one table executes as many as
+    // a stage holds
+    for (int g = 0; g*STATEFUL_ALUS_PER_STAGE < numRegs; ++g) {
+        string tableName = p4rSetArgsTableNameBase + "Stage" + std::to_string(g);
+        string actionName = p4rSetArgsActionNameBase + "Stage" + std::to_string(g);
+        ostringstream oss;
+        oss << "table " << tableName << " {\n"
+            << "  actions { " << actionName << "; }\n"
+            << "  default_action : " << actionName << "();\n"
+            << "}\n\n"
+            << "action " << actionName << "() {\n";
+        for (int i = g*STATEFUL_ALUS_PER_STAGE; i < numRegs && i < (g+1)*STATEFUL_ALUS_PER_STAGE; ++i) {
+            oss << "  " << p4rSetArgsBlackboxNameBase << i << ".execute_stateful_alu(" << aluIndex << ");\n";
+        }
+        oss << "}\n\n";
+        newNodes->push_back(new UnanchoredNode(oss.str(), "table", tableName));
+    }
 }
 
 
 static vector<MblRefNode*> generatePackingTablesForIng(vector<AstNode*>* newNodes,
-                                          const vector<ReactionArgBin>& bins, bool forIng) {
+                                          const vector<ReactionArgBin>& bins, bool forIng, bool merged) {
     vector<MblRefNode*> reactionArgRefs;
 
     string p4rArgHdrType;
@@ -975,26 +1553,26 @@ static vector<MblRefNode*> generatePackingTablesForIng(vector<AstNode*>* newNode
             << "metadata " << p4rArgHdrType << " "
                            << p4rArgHdrName << ";\n\n";
     auto packedMetaNode = new UnanchoredNode(
-            new string(oss_fld.str()), new string("metadata"),
-            new string(p4rArgHdrType));
+            oss_fld.str(), "metadata",
+            p4rArgHdrType);
     newNodes->push_back(packedMetaNode);
 
-    // Synthesize table/action for each pack
+    // Synthesize table/action for each pack, or one for all packs when merged
+    ActionStmtsNode* aiPackStmts = NULL;
     for (int i = 0; i < bins.size(); ++i) {
-        // Generate packing table
-        auto tiPackName = new NameNode(new string(p4rPackTableNameBase+std::to_string(i)));
-        auto tiPackReads = new TableReadStmtsNode();
-        auto tiPackActions = new TableActionStmtsNode();
-        tiPackActions->push_back(
-                new TableActionStmtNode(new NameNode(new string(p4rPackActionNameBase+std::to_string(i)))));
-        auto tiPackTable = new TableNode(tiPackName, tiPackReads, tiPackActions,
-                                        "  default_action : "+p4rPackActionNameBase+std::to_string(i)+"();\nsize:1;", "");
-        newNodes->push_back(tiPackTable);
-
-        // Generate packing action
-        auto aiPackName = new NameNode(new string(p4rPackActionNameBase+std::to_string(i)));
-        auto aiPackParams = new ActionParamsNode();
-        auto aiPackStmts = new ActionStmtsNode(); 
+        string packSuffix = merged ? "" : std::to_string(i);
+        if (!merged || i == 0) {
+            // Generate packing table
+            auto tiPackName = new NameNode(intern(p4rPackTableNameBase+packSuffix));
+            auto tiPackReads = new TableReadStmtsNode();
+            auto tiPackActions = new TableActionStmtsNode();
+            tiPackActions->push_back(
+                    new TableActionStmtNode(new NameNode(intern(p4rPackActionNameBase+packSuffix))));
+            auto tiPackTable = new TableNode(tiPackName, tiPackReads, tiPackActions,
+                                            "  default_action : "+p4rPackActionNameBase+packSuffix+"();\nsize:1;", "");
+            newNodes->push_back(tiPackTable);
+            aiPackStmts = new ActionStmtsNode();
+        }
 
         // Actual size of the reg (<= 32)
         int regsize = 0;
@@ -1007,9 +1585,9 @@ static vector<MblRefNode*> generatePackingTablesForIng(vector<AstNode*>* newNode
             int width = bins[i].first[j].second;
             regsize += width;
 
-            if (typeContains(arg, "FieldNode")) {
+            if (arg->isKind(FIELD_NODE)) {
                 oss_fl << arg->toString() << ";\n";
-            } else if (typeContains(arg, "MblRefNode")) {
+            } else if (arg->isKind(MBL_REF_NODE)) {
                 oss_fl << arg->toString() << ";\n";
                 // Mark this ref for future processing
                 // Currently not supporting field list and hash duplication
@@ -1023,8 +1601,8 @@ static vector<MblRefNode*> generatePackingTablesForIng(vector<AstNode*>* newNode
         oss_fl << "\n}\n\n";
         newNodes->push_back(
             new UnanchoredNode(
-                new string(oss_fl.str()), new string("field_list"),
-                new string("field_list"+std::to_string(i)))
+                oss_fl.str(), "field_list",
+                "field_list"+std::to_string(i))
         );  
 
         // Generate field_list_calculation
@@ -1039,13 +1617,13 @@ static vector<MblRefNode*> generatePackingTablesForIng(vector<AstNode*>* newNode
 
         newNodes->push_back(
             new UnanchoredNode(
-                new string(oss_flc.str()), new string("field_list_calc"),
-                new string(p4rPackFlcNameBase+std::to_string(i)))
+                oss_flc.str(), "field_list_calc",
+                p4rPackFlcNameBase+std::to_string(i))
         ); 
 
         // Example: modify_field_with_hash_based_offset(dst, 0, __flce_packedArgs_reg0, 4294967296);
         // Note: alternative approach using (modify - shift_left - add_to_field) would not fit into a single action due to data plane constraints
-        auto aiPackStmtName = new NameNode(new string("modify_field_with_hash_based_offset"));
+        auto aiPackStmtName = new NameNode(intern("modify_field_with_hash_based_offset"));
         auto aiPackStmtArgs = new ArgsNode();
         // dst
         ostringstream oss_postfix;
@@ -1053,31 +1631,35 @@ static vector<MblRefNode*> generatePackingTablesForIng(vector<AstNode*>* newNode
         BodyWordNode* targetBodyWord = new BodyWordNode(
             BodyWordNode::FIELD,
                 new FieldNode(
-                    new NameNode(new string(p4rArgHdrName)),
-                    new NameNode(new string(oss_postfix.str()))));
+                    new NameNode(intern(p4rArgHdrName)),
+                    new NameNode(intern(oss_postfix.str()))));
         aiPackStmtArgs->push_back(targetBodyWord);
         // base
         aiPackStmtArgs->push_back(
                 new BodyWordNode(
                     BodyWordNode::INTEGER,
-                    new IntegerNode(new string(to_string(0))))); 
+                    new IntegerNode(intern(to_string(0))))); 
         // __calc_packedArgs_regx
         aiPackStmtArgs->push_back(
                 new BodyWordNode(
                     BodyWordNode::STRING,
-                    new StrNode(new string(p4rPackFlcNameBase+std::to_string(i)))));             
+                    new StrNode(intern(p4rPackFlcNameBase+std::to_string(i)))));             
         // size (power of 2)           
         aiPackStmtArgs->push_back(
                 new BodyWordNode(
                     BodyWordNode::INTEGER,
-                    new IntegerNode(new string(to_string((long long)(pow(2, regsize))))))); 
+                    new IntegerNode(intern(to_string((long long)(pow(2, regsize))))))); 
 
         aiPackStmts->push_back(
                 new ActionStmtNode(aiPackStmtName, aiPackStmtArgs, ActionStmtNode::NAME_ARGLIST, NULL, NULL));        
         
-        auto aiPackAction = new ActionNode(aiPackName, aiPackParams, aiPackStmts);
-        auto aiPackActionWrapper = new InputNode(NULL, aiPackAction);
-        newNodes->push_back(aiPackActionWrapper);
+        if (!merged || i == bins.size()-1) {
+            // Generate packing action
+            auto aiPackName = new NameNode(intern(p4rPackActionNameBase+packSuffix));
+            auto aiPackAction = new ActionNode(aiPackName, new ActionParamsNode(), aiPackStmts);
+            auto aiPackActionWrapper = new InputNode(NULL, aiPackAction);
+            newNodes->push_back(aiPackActionWrapper);
+        }
     }
     
     return reactionArgRefs;
@@ -1089,7 +1671,7 @@ vector<ReactionArgBin> generateIngDigestPacking(
             const HeaderDecsMap& headerDecsMap,
             const unordered_map<string, P4RMalleableValueNode*>& mblValues,
             const unordered_map<string, P4RMalleableFieldNode*>& mblFields,
-            const vector<AstNode*>& astNodes, int* ing_iso_opt) {
+            SymbolTable* symbols, int* ing_iso_opt, bool pairArgBins, bool mergeArgTables) {
     if (reaction_args.size() == 0) {
         return vector<ReactionArgBin>();
     }
@@ -1098,18 +1680,18 @@ vector<ReactionArgBin> generateIngDigestPacking(
             findAllReactionArgSizes(reaction_args, headerDecsMap, mblValues,
                                     mblFields);
 
-    // Currently pack arguments into 32-bit bins
-    // Note HW target could support 64-bit reg --- further reducing the number of packed regs by half (therefore latency)
-    vector<ReactionArgBin> argBins = runBinPackForIng(&argSizes, astNodes, true);
-    vector<MblRefNode*> mblRefs = generatePackingTablesForIng(newNodes, argBins, true);
+    // Pack arguments into 32-bit bins, paired into 64-bit registers to halve
+    // the reads in the dialogue
+    vector<ReactionArgBin> argBins = runBinPackForIng(&argSizes, symbols->nodes(), true);
+    vector<MblRefNode*> mblRefs = generatePackingTablesForIng(newNodes, argBins, true, mergeArgTables);
 
     // Update meas isolation option
-    if(argBins.size()<=1) {
-        vector<ReactionArgNode*> reaction_args = findReactionArgs(astNodes);
+    if(numArgRegisters(argBins, pairArgBins)<=1) {
+        vector<ReactionArgNode*> reaction_args = findReactionArgs(symbols->nodes());
         bool has_regarg = false;
         for (auto ra : reaction_args) {    
             if (ra->argType_==ReactionArgNode::REGISTER) {
-                if(findRegargInIng(ra, astNodes)) {
+                if(findRegargInIng(ra, *symbols)) {
                     has_regarg = true;
                 }
             }    
@@ -1124,11 +1706,11 @@ vector<ReactionArgBin> generateIngDigestPacking(
         }
     }
 
-    generateArgRegistersForIng(newNodes, argBins, *ing_iso_opt, true);
+    generateArgRegistersForIng(newNodes, argBins, *ing_iso_opt, true, pairArgBins, mergeArgTables);
 
     // Redo the transformations to capture any malleable references in the generated code
     PRINT_VERBOSE("Found %d generated malleable refs for ing\n", mblRefs.size());
-    transformMalleableRefs(&mblRefs, mblValues, mblFields, newNodes);
+    transformMalleableRefs(&mblRefs, mblValues, mblFields, symbols);
 
     return argBins;
 }
@@ -1139,7 +1721,7 @@ vector<ReactionArgBin> generateEgrDigestPacking(
             const HeaderDecsMap& headerDecsMap,
             const unordered_map<string, P4RMalleableValueNode*>& mblValues,
             const unordered_map<string, P4RMalleableFieldNode*>& mblFields,
-            const vector<AstNode*>& astNodes, int* egr_iso_opt) {
+            SymbolTable* symbols, int* egr_iso_opt, bool pairArgBins, bool mergeArgTables) {
     if (reaction_args.size() == 0) {
         return vector<ReactionArgBin>();
     }
@@ -1149,16 +1731,16 @@ vector<ReactionArgBin> generateEgrDigestPacking(
             findAllReactionArgSizes(reaction_args, headerDecsMap, mblValues,
                                     mblFields);
 
-    vector<ReactionArgBin> argBins = runBinPackForIng(&argSizes, astNodes, false);
-    vector<MblRefNode*> mblRefs = generatePackingTablesForIng(newNodes, argBins, false);
+    vector<ReactionArgBin> argBins = runBinPackForIng(&argSizes, symbols->nodes(), false);
+    vector<MblRefNode*> mblRefs = generatePackingTablesForIng(newNodes, argBins, false, mergeArgTables);
 
     // Update meas isolation
-    if(argBins.size()<=1) {
-        vector<ReactionArgNode*> reaction_args = findReactionArgs(astNodes);
+    if(numArgRegisters(argBins, pairArgBins)<=1) {
+        vector<ReactionArgNode*> reaction_args = findReactionArgs(symbols->nodes());
         bool has_regarg = false;
         for (auto ra : reaction_args) {    
             if (ra->argType_==ReactionArgNode::REGISTER) {
-                if(findRegargInIng(ra, astNodes)) {
+                if(findRegargInIng(ra, *symbols)) {
                     has_regarg = true;
                 }
             }    
@@ -1173,10 +1755,10 @@ vector<ReactionArgBin> generateEgrDigestPacking(
         }
     }
 
-    generateArgRegistersForIng(newNodes, argBins, *egr_iso_opt, false);
+    generateArgRegistersForIng(newNodes, argBins, *egr_iso_opt, false, pairArgBins, mergeArgTables);
 
     PRINT_VERBOSE("Found %d generated malleable refs for egr\n", mblRefs.size());
-    transformMalleableRefs(&mblRefs, mblValues, mblFields, newNodes);
+    transformMalleableRefs(&mblRefs, mblValues, mblFields, symbols);
 
     return argBins;
 }
@@ -1216,6 +1798,11 @@ void generateMetadata(vector<AstNode*>* newNodes,
         }
         oss << "  " << kv.first << kP4rIndexSuffix << " : "
             << indexWidth << ";" << endl;
+        if (kv.second->selected()) {
+            // The selected alt, for exact reads and factored actions
+            oss << "  " << kv.first << kP4rSelectSuffix << " : "
+                << kv.second->varWidth_->val_->toString() << ";" << endl;
+        }
     }
 
     oss << " }" << endl;
@@ -1223,9 +1810,9 @@ void generateMetadata(vector<AstNode*>* newNodes,
     oss << "metadata " << kP4rIngMetadataType << " "
                        << kP4rIngMetadataName << ";\n\n";
 
-    newNodes->push_back(new UnanchoredNode(new string(oss.str()),
-                                           new string("metadata"),
-                                           new string(kP4rIngMetadataName)));
+    newNodes->push_back(new UnanchoredNode(oss.str(),
+                                           "metadata",
+                                           kP4rIngMetadataName));
     // Egr
     oss.str("");
     oss << "header_type "<< kP4rEgrMetadataType << " {\n"
@@ -1239,9 +1826,9 @@ void generateMetadata(vector<AstNode*>* newNodes,
     oss << "metadata " << kP4rEgrMetadataType << " "
                        << kP4rEgrMetadataName << ";\n\n";
 
-    newNodes->push_back(new UnanchoredNode(new string(oss.str()),
-                                           new string("metadata"),
-                                           new string(kP4rEgrMetadataName)));    
+    newNodes->push_back(new UnanchoredNode(oss.str(),
+                                           "metadata",
+                                           kP4rEgrMetadataName));    
 }
 
 int generateInitTableForIng(unordered_map<string, int>* mblUsages,
@@ -1373,30 +1960,64 @@ int generateInitTableForIng(unordered_map<string, int>* mblUsages,
         << "  size : 1;\n"
         << "}\n\n";
 
-    string* codeStr = new string(oss.str());
-    string* objType = new string("table");
-    string* tableName = new string(p4rSetVarTblName);
-
-    newNodes->push_back(new UnanchoredNode(codeStr, objType, tableName));
+    newNodes->push_back(new UnanchoredNode(oss.str(), "table", p4rSetVarTblName));
 
     return num_vars;
 }
 
-void generateSetvarControl(vector<AstNode*>* newNodes) {
+void generateSetvarControl(vector<AstNode*>* newNodes,
+                           const unordered_map<string, P4RMalleableFieldNode*>& mblFields) {
     ostringstream oss;
     oss << "control "<< kSetmblIngControlName << " {\n";
     oss << "  apply(__tiSetVars);\n";
+    // Copy the selected alt of fields read exactly or by factored actions,
+    // one keyless table per alt behind the gateway on the alt index
+    for (auto kv : mblFields) {
+        if (!kv.second->selected()) {
+            continue;
+        }
+        vector<FieldNode*> alts = findAllAlts(*kv.second);
+        for (int i = 0; i < alts.size(); ++i) {
+            string selectName = "Select_" + kv.first + "_" + std::to_string(i);
+            ostringstream oss_select;
+            oss_select << "table __ti" << selectName << " {\n"
+                       << "  actions { __ai" << selectName << "; }\n"
+                       << "  default_action : __ai" << selectName << "();\n"
+                       << "}\n\n"
+                       << "action __ai" << selectName << "() {\n"
+                       << "  modify_field(" << kP4rIngMetadataName << "." << kv.first << kP4rSelectSuffix
+                                            << ", " << alts[i]->toString() << ");\n"
+                       << "}\n\n";
+            newNodes->push_back(new UnanchoredNode(oss_select.str(), "table", "__ti"+selectName));
+
+            if (alts.size() == 1) {
+                oss << "  apply(__ti" << selectName << ");\n";
+                continue;
+            }
+            oss << (i == 0 ? "  " : " else ");
+            if (i < alts.size()-1) {
+                oss << "if (" << kP4rIngMetadataName << "." << kv.first << kP4rIndexSuffix
+                    << " == " << kv.second->mapAltToInt(alts[i]->toString()) << ") ";
+            }
+            oss << "{\n"
+                << "    apply(__ti" << selectName << ");\n"
+                << "  }";
+            if (i == alts.size()-1) {
+                oss << "\n";
+            }
+        }
+    }
     oss << "}\n\n";
-    newNodes->push_back(new UnanchoredNode(new string(oss.str()),
-                                           new string("control"),
-                                           new string(kSetmblIngControlName)));
+    newNodes->push_back(new UnanchoredNode(oss.str(),
+                                           "control",
+                                           kSetmblIngControlName));
 
     oss.str("");
     oss << "control "<< kSetmblEgrControlName << " {\n";
     oss << "  apply(__teSetVars);\n";
     oss << "}\n\n";
-    newNodes->push_back(new UnanchoredNode(new string(oss.str()),
-                                           new string("control"),
-                                           new string(kSetmblEgrControlName)));
+    newNodes->push_back(new UnanchoredNode(oss.str(),
+                                           "control",
+                                           kSetmblEgrControlName));
 
 }
\ No newline at end of file
@@ -16,21 +16,23 @@
 #ifndef COMPILE_P4_H
 #define COMPILE_P4_H
 
+#include <set>
 #include <unordered_map>
 #include <vector>
 
-#define REGISTER_SIZE 32
-
-typedef pair<ReactionArgNode*, int /* size */> ReactionArgSize;
-typedef pair<vector<ReactionArgSize>, int /* size */> ReactionArgBin;
+#include "../../include/compile.h"
 
-void transformPragma(vector<AstNode*>* astNodes);
+#define REGISTER_SIZE 32
+// Tofino limits on what one match-action stage holds
+#define STATEFUL_ALUS_PER_STAGE 4
+#define TABLES_PER_STAGE 16
+#define NUM_STAGES 12
 
-int inferIsoOptForIng(vector<AstNode*>* astNodes, bool forIng);
+int inferIsoOptForIng(const NodeRegistry& astNodes, const SymbolTable& symbols, bool forIng);
 
-bool augmentIngress(vector<AstNode*>* astNodes);
+bool augmentIngress(NodeRegistry* astNodes);
 
-bool augmentEgress(vector<AstNode*>* astNodes);
+bool augmentEgress(NodeRegistry* astNodes);
 
 enum USAGE {
     INGRESS = 0,
@@ -38,38 +40,62 @@ enum USAGE {
     BOTH = 2
 };
 void findMalleableUsage(
-            vector<MblRefNode*> mblRefs,
-            const unordered_map<string, P4RMalleableValueNode*> mblValues,
-            const unordered_map<string, P4RMalleableFieldNode*> mblFields,
-            vector<AstNode*>* nodeArray,
+            const vector<MblRefNode*>& mblRefs,
+            const SymbolTable& symbols,
             unordered_map<string, int>* mblUsages);
 
+// Actions referring to malleable fields are duplicated once per combination
+// of their alts.  Past maxActionCopies copies, the fields an ingress action
+// only reads are read from a helper field the selected alt is copied to
+// instead (see generateSetvarControl), unless a table applied before may
+// write an alt or an alt does not fit the helper field.  The other fields
+// are still duplicated by
+// transformMalleableRefs.  Appends the factored actions with
+// the copies that saved.
+void factorMalleableActions(const vector<MblRefNode*>& mblRefs,
+                            const unordered_map<string, P4RMalleableFieldNode*>& mblFields,
+                            const SymbolTable& symbols, int maxActionCopies,
+                            vector<pair<string, int> >* factoredActions);
+
 void transformMalleableRefs(
             vector<MblRefNode*>* mblRefs,
             const unordered_map<string, P4RMalleableValueNode*>& mblValues,
             const unordered_map<string, P4RMalleableFieldNode*>& mblFields,
-            vector<AstNode*>* nodeArray);
+            SymbolTable* symbols);
 
 void transformMalleableTables(
-            unordered_map<string, P4RMalleableTableNode*>* mblTables, vector<AstNode*> nodeArray, int ing_iso_opt, int egr_iso_opt);
+            unordered_map<string, P4RMalleableTableNode*>* mblTables, const SymbolTable& symbols, int ing_iso_opt, int egr_iso_opt);
 
 void generateExportControl(vector<AstNode*>* newNodes,
-                           const vector<ReactionArgBin>& argBins, const vector<ReactionArgBin>& argBinsEgr);
+                           const vector<ReactionArgBin>& argBins, const vector<ReactionArgBin>& argBinsEgr,
+                           bool pairArgBins, bool mergeArgTables);
+
+// Tables exporting the field arguments of both pipelines, and the stages
+// of the pipeline taking more
+ArgExportCost argExportCost(const vector<ReactionArgBin>& argBinsIng, const vector<ReactionArgBin>& argBinsEgr,
+                            bool pairArgBins, bool mergeArgTables);
 
 void augmentRegisterArgProgForIng(vector<AstNode*>* newNodes,
-                         vector<AstNode*>* nodeArray,
+                         const SymbolTable& symbols,
                          const vector<ReactionArgNode*>& reaction_args,
-                         int iso_opt, bool forIng);
+                         int iso_opt, bool forIng, int dirtyBlock);
 
 void generateRegArgGateControl(vector<AstNode*>* newNodes,
-                         vector<AstNode*>* nodeArray,
+                         const SymbolTable& symbols,
                          const vector<ReactionArgNode*>& reaction_args,
-                         int isolation_opt, int egr_iso_opt);
+                         int isolation_opt, int egr_iso_opt, bool singleReplica);
 
+// Replicas of the register arguments for measurement isolation, two per
+// register or a single one of twice the entries, see RegReplicaLayout.  With
+// dirtyBlock, their updates also set a bit per block of that many entries.
 void generateDupRegArgProg(vector<AstNode*>* newNodes,
-                         vector<AstNode*>* nodeArray,
+                         const SymbolTable& symbols,
                          const vector<ReactionArgNode*>& reaction_args,
-                         int isolation_opt, int egr_iso_opt);
+                         int isolation_opt, int egr_iso_opt, bool singleReplica, int dirtyBlock);
+
+// Registers the bins are read from, the bins 2i and 2i+1 share the lo and
+// hi half of the 64-bit register i when paired
+int numArgRegisters(const vector<ReactionArgBin>& bins, bool paired);
 
 vector<ReactionArgBin> generateIngDigestPacking(
             vector<AstNode*>* newNodes,
@@ -77,8 +103,10 @@ vector<ReactionArgBin> generateIngDigestPacking(
             const HeaderDecsMap& headerDecsMap,
             const unordered_map<string, P4RMalleableValueNode*>& mblValues,
             const unordered_map<string, P4RMalleableFieldNode*>& mblFields,
-            const vector<AstNode*>& astNodes,
-            int* ing_iso_opt);
+            SymbolTable* symbols,
+            int* ing_iso_opt,
+            bool pairArgBins,
+            bool mergeArgTables);
 
 vector<ReactionArgBin> generateEgrDigestPacking(
             vector<AstNode*>* newNodes,
@@ -86,8 +114,10 @@ vector<ReactionArgBin> generateEgrDigestPacking(
             const HeaderDecsMap& headerDecsMap,
             const unordered_map<string, P4RMalleableValueNode*>& mblValues,
             const unordered_map<string, P4RMalleableFieldNode*>& mblFields,
-            const vector<AstNode*>& astNodes,
-            int* egr_iso_opt);
+            SymbolTable* symbols,
+            int* egr_iso_opt,
+            bool pairArgBins,
+            bool mergeArgTables);
 
 // Generate metadata for dynamic malleables
 void generateMetadata(vector<AstNode*>* newNodes,
@@ -106,6 +136,7 @@ int generateInitTableForIng(unordered_map<string, int>* mblUsages,
                                                  P4RMalleableFieldNode*>& mblFields,
                              int iso_opt, bool forIng);
 
-void generateSetvarControl(vector<AstNode*>* newNodes);
+void generateSetvarControl(vector<AstNode*>* newNodes,
+                           const unordered_map<string, P4RMalleableFieldNode*>& mblFields);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,157 @@
+/* Copyright 2020-present University of Pennsylvania
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include "../../include/compile_stats.h"
+
+using namespace std;
+
+// Allocations are counted per thread, so passes and compilations running
+// side by side each see their own
+static thread_local size_t heapBytes = 0;
+static thread_local size_t heapAllocs = 0;
+
+void* operator new(size_t size) {
+    heapBytes += size;
+    heapAllocs++;
+    void* ptr = malloc(size == 0 ? 1 : size);
+    if (ptr == NULL) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
+size_t threadHeapBytes() {
+    return heapBytes;
+}
+
+size_t threadHeapAllocs() {
+    return heapAllocs;
+}
+
+static void add(PassStats* sum, const PassStats& pass) {
+    sum->seconds_ += pass.seconds_;
+    sum->nodes_ += pass.nodes_;
+    sum->arenaBytes_ += pass.arenaBytes_;
+    sum->heapBytes_ += pass.heapBytes_;
+    sum->heapAllocs_ += pass.heapAllocs_;
+}
+
+static void formatText(string* out, const string& label, const PassStats& pass,
+                       bool withTime, bool withMem) {
+    char line[256];
+    snprintf(line, sizeof(line), "  %-40s", (pass.cached_ ? label + " (cached)" : label).c_str());
+    *out += line;
+    if (withTime) {
+        snprintf(line, sizeof(line), " %10.3f ms", pass.seconds_ * 1e3);
+        *out += line;
+    }
+    if (withMem) {
+        snprintf(line, sizeof(line), " %9zu %12zu %12zu %10zu",
+                 pass.nodes_, pass.arenaBytes_, pass.heapBytes_, pass.heapAllocs_);
+        *out += line;
+    }
+    *out += "\n";
+}
+
+static void formatJson(string* out, const PassStats& pass, bool withTime, bool withMem) {
+    char line[256];
+    snprintf(line, sizeof(line), "{\"phase\": \"%s\", \"name\": \"%s\"",
+             pass.phase_.c_str(), pass.name_.c_str());
+    *out += line;
+    if (withTime) {
+        snprintf(line, sizeof(line), ", \"ms\": %.3f", pass.seconds_ * 1e3);
+        *out += line;
+    }
+    if (withMem) {
+        snprintf(line, sizeof(line), ", \"nodes\": %zu, \"arena_bytes\": %zu, \"heap_bytes\": %zu, \"heap_allocs\": %zu",
+                 pass.nodes_, pass.arenaBytes_, pass.heapBytes_, pass.heapAllocs_);
+        *out += line;
+    }
+    if (pass.cached_) {
+        *out += ", \"cached\": true";
+    }
+    *out += "}";
+}
+
+string formatPassStats(const vector<PassStats>& passes, bool withTime, bool withMem, bool json) {
+    // Phases in the order they first ran
+    vector<PassStats> phases;
+    PassStats total;
+    total.phase_ = "total";
+    total.name_ = "total";
+    for (const PassStats& pass : passes) {
+        PassStats* phase = NULL;
+        for (PassStats& p : phases) {
+            if (p.phase_ == pass.phase_) {
+                phase = &p;
+            }
+        }
+        if (phase == NULL) {
+            phases.push_back(PassStats());
+            phase = &phases.back();
+            phase->phase_ = pass.phase_;
+            phase->name_ = pass.phase_;
+        }
+        add(phase, pass);
+        add(&total, pass);
+    }
+
+    string ret;
+    if (json) {
+        ret += "{\"passes\": [";
+        for (int i = 0; i < passes.size(); i++) {
+            ret += i == 0 ? "\n  " : ",\n  ";
+            formatJson(&ret, passes[i], withTime, withMem);
+        }
+        ret += "],\n \"phases\": [";
+        for (int i = 0; i < phases.size(); i++) {
+            ret += i == 0 ? "\n  " : ",\n  ";
+            formatJson(&ret, phases[i], withTime, withMem);
+        }
+        ret += "],\n \"total\": ";
+        formatJson(&ret, total, withTime, withMem);
+        ret += "}\n";
+        return ret;
+    }
+
+    char line[256];
+    snprintf(line, sizeof(line), "  %-40s", "pass");
+    ret += line;
+    if (withTime) {
+        ret += "       time";
+    }
+    if (withMem) {
+        ret += "     nodes  arena bytes   heap bytes     allocs";
+    }
+    ret += "\n";
+    for (const PassStats& phase : phases) {
+        for (const PassStats& pass : passes) {
+            if (pass.phase_ == phase.phase_) {
+                formatText(&ret, pass.phase_ + "/" + pass.name_, pass, withTime, withMem);
+            }
+        }
+        formatText(&ret, phase.phase_ + " total", phase, withTime, withMem);
+    }
+    formatText(&ret, "total", total, withTime, withMem);
+    return ret;
+}
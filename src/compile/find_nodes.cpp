@@ -13,25 +13,18 @@
  * limitations under the License.
  */
 
-#include <regex>
 #include <unordered_map>
 
 #include "../../include/ast_nodes.h"
 #include "../../include/ast_nodes_p4.h"
 #include "../../include/ast_nodes_p4r.h"
+#include "../../include/node_registry.h"
+#include "../../include/symbol_table.h"
 #include "../../include/helper.h"
 
 #include "compile_const.h"
 
 
-bool typeContains(AstNode* n, const char* type) {
-    if (n->nodeType_.find(string(type)) != string::npos) {
-        return true;    
-    } else {
-        return false;
-    }
-}
-
 bool p4KeywordMatches(P4ExprNode* n, const char* type) {
     if (n->keyword_->word_->compare(string(type)) == 0) {
         return true;    
@@ -40,97 +33,86 @@ bool p4KeywordMatches(P4ExprNode* n, const char* type) {
     }
 }
 
-P4ExprNode* findIngress(const std::vector<AstNode*>& astNodes) {
-    for (auto node : astNodes) {
-        if (typeContains(node, "P4ExprNode")) {
-            P4ExprNode* exprNode = dynamic_cast<P4ExprNode*>(node);
-            // Might be called after ing transformation
-            if (exprNode->name1_->toString().find("ingress") != string::npos || exprNode->name1_->toString().find(string(kOrigIngControlName)) != string::npos) {
-                return exprNode;
-            }
+P4ExprNode* findIngress(const NodeRegistry& astNodes) {
+    for (auto node : astNodes.ofKind(P4_EXPR_NODE)) {
+        P4ExprNode* exprNode = dynamic_cast<P4ExprNode*>(node);
+        if (!p4KeywordMatches(exprNode, "control")) {
+            continue;
+        }
+        // Might be called after ing transformation
+        if (exprNode->name1_->toString().compare("ingress") == 0 || exprNode->name1_->toString().compare(kOrigIngControlName) == 0) {
+            return exprNode;
         }
     }
 
     return NULL;
 }
 
-P4ExprNode* findEgress(const std::vector<AstNode*>& astNodes) {
-    for (auto node : astNodes) {
-        if (typeContains(node, "P4ExprNode")) {
-            P4ExprNode* exprNode = dynamic_cast<P4ExprNode*>(node);
-            if (exprNode->name1_->toString().find("egress") != string::npos || exprNode->name1_->toString().find(string(kOrigEgrControlName)) != string::npos) {
-                return exprNode;
-            }
+P4ExprNode* findEgress(const NodeRegistry& astNodes) {
+    for (auto node : astNodes.ofKind(P4_EXPR_NODE)) {
+        P4ExprNode* exprNode = dynamic_cast<P4ExprNode*>(node);
+        if (!p4KeywordMatches(exprNode, "control")) {
+            continue;
+        }
+        if (exprNode->name1_->toString().compare("egress") == 0 || exprNode->name1_->toString().compare(kOrigEgrControlName) == 0) {
+            return exprNode;
         }
     }
 
     return NULL;
 }
 
-vector<P4ExprNode*> findBlackbox(const std::vector<AstNode*>& astNodes) {
-    vector<P4ExprNode*> ret;
-    for (auto node : astNodes) {
-        if (typeContains(node, "P4ExprNode")) {
-            P4ExprNode* exprNode = dynamic_cast<P4ExprNode*>(node);
-            if (exprNode->keyword_->toString().find("blackbox") != string::npos) {
-                ret.push_back(exprNode);
-            }
-        }
-    }
-    return ret;
+vector<P4StatefulAluNode*> findStatefulAlus(const NodeRegistry& astNodes) {
+    return astNodes.allOf<P4StatefulAluNode>(P4_STATEFUL_ALU_NODE);
 }
 
 void findAndRemoveMalleables(
             unordered_map<string, P4RMalleableValueNode*>* mblValues,
             unordered_map<string, P4RMalleableFieldNode*>* mblFields,
             unordered_map<string, P4RMalleableTableNode*>* mblTables,
-            const vector<AstNode*>& astNodes) {
+            const NodeRegistry& astNodes) {
     // Find all the Malleables
-    for (auto n : astNodes) {
-        if (typeContains(n, "P4RMalleableValueNode")) {
-            auto v = dynamic_cast<P4RMalleableValueNode*>(n);
-            mblValues->emplace(*v->name_->word_, v);
-            n->removed_ = true;
-        } else if (typeContains(n, "P4RMalleableFieldNode")) {
-            auto v = dynamic_cast<P4RMalleableFieldNode*>(n);
-            mblFields->emplace(*v->name_->word_, v);
-            n->removed_ = true;
-        } else if (typeContains(n, "P4RMalleableTableNode")) {
-            auto v = dynamic_cast<P4RMalleableTableNode*>(n);
-            mblTables->emplace(*v->table_->name_->word_, v);
-            // for a Malleable table, the parser will give both MalleableTableNode and TableNode, 
-            // we need to tag the latter as Malleable
-            v->table_->isMalleable_ = true;
-            n->removed_ = true;
-        } else if (typeContains(n, "P4RInitBlockNode")) {
-            n->removed_ = true;
-        }
+    for (auto n : astNodes.ofKind(P4R_MALLEABLE_VALUE_NODE)) {
+        auto v = dynamic_cast<P4RMalleableValueNode*>(n);
+        mblValues->emplace(*v->name_->word_, v);
+        n->removed_ = true;
+    }
+    for (auto n : astNodes.ofKind(P4R_MALLEABLE_FIELD_NODE)) {
+        auto v = dynamic_cast<P4RMalleableFieldNode*>(n);
+        mblFields->emplace(*v->name_->word_, v);
+        n->removed_ = true;
+    }
+    for (auto n : astNodes.ofKind(P4R_MALLEABLE_TABLE_NODE)) {
+        auto v = dynamic_cast<P4RMalleableTableNode*>(n);
+        mblTables->emplace(*v->table_->name_->word_, v);
+        // for a Malleable table, the parser will give both MalleableTableNode and TableNode, 
+        // we need to tag the latter as Malleable
+        v->table_->isMalleable_ = true;
+        n->removed_ = true;
+    }
+    for (auto n : astNodes.ofKind(P4R_INIT_BLOCK_NODE)) {
+        n->removed_ = true;
     }
 }
 
 void findMalleableRefs(vector<MblRefNode*>* varRefs,
-                      const vector<AstNode*>& astNodes) {
-    for (AstNode* node : astNodes) {
-        if (typeContains(node, "MblRefNode")) {
-            MblRefNode* varRef = dynamic_cast<MblRefNode*>(node);
-            varRefs->push_back(varRef);
-        }
+                      const NodeRegistry& astNodes) {
+    for (AstNode* node : astNodes.ofKind(MBL_REF_NODE)) {
+        varRefs->push_back(dynamic_cast<MblRefNode*>(node));
     }
 }
 
 unordered_map<TableActionStmtNode*, TableNode*> findTableActionStmts(
-            const vector<AstNode*>& astNodes, const string& actionName) {
+            const SymbolTable& symbols, const string& actionName) {
     auto ret = unordered_map<TableActionStmtNode*, TableNode*>();
 
-    for (auto node : astNodes) {
-        if (typeContains(node, "TableNode") && !typeContains(node, "P4R")) {
-            TableNode* table = dynamic_cast<TableNode*>(node);
-            TableActionStmtsNode* actions = table->actions_;
-            for (TableActionStmtNode* tas : *actions->list_) {
-                if (*tas->name_->word_ == actionName) {
-                    ret.emplace(tas, table);
-                    break;
-                }
+    // Names are interned, compare by pointer
+    const string* actionWord = intern(actionName);
+    for (TableNode* table : symbols.tablesListing(actionName)) {
+        for (TableActionStmtNode* tas : *table->actions_->list_) {
+            if (tas->name_->word_ == actionWord) {
+                ret.emplace(tas, table);
+                break;
             }
         }
     }
@@ -140,7 +122,7 @@ unordered_map<TableActionStmtNode*, TableNode*> findTableActionStmts(
 bool findTableReadStmt(const TableNode& table, const string& fieldName) {
     TableReadStmtsNode* reads = table.reads_;
     for (TableReadStmtNode* trs : *reads->list_) {
-        if (typeContains(trs->field_, "StrNode")) {
+        if (trs->field_->isKind(STR_NODE)) {
             StrNode* sn = dynamic_cast<StrNode*>(trs->field_);
             if (*sn->word_ == fieldName) {
                 return true;
@@ -173,72 +155,68 @@ void findAndTransformMblRefsInAction(ActionNode* action,
     }
 }
 
+vector<BodyWordNode*> findBodyWords(BodyNode* body) {
+    vector<BodyWordNode*> ret;
+    // Bodies are left-recursive, so collect the outer chain first instead of recursing on it
+    vector<BodyNode*> chain;
+    for (BodyNode* b = body; b != NULL; b = b->bodyOuter_) {
+        chain.push_back(b);
+    }
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+        if ((*it)->str_) {
+            ret.push_back((*it)->str_);
+        } else if ((*it)->bodyInner_) {
+            vector<BodyWordNode*> inner = findBodyWords((*it)->bodyInner_);
+            ret.insert(ret.end(), inner.begin(), inner.end());
+        }
+    }
+    return ret;
+}
+
 vector<FieldNode*> findAllAlts(const P4RMalleableFieldNode& malleable) {
     return vector<FieldNode*>(*malleable.varAlts_->fields_->list_);
 }
 
-P4RInitBlockNode* findInitBlock(std::vector<AstNode*> astNodes){
+P4RInitBlockNode* findInitBlock(const NodeRegistry& astNodes){
     // Currently get a single node, easily generalize to multiple distributed init/reaction block
-	for (auto node : astNodes) {
-		if (node->nodeType_.find(string("InitBlockNode")) != string::npos) {
-			P4RInitBlockNode * iNode = dynamic_cast<P4RInitBlockNode *>(node);
-			return iNode;
-		}
+	for (auto node : astNodes.ofKind(P4R_INIT_BLOCK_NODE)) {
+		return dynamic_cast<P4RInitBlockNode *>(node);
 	}
 	return 0;
 }
 
-P4RReactionNode* findReaction(std::vector<AstNode*> astNodes){
-	for (auto node : astNodes) {
-		if (node->nodeType_.find(string("ReactionNode")) != string::npos) {
-			P4RReactionNode * reactionNode = dynamic_cast<P4RReactionNode *>(node);
-			return reactionNode;
-		}
+P4RReactionNode* findReaction(const NodeRegistry& astNodes){
+	for (auto node : astNodes.ofKind(P4R_REACTION_NODE)) {
+		return dynamic_cast<P4RReactionNode *>(node);
 	}
 	return 0;
 }
 
-vector<P4RegisterNode*> findP4RegisterNode(const vector<AstNode*>& astNodes) {
-    vector<P4RegisterNode*> ret;
-    for (auto node : astNodes) {
-        if (typeContains(node, "P4RegisterNode")) {
-            ret.push_back(dynamic_cast<P4RegisterNode*>(node));
-        }
-    }
-    return ret;
+vector<P4RegisterNode*> findP4RegisterNode(const NodeRegistry& astNodes) {
+    return astNodes.allOf<P4RegisterNode>(P4_REGISTER_NODE);
 }
 
-vector<ReactionArgNode*> findReactionArgs(const vector<AstNode*>& astNodes) {
-    vector<ReactionArgNode*> ret;
+vector<ReactionArgNode*> findReactionArgs(const NodeRegistry& astNodes) {
     // Find all the argument nodes
-    for (auto node : astNodes) {
-        if (typeContains(node, "ReactionArgNode")) {
-            ret.push_back(dynamic_cast<ReactionArgNode*>(node));
-        }
-    }
-    return ret;
+    return astNodes.allOf<ReactionArgNode>(REACTION_ARG_NODE);
 }
 
 typedef unordered_map<string /* instanceName */,
                       std::vector<FieldDecNode*>*> HeaderDecsMap;
-HeaderDecsMap findHeaderDecs(const vector<AstNode*>& astNodes) {
+HeaderDecsMap findHeaderDecs(const NodeRegistry& astNodes) {
     unordered_map<string /* type */,
                   std::vector<FieldDecNode*>*> typeDecsMap;
-    for (auto node : astNodes) {
-        if (typeContains(node, "HeaderTypeDeclarationNode")) {
-            auto headerDecl = dynamic_cast<HeaderTypeDeclarationNode*>(node);
-            typeDecsMap.emplace(headerDecl->name_->toString(),
-                                headerDecl->field_decs_->list_);
-        }       
+    for (auto node : astNodes.ofKind(HEADER_TYPE_DECLARATION_NODE)) {
+        auto headerDecl = dynamic_cast<HeaderTypeDeclarationNode*>(node);
+        typeDecsMap.emplace(headerDecl->name_->toString(),
+                            headerDecl->field_decs_->list_);
     }
 
     HeaderDecsMap ret;
-    for (auto node : astNodes) {
-        if (typeContains(node, "HeaderInstanceNode")) {
-            auto headerInstance = dynamic_cast<HeaderInstanceNode*>(node);
-            auto fieldDecVector = typeDecsMap.at(*headerInstance->type_->word_);
-            ret.emplace(*headerInstance->name_->word_, fieldDecVector);
-        }
+    for (auto node : astNodes.ofKind(HEADER_INSTANCE_NODE)) {
+        auto headerInstance = dynamic_cast<HeaderInstanceNode*>(node);
+        auto fieldDecVector = typeDecsMap.at(*headerInstance->type_->word_);
+        ret.emplace(*headerInstance->name_->word_, fieldDecVector);
     }
 
     return ret;
@@ -257,7 +235,7 @@ vector<pair<ReactionArgNode*, int> > findAllReactionArgSizes(
         case ReactionArgNode::EGRESS_FIELD:
         case ReactionArgNode::INGRESS_MBL_FIELD:
         case ReactionArgNode::EGRESS_MBL_FIELD:
-            if (typeContains(ra->arg_, "FieldNode")) {
+            if (ra->arg_->isKind(FIELD_NODE)) {
                 // If it's a field node, grab from headerDecsMap
                 auto fieldArg = dynamic_cast<FieldNode*>(ra->arg_);
                 auto fieldDecs = headerDecsMap.at(*fieldArg->headerName_->word_);
@@ -271,7 +249,7 @@ vector<pair<ReactionArgNode*, int> > findAllReactionArgSizes(
                     }
                 }
                 assert(found);
-            } else if (typeContains(ra->arg_, "MblRefNode")) {
+            } else if (ra->arg_->isKind(MBL_REF_NODE)) {
                 // If it's a var ref, find it
                 auto varRefArg = dynamic_cast<MblRefNode*>(ra->arg_);
                 if (mblValues.find(*varRefArg->name_->word_) != mblValues.end()) {
@@ -295,133 +273,87 @@ vector<pair<ReactionArgNode*, int> > findAllReactionArgSizes(
 }
 
 void findAndRemoveReactions(vector<P4RReactionNode*>* reactions,
-                            const vector<AstNode*>& astNodes) {
+                            const NodeRegistry& astNodes) {
     // Find all the malleables
-    for (auto n : astNodes) {
-        if (typeContains(n, "P4RReactionNode")) {
-            auto r = dynamic_cast<P4RReactionNode*>(n);
-            reactions->push_back(r);
-            n->removed_ = true;
-        }
+    for (auto n : astNodes.ofKind(P4R_REACTION_NODE)) {
+        reactions->push_back(dynamic_cast<P4RReactionNode*>(n));
+        n->removed_ = true;
     }
 }
 
-bool findTblInIng(string tableName, const vector<AstNode*>& nodeArray) {
-    P4ExprNode* ing_node = findIngress(nodeArray);
-    P4ExprNode* egr_node = findEgress(nodeArray);
-    // Currently assume that control ing/egr doesn't wrap other control blocks (otherwise requires recursive search)
-    if(ing_node==NULL || egr_node==NULL) {
-        PANIC("Missing ing/egr node for %s\n", tableName.c_str());
-    }
-    if(ing_node->body_->toString().find(tableName) != string::npos) {
+bool findTblInIng(string tableName, const SymbolTable& symbols) {
+    // Placement follows sub-control calls from ingress/egress, a table reached
+    // from both is treated as ingress
+    unsigned int pipelines = symbols.applyGraph().pipelines(tableName);
+    if(pipelines & ApplyGraph::INGRESS) {
         return true;
-    } else if (egr_node->body_->toString().find(tableName) != string::npos) {
+    } else if (pipelines & ApplyGraph::EGRESS) {
         return false;
     } else {
         PANIC("Failed to locate %s in ing/egr control block\n", tableName.c_str());
     }
 }
 
-bool findRegargInIng(ReactionArgNode* regarg, std::vector<AstNode*> nodeArray) {
+TableNode* findRegargTable(ReactionArgNode* regarg, const SymbolTable& symbols) {
+    // register -> stateful alu -> action executing it -> table listing the action
+    const vector<P4StatefulAluNode*>& blackboxes = symbols.blackboxesOn(regarg->toString());
+    if(blackboxes.empty()) {
+        PANIC("Stateful alu missing for %s\n", regarg->toString().c_str());
+    }
+    const vector<ActionNode*>& actions = symbols.actionsExecuting(blackboxes[0]->name());
+    if(actions.empty()) {
+        PANIC("Action missing to execute the stateful alu for %s\n", regarg->toString().c_str());
+    }
+    const vector<TableNode*>& tables = symbols.tablesListing(actions[0]->name_->toString());
+    if(tables.empty()) {
+        PANIC("Table missing for %s\n", regarg->toString().c_str());
+    }
+    return tables[0];
+}
+
+bool findRegargInIng(ReactionArgNode* regarg, const SymbolTable& symbols) {
 
     if(regarg->argType_!=ReactionArgNode::REGISTER) {
         PRINT_VERBOSE("Miscall findRegargInIng for arg %s\n", regarg->toString().c_str());
         return false;
     }
 
-    vector<P4ExprNode*> blackboxes = findBlackbox(nodeArray);
-    
-    std::string prog_name;
-    for (auto blackbox : blackboxes) {
-        prog_name = blackbox->name2_->toString();
-        std::stringstream ss(blackbox->body_->toString());
-        std::string reg_name;
-        std::string item;
-        while (std::getline(ss, item, ';'))
-        {
-            std::stringstream ss_(item);
-            std::string item_;
-            while (std::getline(ss_, item_, ':')) {
-                boost::algorithm::trim(item_);
-                if(item_.compare("reg")==0) {
-                    std::getline(ss_, item_, ':');
-                    boost::algorithm::trim(item_);
-                    reg_name = item_;
-                }
-            }
-        }
-        if(reg_name.compare(regarg->toString())==0) {
-            break;
-        }
-    }
-    string action_name;
-    bool found = false;
-    for (auto tmp_node : nodeArray) {
-        if(typeContains(tmp_node, "ActionNode") && !typeContains(tmp_node, "P4R")) {
-            ActionNode* tmp_action_node = dynamic_cast<ActionNode*>(tmp_node);
-            string tmp_action_name = tmp_action_node->name_->toString();
-            ActionStmtsNode* actionstmts = tmp_action_node->stmts_;
-            for (ActionStmtNode* as : *actionstmts->list_) {
-                if(as->toString().find("execute_stateful_alu")!=string::npos &&
-                    as->toString().find(prog_name)!=string::npos) {
-                    found = true;
-                    action_name = tmp_action_node->name_->toString();
-                    break;
-                }
-            }
-            if (found) {
-                break;
-            }
-        }
-    }
-    if(!found) {
-        PANIC("Action missing to execute the stateful alu for %s\n", regarg->toString().c_str());
-    }
-    string table_name;
-    found = false;
-    for (auto node : nodeArray) {
-        if(typeContains(node, "TableNode") && !typeContains(node, "P4R")) {
-            TableNode* table = dynamic_cast<TableNode*>(node);
-            table_name = *(table->name_->word_);
-            TableActionStmtsNode* actions = table->actions_;
-            for (TableActionStmtNode* tas : *actions->list_) {
-                string tmp_action_name = *tas->name_->word_;
-                if(tmp_action_name.compare(action_name)==0) {
-                    found = true;
-                    break;
-                }
-            }
-            if(found) {
-                break;
-            }        
-        }
-    }
-    if(!found) {
-        PANIC("Table missing for %s\n", regarg->toString().c_str());
-    }    
-    // Now locate ing/egr for the table
-    P4ExprNode* ing_node = findIngress(nodeArray);
-    P4ExprNode* egr_node = findEgress(nodeArray);
-    if(ing_node==NULL || egr_node==NULL) {
-        PANIC("Missing ing/egr node for %s\n", regarg->toString().c_str());
-    }
     // A valid table will either be applied at ing or egr
-    if(ing_node->body_->toString().find(table_name) != string::npos) {
-        return true;
-    } else if (egr_node->body_->toString().find(table_name) != string::npos) {
-        return false;
-    } else {
-        PANIC("Failed to locate %s for %s\n", table_name.c_str(), regarg->toString().c_str());
+    return findTblInIng(*findRegargTable(regarg, symbols)->name_->word_, symbols);
+}
+
+int findRegargWidth(ReactionArgNode* regarg, const SymbolTable& symbols) {
+    P4RegisterNode* reg = symbols.reg(regarg->toString());
+    if(reg == NULL) {
+        PANIC("Non existing reg arg %s\n", regarg->toString().c_str());
     }
+    return reg->width_;
 }
 
-int findRegargWidth(ReactionArgNode* regarg, std::vector<AstNode*> nodeArray) {
-    vector<P4RegisterNode*> regNodes = findP4RegisterNode(nodeArray);
-    for(auto reg : regNodes) {
-        if(reg->name_->toString().compare(regarg->toString())==0) {
-            return reg->width_;
-        }
+bool findArgWritten(ActionStmtNode* stmt, BodyWordNode* word) {
+    // Position of the destination among the arguments, -1 for primitives
+    // writing no field
+    static const unordered_map<string, int> destinations = {
+        {"modify_field", 0}, {"modify_field_with_hash_based_offset", 0},
+        {"modify_field_rng_uniform", 0}, {"modify_field_conditionally", 0},
+        {"add_to_field", 0}, {"subtract_from_field", 0},
+        {"add", 0}, {"subtract", 0}, {"bit_and", 0}, {"bit_or", 0}, {"bit_xor", 0},
+        {"bit_not", 0}, {"bit_nor", 0}, {"bit_nand", 0}, {"bit_xnor", 0}, {"bit_andca", 0},
+        {"bit_andcb", 0}, {"bit_orca", 0}, {"bit_orcb", 0},
+        {"shift_left", 0}, {"shift_right", 0}, {"min", 0}, {"max", 0},
+        {"register_read", 0}, {"copy_header", 0}, {"execute_meter", 2},
+        {"register_write", -1}, {"count", -1}, {"drop", -1}, {"no_op", -1},
+        {"add_header", -1}, {"remove_header", -1}, {"generate_digest", -1},
+        {"clone_ingress_pkt_to_egress", -1}, {"clone_egress_pkt_to_egress", -1},
+        {"recirculate", -1}, {"resubmit", -1}, {"truncate", -1}};
+    // <blackbox>.execute_stateful_alu(index) and alike only read their index
+    if (stmt->type_ != ActionStmtNode::NAME_ARGLIST || stmt->args_ == NULL) {
+        return false;
+    }
+    auto dst = destinations.find(*stmt->name1_->word_);
+    if (dst == destinations.end()) {
+        return true;
     }
-    PANIC("Non existing reg arg %s\n", regarg->toString().c_str());
-    return -1;
-}
\ No newline at end of file
+    return dst->second >= 0 && dst->second < stmt->args_->list_->size() &&
+           stmt->args_->list_->at(dst->second) == word;
+}
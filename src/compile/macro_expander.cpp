@@ -0,0 +1,249 @@
+/* Copyright 2020-present University of Pennsylvania
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cctype>
+
+#include "macro_expander.h"
+#include "c_scanner.h"
+#include "compile_const.h"
+
+#include "../../include/helper.h"
+
+using namespace std;
+
+static const string kWhitespace = " \t\r\n";
+
+static string trim(const string& str) {
+    size_t begin = str.find_first_not_of(kWhitespace);
+    if (begin == string::npos) {
+        return "";
+    }
+    size_t end = str.find_last_not_of(kWhitespace);
+    return str.substr(begin, end - begin + 1);
+}
+
+MacroExpander::MacroExpander(const string& defs) {
+    string directive;
+    size_t pos = 0;
+    while (pos < defs.size()) {
+        size_t eol = defs.find('\n', pos);
+        if (eol == string::npos) {
+            eol = defs.size();
+        }
+        // Continued lines end with a backslash
+        if (eol > pos && defs[eol-1] == '\\') {
+            directive.append(defs, pos, eol - 1 - pos);
+        } else {
+            directive.append(defs, pos, eol - pos);
+            define(directive);
+            directive.clear();
+        }
+        pos = eol + 1;
+    }
+    define(directive);
+    PRINT_VERBOSE("Expanding %d generated macros\n", macros_.size());
+}
+
+void MacroExpander::define(const string& directive) {
+    string line = trim(directive);
+    if (line.compare(0, 7, "#define") != 0) {
+        return;
+    }
+    size_t begin = line.find_first_not_of(kWhitespace, 7);
+    if (begin == string::npos) {
+        return;
+    }
+    size_t end = begin;
+    while (end < line.size() && (isalnum((unsigned char)line[end]) || line[end] == '_')) {
+        end++;
+    }
+
+    Macro macro;
+    string name = line.substr(begin, end - begin);
+    // Function like only when the parenthesis directly follows the name
+    macro.function_ = end < line.size() && line[end] == '(';
+    if (macro.function_) {
+        size_t close = line.find(')', end);
+        if (close == string::npos) {
+            PANIC("Malformed macro %s\n", name.c_str());
+        }
+        string params = line.substr(end + 1, close - end - 1);
+        size_t start = 0;
+        while (start <= params.size()) {
+            size_t comma = params.find(',', start);
+            if (comma == string::npos) {
+                comma = params.size();
+            }
+            string param = trim(params.substr(start, comma - start));
+            if (!param.empty()) {
+                macro.params_.push_back(param);
+            }
+            start = comma + 1;
+        }
+        end = close + 1;
+    }
+    macro.body_ = trim(line.substr(end));
+    macro.tokens_ = scanCTokens(macro.body_);
+    for (const CToken& tok : macro.tokens_) {
+        int param = -1;
+        if (tok.kind == CToken::IDENT) {
+            for (int k = 0; k < macro.params_.size(); k++) {
+                if (macro.body_.compare(tok.begin, tok.end - tok.begin, macro.params_[k]) == 0) {
+                    param = k;
+                    break;
+                }
+            }
+        }
+        macro.paramOf_.push_back(param);
+    }
+    macros_[name] = std::move(macro);
+}
+
+string MacroExpander::substitute(const Macro& macro, const vector<string>& args) const {
+    const string& body = macro.body_;
+    const vector<CToken>& tokens = macro.tokens_;
+    string ret;
+    ret.reserve(body.size());
+    size_t copied = 0;
+    for (int i = 0; i < tokens.size(); i++) {
+        const CToken& tok = tokens[i];
+        // Token pasting, drop ## and the whitespace around it
+        if (tok.kind == CToken::PUNCT && body[tok.begin] == '#' && i + 1 < tokens.size() &&
+            body[tokens[i+1].begin] == '#' && tokens[i+1].begin == tok.end) {
+            ret.erase(ret.find_last_not_of(kWhitespace) + 1);
+            i++;
+            copied = i + 1 < tokens.size() ? tokens[i+1].begin : body.size();
+            continue;
+        }
+        ret.append(body, copied, tok.begin - copied);
+        copied = tok.end;
+
+        int param = macro.paramOf_[i];
+        if (param < 0) {
+            ret.append(body, tok.begin, tok.end - tok.begin);
+        } else if (param < args.size()) {
+            ret += args[param];
+        }
+    }
+    ret.append(body, copied, string::npos);
+    return ret;
+}
+
+string MacroExpander::expandIn(const string& code, unordered_set<string>& active) const {
+    vector<CToken> tokens = scanCTokens(code);
+    int n = tokens.size();
+    auto isPunct = [&](int i, char c) {
+        return i < n && tokens[i].kind == CToken::PUNCT && code[tokens[i].begin] == c;
+    };
+
+    string ret;
+    ret.reserve(code.size());
+    size_t copied = 0;
+    for (int i = 0; i < n; i++) {
+        if (tokens[i].kind != CToken::IDENT) {
+            continue;
+        }
+        string name = code.substr(tokens[i].begin, tokens[i].end - tokens[i].begin);
+        auto it = macros_.find(name);
+        if (it == macros_.end() || active.count(name) != 0) {
+            continue;
+        }
+        const Macro& macro = it->second;
+
+        // Collect the arguments, split on top level commas
+        vector<string> args;
+        int last = i;
+        if (macro.function_) {
+            if (!isPunct(i+1, '(')) {
+                continue;
+            }
+            int depth = 0;
+            size_t argBegin = tokens[i+1].end;
+            for (last = i + 1; last < n; last++) {
+                if (isPunct(last, '(') || isPunct(last, '[') || isPunct(last, '{')) {
+                    depth++;
+                } else if (isPunct(last, ')') || isPunct(last, ']') || isPunct(last, '}')) {
+                    depth--;
+                }
+                if (depth == 0 || (depth == 1 && isPunct(last, ','))) {
+                    args.push_back(trim(code.substr(argBegin, tokens[last].begin - argBegin)));
+                    argBegin = tokens[last].end;
+                }
+                if (depth == 0) {
+                    break;
+                }
+            }
+            if (last == n) {
+                PANIC("Unterminated call to %s\n", name.c_str());
+            }
+            if (args.size() == 1 && args[0].empty() && macro.params_.empty()) {
+                args.clear();
+            }
+            if (args.size() != macro.params_.size()) {
+                PANIC("%s expects %d arguments, got %d\n", name.c_str(),
+                      macro.params_.size(), args.size());
+            }
+        }
+
+        // Rescan the replacement, without expanding the macro into itself
+        active.insert(name);
+        string expansion = expandIn(substitute(macro, args), active);
+        active.erase(name);
+
+        ret.append(code, copied, tokens[i].begin - copied);
+        ret += expansion;
+        copied = tokens[last].end;
+        i = last;
+    }
+    ret.append(code, copied, string::npos);
+    return ret;
+}
+
+string MacroExpander::expand(const string& code) const {
+    unordered_set<string> active;
+    string expanded = expandIn(code, active);
+
+    // Break _MANTIS_NL_ markers into lines at the indentation of the line
+    // they are on, a marker closing a statement also takes the ; after it
+    const string marker = kMantisNl;
+    string ret;
+    ret.reserve(expanded.size());
+    size_t pos = 0;
+    while (true) {
+        size_t found = expanded.find(marker, pos);
+        if (found == string::npos) {
+            ret.append(expanded, pos, string::npos);
+            break;
+        }
+        ret.append(expanded, pos, found - pos);
+        ret.erase(ret.find_last_not_of(" \t") + 1);
+
+        pos = expanded.find_first_not_of(" \t", found + marker.size());
+        if (pos == string::npos) {
+            pos = expanded.size();
+        } else if (expanded[pos] == ';') {
+            pos++;
+        }
+        if (pos == expanded.size() || expanded[pos] == '\n' ||
+            expanded.compare(pos, marker.size(), marker) == 0) {
+            continue;
+        }
+        size_t lineBegin = ret.rfind('\n');
+        lineBegin = lineBegin == string::npos ? 0 : lineBegin + 1;
+        size_t indentEnd = ret.find_first_not_of(" \t", lineBegin);
+        ret += "\n" + ret.substr(lineBegin, (indentEnd == string::npos ? ret.size() : indentEnd) - lineBegin);
+    }
+    return ret;
+}
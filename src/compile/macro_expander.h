@@ -0,0 +1,58 @@
+/* Copyright 2020-present University of Pennsylvania
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MACRO_EXPANDER_H
+#define MACRO_EXPANDER_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "c_scanner.h"
+
+// Expands the table operation, mirror and variable update macros generated
+// for the agent in place, so the prologue/dialogue come out as ready to
+// compile C.  Supports the subset the generator uses: object and function
+// like #define, ## pasting, and _MANTIS_NL_ line breaks.  Macros the user
+// defined are not known here and stay for the C compiler.
+class MacroExpander {
+public:
+    // defs holds #define directives, continued lines ending with a backslash
+    explicit MacroExpander(const std::string& defs);
+
+    std::string expand(const std::string& code) const;
+
+    size_t numMacros() const { return macros_.size(); }
+
+private:
+    struct Macro {
+        bool function_;
+        std::vector<std::string> params_;
+        std::string body_;
+        // Body scanned once at definition, with the parameter each token
+        // names or -1
+        std::vector<CToken> tokens_;
+        std::vector<int> paramOf_;
+    };
+
+    void define(const std::string& directive);
+    std::string substitute(const Macro& macro, const std::vector<std::string>& args) const;
+    std::string expandIn(const std::string& code, std::unordered_set<std::string>& active) const;
+
+    std::unordered_map<std::string, Macro> macros_;
+};
+
+#endif
@@ -0,0 +1,132 @@
+/* Copyright 2020-present University of Pennsylvania
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+
+#include "../../include/mantisc.h"
+#include "../../include/compile.h"
+#include "../../include/emitter.h"
+#include "../../include/find_nodes.h"
+
+template <typename T>
+static vector<string> sortedNames(const unordered_map<string, T>& mbls) {
+    vector<string> names;
+    for (auto& kv : mbls) {
+        names.push_back(kv.first);
+    }
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+static vector<PackedArgs> packedArgs(const vector<ReactionArgBin>& bins) {
+    vector<PackedArgs> ret;
+    for (const ReactionArgBin& bin : bins) {
+        PackedArgs args;
+        for (const ReactionArgSize& arg : bin.first) {
+            args.emplace_back(arg.first->toString(), arg.second);
+        }
+        ret.push_back(args);
+    }
+    return ret;
+}
+
+static string fnv1aHex(const string& text) {
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : text) {
+        hash = (hash ^ c) * 1099511628211ull;
+    }
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)hash);
+    return hex;
+}
+
+CompileOutput compileP4R(const string& source, const string& progName,
+                         const CompileOptions& opts) {
+    return compileP4R(source.data(), source.size(), progName, opts);
+}
+
+CompileOutput compileP4R(const char* source, size_t len, const string& progName,
+                         const CompileOptions& opts) {
+    CompileOutput ret;
+    CompileContext ctx;
+    ctx.pairArgBins_ = opts.argLayout_ == ARG_LAYOUT_READS;
+    ctx.mergeArgTables_ = opts.mergeArgTables_;
+    ctx.maxActionCopies_ = opts.maxActionCopies_;
+    ctx.singleRegReplica_ = opts.regReplicaLayout_ == REG_REPLICAS_SINGLE;
+    ctx.dirtyBlock_ = opts.dirtyBlock_;
+    // Syntax tree and identifiers of this compilation, released with ctx
+    Arena::Scope arenaScope(&ctx.arena_);
+    PassManager pm(&ctx.arena_, opts.passStats_ ? &ret.meta_.passes_ : NULL, opts.passCache_);
+
+    pm.add("parse", "parseP4R", 0, RES_TREE, [&](PassOutput*) {
+        parseP4R(source, len, &ctx);
+        PRINT_VERBOSE("Number of syntax tree nodes: %d\n", ctx.nodes_.size());
+        PRINT_VERBOSE("Arena: %zu bytes, %zu interned symbols\n", ctx.arena_.bytesAllocated(), ctx.arena_.numSymbols());
+        ret.meta_.numNodes_ = ctx.nodes_.size();
+    });
+
+    addP4Passes(&pm, &ctx);
+
+    // Runs beside the C passes, which only read the tree from here on
+    pm.add("emit", "emitP4", RES_TREE | outputRes(OUT_P4_NODES), 0, [&](PassOutput*) {
+        Emitter out(&ret.p4_);
+        out << ctx.root_ << "\n\n";
+        for (auto n : pm.nodes(OUT_P4_NODES)) {
+            out << n;
+        }
+    });
+
+    addCPasses(&pm, &ctx, progName);
+
+    pm.add("emit", "emitC", outputRes(OUT_C_NODES), 0, [&](PassOutput*) {
+        vector<AstNode*> cNodes = pm.nodes(OUT_C_NODES);
+        PRINT_VERBOSE("Number of C nodes: %d\n", cNodes.size());
+        Emitter out(&ret.c_);
+        for (auto node : cNodes){
+            out << node << "\n";
+            out << "\n" << "\n";
+        }
+    });
+
+    pm.run(opts.passThreads_);
+
+    ret.meta_.ingIsoOpt_ = ctx.ingIsoOpt_;
+    ret.meta_.egrIsoOpt_ = ctx.egrIsoOpt_;
+    ret.meta_.mblValues_ = sortedNames(ctx.mblValues_);
+    ret.meta_.mblFields_ = sortedNames(ctx.mblFields_);
+    ret.meta_.mblTables_ = sortedNames(ctx.mblTables_);
+    for (const string& name : sortedNames(ctx.mblUsages_)) {
+        ret.meta_.mblUsages_.emplace_back(name, ctx.mblUsages_[name]);
+    }
+    ret.meta_.numInitMblsIng_ = ctx.numInitMblsIng_;
+    ret.meta_.numInitMblsEgr_ = ctx.numInitMblsEgr_;
+    ret.meta_.numMaxAlts_ = ctx.numMaxAlts_;
+    for (auto& kv : ctx.mblFields_) {
+        ret.meta_.numExactMblReads_ += kv.second->numExactReads_;
+        ret.meta_.tcamBitsSaved_ += kv.second->tcamBitsSaved_;
+    }
+    ret.meta_.factoredActions_ = ctx.factoredActions_;
+    ret.meta_.ingBins_ = packedArgs(ctx.ingBins_);
+    ret.meta_.egrBins_ = packedArgs(ctx.egrBins_);
+    ret.meta_.argExport_ = ctx.argExport_;
+    ret.meta_.argExportPerRegister_ = ctx.argExportPerRegister_;
+    ret.meta_.ingStages_ = ctx.ingStages_;
+    ret.meta_.egrStages_ = ctx.egrStages_;
+    ret.meta_.p4Hash_ = fnv1aHex(ret.p4_);
+    ret.meta_.arenaBytes_ = ctx.arena_.bytesAllocated();
+    return ret;
+}
@@ -0,0 +1,247 @@
+/* Copyright 2020-present University of Pennsylvania
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <queue>
+#include <thread>
+
+#include "../../include/pass_manager.h"
+#include "../../include/arena.h"
+
+using namespace std;
+
+// Resources of all outputs, appended to rather than written
+static const uint64_t kOutputRes = ((1ull << NUM_PASS_OUTPUTS) - 1) << 32;
+
+ostringstream& PassOutput::stream(PassOutputId id) {
+    if (!streams_[id]) {
+        streams_[id].reset(new ostringstream());
+    }
+    return *streams_[id];
+}
+
+bool PassCache::lookup(const string& pass, const string& key, PassOutput* out) {
+    lock_guard<mutex> lock(mutex_);
+    auto it = entries_.find(pass);
+    if (it == entries_.end() || it->second.key_ != key) {
+        return false;
+    }
+    for (int i = 0; i < NUM_PASS_OUTPUTS; i++) {
+        if (!it->second.streams_[i].empty()) {
+            out->stream((PassOutputId)i) << it->second.streams_[i];
+        }
+    }
+    return true;
+}
+
+void PassCache::store(const string& pass, const string& key, const PassOutput& out) {
+    Entry entry;
+    entry.key_ = key;
+    for (int i = 0; i < NUM_PASS_OUTPUTS; i++) {
+        if (out.streams_[i]) {
+            entry.streams_[i] = out.streams_[i]->str();
+        }
+    }
+    lock_guard<mutex> lock(mutex_);
+    entries_[pass] = move(entry);
+}
+
+PassManager::PassManager(Arena* arena, vector<PassStats>* stats, PassCache* cache)
+                         : arena_(arena), stats_(stats), cache_(cache) {
+}
+
+void PassManager::add(const char* phase, const char* name, uint64_t reads, uint64_t writes, Body body) {
+    addCached(phase, name, reads, writes, Key(), body);
+}
+
+void PassManager::addCached(const char* phase, const char* name, uint64_t reads, uint64_t writes,
+                            Key key, Body body) {
+    // Replaying a cached pass only restores its streams
+    assert(!key || (writes & ~kOutputRes) == 0);
+    unique_ptr<Pass> pass(new Pass());
+    pass->phase_ = phase;
+    pass->name_ = name;
+    pass->reads_ = reads;
+    pass->writes_ = writes;
+    pass->key_ = key;
+    pass->body_ = body;
+    passes_.push_back(move(pass));
+}
+
+bool PassManager::dependsOn(const Pass& later, const Pass& earlier) {
+    // Read after write, write after read and write after write, except for
+    // appends to the same output
+    return (earlier.writes_ & later.reads_) != 0 ||
+           (earlier.reads_ & later.writes_) != 0 ||
+           (earlier.writes_ & later.writes_ & ~kOutputRes) != 0;
+}
+
+void PassManager::runPass(Pass* pass) {
+    size_t nodes = Arena::threadNumNodes();
+    size_t arenaBytes = Arena::threadBytesAllocated();
+    size_t heapBytes = threadHeapBytes();
+    size_t heapAllocs = threadHeapAllocs();
+    auto start = chrono::steady_clock::now();
+
+    try {
+        if (pass->key_ && cache_ != NULL) {
+            string key = pass->key_();
+            pass->stats_.cached_ = cache_->lookup(pass->name_, key, &pass->output_);
+            if (!pass->stats_.cached_) {
+                pass->body_(&pass->output_);
+                cache_->store(pass->name_, key, pass->output_);
+            }
+        } else {
+            pass->body_(&pass->output_);
+        }
+    } catch (...) {
+        pass->error_ = current_exception();
+    }
+    pass->ran_ = true;
+
+    pass->stats_.phase_ = pass->phase_;
+    pass->stats_.name_ = pass->name_;
+    pass->stats_.seconds_ = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    pass->stats_.nodes_ = Arena::threadNumNodes() - nodes;
+    pass->stats_.arenaBytes_ = Arena::threadBytesAllocated() - arenaBytes;
+    pass->stats_.heapBytes_ = threadHeapBytes() - heapBytes;
+    pass->stats_.heapAllocs_ = threadHeapAllocs() - heapAllocs;
+}
+
+void PassManager::runParallel(int numThreads) {
+    vector<int> numDeps;
+    for (auto& pass : passes_) {
+        numDeps.push_back(pass->numDeps_);
+    }
+
+    // Ready passes are started lowest registration index first, the run
+    // stays close to the sequential order
+    priority_queue<size_t, vector<size_t>, greater<size_t> > ready;
+    for (size_t i = 0; i < passes_.size(); i++) {
+        if (numDeps[i] == 0) {
+            ready.push(i);
+        }
+    }
+
+    mutex readyMutex;
+    condition_variable changed;
+    int numRunning = 0;
+    auto work = [&]() {
+        Arena::Scope arenaScope(arena_);
+        unique_lock<mutex> lock(readyMutex);
+        while (true) {
+            changed.wait(lock, [&]() { return !ready.empty() || numRunning == 0; });
+            if (ready.empty()) {
+                // Nothing running that could make a pass ready
+                break;
+            }
+            Pass* pass = passes_[ready.top()].get();
+            ready.pop();
+            numRunning++;
+
+            lock.unlock();
+            runPass(pass);
+            lock.lock();
+
+            numRunning--;
+            if (pass->error_) {
+                ready = decltype(ready)();
+            } else {
+                for (size_t d : pass->dependents_) {
+                    if (--numDeps[d] == 0) {
+                        ready.push(d);
+                    }
+                }
+            }
+            changed.notify_all();
+        }
+        changed.notify_all();
+    };
+
+    vector<thread> helpers;
+    for (int t = 1; t < numThreads; t++) {
+        helpers.emplace_back(work);
+    }
+    work();
+    for (auto& helper : helpers) {
+        helper.join();
+    }
+}
+
+void PassManager::run(int numThreads) {
+    if (numThreads <= 0) {
+        numThreads = max(1u, thread::hardware_concurrency());
+    }
+    numThreads = min<size_t>(numThreads, max<size_t>(passes_.size(), 1));
+
+    for (size_t i = 0; i < passes_.size(); i++) {
+        for (size_t j = 0; j < i; j++) {
+            if (dependsOn(*passes_[i], *passes_[j])) {
+                passes_[i]->numDeps_++;
+                passes_[j]->dependents_.push_back(i);
+            }
+        }
+    }
+
+    if (numThreads == 1) {
+        for (auto& pass : passes_) {
+            runPass(pass.get());
+            if (pass->error_) {
+                break;
+            }
+        }
+    } else {
+        runParallel(numThreads);
+    }
+
+    exception_ptr error;
+    for (auto& pass : passes_) {
+        if (!pass->ran_) {
+            continue;
+        }
+        if (stats_ != NULL) {
+            stats_->push_back(pass->stats_);
+        }
+        if (pass->error_ && !error) {
+            error = pass->error_;
+        }
+    }
+    if (error) {
+        rethrow_exception(error);
+    }
+}
+
+vector<AstNode*> PassManager::nodes(PassOutputId id) const {
+    vector<AstNode*> ret;
+    for (auto& pass : passes_) {
+        const vector<AstNode*>& nodes = pass->output_.nodes_[id];
+        ret.insert(ret.end(), nodes.begin(), nodes.end());
+    }
+    return ret;
+}
+
+string PassManager::str(PassOutputId id) const {
+    string ret;
+    for (auto& pass : passes_) {
+        if (pass->output_.streams_[id]) {
+            ret += pass->output_.streams_[id]->str();
+        }
+    }
+    return ret;
+}
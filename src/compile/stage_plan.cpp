@@ -0,0 +1,413 @@
+/* Copyright 2020-present University of Pennsylvania
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <map>
+#include <boost/algorithm/string.hpp>
+
+#include "../../include/find_nodes.h"
+#include "../../include/helper.h"
+#include "compile_p4.h"
+#include "compile_const.h"
+#include "stage_plan.h"
+
+// Stage of "@pragma stage <stage> [...]", -1 for other pragmas
+static int pragmaStage(const string& pragma) {
+    vector<string> words;
+    string trimmed = boost::algorithm::trim_copy(pragma);
+    boost::algorithm::split(words, trimmed, boost::algorithm::is_space(), boost::token_compress_on);
+    if (words.size() < 3 || words[0] != "@pragma" || words[1] != "stage" ||
+        words[2].find_first_not_of("0123456789") != string::npos) {
+        return -1;
+    }
+    return stoi(words[2]);
+}
+
+static string withPragmaStage(const string& pragma, int stage) {
+    vector<string> words;
+    string trimmed = boost::algorithm::trim_copy(pragma);
+    boost::algorithm::split(words, trimmed, boost::algorithm::is_space(), boost::token_compress_on);
+    words[2] = to_string(stage);
+    return boost::algorithm::join(words, " ");
+}
+
+// header.field a node refers to, empty for names and constants
+static string fieldOf(AstNode* node) {
+    string field = boost::algorithm::trim_copy(node->toString());
+    return field.find('.') == string::npos ? "" : field;
+}
+
+static bool intersects(const set<string>& a, const set<string>& b) {
+    for (const string& field : a) {
+        if (b.find(field) != b.end()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool dependsOn(const PlannedTable& table, const PlannedTable& earlier) {
+    if (!table.exclusive_.empty() && table.exclusive_ == earlier.exclusive_) {
+        return false;
+    }
+    // Match and action dependencies, then output dependencies
+    return intersects(table.reads_, earlier.writes_) || intersects(table.writes_, earlier.writes_);
+}
+
+// Reverse dependency, the table writes a field the earlier one reads.  The
+// two can share a stage but the write may not come first.
+static bool readBefore(const PlannedTable& table, const PlannedTable& earlier) {
+    if (!table.exclusive_.empty() && table.exclusive_ == earlier.exclusive_) {
+        return false;
+    }
+    return intersects(table.writes_, earlier.reads_);
+}
+
+void placeTables(vector<PlannedTable>* tables) {
+    vector<int> numTables;
+    vector<int> numAlus;
+    for (size_t i = 0; i < tables->size(); i++) {
+        PlannedTable& table = (*tables)[i];
+        int earliest = 0;
+        for (size_t j = 0; j < i; j++) {
+            const PlannedTable& earlier = (*tables)[j];
+            if (dependsOn(table, earlier)) {
+                earliest = max(earliest, earlier.stage_ + 1);
+            } else if (readBefore(table, earlier)) {
+                earliest = max(earliest, earlier.stage_);
+            }
+        }
+        int stage = earliest;
+        if (table.withPrevious_ && i > 0) {
+            stage = (*tables)[i - 1].stage_;
+        } else {
+            if (table.pinned_ >= earliest) {
+                stage = table.pinned_;
+            }
+            // Room for the tables joining it too
+            int group = 1;
+            for (size_t j = i + 1; j < tables->size() && (*tables)[j].withPrevious_; j++) {
+                group++;
+            }
+            while (stage < numTables.size() &&
+                   (numTables[stage] + group > TABLES_PER_STAGE ||
+                    numAlus[stage] + table.alus_ > STATEFUL_ALUS_PER_STAGE)) {
+                stage++;
+            }
+            if (table.pinned_ >= 0 && stage != table.pinned_) {
+                PRINT_VERBOSE("Table %s pinned to stage %d moves to stage %d\n",
+                              table.name_.c_str(), table.pinned_, stage);
+            }
+        }
+        if (stage >= numTables.size()) {
+            numTables.resize(stage + 1, 0);
+            numAlus.resize(stage + 1, 0);
+        }
+        if (numTables[stage] >= TABLES_PER_STAGE || numAlus[stage] + table.alus_ > STATEFUL_ALUS_PER_STAGE) {
+            PANIC("Table %s does not fit in stage %d with the table before it\n", table.name_.c_str(), stage);
+        }
+        numTables[stage]++;
+        numAlus[stage] += table.alus_;
+        table.stage_ = stage;
+    }
+}
+
+// What a table of the program matches on, reads and writes.  The fields of
+// the conditions it is applied under are read.  The first argument of a
+// primitive is taken as written, as are the output of the stateful alus and
+// the register outputs mirrored by the replica tables.
+static PlannedTable userTable(TableNode* table, int pinned, bool forIng, const SymbolTable& symbols) {
+    PlannedTable planned;
+    planned.name_ = *table->name_->word_;
+    planned.pinned_ = pinned;
+    planned.reads_ = symbols.applyGraph().conditionFields(planned.name_);
+    if (table->reads_ != NULL) {
+        for (TableReadStmtNode* read : *table->reads_->list_) {
+            string field = fieldOf(read->field_);
+            if (!field.empty()) {
+                planned.reads_.insert(field);
+            }
+        }
+    }
+    set<string> blackboxes;
+    for (TableActionStmtNode* entry : *table->actions_->list_) {
+        ActionNode* action = symbols.action(*entry->name_->word_);
+        if (action == NULL) {
+            continue;
+        }
+        for (ActionStmtNode* stmt : *action->stmts_->list_) {
+            P4StatefulAluNode* blackbox = stmt->executesStatefulAlu() ? symbols.blackbox(*stmt->name1_->word_) : NULL;
+            if (blackbox != NULL) {
+                blackboxes.insert(blackbox->name());
+                if (blackbox->reg() != NULL) {
+                    planned.writes_.insert(string(forIng ? kP4rIngRegMetadataName : kP4rEgrRegMetadataName) +
+                                           "." + *blackbox->reg() +
+                                           kP4rRegMetadataOutputSuffix);
+                }
+                P4AttributeNode* outputDst = blackbox->attribute("output_dst");
+                if (outputDst != NULL) {
+                    string field;
+                    for (BodyWordNode* word : outputDst->value_) {
+                        field += word->contents_->toString();
+                    }
+                    planned.writes_.insert(boost::algorithm::trim_copy(field));
+                }
+            }
+            if (stmt->args_ == NULL) {
+                continue;
+            }
+            for (BodyWordNode* word : *stmt->args_->list_) {
+                string field = fieldOf(word->contents_);
+                if (field.empty()) {
+                    continue;
+                }
+                if (stmt->type_ == ActionStmtNode::NAME_ARGLIST && word == stmt->args_->list_->front()) {
+                    planned.writes_.insert(field);
+                } else {
+                    planned.reads_.insert(field);
+                }
+            }
+        }
+    }
+    planned.alus_ = blackboxes.size();
+    return planned;
+}
+
+static PlannedTable injectedTable(const string& name) {
+    PlannedTable planned;
+    planned.name_ = name;
+    planned.injected_ = true;
+    return planned;
+}
+
+// Fields a reaction argument is packed from, every alt of a malleable field
+static vector<string> argFields(ReactionArgNode* arg,
+                                const unordered_map<string, P4RMalleableFieldNode*>& mblFields) {
+    vector<string> fields;
+    MblRefNode* ref = dynamic_cast<MblRefNode*>(arg->arg_);
+    if (ref != NULL && mblFields.find(*ref->name_->word_) != mblFields.end()) {
+        for (FieldNode* alt : findAllAlts(*mblFields.at(*ref->name_->word_))) {
+            fields.push_back(fieldOf(alt));
+        }
+    } else if (ref == NULL) {
+        fields.push_back(fieldOf(arg->arg_));
+    }
+    return fields;
+}
+
+// The pack tables and the SetArgs tables, in the order applyArgTables
+// applies them
+static void addArgTables(vector<PlannedTable>* tables, const vector<ReactionArgBin>& bins,
+                         const unordered_map<string, P4RMalleableFieldNode*>& mblFields,
+                         bool pairArgBins, bool mergeArgTables, bool forIng) {
+    string prefix = forIng ? "__ti" : "__te";
+    string packed = string(forIng ? kP4rIngArghdrName : kP4rEgrArghdrName) + ".reg";
+    string mv = string(forIng ? kP4rIngMetadataName : kP4rEgrMetadataName) + ".__mv";
+    vector<PlannedTable> packTables;
+    for (int j = 0; j < bins.size(); j++) {
+        PlannedTable pack = injectedTable(prefix + "Pack" + to_string(j));
+        for (const ReactionArgSize& arg : bins[j].first) {
+            for (const string& field : argFields(arg.first, mblFields)) {
+                pack.reads_.insert(field);
+            }
+        }
+        pack.writes_.insert(packed + to_string(j));
+        packTables.push_back(pack);
+    }
+
+    int numRegs = numArgRegisters(bins, pairArgBins);
+    int binsPerReg = pairArgBins ? 2 : 1;
+    if (mergeArgTables) {
+        if (bins.empty()) {
+            return;
+        }
+        PlannedTable pack = injectedTable(prefix + "Pack");
+        for (const PlannedTable& bin : packTables) {
+            pack.reads_.insert(bin.reads_.begin(), bin.reads_.end());
+            pack.writes_.insert(bin.writes_.begin(), bin.writes_.end());
+        }
+        tables->push_back(pack);
+        for (int g = 0; g*STATEFUL_ALUS_PER_STAGE < numRegs; ++g) {
+            PlannedTable setArgs = injectedTable(prefix + "SetArgsStage" + to_string(g));
+            setArgs.reads_ = pack.writes_;
+            setArgs.reads_.insert(mv);
+            setArgs.alus_ = min(STATEFUL_ALUS_PER_STAGE, numRegs - g*STATEFUL_ALUS_PER_STAGE);
+            tables->push_back(setArgs);
+        }
+        return;
+    }
+    for (int i = 0; i < numRegs; ++i) {
+        PlannedTable setArgs = injectedTable(prefix + "SetArgs" + to_string(i));
+        for (int j = i*binsPerReg; j < bins.size() && j < (i+1)*binsPerReg; ++j) {
+            tables->push_back(packTables[j]);
+            setArgs.reads_.insert(packed + to_string(j));
+        }
+        setArgs.reads_.insert(mv);
+        setArgs.alus_ = 1;
+        tables->push_back(setArgs);
+    }
+}
+
+static vector<PlannedTable> pipelineTables(bool forIng, const unordered_map<string, string*>& pragmas,
+                                           const SymbolTable& symbols,
+                                           const unordered_map<string, P4RMalleableFieldNode*>& mblFields,
+                                           const vector<ReactionArgNode*>& reactionArgs,
+                                           const vector<ReactionArgBin>& bins,
+                                           int isoOpt, bool pairArgBins, bool mergeArgTables,
+                                           bool singleRegReplica, int dirtyBlock) {
+    string meta = forIng ? kP4rIngMetadataName : kP4rEgrMetadataName;
+    vector<PlannedTable> tables;
+    tables.push_back(injectedTable(forIng ? "__tiSetVars" : "__teSetVars"));
+
+    // The selected alts, behind a gateway on the alt index
+    if (forIng) {
+        map<string, P4RMalleableFieldNode*> sortedFields(mblFields.begin(), mblFields.end());
+        for (auto& kv : sortedFields) {
+            if (!kv.second->selected()) {
+                continue;
+            }
+            vector<FieldNode*> alts = findAllAlts(*kv.second);
+            for (int i = 0; i < alts.size(); i++) {
+                PlannedTable select = injectedTable("__tiSelect_" + kv.first + "_" + to_string(i));
+                select.reads_.insert(meta + "." + kv.first + kP4rIndexSuffix);
+                select.reads_.insert(fieldOf(alts[i]));
+                select.writes_.insert(meta + "." + kv.first + kP4rSelectSuffix);
+                select.exclusive_ = kv.first;
+                tables.push_back(select);
+            }
+        }
+    }
+
+    for (const string& name : symbols.applyGraph().tableOrder(forIng ? ApplyGraph::INGRESS : ApplyGraph::EGRESS)) {
+        TableNode* table = symbols.table(name);
+        if (table == NULL) {
+            continue;
+        }
+        auto pragma = pragmas.find(name);
+        int pinned = pragma == pragmas.end() ? -1 : pragmaStage(*pragma->second);
+        tables.push_back(userTable(table, pinned, forIng, symbols));
+    }
+
+    addArgTables(&tables, bins, mblFields, pairArgBins, mergeArgTables, forIng);
+
+    if (((unsigned int)isoOpt) & 0b1) {
+        for (ReactionArgNode* arg : reactionArgs) {
+            if (arg->argType_ != ReactionArgNode::REGISTER || findRegargInIng(arg, symbols) != forIng ||
+                symbols.reg(arg->toString()) == NULL) {
+                continue;
+            }
+            string output = string(forIng ? kP4rIngRegMetadataName : kP4rEgrRegMetadataName) + "." + arg->toString();
+            vector<const char*> suffixes = {kP4rRegReplicasSuffix0, kP4rRegReplicasSuffix1};
+            if (singleRegReplica) {
+                suffixes = {kP4rRegReplicasSuffix};
+            }
+            for (const char* suffix : suffixes) {
+                PlannedTable replica = injectedTable(kP4rRegReplicasTablePrefix + arg->toString() + suffix);
+                replica.reads_.insert(meta + ".__mv");
+                replica.reads_.insert(output + kP4rRegMetadataOutputSuffix);
+                replica.reads_.insert(output + kP4rRegMetadataIndexSuffix);
+                replica.alus_ = 1;
+                // A 64b value counts its updates in a version register
+                if (symbols.reg(arg->toString())->width_ == 64) {
+                    replica.reads_.insert(output + kP4rRegMetadataOutputHiSuffix);
+                    replica.alus_ = 2;
+                }
+                // And the dirty bitmap of the register, one ALU for both
+                // replicas of the pair, which is why they share a stage.  The
+                // first replica reserves the ALUs of both.
+                if (dirtyBlock > 0) {
+                    replica.reads_.insert(output + kP4rRegMetadataBlockSuffix);
+                    if (suffix == suffixes.front()) {
+                        replica.alus_ = replica.alus_ * suffixes.size() + 1;
+                    } else {
+                        replica.alus_ = 0;
+                        replica.withPrevious_ = true;
+                    }
+                }
+                replica.exclusive_ = arg->toString();
+                tables.push_back(replica);
+            }
+        }
+    }
+
+    // __tiSetVars sets the malleables of the pipeline, the selected alts
+    // are copied after it
+    PlannedTable& setVars = tables.front();
+    for (const PlannedTable& table : tables) {
+        for (const set<string>* fields : {&table.reads_, &table.writes_}) {
+            for (const string& field : *fields) {
+                if (field.compare(0, meta.size() + 1, meta + ".") == 0 &&
+                    !boost::algorithm::ends_with(field, kP4rSelectSuffix)) {
+                    setVars.writes_.insert(field);
+                }
+            }
+        }
+    }
+
+    placeTables(&tables);
+    return tables;
+}
+
+void planStages(const NodeRegistry& nodes, const SymbolTable& symbols,
+                const unordered_map<string, P4RMalleableFieldNode*>& mblFields,
+                const vector<ReactionArgNode*>& reactionArgs,
+                const vector<ReactionArgBin>& ingBins, const vector<ReactionArgBin>& egrBins,
+                int ingIsoOpt, int egrIsoOpt, bool pairArgBins, bool mergeArgTables, bool singleRegReplica,
+                int dirtyBlock, vector<TableStage>* ingStages, vector<TableStage>* egrStages) {
+    // Pragma of every table, a malleable table carries it on the declaration
+    unordered_map<string, string*> pragmas;
+    for (auto node : nodes.ofKind(TABLE_NODE)) {
+        TableNode* table = dynamic_cast<TableNode*>(node);
+        pragmas[*table->name_->word_] = &table->pragma_;
+    }
+    for (auto node : nodes.ofKind(P4R_MALLEABLE_TABLE_NODE)) {
+        P4RMalleableTableNode* table = dynamic_cast<P4RMalleableTableNode*>(node);
+        if (!table->pragma_.empty()) {
+            pragmas[*table->table_->name_->word_] = &table->pragma_;
+        }
+    }
+
+    // A table applied in both pipelines is pinned to the later stage
+    map<string, int> stages;
+    for (bool forIng : {true, false}) {
+        vector<PlannedTable> tables = pipelineTables(forIng, pragmas, symbols, mblFields, reactionArgs,
+                                                     forIng ? ingBins : egrBins, forIng ? ingIsoOpt : egrIsoOpt,
+                                                     pairArgBins, mergeArgTables, singleRegReplica, dirtyBlock);
+        vector<TableStage>* placed = forIng ? ingStages : egrStages;
+        for (const PlannedTable& table : tables) {
+            TableStage stage;
+            stage.table_ = table.name_;
+            stage.stage_ = table.stage_;
+            stage.pinned_ = table.pinned_;
+            stage.injected_ = table.injected_;
+            placed->push_back(stage);
+            if (table.pinned_ >= 0) {
+                stages[table.name_] = max(stages[table.name_], table.stage_);
+            }
+            PRINT_VERBOSE("%s stage %d: %s\n", forIng ? "Ingress" : "Egress", table.stage_, table.name_.c_str());
+        }
+    }
+
+    for (auto& kv : stages) {
+        string* pragma = pragmas[kv.first];
+        if (kv.second >= NUM_STAGES) {
+            PANIC("Table %s pinned by %s needs stage %d, past the last stage %d\n",
+                  kv.first.c_str(), pragma->c_str(), kv.second, NUM_STAGES - 1);
+        }
+        if (kv.second != pragmaStage(*pragma)) {
+            *pragma = withPragmaStage(*pragma, kv.second);
+        }
+    }
+}
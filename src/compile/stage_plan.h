@@ -0,0 +1,61 @@
+/* Copyright 2020-present University of Pennsylvania
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef STAGE_PLAN_H
+#define STAGE_PLAN_H
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "../../include/compile.h"
+
+// A table of one pipeline as the stage planner sees it
+struct PlannedTable {
+    string name_;
+    // Fields matched on or read by the actions, and fields the actions write
+    set<string> reads_;
+    set<string> writes_;
+    int alus_ = 0;
+    // Tables on opposite branches of one gateway never depend on each other
+    string exclusive_;
+    // Shares a register with the table before it, so takes its stage
+    bool withPrevious_ = false;
+    // @pragma stage of the program, -1 without
+    int pinned_ = -1;
+    bool injected_ = false;
+    int stage_ = -1;
+};
+
+// Places the tables, in the order they are applied, in the earliest stage
+// after every table they have a match, action or output dependency on, no
+// earlier than the tables reading what they write, and with room left for
+// them.  A pinned table stays in its stage unless that
+// comes too early or is full, a table sharing a register with the previous
+// one joins it.
+void placeTables(vector<PlannedTable>* tables);
+
+// Plans the stages of the user tables together with the tables injected
+// around them: __tiSetVars and the __tiSelect tables before, the pack,
+// SetArgs and register replica tables after.  @pragma stage of the user
+// tables is rewritten to the planned stage.
+void planStages(const NodeRegistry& nodes, const SymbolTable& symbols,
+                const unordered_map<string, P4RMalleableFieldNode*>& mblFields,
+                const vector<ReactionArgNode*>& reactionArgs,
+                const vector<ReactionArgBin>& ingBins, const vector<ReactionArgBin>& egrBins,
+                int ingIsoOpt, int egrIsoOpt, bool pairArgBins, bool mergeArgTables, bool singleRegReplica,
+                int dirtyBlock, vector<TableStage>* ingStages, vector<TableStage>* egrStages);
+
+#endif
@@ -0,0 +1,161 @@
+/* Copyright 2020-present University of Pennsylvania
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../../include/symbol_table.h"
+#include "../../include/find_nodes.h"
+#include "../../include/helper.h"
+
+static const std::vector<P4StatefulAluNode*> kNoAlus;
+static const std::vector<ActionNode*> kNoActions;
+static const std::vector<TableNode*> kNoTables;
+
+template<class T>
+static T* lookup(const std::unordered_map<std::string, T*>& m, const std::string& name) {
+    auto it = m.find(name);
+    return it == m.end() ? NULL : it->second;
+}
+
+template<class T>
+static const std::vector<T*>& lookupEdges(const std::unordered_map<std::string, std::vector<T*>>& m,
+                                          const std::string& name,
+                                          const std::vector<T*>& none) {
+    auto it = m.find(name);
+    return it == m.end() ? none : it->second;
+}
+
+void SymbolTable::build(const NodeRegistry& nodes) {
+    nodes_ = &nodes;
+
+    for (auto node : nodes.ofKind(P4_REGISTER_NODE)) {
+        auto reg = dynamic_cast<P4RegisterNode*>(node);
+        registers_.emplace(reg->name_->toString(), reg);
+    }
+
+    for (auto alu : nodes.allOf<P4StatefulAluNode>(P4_STATEFUL_ALU_NODE)) {
+        blackboxes_.emplace(alu->name(), alu);
+        if (alu->reg() != NULL) {
+            regBlackboxes_[*alu->reg()].push_back(alu);
+        }
+    }
+
+    std::unordered_map<std::string, FieldDecsNode*> typeFields;
+    for (auto node : nodes.ofKind(HEADER_TYPE_DECLARATION_NODE)) {
+        auto headerType = dynamic_cast<HeaderTypeDeclarationNode*>(node);
+        typeFields.emplace(headerType->name_->toString(), headerType->field_decs_);
+    }
+    for (auto node : nodes.ofKind(HEADER_INSTANCE_NODE)) {
+        auto instance = dynamic_cast<HeaderInstanceNode*>(node);
+        instanceFields_.emplace(instance->name_->toString(), lookup(typeFields, instance->type_->toString()));
+    }
+    for (auto node : nodes.ofKind(METADATA_INSTANCE_NODE)) {
+        auto instance = dynamic_cast<MetadataInstanceNode*>(node);
+        instanceFields_.emplace(instance->name_->toString(), lookup(typeFields, instance->type_->toString()));
+    }
+
+    for (auto node : nodes.ofKind(P4_EXPR_NODE)) {
+        auto expr = dynamic_cast<P4ExprNode*>(node);
+        if (p4KeywordMatches(expr, "control")) {
+            controls_.emplace(expr->name1_->toString(), expr);
+        }
+    }
+
+    for (auto node : nodes.ofKind(ACTION_NODE)) {
+        addAction(dynamic_cast<ActionNode*>(node));
+    }
+
+    for (auto node : nodes.ofKind(TABLE_NODE)) {
+        auto table = dynamic_cast<TableNode*>(node);
+        tables_.emplace(*table->name_->word_, table);
+        for (TableActionStmtNode* tas : *table->actions_->list_) {
+            actionTables_[*tas->name_->word_].push_back(table);
+        }
+    }
+
+    applyGraph_.build(nodes);
+}
+
+TableNode* SymbolTable::table(const std::string& name) const {
+    return lookup(tables_, name);
+}
+
+ActionNode* SymbolTable::action(const std::string& name) const {
+    return lookup(actions_, name);
+}
+
+P4RegisterNode* SymbolTable::reg(const std::string& name) const {
+    return lookup(registers_, name);
+}
+
+P4StatefulAluNode* SymbolTable::blackbox(const std::string& name) const {
+    return lookup(blackboxes_, name);
+}
+
+P4ExprNode* SymbolTable::control(const std::string& name) const {
+    return lookup(controls_, name);
+}
+
+int SymbolTable::fieldWidth(const std::string& instance, const std::string& field) const {
+    FieldDecsNode* fields = lookup(instanceFields_, instance);
+    if (fields == NULL) {
+        return -1;
+    }
+    for (FieldDecNode* fd : *fields->list_) {
+        if (*fd->name_->word_ == field) {
+            return atoi(fd->size_->word_->c_str());
+        }
+    }
+    return -1;
+}
+
+const std::vector<P4StatefulAluNode*>& SymbolTable::blackboxesOn(const std::string& regName) const {
+    return lookupEdges(regBlackboxes_, regName, kNoAlus);
+}
+
+const std::vector<ActionNode*>& SymbolTable::actionsExecuting(const std::string& blackboxName) const {
+    return lookupEdges(aluActions_, blackboxName, kNoActions);
+}
+
+const std::vector<TableNode*>& SymbolTable::tablesListing(const std::string& actionName) const {
+    return lookupEdges(actionTables_, actionName, kNoTables);
+}
+
+void SymbolTable::renameAction(const std::string& oldName, const std::string& newName) {
+    auto it = actions_.find(oldName);
+    if (it != actions_.end()) {
+        ActionNode* action = it->second;
+        actions_.erase(it);
+        actions_[newName] = action;
+    }
+    auto edges = actionTables_.find(oldName);
+    if (edges != actionTables_.end()) {
+        vector<TableNode*> tables = edges->second;
+        actionTables_.erase(edges);
+        actionTables_[newName] = tables;
+    }
+}
+
+void SymbolTable::addAction(ActionNode* action) {
+    actions_.emplace(action->name_->toString(), action);
+    // <blackbox>.execute_stateful_alu(...)
+    for (ActionStmtNode* as : *action->stmts_->list_) {
+        if (as->executesStatefulAlu()) {
+            aluActions_[*as->name1_->word_].push_back(action);
+        }
+    }
+}
+
+void SymbolTable::addTableAction(TableNode* table, const std::string& actionName) {
+    actionTables_[actionName].push_back(table);
+}
@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+# Copyright 2020-present University of Pennsylvania
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Compiles synthetic programs of growing size (see gen_p4r.py) and writes one
+# CSV row per program: its dimensions, the time of every compiler phase, the
+# syntax tree nodes, output sizes and the peak RSS of the frontend, e.g.
+#   ./util/bench_frontend.py --scales 1,4,16,64 --vary tables -o bench.csv
+# Every dimension is its gen_p4r.py default times the scale, --vary only
+# scales the given ones.
+
+import argparse
+import json
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import gen_p4r
+
+PHASES = ["parse", "p4", "c", "emit"]
+
+
+def run_frontend(frontend, p4r, out_base, pass_threads):
+    """Compiles p4r, returns its wall time, peak RSS in kB and stats report"""
+    cmd = [frontend, "-i", p4r, "-o", out_base, "--pass-threads", str(pass_threads),
+           "--time-passes", "--mem-report", "--stats-json"]
+    start = time.time()
+    proc = subprocess.Popen(cmd, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE)
+    stderr = proc.stderr.read()
+    # Resource usage of this child alone, in kB on Linux
+    _, status, usage = os.wait4(proc.pid, 0)
+    seconds = time.time() - start
+    if not os.WIFEXITED(status) or os.WEXITSTATUS(status) != 0:
+        sys.exit("FAILED %s:\n%s" % (" ".join(cmd), stderr.decode()))
+    return seconds, usage.ru_maxrss, json.loads(stderr.decode())
+
+
+def bench(args, scale, workdir):
+    sizes = argparse.Namespace()
+    for name, default, _ in gen_p4r.DIMENSIONS:
+        varied = args.vary is None or name in args.vary
+        setattr(sizes, name, default * scale if varied else default)
+
+    p4r = os.path.join(workdir, "bench_%d.p4r" % scale)
+    with open(p4r, "w") as f:
+        f.write(gen_p4r.generate(sizes))
+    out_base = os.path.join(workdir, "bench_%d" % scale)
+
+    # The fastest of the repeats, peak RSS does not vary between them
+    best = None
+    for _ in range(args.repeat):
+        seconds, rss, stats = run_frontend(args.frontend, p4r, out_base, args.pass_threads)
+        if best is None or seconds < best[0]:
+            best = (seconds, rss, stats)
+    seconds, rss, stats = best
+
+    row = {"scale": scale}
+    for name, _, _ in gen_p4r.DIMENSIONS:
+        row[name] = getattr(sizes, name)
+    row["p4r_bytes"] = os.path.getsize(p4r)
+    phases = dict((phase["phase"], phase) for phase in stats["phases"])
+    for phase in PHASES:
+        row[phase + "_ms"] = phases[phase]["ms"] if phase in phases else 0
+    row["passes_ms"] = stats["total"]["ms"]
+    row["wall_ms"] = round(seconds * 1e3, 3)
+    row["nodes"] = stats["total"]["nodes"]
+    row["arena_bytes"] = stats["total"]["arena_bytes"]
+    row["heap_bytes"] = stats["total"]["heap_bytes"]
+    row["p4_bytes"] = os.path.getsize(out_base + "_mantis.p4")
+    row["c_bytes"] = os.path.getsize(out_base + "_mantis.c")
+    row["peak_rss_kb"] = rss
+    return row
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Frontend scaling benchmark")
+    parser.add_argument("--frontend", default="./frontend", help="frontend binary (default ./frontend)")
+    parser.add_argument("--scales", default="1,2,4,8,16,32",
+                        help="comma separated size multipliers (default 1,2,4,8,16,32)")
+    parser.add_argument("--vary", help="comma separated dimensions to scale, all by default: " +
+                        ", ".join(name for name, _, _ in gen_p4r.DIMENSIONS))
+    parser.add_argument("--repeat", type=int, default=3, help="runs per program, the fastest is kept (default 3)")
+    parser.add_argument("--pass-threads", type=int, default=1,
+                        help="--pass-threads of the frontend (default 1, passes in sequence)")
+    parser.add_argument("--keep", help="directory to keep the programs and outputs in")
+    parser.add_argument("-o", "--output", help="CSV file, stdout by default")
+    args = parser.parse_args()
+
+    dimensions = [name for name, _, _ in gen_p4r.DIMENSIONS]
+    if args.vary is not None:
+        args.vary = args.vary.replace("-", "_").split(",")
+        for name in args.vary:
+            if name not in dimensions:
+                sys.exit("Unknown dimension %s, expected one of %s" % (name, ", ".join(dimensions)))
+
+    workdir = args.keep or tempfile.mkdtemp(prefix="mantis_bench_")
+    os.makedirs(workdir, exist_ok=True)
+    try:
+        rows = [bench(args, int(scale), workdir) for scale in args.scales.split(",")]
+    finally:
+        if args.keep is None:
+            shutil.rmtree(workdir)
+
+    out = open(args.output, "w") if args.output else sys.stdout
+    columns = list(rows[0].keys())
+    out.write(",".join(columns) + "\n")
+    for row in rows:
+        out.write(",".join(str(row[c]) for c in columns) + "\n")
+    if args.output:
+        out.close()
+
+
+if __name__ == "__main__":
+    main()
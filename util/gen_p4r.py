@@ -0,0 +1,206 @@
+#!/usr/bin/env python3
+# Copyright 2020-present University of Pennsylvania
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Synthetic P4R programs to measure how the frontend scales, e.g.
+#   ./util/gen_p4r.py --tables 64 --mbl-fields 8 --alts 16 -o big.p4r
+# The program is the same for the same arguments.
+
+import argparse
+import sys
+
+# Size of every program dimension, see --help
+DIMENSIONS = [
+    ("tables", 8, "plain tables, every other one applied in egress"),
+    ("actions", 2, "actions per plain table"),
+    ("mbl_values", 2, "malleable values, each used by a table"),
+    ("mbl_fields", 2, "malleable fields, each written by a table"),
+    ("mbl_tables", 1, "malleable tables"),
+    ("alts", 4, "alts of every malleable field"),
+    ("reg_args", 1, "registers passed to the reaction"),
+    ("ing_args", 2, "ingress fields passed to the reaction"),
+    ("egr_args", 2, "egress fields passed to the reaction"),
+    ("init_entries", 8, "table entries added by the init_block"),
+]
+
+
+def header(out, num_fields):
+    out.append("#include <tofino/intrinsic_metadata.p4>")
+    out.append("#include <tofino/constants.p4>")
+    out.append("#include <tofino/stateful_alu_blackbox.p4>")
+    out.append("#include <tofino/primitives.p4>")
+    out.append("")
+    out.append("header_type bench_t {")
+    out.append("  fields {")
+    for i in range(num_fields):
+        out.append("    f%d : 32;" % i)
+    out.append("  }")
+    out.append("}")
+    out.append("header bench_t hdr;")
+    out.append("")
+    out.append("parser start {")
+    out.append("  return parse_hdr;")
+    out.append("}")
+    out.append("parser parse_hdr {")
+    out.append("  extract(hdr);")
+    out.append("  return ingress;")
+    out.append("}")
+    out.append("")
+
+
+def table(out, name, actions, reads=None, default=None, malleable=False):
+    out.append("%stable %s {" % ("malleable " if malleable else "", name))
+    if reads is not None:
+        out.append("  reads {")
+        out.append("    %s : exact;" % reads)
+        out.append("  }")
+    out.append("  actions {")
+    for action in actions:
+        out.append("    %s;" % action)
+    out.append("  }")
+    if default is not None:
+        out.append("  default_action: %s();" % default)
+    else:
+        out.append("  size : 1024;")
+    out.append("}")
+    out.append("")
+
+
+def generate(args):
+    num_fields = max(8, args.alts, args.ing_args, args.egr_args)
+    field = lambda i: "hdr.f%d" % (i % num_fields)
+    out = []
+    ingress = []
+    egress = []
+    header(out, num_fields)
+
+    for t in range(args.tables):
+        actions = []
+        for a in range(args.actions):
+            name = "a_%d_%d" % (t, a)
+            out.append("action %s(p) {" % name)
+            out.append("  modify_field(%s, p);" % field(t + a + 1))
+            out.append("}")
+            out.append("")
+            actions.append(name)
+        table(out, "t_%d" % t, actions, reads=field(t))
+        (ingress if t % 2 == 0 else egress).append("t_%d" % t)
+
+    for v in range(args.mbl_values):
+        out.append("malleable value mv_%d {" % v)
+        out.append("  width : 16;")
+        out.append("  init : %d;" % (v + 1))
+        out.append("}")
+        out.append("")
+        out.append("action av_%d() {" % v)
+        out.append("  add_to_field(%s, ${mv_%d});" % (field(v), v))
+        out.append("}")
+        out.append("")
+        table(out, "tv_%d" % v, ["av_%d" % v], default="av_%d" % v)
+        ingress.append("tv_%d" % v)
+
+    for m in range(args.mbl_fields):
+        out.append("malleable field mf_%d {" % m)
+        out.append("  width : 32;")
+        out.append("  init : %s;" % field(0))
+        out.append("  alts { %s }" % ", ".join(field(i) for i in range(max(args.alts, 1))))
+        out.append("}")
+        out.append("")
+        out.append("action af_%d(p) {" % m)
+        out.append("  modify_field(${mf_%d}, p);" % m)
+        out.append("  add_to_field(%s, 1);" % field(m + 1))
+        out.append("}")
+        out.append("")
+        table(out, "tf_%d" % m, ["af_%d" % m], reads=field(m))
+        ingress.append("tf_%d" % m)
+
+    for m in range(args.mbl_tables):
+        out.append("action am_%d(p) {" % m)
+        out.append("  modify_field(%s, p);" % field(m + 2))
+        out.append("}")
+        out.append("")
+        table(out, "tm_%d" % m, ["am_%d" % m], reads=field(m), malleable=True)
+        ingress.append("tm_%d" % m)
+
+    for r in range(args.reg_args):
+        out.append("register r_%d {" % r)
+        out.append("  width : 32;")
+        out.append("  instance_count : 16;")
+        out.append("}")
+        out.append("")
+        out.append("blackbox stateful_alu b_%d {" % r)
+        out.append("  reg : r_%d;" % r)
+        out.append("  update_lo_1_value : register_lo + 1;")
+        out.append("}")
+        out.append("")
+        out.append("action ar_%d() {" % r)
+        out.append("  b_%d.execute_stateful_alu(0);" % r)
+        out.append("}")
+        out.append("")
+        table(out, "tr_%d" % r, ["ar_%d" % r], default="ar_%d" % r)
+        (ingress if r % 2 == 0 else egress).append("tr_%d" % r)
+
+    for name, applied in (("ingress", ingress), ("egress", egress)):
+        out.append("control %s {" % name)
+        for t in applied:
+            out.append("  apply(%s);" % t)
+        out.append("}")
+        out.append("")
+
+    if args.init_entries > 0:
+        out.append("init_block bench_init {")
+        tables = [("t_%d" % t, "a_%d_0" % t) for t in range(args.tables if args.actions > 0 else 0)]
+        tables += [("tm_%d" % m, "am_%d" % m) for m in range(args.mbl_tables)]
+        for i in range(args.init_entries if tables else 0):
+            name, action = tables[i % len(tables)]
+            out.append("  %s_add_%s(%d, 0x%x, %d);" % (name, action, i // len(tables), i, i))
+        out.append("}")
+        out.append("")
+
+    reaction_args = ["reg r_%d" % r for r in range(args.reg_args)]
+    reaction_args += ["ing %s" % field(i) for i in range(args.ing_args)]
+    reaction_args += ["egr %s" % field(i) for i in range(args.egr_args)]
+    out.append("reaction bench_reaction(%s) {" % ", ".join(reaction_args))
+    out.append("  static int round = 0;")
+    for v in range(args.mbl_values):
+        out.append("  ${mv_%d} = round;" % v)
+    for m in range(args.mbl_fields):
+        out.append("  ${mf_%d} = round %% %d;" % (m, max(args.alts, 1)))
+    out.append("  round++;")
+    out.append("}")
+    return "\n".join(out) + "\n"
+
+
+def add_arguments(parser):
+    for name, default, help in DIMENSIONS:
+        parser.add_argument("--" + name.replace("_", "-"), type=int, default=default,
+                            help="%s (default %d)" % (help, default))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Generate a synthetic P4R program")
+    add_arguments(parser)
+    parser.add_argument("-o", "--output", help="output file, stdout by default")
+    args = parser.parse_args()
+
+    program = generate(args)
+    if args.output:
+        with open(args.output, "w") as f:
+            f.write(program)
+    else:
+        sys.stdout.write(program)
+
+
+if __name__ == "__main__":
+    main()